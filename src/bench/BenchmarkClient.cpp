@@ -0,0 +1,265 @@
+// Load generator for the replication server, modelled on redis-benchmark.
+#include "server/RespProtocol.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace replication::server;
+
+namespace {
+
+struct BenchmarkOptions {
+    std::string host = "127.0.0.1";
+    int port = 6380;
+    int clients = 50;
+    long requests = 100000;
+    int pipeline = 1;
+    long keyspace = 10000;
+    size_t valueSize = 3;
+    std::vector<std::string> tests = {"set", "get"};
+};
+
+struct ClientResult {
+    long completed = 0;
+    long errors = 0;
+    std::vector<double> batchLatenciesMicros;
+};
+
+void printUsage() {
+    std::cout << "Usage: replication-benchmark [-h host] [-p port] [-c clients] [-n requests]\n"
+              << "                             [-P pipeline] [-r keyspace] [-d value-size]\n"
+              << "                             [-t set,get,mget,ping]" << std::endl;
+}
+
+std::vector<std::string> splitTests(const std::string& input) {
+    std::vector<std::string> tests;
+    std::istringstream stream(input);
+    std::string token;
+    while (std::getline(stream, token, ',')) {
+        if (!token.empty()) {
+            tests.push_back(token);
+        }
+    }
+    return tests;
+}
+
+bool parseOptions(int argc, char* argv[], BenchmarkOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help") {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << flag << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+        if (flag == "-h") {
+            options.host = value;
+        } else if (flag == "-p") {
+            options.port = std::stoi(value);
+        } else if (flag == "-c") {
+            options.clients = std::max(1, std::stoi(value));
+        } else if (flag == "-n") {
+            options.requests = std::max(1L, std::stol(value));
+        } else if (flag == "-P") {
+            options.pipeline = std::max(1, std::stoi(value));
+        } else if (flag == "-r") {
+            options.keyspace = std::max(1L, std::stol(value));
+        } else if (flag == "-d") {
+            options.valueSize = static_cast<size_t>(std::stoul(value));
+        } else if (flag == "-t") {
+            options.tests = splitTests(value);
+        } else {
+            std::cerr << "Unknown option " << flag << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int connectTo(const BenchmarkOptions& options) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (::inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    int noDelay = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+std::vector<std::string> buildCommand(const std::string& test, std::mt19937& random,
+                                      const BenchmarkOptions& options, const std::string& value) {
+    std::uniform_int_distribution<long> keyDist(0, options.keyspace - 1);
+    auto key = [&]() { return "key:" + std::to_string(keyDist(random)); };
+
+    if (test == "set") {
+        return {"SET", key(), value};
+    } else if (test == "get") {
+        return {"GET", key()};
+    } else if (test == "mget") {
+        std::vector<std::string> command = {"MGET"};
+        for (int i = 0; i < 10; i++) {
+            command.push_back(key());
+        }
+        return command;
+    }
+    return {"PING"};
+}
+
+/**
+ * Runs one client: sends batches of `pipeline` commands and waits for all
+ * replies before sending the next batch.
+ */
+void runClient(const BenchmarkOptions& options, const std::string& test, long requests,
+               unsigned seed, ClientResult& result) {
+    int fd = connectTo(options);
+    if (fd < 0) {
+        result.errors = requests;
+        return;
+    }
+
+    std::mt19937 random(seed);
+    std::string value(options.valueSize, 'x');
+    std::string request;
+    std::string input;
+    char buffer[64 * 1024];
+
+    while (result.completed + result.errors < requests) {
+        long batch = std::min<long>(options.pipeline, requests - result.completed - result.errors);
+        request.clear();
+        for (long i = 0; i < batch; i++) {
+            RespWriter::appendCommand(request, buildCommand(test, random, options, value));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t sent = 0;
+        while (sent < request.size()) {
+            ssize_t written = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0) {
+                ::close(fd);
+                result.errors += requests - result.completed - result.errors;
+                return;
+            }
+            sent += static_cast<size_t>(written);
+        }
+
+        long replies = 0;
+        while (replies < batch) {
+            size_t consumed = 0;
+            bool isError = false;
+            auto status = RespParser::skipReply(input.data(), input.size(), consumed, isError);
+            if (status == RespParser::Status::COMPLETE) {
+                input.erase(0, consumed);
+                replies++;
+                if (isError) {
+                    result.errors++;
+                } else {
+                    result.completed++;
+                }
+                continue;
+            }
+            if (status == RespParser::Status::ERROR) {
+                ::close(fd);
+                result.errors += requests - result.completed - result.errors;
+                return;
+            }
+            ssize_t bytesRead = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (bytesRead <= 0) {
+                ::close(fd);
+                result.errors += requests - result.completed - result.errors;
+                return;
+            }
+            input.append(buffer, static_cast<size_t>(bytesRead));
+        }
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        result.batchLatenciesMicros.push_back(
+            std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+
+    ::close(fd);
+}
+
+double percentile(std::vector<double>& values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(fraction * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void runTest(const BenchmarkOptions& options, const std::string& test) {
+    std::vector<ClientResult> results(options.clients);
+    std::vector<std::thread> clients;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.clients; i++) {
+        long share = options.requests / options.clients + (i < options.requests % options.clients ? 1 : 0);
+        clients.emplace_back(runClient, std::cref(options), std::cref(test), share,
+                             static_cast<unsigned>(i + 1), std::ref(results[i]));
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long completed = 0;
+    long errors = 0;
+    std::vector<double> latencies;
+    for (auto& result : results) {
+        completed += result.completed;
+        errors += result.errors;
+        latencies.insert(latencies.end(), result.batchLatenciesMicros.begin(),
+                         result.batchLatenciesMicros.end());
+    }
+
+    std::string name = test;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    std::cout << "====== " << name << " ======\n"
+              << "  " << completed << " requests completed in " << std::fixed << std::setprecision(2)
+              << seconds << " seconds (" << errors << " errors)\n"
+              << "  " << options.clients << " parallel clients, pipeline " << options.pipeline << "\n"
+              << "  throughput: " << (seconds > 0 ? completed / seconds : 0.0) << " requests per second\n"
+              << "  batch latency p50: " << percentile(latencies, 0.50) << " us"
+              << ", p99: " << percentile(latencies, 0.99) << " us"
+              << ", max: " << percentile(latencies, 1.0) << " us\n" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    for (const auto& test : options.tests) {
+        runTest(options, test);
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+// Runs a large cluster in one process on a shared event loop and measures replication throughput.
+#include "system/ReplicationSystem.h"
+#include "node/EventLoop.h"
+#include "bench/ProcessStats.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+using namespace replication;
+
+namespace {
+
+struct ClusterBenchmarkOptions {
+    int shards = 100;
+    int slavesPerShard = 9;
+    size_t loopThreads = 4;
+    int writers = 4;
+    long writesPerWriter = 5000;
+    system::TopologyConfig::Type topology = system::TopologyConfig::Type::STAR;
+};
+
+void printUsage() {
+    std::cout << "Usage: replication-cluster-benchmark [-s shards] [-r slaves-per-shard] [-t loop-threads]\n"
+              << "                                     [-w writers] [-n writes-per-writer]\n"
+              << "                                     [-c star|chain|tree]" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], ClusterBenchmarkOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help" || i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (flag == "-s") {
+            options.shards = std::max(1, std::stoi(value));
+        } else if (flag == "-r") {
+            options.slavesPerShard = std::max(1, std::stoi(value));
+        } else if (flag == "-t") {
+            options.loopThreads = std::max(1UL, std::stoul(value));
+        } else if (flag == "-w") {
+            options.writers = std::max(1, std::stoi(value));
+        } else if (flag == "-n") {
+            options.writesPerWriter = std::max(1L, std::stol(value));
+        } else if (flag == "-c") {
+            if (value == "star") {
+                options.topology = system::TopologyConfig::Type::STAR;
+            } else if (value == "chain") {
+                options.topology = system::TopologyConfig::Type::CHAIN;
+            } else if (value == "tree") {
+                options.topology = system::TopologyConfig::Type::TREE;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    ClusterBenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    // Nodes log every replicated entry; keep that out of the measurement
+    std::streambuf* console = std::cout.rdbuf(nullptr);
+    auto eventLoop = std::make_shared<node::EventLoop>(options.loopThreads);
+
+    auto setupStart = std::chrono::steady_clock::now();
+    system::ReplicationSystem replicationSystem(options.slavesPerShard, options.shards, eventLoop);
+    system::FailoverConfig failover;
+    failover.enabled = false;
+    replicationSystem.configureFailover(failover);
+    system::TopologyConfig topology;
+    topology.type = options.topology;
+    replicationSystem.configureTopology(topology);
+    double setupSeconds = secondsSince(setupStart);
+    int threads = bench::countProcessThreads();
+
+    // Every writer is a synchronous client spreading keys over all shards
+    std::atomic<long> failedWrites{0};
+    auto writeStart = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int w = 0; w < options.writers; w++) {
+        writers.emplace_back([&, w]() {
+            for (long i = 0; i < options.writesPerWriter; i++) {
+                std::string key = "key-" + std::to_string(w) + "-" + std::to_string(i % 1000);
+                if (!replicationSystem.write(key, std::to_string(i))) {
+                    failedWrites++;
+                }
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    double writeSeconds = secondsSince(writeStart);
+    bool caughtUp = replicationSystem.quiesce(std::chrono::seconds(120));
+    double totalSeconds = secondsSince(writeStart);
+
+    long writes = static_cast<long>(options.writers) * options.writesPerWriter - failedWrites;
+    long lagging = 0;
+    for (int s = 0; s < replicationSystem.getShardCount(); s++) {
+        long index = replicationSystem.getMaster(s)->getLastLogIndex();
+        for (const auto& slave : replicationSystem.getSlaves(s)) {
+            lagging += slave->getLastLogIndex() < index ? 1 : 0;
+        }
+    }
+    uint64_t tasksRun = eventLoop->getTasksRun();
+    std::cout.rdbuf(console);
+
+    int nodes = options.shards * (options.slavesPerShard + 1);
+    std::cout << std::fixed << std::setprecision(2)
+              << "nodes:               " << nodes << " (" << options.shards << " shards x "
+              << options.slavesPerShard << " slaves + master)\n"
+              << "process threads:     " << threads << " (" << eventLoop->getThreadCount() << " event loop)\n"
+              << "setup:               " << setupSeconds << " s\n"
+              << "writes:              " << writes << " in " << writeSeconds << " s ("
+              << static_cast<long>(writes / writeSeconds) << "/s)\n"
+              << "replicated applies:  " << writes * options.slavesPerShard << " in " << totalSeconds << " s ("
+              << static_cast<long>(writes * options.slavesPerShard / totalSeconds) << "/s)\n"
+              << "event loop tasks:    " << tasksRun << "\n"
+              << "caught up:           " << (caughtUp && lagging == 0 ? "yes" : "no, " + std::to_string(lagging)
+                                                                             + " slaves behind")
+              << std::endl;
+
+    replicationSystem.shutdown();
+    return caughtUp && lagging == 0 ? 0 : 1;
+}
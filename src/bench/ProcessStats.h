@@ -0,0 +1,29 @@
+#ifndef PROCESS_STATS_H
+#define PROCESS_STATS_H
+
+#include <fstream>
+#include <string>
+
+namespace replication {
+namespace bench {
+
+/**
+ * Gets the number of threads in this process, from /proc. Shared by the
+ * benchmarks and the tests that check how many threads a cluster costs.
+ * @return the thread count, or 0 where /proc is unavailable
+ */
+inline int countProcessThreads() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("Threads:", 0) == 0) {
+            return std::stoi(line.substr(8));
+        }
+    }
+    return 0;
+}
+
+} // namespace bench
+} // namespace replication
+
+#endif // PROCESS_STATS_H
@@ -0,0 +1,162 @@
+// Group-commit benchmark comparing the write-ahead log I/O backends.
+#include "storage/WriteAheadLog.h"
+#include "model/LogEntry.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+
+using namespace replication;
+
+namespace {
+
+struct WalBenchmarkOptions {
+    std::string directory = "wal-bench";
+    int threads = 16;
+    long entriesPerThread = 2000;
+    size_t valueSize = 100;
+    storage::CompressionType compression = storage::CompressionType::NONE;
+    std::vector<storage::IoBackendType> backends = {storage::IoBackendType::POSIX,
+                                                    storage::IoBackendType::IO_URING};
+};
+
+void printUsage() {
+    std::cout << "Usage: replication-wal-benchmark [-d directory] [-t threads] [-n entries-per-thread]\n"
+              << "                                 [-s value-size] [-b posix|io_uring|both]\n"
+              << "                                 [-z none|fast|dictionary]" << std::endl;
+}
+
+bool parseOptions(int argc, char* argv[], WalBenchmarkOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--help" || i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (flag == "-d") {
+            options.directory = value;
+        } else if (flag == "-t") {
+            options.threads = std::max(1, std::stoi(value));
+        } else if (flag == "-n") {
+            options.entriesPerThread = std::max(1L, std::stol(value));
+        } else if (flag == "-s") {
+            options.valueSize = static_cast<size_t>(std::stoul(value));
+        } else if (flag == "-b") {
+            if (value == "posix") {
+                options.backends = {storage::IoBackendType::POSIX};
+            } else if (value == "io_uring") {
+                options.backends = {storage::IoBackendType::IO_URING};
+            } else if (value != "both") {
+                return false;
+            }
+        } else if (flag == "-z") {
+            if (value == "none") {
+                options.compression = storage::CompressionType::NONE;
+            } else if (value == "fast") {
+                options.compression = storage::CompressionType::FAST;
+            } else if (value == "dictionary") {
+                options.compression = storage::CompressionType::DICTIONARY;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Every thread behaves like a synchronous client: append one entry, then
+ * wait until it is durable. Concurrent waiters share fdatasync calls.
+ */
+void runBackend(const WalBenchmarkOptions& options, storage::IoBackendType type) {
+    std::string directory = options.directory + (type == storage::IoBackendType::POSIX ? "/posix" : "/uring");
+    std::filesystem::remove_all(directory);
+
+    storage::WalConfig config;
+    config.directory = directory;
+    config.backend = type;
+    config.compression = options.compression;
+    config.dictionary = storage::Compressor::trainDictionary({std::string(options.valueSize, 'v')});
+    storage::WriteAheadLog wal(config);
+    if (!wal.open()) {
+        std::cerr << "Could not open WAL in " << directory << std::endl;
+        return;
+    }
+
+    std::mutex sequenceMutex;
+    long nextIndex = 1;
+    std::string value(options.valueSize, 'v');
+    std::vector<std::vector<double>> latencies(options.threads);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < options.threads; t++) {
+        workers.emplace_back([&, t] {
+            for (long i = 0; i < options.entriesPerThread; i++) {
+                auto begin = std::chrono::steady_clock::now();
+                long index = 0;
+                {
+                    // Indices must reach the WAL in order, as under the master's write lock
+                    std::lock_guard<std::mutex> guard(sequenceMutex);
+                    index = nextIndex++;
+                    wal.append(model::LogEntry(index, "key-" + std::to_string(t) + "-" + std::to_string(i), value));
+                }
+                wal.waitForDurable(index);
+                latencies[t].push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - begin).count());
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> all;
+    for (auto& perThread : latencies) {
+        all.insert(all.end(), perThread.begin(), perThread.end());
+    }
+    std::sort(all.begin(), all.end());
+    long total = static_cast<long>(all.size());
+    uint64_t syncs = wal.getSyncCount();
+
+    std::cout << "====== " << wal.getBackendName() << " ======\n" << std::fixed << std::setprecision(2)
+              << "  " << total << " durable appends in " << seconds << " seconds ("
+              << options.threads << " threads, " << options.valueSize << " byte values)\n"
+              << "  throughput: " << total / seconds << " appends per second\n"
+              << "  syncs: " << syncs << " (" << (syncs ? static_cast<double>(total) / syncs : 0.0)
+              << " entries per sync)\n"
+              << "  commit latency p50: " << all[all.size() / 2] << " us, p99: "
+              << all[static_cast<size_t>((all.size() - 1) * 0.99)] << " us" << std::endl;
+
+    wal.close();
+    uintmax_t logBytes = 0;
+    for (const auto& file : std::filesystem::directory_iterator(directory)) {
+        logBytes += file.is_regular_file() ? file.file_size() : 0;
+    }
+    std::cout << "  on-disk size: " << logBytes << " bytes\n" << std::endl;
+    std::filesystem::remove_all(directory);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    WalBenchmarkOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    for (auto type : options.backends) {
+        runBackend(options, type);
+    }
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "system/ReplicationSystem.h"
 #include "model/LogEntry.h"
+#include "server/ReplicationServer.h"
+#include "sim/Simulation.h"
 
 #include <iostream>
 #include <string>
@@ -10,6 +12,9 @@
 #include <map>
 #include <ctime>
 #include <iomanip>
+#include <atomic>
+#include <csignal>
+#include <algorithm>
 
 using namespace replication;
 using namespace std::chrono_literals;
@@ -17,20 +22,102 @@ using namespace std::chrono_literals;
 // Forward declarations
 void demoSystem(system::ReplicationSystem& system);
 void interactiveMode(system::ReplicationSystem& system);
+void serverMode(system::ReplicationSystem& system, uint16_t port);
+int simulateMode(int scenarios, uint64_t firstSeed);
 std::vector<std::string> splitString(const std::string& input, char delimiter);
 
 int main(int argc, char* argv[]) {
     std::cout << "Starting Master-Slave Replication System with Fault Tolerance" << std::endl;
     
-    // Create a replication system with 3 slaves
-    system::ReplicationSystem system(3);
+    // Deterministic simulation runs without a live system: --simulate [scenarios] [seed]
+    if (argc > 1 && std::string(argv[1]) == "--simulate") {
+        int scenarios = argc > 2 ? std::stoi(argv[2]) : 1000;
+        uint64_t seed = argc > 3 ? std::stoull(argv[3]) : 1;
+        return simulateMode(scenarios, seed);
+    }
+    
+    // Optional keyspace partitioning: --shards <n>
+    // Optional failover tuning: --election-timeout <ms> (0 disables automatic failover)
+    // Optional relay topology: --topology star|chain|tree[:fanout]
+    // Optional bounded cache: --max-memory <bytes>[:lru|lfu] per shard
+    // Optional key layout: --engine tree|radix|lsm:<directory>
+    // Optional seed data: --bulk-load <file> (.csv or binary key/value records)
+    // Optional shared runtime: --event-loop <threads> runs every node's replication work on one loop
+    int numShards = 1;
+    size_t eventLoopThreads = 0;
+    std::string bulkLoadPath;
+    system::FailoverConfig failover;
+    system::TopologyConfig topology;
+    system::MemoryConfig memory;
+    system::StorageConfig storage;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--shards") {
+            numShards = std::max(1, std::stoi(argv[i + 1]));
+        } else if (std::string(argv[i]) == "--election-timeout") {
+            long timeoutMs = std::stol(argv[i + 1]);
+            failover.enabled = timeoutMs > 0;
+            failover.electionTimeout = std::chrono::milliseconds(timeoutMs);
+        } else if (std::string(argv[i]) == "--topology") {
+            std::string type = argv[i + 1];
+            if (type == "chain") {
+                topology.type = system::TopologyConfig::Type::CHAIN;
+            } else if (type.rfind("tree", 0) == 0) {
+                topology.type = system::TopologyConfig::Type::TREE;
+                if (type.size() > 5 && type[4] == ':') {
+                    topology.fanout = std::max(1, std::stoi(type.substr(5)));
+                }
+            }
+        } else if (std::string(argv[i]) == "--max-memory") {
+            std::string limit = argv[i + 1];
+            size_t colon = limit.find(':');
+            memory.limitBytes = std::stoull(limit.substr(0, colon));
+            if (colon != std::string::npos && limit.substr(colon + 1) == "lfu") {
+                memory.policy = storage::StripedStore::EvictionPolicy::LFU;
+            }
+        } else if (std::string(argv[i]) == "--engine") {
+            std::string engine = argv[i + 1];
+            if (engine == "radix") {
+                storage.engine = storage::StripedStore::Engine::RADIX;
+            } else if (engine.rfind("lsm:", 0) == 0) {
+                storage.engine = storage::StripedStore::Engine::LSM;
+                storage.lsm.directory = engine.substr(4);
+            }
+        } else if (std::string(argv[i]) == "--bulk-load") {
+            bulkLoadPath = argv[i + 1];
+        } else if (std::string(argv[i]) == "--event-loop") {
+            eventLoopThreads = std::max(1UL, std::stoul(argv[i + 1]));
+        }
+    }
+    
+    // Create a replication system with 3 slaves per shard
+    std::shared_ptr<node::EventLoop> eventLoop;
+    if (eventLoopThreads > 0) {
+        eventLoop = std::make_shared<node::EventLoop>(eventLoopThreads);
+    }
+    system::ReplicationSystem system(3, numShards, eventLoop);
+    system.configureFailover(failover);
+    system.configureTopology(topology);
+    system.configureMemory(memory);
+    system.configureStorage(storage);
+    
+    if (!bulkLoadPath.empty()) {
+        bool csv = bulkLoadPath.size() >= 4 && bulkLoadPath.compare(bulkLoadPath.size() - 4, 4, ".csv") == 0;
+        if (!system.bulkLoad(bulkLoadPath,
+                             csv ? storage::BulkReader::Format::CSV : storage::BulkReader::Format::BINARY,
+                             bulkLoadPath + ".images")) {
+            return 1;
+        }
+    }
     
     // Start the failure simulator with moderate probabilities
     // 10% chance of failure, 30% chance of recovery per 5 seconds
     system.startFailureSimulator(0.1, 0.3, 5);
     
-    // Check if we should run in demo mode
-    if (argc > 1 && std::string(argv[1]) == "--demo") {
+    // Check if we should run in demo or server mode
+    if (argc > 1 && std::string(argv[1]) == "--server") {
+        uint16_t port = argc > 2 ? static_cast<uint16_t>(std::stoi(argv[2])) : 6380;
+        serverMode(system, port);
+    } else if (argc > 1 && std::string(argv[1]) == "--demo") {
         try {
             demoSystem(system);
         } catch (const std::exception& e) {
@@ -134,7 +221,9 @@ void interactiveMode(system::ReplicationSystem& system) {
     std::string input;
     
     std::cout << "\n--- Interactive Mode ---" << std::endl;
-    std::cout << "Commands: write <key> <value> | read <key> | delete <key> | show | logs | status | exit" << std::endl;
+    std::cout << "Commands: write <key> <value> | read <key> | delete <key> | scan <prefix> | show | logs | status | "
+              << "add-slave [shard] | remove-slave <id> | exit"
+              << std::endl;
     
     while (true) {
         std::cout << "> ";
@@ -159,7 +248,7 @@ void interactiveMode(system::ReplicationSystem& system) {
                 std::cout << "(no log entries)" << std::endl;
             } else {
                 for (const auto& entry : logs) {
-                    std::string operationStr = entry.isDelete() ? "DELETE" : "WRITE";
+                    std::string operationStr = entry.getOperationName();
                     
                     // Format timestamp
                     auto timeMs = static_cast<time_t>(entry.getTimestamp() / 1000);
@@ -185,6 +274,32 @@ void interactiveMode(system::ReplicationSystem& system) {
             if (value.empty()) {
                 std::cout << "Key not found or all slaves are down" << std::endl;
             }
+        } else if (input.compare(0, 5, "scan ") == 0) {
+            for (const auto& [key, value] : system.scanPrefix(input.substr(5))) {
+                std::cout << key << " = " << value << std::endl;
+            }
+        } else if (input == "add-slave" || input.compare(0, 10, "add-slave ") == 0) {
+            int shard = 0;
+            try {
+                shard = input.size() > 10 ? std::stoi(input.substr(10)) : 0;
+            } catch (const std::exception&) {
+                std::cout << "Usage: add-slave [shard]" << std::endl;
+                continue;
+            }
+            if (shard < 0 || shard >= system.getShardCount()) {
+                std::cout << "No such shard" << std::endl;
+            } else if (auto slave = system.addSlave(shard)) {
+                std::cout << "Added " << slave->getId() << std::endl;
+            } else {
+                std::cout << "Add failed (no node to snapshot?)" << std::endl;
+            }
+        } else if (input.compare(0, 13, "remove-slave ") == 0) {
+            std::string slaveId = input.substr(13);
+            bool success = false;
+            for (int shard = 0; shard < system.getShardCount() && !success; shard++) {
+                success = system.removeSlave(shard, slaveId);
+            }
+            std::cout << (success ? "Removed " + slaveId : "Remove failed (unknown or last slave)") << std::endl;
         } else if (input.compare(0, 7, "delete ") == 0) {
             std::string key = input.substr(7);
             bool success = system.deleteKey(key);
@@ -215,13 +330,44 @@ void interactiveMode(system::ReplicationSystem& system) {
                 std::cout << "Usage: write <key> <value>" << std::endl;
             }
         } else {
-            std::cout << "Unknown command. Use write, read, delete, show, logs, status, or exit" << std::endl;
+            std::cout << "Unknown command. Use write, read, delete, scan, show, logs, status, add-slave, remove-slave, "
+                      << "or exit" << std::endl;
         }
     }
     
     system.shutdown();
 }
 
+namespace {
+std::atomic<bool> serverStopRequested(false);
+
+void handleStopSignal(int) {
+    serverStopRequested = true;
+}
+} // namespace
+
+void serverMode(system::ReplicationSystem& system, uint16_t port) {
+    server::ServerConfig config;
+    config.port = port;
+    server::ReplicationServer server(system, config);
+    if (!server.start()) {
+        system.shutdown();
+        return;
+    }
+
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+    std::cout << "Serving RESP clients on port " << server.getPort() 
+              << " (Ctrl+C to stop)" << std::endl;
+
+    while (!serverStopRequested && server.isRunning()) {
+        std::this_thread::sleep_for(200ms);
+    }
+
+    server.stop();
+    system.shutdown();
+}
+
 std::vector<std::string> splitString(const std::string& input, char delimiter) {
     std::vector<std::string> tokens;
     std::string token;
@@ -234,4 +380,33 @@ std::vector<std::string> splitString(const std::string& input, char delimiter) {
     }
     
     return tokens;
-}
\ No newline at end of file
+}
+
+int simulateMode(int scenarios, uint64_t firstSeed) {
+    std::cout << "Running " << scenarios << " simulated fault scenarios from seed " << firstSeed << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    int failures = 0;
+    
+    for (int i = 0; i < scenarios; i++) {
+        sim::SimulationConfig config;
+        config.seed = firstSeed + static_cast<uint64_t>(i);
+        config.faults = sim::Simulation::randomFaults(config.seed, config.numSlaves, 
+                                                      config.numOperations, 4, true);
+        
+        sim::Simulation simulation(config);
+        sim::SimulationResult result = simulation.run();
+        if (!result.consistent) {
+            failures++;
+            std::cout << "Seed " << config.seed << " FAILED:" << std::endl;
+            for (const auto& violation : result.violations) {
+                std::cout << "  " << violation << std::endl;
+            }
+        }
+    }
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << scenarios - failures << "/" << scenarios << " scenarios consistent in " 
+              << elapsed << " ms" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -1,24 +1,32 @@
 #include "model/LogEntry.h"
 #include <chrono>
 #include <sstream>
+#include <cstdlib>
 
 namespace replication {
 namespace model {
 
 LogEntry::LogEntry(long id, const std::string& key, const std::string& value)
-    : id_(id), key_(key), value_(value), operationType_(OperationType::WRITE) {
-    // Get current time in milliseconds since epoch
-    auto now = std::chrono::system_clock::now();
-    timestamp_ = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()).count();
+    : id_(id), key_(key), value_(value), timestamp_(currentTimeMillis()), term_(0),
+      operationType_(OperationType::WRITE) {
 }
 
 LogEntry::LogEntry(long id, const std::string& key, const std::string& value, 
                    OperationType operationType)
-    : id_(id), key_(key), value_(value), operationType_(operationType) {
+    : id_(id), key_(key), value_(value), timestamp_(currentTimeMillis()), term_(0),
+      operationType_(operationType) {
+}
+
+LogEntry::LogEntry(long id, const std::string& key, const std::string& value,
+                   OperationType operationType, long timestamp, long term)
+    : id_(id), key_(key), value_(value), timestamp_(timestamp), term_(term),
+      operationType_(operationType) {
+}
+
+long LogEntry::currentTimeMillis() {
     // Get current time in milliseconds since epoch
     auto now = std::chrono::system_clock::now();
-    timestamp_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
         now.time_since_epoch()).count();
 }
 
@@ -38,6 +46,10 @@ long LogEntry::getTimestamp() const {
     return timestamp_;
 }
 
+long LogEntry::getTerm() const {
+    return term_;
+}
+
 LogEntry::OperationType LogEntry::getOperationType() const {
     return operationType_;
 }
@@ -46,13 +58,42 @@ bool LogEntry::isDelete() const {
     return operationType_ == OperationType::DELETE;
 }
 
+bool LogEntry::isExpire() const {
+    return operationType_ == OperationType::EXPIRE;
+}
+
+bool LogEntry::isLoad() const {
+    return operationType_ == OperationType::LOAD;
+}
+
+long LogEntry::getExpiresAt() const {
+    return isExpire() ? std::strtol(value_.c_str(), nullptr, 10) : 0;
+}
+
+const char* LogEntry::getOperationName() const {
+    switch (operationType_) {
+        case OperationType::DELETE:
+            return "DELETE";
+        case OperationType::EXPIRE:
+            return "EXPIRE";
+        case OperationType::NOOP:
+            return "NOOP";
+        case OperationType::LOAD:
+            return "LOAD";
+        case OperationType::WRITE:
+        default:
+            return "WRITE";
+    }
+}
+
 std::string LogEntry::toString() const {
     std::ostringstream oss;
     oss << "LogEntry{id=" << id_
         << ", key='" << key_ << "'"
         << ", value='" << value_ << "'"
         << ", timestamp=" << timestamp_
-        << ", operation=" << (isDelete() ? "DELETE" : "WRITE") << "}";
+        << ", term=" << term_
+        << ", operation=" << getOperationName() << "}";
     return oss.str();
 }
 
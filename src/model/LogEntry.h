@@ -18,7 +18,10 @@ public:
      */
     enum class OperationType {
         WRITE,
-        DELETE
+        DELETE,
+        EXPIRE, // Sets the key's expiry deadline; the value holds it (empty clears it)
+        NOOP,   // Takes up a log ID without changing anything (a failed conditional operation)
+        LOAD    // Writes every pair of the bulk image file named by the value, at this entry's ID
     };
 
     /**
@@ -39,11 +42,29 @@ public:
     LogEntry(long id, const std::string& key, const std::string& value, 
              OperationType operationType);
 
+    /**
+     * Recreates a log entry with its original timestamp (e.g. when read back from disk).
+     * @param id the log entry ID
+     * @param key the key being operated on
+     * @param value the value (empty for delete operations)
+     * @param operationType the type of operation
+     * @param timestamp the original creation time in milliseconds since epoch
+     * @param term the leader term in which the entry was created
+     */
+    LogEntry(long id, const std::string& key, const std::string& value,
+             OperationType operationType, long timestamp, long term = 0);
+
+    /**
+     * Gets the current time in milliseconds since epoch, as used for timestamps.
+     */
+    static long currentTimeMillis();
+
     // Getters
     long getId() const;
     const std::string& getKey() const;
     const std::string& getValue() const;
     long getTimestamp() const;
+    long getTerm() const;
     OperationType getOperationType() const;
 
     /**
@@ -52,6 +73,29 @@ public:
      */
     bool isDelete() const;
 
+    /**
+     * Checks if this log entry sets or clears a key's expiry deadline.
+     */
+    bool isExpire() const;
+
+    /**
+     * Checks whether this log entry stands for a bulk load. Its value is
+     * the path of the image file holding the loaded pairs, in the snapshot
+     * format, and its key is empty.
+     */
+    bool isLoad() const;
+
+    /**
+     * Gets the deadline carried by an expire operation.
+     * @return milliseconds since epoch, or 0 if the entry clears the deadline
+     */
+    long getExpiresAt() const;
+
+    /**
+     * Gets the name of the operation, e.g. "WRITE".
+     */
+    const char* getOperationName() const;
+
     /**
      * Convert log entry to string representation
      */
@@ -62,6 +106,7 @@ private:
     std::string key_;
     std::string value_;
     long timestamp_;
+    long term_;
     OperationType operationType_;
 };
 
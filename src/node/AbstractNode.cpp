@@ -1,28 +1,45 @@
 #include "node/AbstractNode.h"
+#include "storage/SnapshotWriter.h"
+#include "storage/MemoryAccounting.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
 
 namespace replication {
 namespace node {
 
+namespace {
+
+// Smaller batches are applied sequentially; handing them to workers costs more than it saves
+constexpr size_t kParallelApplyMinBatch = 256;
+
+size_t heapBytes(const model::LogEntry& entry) {
+    return storage::heapBytes(entry.getKey()) + storage::heapBytes(entry.getValue());
+}
+
+} // namespace
+
 // Thread pool implementation
-AbstractNode::ThreadPool::ThreadPool(size_t num_threads) : stop(false) {
+AbstractNode::ThreadPool::ThreadPool(size_t num_threads) : state(std::make_shared<State>()) {
     for(size_t i = 0; i < num_threads; ++i) {
-        workers.emplace_back([this] {
+        workers.emplace_back([state = this->state] {
             while(true) {
                 std::function<void()> task;
                 
                 {
-                    std::unique_lock<std::mutex> lock(this->queue_mutex);
-                    this->condition.wait(lock, [this] { 
-                        return this->stop || !this->tasks.empty(); 
+                    std::unique_lock<std::mutex> lock(state->queue_mutex);
+                    state->condition.wait(lock, [&state] { 
+                        return state->stop || !state->tasks.empty(); 
                     });
                     
-                    if(this->stop && this->tasks.empty()) {
+                    if(state->stop && state->tasks.empty()) {
                         return;
                     }
                     
-                    task = std::move(this->tasks.front());
-                    this->tasks.pop();
+                    task = std::move(state->tasks.front());
+                    state->tasks.pop();
                 }
                 
                 task();
@@ -31,29 +48,53 @@ AbstractNode::ThreadPool::ThreadPool(size_t num_threads) : stop(false) {
     }
 }
 
+void AbstractNode::ThreadPool::execute(std::function<void()> task) {
+    enqueue(std::move(task));
+}
+
 AbstractNode::ThreadPool::~ThreadPool() {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+        state->stop = true;
     }
-    condition.notify_all();
+    state->condition.notify_all();
     
     for(std::thread &worker : workers) {
-        worker.join();
+        // A task may drop the last reference to the node owning this pool
+        if (worker.get_id() == std::this_thread::get_id()) {
+            worker.detach();
+        } else {
+            worker.join();
+        }
     }
 }
 
 // AbstractNode implementation
-AbstractNode::AbstractNode(const std::string& id) 
+AbstractNode::AbstractNode(const std::string& id, std::shared_ptr<Executor> executor) 
     : id_(id), 
       up_(true),
-      lock_(std::make_shared<std::shared_mutex>()),
+      logHeapBytes_(0),
+      logStartIndex_(0),
+      logCompaction_(false),
+      maxLogBytes_(0),
       lastAppliedIndex_(0),
-      replicationExecutor_(std::make_unique<ThreadPool>(5)) {
+      lastAppliedTimestamp_(0),
+      term_(0),
+      downSinceMillis_(-1),
+      coalescedCount_(0),
+      replicationExecutor_(executor ? std::move(executor) : std::make_shared<ThreadPool>(5)),
+      snapshotActive_(false),
+      stopping_(false),
+      expiringKeys_(0),
+      stateEpoch_(0),
+      historyHorizon_(0),
+      historyFloor_(0),
+      progressWaiters_(0) {
 }
 
 AbstractNode::~AbstractNode() {
-    // ThreadPool cleanup happens automatically via unique_ptr
+    // Abandon any snapshot load still queued; a private ThreadPool is joined when released
+    stopping_ = true;
 }
 
 std::string AbstractNode::getId() const {
@@ -66,12 +107,58 @@ bool AbstractNode::isUp() const {
 
 void AbstractNode::goDown() {
     std::cout << "Node " << id_ << " going DOWN" << std::endl;
+    downSinceMillis_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
     up_ = false;
+    notifyProgress();
 }
 
 void AbstractNode::goUp() {
     std::cout << "Node " << id_ << " coming UP" << std::endl;
     up_ = true;
+    downSinceMillis_ = -1;
+    notifyProgress();
+}
+
+long AbstractNode::getDownSinceMillis() const {
+    return downSinceMillis_.load();
+}
+
+long AbstractNode::getTerm() const {
+    return term_.load();
+}
+
+void AbstractNode::observeTerm(long term) {
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    if (term > term_) {
+        term_ = term;
+    }
+}
+
+bool AbstractNode::lookup(const std::string& key, std::string& value) const {
+    long version;
+    return lookup(key, value, version);
+}
+
+bool AbstractNode::lookup(const std::string& key, std::string& value, long& version) const {
+    if (dataStore_.get(key, value, version)) {
+        return true;
+    }
+    if (!snapshotActive_) {
+        return false;
+    }
+    
+    // Fall through to the snapshot while it is still being loaded. Look in the
+    // store again under the snapshot lock, in case the loader just moved the key.
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+    if (dataStore_.get(key, value, version)) {
+        return true;
+    }
+    if (snapshot_ && snapshotTombstones_.count(key) == 0 && snapshot_->get(key, value)) {
+        version = snapshot_->getLastIndex();
+        return true;
+    }
+    return false;
 }
 
 std::string AbstractNode::read(const std::string& key) {
@@ -80,12 +167,176 @@ std::string AbstractNode::read(const std::string& key) {
         return "";
     }
     
-    std::shared_lock<std::shared_mutex> readLock(*lock_);
-    auto it = dataStore_.find(key);
-    if (it != dataStore_.end()) {
-        return it->second;
+    std::string value;
+    lookup(key, value);
+    return value;
+}
+
+bool AbstractNode::readVersioned(const std::string& key, std::string& value, long& version) {
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot read" << std::endl;
+        return false;
     }
-    return "";
+    return lookup(key, value, version);
+}
+
+std::vector<std::string> AbstractNode::readMany(const std::vector<std::string>& keys) {
+    std::vector<bool> found;
+    return readMany(keys, found);
+}
+
+std::vector<std::string> AbstractNode::readMany(const std::vector<std::string>& keys, std::vector<bool>& found) {
+    found.assign(keys.size(), false);
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot read" << std::endl;
+        return std::vector<std::string>(keys.size());
+    }
+    
+    std::vector<std::string> values(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        found[i] = lookup(keys[i], values[i]);
+    }
+    return values;
+}
+
+std::vector<std::pair<std::string, std::string>> AbstractNode::scanPrefix(const std::string& prefix, size_t limit) {
+    std::vector<std::pair<std::string, std::string>> result;
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot read" << std::endl;
+        return result;
+    }
+    
+    if (snapshotActive_) {
+        // Part of the data may still be in the snapshot being loaded
+        auto copy = copyDataStore();
+        for (auto it = copy.lower_bound(prefix);
+             it != copy.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            if (limit > 0 && result.size() == limit) {
+                break;
+            }
+            result.emplace_back(it->first, std::move(it->second));
+        }
+        return result;
+    }
+    
+    for (auto& [key, entry] : dataStore_.scanPrefix(prefix, limit)) {
+        result.emplace_back(std::move(key), std::move(entry.value));
+    }
+    return result;
+}
+
+AbstractNode::ReadView::ReadView(AbstractNode& node, long index, uint64_t epoch)
+    : node_(node), index_(index), epoch_(epoch) {
+}
+
+AbstractNode::ReadView::~ReadView() {
+    node_.closeReadView(index_);
+}
+
+long AbstractNode::ReadView::getIndex() const {
+    return index_;
+}
+
+std::shared_ptr<AbstractNode::ReadView> AbstractNode::openReadView() {
+    return openReadView(-1);
+}
+
+std::shared_ptr<AbstractNode::ReadView> AbstractNode::openReadView(long index) {
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot read" << std::endl;
+        return nullptr;
+    }
+    
+    // Holding applyMutex_ pins the index: every entry applied after it sees the view
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    if (snapshotActive_) {
+        return nullptr;
+    }
+    long last = lastAppliedIndex_.load();
+    if (index < 0) {
+        index = last;
+    } else if (index > last || index < oldestReadableIndexLocked()) {
+        std::cout << "Node " << id_ << " cannot open a view at log index " << index << " (readable from "
+                  << oldestReadableIndexLocked() << " to " << last << ")" << std::endl;
+        return nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> viewsLock(viewsMutex_);
+        openViews_.insert(index);
+        dataStore_.setOldestReader(*openViews_.begin());
+    }
+    return std::shared_ptr<ReadView>(new ReadView(*this, index, stateEpoch_.load()));
+}
+
+void AbstractNode::closeReadView(long index) {
+    std::lock_guard<std::mutex> viewsLock(viewsMutex_);
+    openViews_.erase(openViews_.find(index));
+    if (openViews_.empty()) {
+        dataStore_.setOldestReader(storage::StripedStore::kNoReader);
+        if (historyHorizon_.load() == 0) {
+            dataStore_.clearHistory();
+        }
+    } else {
+        dataStore_.setOldestReader(*openViews_.begin());
+    }
+}
+
+bool AbstractNode::readAt(const ReadView& view, const std::vector<std::string>& keys,
+                          std::vector<std::string>& values) const {
+    values.assign(keys.size(), std::string());
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (dataStore_.getAt(keys[i], view.index_, values[i]) ==
+            storage::StripedStore::VersionLookup::DISCARDED) {
+            return false;
+        }
+    }
+    // Checked last: a state replaced mid-read invalidates what was read
+    return stateEpoch_.load() == view.epoch_;
+}
+
+bool AbstractNode::readConsistent(const std::vector<std::string>& keys, std::vector<std::string>& values,
+                                  long& index) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        auto view = openReadView();
+        if (!view) {
+            return false;
+        }
+        if (readAt(*view, keys, values)) {
+            index = view->getIndex();
+            return true;
+        }
+    }
+    std::cout << "Node " << id_ << " could not read " << keys.size()
+              << " keys consistently (history dropped)" << std::endl;
+    return false;
+}
+
+void AbstractNode::setVersionRetention(size_t versionsPerKey) {
+    dataStore_.setHistoryDepth(versionsPerKey);
+}
+
+void AbstractNode::setHistoryHorizon(long entries) {
+    entries = std::max(0L, entries);
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    // Values replaced beyond the old horizon may already be gone
+    historyFloor_ = std::max(historyFloor_, lastAppliedIndex_.load() - historyHorizon_.load());
+    historyHorizon_ = entries;
+    dataStore_.setHistoryHorizon(entries);
+    std::lock_guard<std::mutex> viewsLock(viewsMutex_);
+    if (entries == 0 && openViews_.empty()) {
+        dataStore_.clearHistory();
+    }
+}
+
+long AbstractNode::getOldestReadableIndex() const {
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    return oldestReadableIndexLocked();
+}
+
+long AbstractNode::oldestReadableIndexLocked() const {
+    long last = lastAppliedIndex_.load();
+    long horizon = historyHorizon_.load();
+    return horizon == 0 ? last : std::max(historyFloor_, last - horizon);
 }
 
 bool AbstractNode::deleteKey(const std::string& key) {
@@ -94,17 +345,28 @@ bool AbstractNode::deleteKey(const std::string& key) {
         return false;
     }
     
-    std::unique_lock<std::shared_mutex> writeLock(*lock_);
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
     
     // Check if the key exists before attempting to delete
-    auto it = dataStore_.find(key);
-    if (it == dataStore_.end()) {
+    std::string value;
+    if (!lookup(key, value)) {
         std::cout << "Node " << id_ << " could not delete key '" << key << "' (not found)" << std::endl;
         return false;
     }
     
-    // Remove the key from the data store
-    dataStore_.erase(it);
+    // Remove the key from the data store; open views keep seeing it, as the delete is not logged
+    if (snapshotActive_) {
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+        dataStore_.erase(key);
+        snapshotTombstones_.insert(key);
+    } else {
+        dataStore_.erase(key, lastAppliedIndex_.load() + 1);
+    }
+    {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        expiries_.erase(key);
+        expiringKeys_ = expiries_.size();
+    }
     std::cout << "Node " << id_ << " deleted key '" << key << "'" << std::endl;
     return true;
 }
@@ -115,8 +377,43 @@ std::map<std::string, std::string> AbstractNode::getDataStore() const {
         return {};
     }
     
-    std::shared_lock<std::shared_mutex> readLock(*lock_);
-    return dataStore_; // This creates a copy
+    return copyDataStore();
+}
+
+std::map<std::string, std::string> AbstractNode::copyDataStore() const {
+    if (!snapshotActive_) {
+        return dataStore_.copy();
+    }
+    
+    std::map<std::string, std::string> copy;
+    for (auto& [key, entry] : copyVersionedDataStore()) {
+        copy.emplace_hint(copy.end(), key, std::move(entry.value));
+    }
+    return copy;
+}
+
+std::map<std::string, storage::StripedStore::VersionedValue> AbstractNode::copyVersionedDataStore() const {
+    if (!snapshotActive_) {
+        return dataStore_.copyVersioned();
+    }
+    
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+    auto copy = dataStore_.copyVersioned();
+    
+    // Merge in whatever part of the snapshot has not been loaded yet
+    if (snapshot_) {
+        long version = snapshot_->getLastIndex();
+        for (size_t block = 0; block < snapshot_->getBlockCount(); block++) {
+            snapshot_->forEachInBlock(block, [&](std::string_view key, std::string_view value) {
+                std::string keyString(key);
+                if (snapshotTombstones_.count(keyString) == 0) {
+                    copy.emplace(std::move(keyString),
+                                 storage::StripedStore::VersionedValue{std::string(value), version});
+                }
+            });
+        }
+    }
+    return copy;
 }
 
 long AbstractNode::getLastLogIndex() const {
@@ -126,15 +423,447 @@ long AbstractNode::getLastLogIndex() const {
     return lastAppliedIndex_.load();
 }
 
-bool AbstractNode::applyLogEntry(const model::LogEntry& entry, 
-                                std::shared_ptr<std::shared_mutex> lock) {
+long AbstractNode::getAppliedIndex() const {
+    return lastAppliedIndex_.load();
+}
+
+bool AbstractNode::applyToDataStore(const model::LogEntry& entry) {
+    if (entry.isLoad()) {
+        auto image = storage::SnapshotReader::open(entry.getValue());
+        if (!image) {
+            std::cout << "Node " << id_ << " could not open bulk image " << entry.getValue() 
+                      << " (Log ID: " << entry.getId() << ")" << std::endl;
+            return false;
+        }
+        if (!image->verifyAll()) {
+            std::cout << "Node " << id_ << " found a corrupt block in bulk image " << entry.getValue() 
+                      << " (Log ID: " << entry.getId() << ")" << std::endl;
+            return false;
+        }
+        std::vector<std::pair<std::string, std::string>> pairs;
+        size_t loaded = 0;
+        for (size_t block = 0; block < image->getBlockCount(); block++) {
+            pairs.clear();
+            bool intact = image->forEachInBlock(block, [&pairs](std::string_view key, std::string_view value) {
+                pairs.emplace_back(std::string(key), std::string(value));
+            });
+            if (!intact) {
+                // Checksummed but undecodable; the caller replaces the partly loaded state
+                std::cout << "Node " << id_ << " could not decode bulk image " << entry.getValue() 
+                          << " block " << block << " (Log ID: " << entry.getId() << ")" << std::endl;
+                return false;
+            }
+            loaded += applyLoad(pairs, entry.getId());
+        }
+        std::cout << "Node " << id_ << " loaded " << loaded << " keys from bulk image " << entry.getValue()
+                  << " (Log ID: " << entry.getId() << ")" << std::endl;
+        return true;
+    }
+
+    // Tombstones only matter while a snapshot is loading; otherwise touch just the key's stripe
+    std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_, std::defer_lock);
+    if (snapshotActive_) {
+        snapshotLock.lock();
+    }
+    
+    if (entry.getOperationType() == model::LogEntry::OperationType::NOOP) {
+        return true;
+    }
+    if (entry.isExpire()) {
+        const std::string& key = entry.getKey();
+        std::string existing;
+        bool exists = dataStore_.contains(key) ||
+                      (snapshot_ && snapshotTombstones_.count(key) == 0 && snapshot_->get(key, existing));
+        long deadline = entry.getExpiresAt();
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        if (exists && deadline > 0) {
+            expiries_[key] = deadline;
+        } else {
+            expiries_.erase(key);
+        }
+        expiringKeys_ = expiries_.size();
+        return true;
+    }
+
+    if (entry.isDelete()) {
+        dataStore_.erase(entry.getKey(), entry.getId());
+        if (snapshot_) {
+            snapshotTombstones_.insert(entry.getKey());
+        }
+    } else {
+        dataStore_.put(entry.getKey(), entry.getValue(), entry.getId());
+        if (snapshot_) {
+            snapshotTombstones_.erase(entry.getKey());
+        }
+    }
+    
+    // Deadlines are rare, so the common case checks the count instead of taking the lock.
+    // A key's own deadline is only set by its own entries, which are applied before this one.
+    if (expiringKeys_.load() > 0) {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        expiries_.erase(entry.getKey());
+        expiringKeys_ = expiries_.size();
+    }
+    return true;
+}
+
+size_t AbstractNode::applyLoad(const std::vector<std::pair<std::string, std::string>>& pairs, long version) {
+    std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_, std::defer_lock);
+    if (snapshotActive_) {
+        snapshotLock.lock();
+    }
+    if (snapshot_) {
+        for (const auto& pair : pairs) {
+            snapshotTombstones_.erase(pair.first);
+        }
+    }
+    if (expiringKeys_.load() > 0) {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        for (const auto& pair : pairs) {
+            expiries_.erase(pair.first);
+        }
+        expiringKeys_ = expiries_.size();
+    }
+
+    if (!parallelApplier_ || pairs.size() < kParallelApplyMinBatch) {
+        return dataStore_.putMany(pairs, version);
+    }
+    // Hash every key once here rather than once per partition
+    std::vector<std::vector<size_t>> byStripe = dataStore_.groupByStripe(pairs);
+    size_t partitions = parallelApplier_->getThreadCount();
+    parallelApplier_->run(partitions, [this, &pairs, &byStripe, version, partitions](size_t partition) {
+        dataStore_.putMany(pairs, byStripe, version, partition, partitions);
+    });
+    return pairs.size();
+}
+
+long AbstractNode::getExpiresAt(const std::string& key) const {
+    std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+    auto it = expiries_.find(key);
+    return it == expiries_.end() ? 0 : it->second;
+}
+
+size_t AbstractNode::getExpiringKeyCount() const {
+    std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+    return expiries_.size();
+}
+
+AbstractNode::MemoryUsage AbstractNode::getMemoryUsage() const {
+    storage::StripedStore::MemoryUsage store = dataStore_.getMemoryUsage();
+    MemoryUsage usage;
+    usage.keyBytes = store.keyBytes;
+    usage.valueBytes = store.valueBytes;
+    usage.overheadBytes = store.overheadBytes;
+    usage.keyCount = store.entryCount;
+    {
+        std::lock_guard<std::mutex> logLock(logMutex_);
+        usage.logEntries = log_.size();
+        usage.logBytes = log_.capacity() * sizeof(model::LogEntry) + logHeapBytes_;
+    }
+    usage.replicationBytes = getReplicationMemoryUsage();
+    return usage;
+}
+
+void AbstractNode::markApplied(const model::LogEntry& entry) {
+    // Timestamp first, so a reader that sees the new index never sees an older timestamp
+    lastAppliedTimestamp_ = entry.getTimestamp();
+    lastAppliedIndex_ = entry.getId();
+    notifyProgress();
+}
+
+void AbstractNode::notifyProgress() {
+    // A waiter registers before checking its predicate, so if none is
+    // registered here any later one will already see the new state
+    if (progressWaiters_.load() > 0) {
+        std::lock_guard<std::mutex> progressLock(progressMutex_);
+        progressCondition_.notify_all();
+    }
+}
+
+bool AbstractNode::waitForIndex(long index, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> progressLock(progressMutex_);
+    progressWaiters_++;
+    progressCondition_.wait_for(progressLock, timeout, [this, index] {
+        return !up_ || (lastAppliedIndex_.load() >= index && !snapshotActive_);
+    });
+    progressWaiters_--;
+    return up_ && lastAppliedIndex_.load() >= index && !snapshotActive_;
+}
+
+long AbstractNode::getLastAppliedTimestamp() const {
+    return lastAppliedTimestamp_.load();
+}
+
+void AbstractNode::appendToLog(const model::LogEntry& entry) {
+    std::lock_guard<std::mutex> logLock(logMutex_);
+    log_.push_back(entry);
+    logHeapBytes_ += heapBytes(log_.back());
+}
+
+bool AbstractNode::applyLogEntry(const model::LogEntry& entry) {
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot apply log entry" << std::endl;
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    return applyInOrderLocked(entry);
+}
+
+bool AbstractNode::applyFromLeader(const model::LogEntry& entry, long leaderTerm) {
     if (!up_) {
         std::cout << "Node " << id_ << " is DOWN, cannot apply log entry" << std::endl;
         return false;
     }
     
-    std::unique_lock<std::shared_mutex> writeLock(*lock);
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
     
+    // Fencing: a deposed leader cannot overwrite state accepted under a newer term
+    if (leaderTerm < term_) {
+        std::cout << "Node " << id_ << " refused log entry " << entry.getId() << " from stale term "
+                  << leaderTerm << " (current term " << term_ << ")" << std::endl;
+        return false;
+    }
+    term_ = leaderTerm;
+    return applyInOrderLocked(entry);
+}
+
+size_t AbstractNode::applyBatchFromLeader(const std::vector<model::LogEntry>& entries,
+                                          long leaderTerm, bool coalesce) {
+    size_t applied = applyLeaderBatch(entries, leaderTerm, coalesce);
+    if (applied > 0) {
+        compactLogIfDue();
+    }
+    return applied;
+}
+
+size_t AbstractNode::applyLeaderBatch(const std::vector<model::LogEntry>& entries,
+                                      long leaderTerm, bool coalesce) {
+    if (!up_) {
+        std::cout << "Node " << id_ << " is DOWN, cannot apply log entries" << std::endl;
+        return 0;
+    }
+    if (entries.empty()) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    if (leaderTerm < term_) {
+        std::cout << "Node " << id_ << " refused " << entries.size() << " log entries from stale term "
+                  << leaderTerm << " (current term " << term_ << ")" << std::endl;
+        return 0;
+    }
+    term_ = leaderTerm;
+
+    // A load writes keys it does not name, so batches holding one are applied entry by entry
+    bool hasLoad = std::any_of(entries.begin(), entries.end(), [](const model::LogEntry& entry) {
+        return entry.isLoad();
+    });
+    coalesce = coalesce && !hasLoad;
+    bool parallel = parallelApplier_ && entries.size() >= kParallelApplyMinBatch && !hasLoad;
+    if (!coalesce && !parallel) {
+        size_t applied = 0;
+        while (applied < entries.size() && applyInOrderLocked(entries[applied])) {
+            applied++;
+        }
+        if (applied > 0) {
+            relayApplied(entries, applied);
+        }
+        return applied;
+    }
+
+    // Only the in-sequence prefix can be applied
+    long next = lastAppliedIndex_ + 1;
+    size_t count = 0;
+    while (count < entries.size() && entries[count].getId() == next + static_cast<long>(count)) {
+        count++;
+    }
+    if (count == 0) {
+        std::cout << "Node " << id_ << " received out-of-order log entry: " << entries.front().getId()
+                  << ", expected: " << next << std::endl;
+        return 0;
+    }
+
+    // Last write (or delete) wins within the batch, followed by any expire
+    // operations after it; a write clears the deadlines set before it
+    auto replacesValue = [](const model::LogEntry& entry) {
+        return entry.getOperationType() == model::LogEntry::OperationType::WRITE || entry.isDelete();
+    };
+    std::unordered_map<std::string, size_t> lastForKey;
+    if (coalesce) {
+        for (size_t i = 0; i < count; i++) {
+            if (replacesValue(entries[i])) {
+                lastForKey[entries[i].getKey()] = i;
+            }
+        }
+    }
+    std::vector<const model::LogEntry*> toApply;
+    toApply.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        auto last = lastForKey.find(entries[i].getKey());
+        bool superseded = last != lastForKey.end() &&
+                          (replacesValue(entries[i]) ? i != last->second : i < last->second);
+        if (!superseded) {
+            toApply.push_back(&entries[i]);
+        }
+    }
+    size_t skipped = count - toApply.size();
+
+    if (parallel) {
+        // A key always maps to the same stripe, so its entries stay in order within one partition
+        size_t partitions = parallelApplier_->getThreadCount();
+        std::vector<std::vector<const model::LogEntry*>> byPartition(partitions);
+        for (const model::LogEntry* entry : toApply) {
+            byPartition[dataStore_.stripeFor(entry->getKey()) % partitions].push_back(entry);
+        }
+        parallelApplier_->run(partitions, [this, &byPartition](size_t partition) {
+            for (const model::LogEntry* entry : byPartition[partition]) {
+                applyToDataStore(*entry);
+            }
+        });
+    } else {
+        for (const model::LogEntry* entry : toApply) {
+            applyToDataStore(*entry);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> logLock(logMutex_);
+        log_.insert(log_.end(), entries.begin(), entries.begin() + count);
+        for (auto it = log_.end() - count; it != log_.end(); ++it) {
+            logHeapBytes_ += heapBytes(*it);
+        }
+    }
+    markApplied(entries[count - 1]);
+    coalescedCount_ += skipped;
+    relayApplied(entries, count);
+
+    std::cout << "Node " << id_ << " applied log entries " << entries.front().getId() << "-"
+              << entries[count - 1].getId() << " (" << skipped << " overwritten within the batch"
+              << (parallel ? ", " + std::to_string(parallelApplier_->getThreadCount()) + " threads" : "")
+              << ")" << std::endl;
+    return count;
+}
+
+void AbstractNode::relayApplied(const std::vector<model::LogEntry>&, size_t) {
+}
+
+size_t AbstractNode::getReplicationMemoryUsage() const {
+    return 0;
+}
+
+long AbstractNode::getLogCompactionBound() const {
+    return lastAppliedIndex_.load();
+}
+
+void AbstractNode::setLogCompaction(bool enabled, size_t maxBytes) {
+    maxLogBytes_ = enabled ? maxBytes : 0;
+    logCompaction_ = enabled;
+    compactLogIfDue();
+}
+
+long AbstractNode::getLogStartIndex() const {
+    return logStartIndex_.load();
+}
+
+size_t AbstractNode::getLogFootprint() const {
+    long entries = std::max(0L, lastAppliedIndex_.load() - logStartIndex_.load());
+    return static_cast<size_t>(entries) * sizeof(model::LogEntry) + logHeapBytes_.load();
+}
+
+void AbstractNode::compactLogIfDue() {
+    long durable = 0;
+    bool lsm = dataStore_.getDurableVersion(durable);
+    if (!logCompaction_.load() && !lsm) {
+        return;
+    }
+    long last = lastAppliedIndex_.load();
+    long start = logStartIndex_.load();
+    if (last <= start) {
+        return;
+    }
+    long bound = std::min(last, getLogCompactionBound());
+
+    // Past the byte budget, keep only what fits in half of it, lagging slaves or not
+    size_t maxBytes = maxLogBytes_.load();
+    size_t footprint = getLogFootprint();
+    if (maxBytes > 0 && footprint > maxBytes) {
+        size_t perEntry = std::max<size_t>(1, footprint / static_cast<size_t>(last - start));
+        bound = std::max(bound, last - static_cast<long>(maxBytes / 2 / perEntry));
+    }
+    if (lsm) {
+        // Entries still only in a memtable are what a restart replays into the tree
+        bound = std::min(bound, durable);
+    }
+
+    // Erasing shifts the rest of the log, so wait until that is at most as much as is dropped
+    if ((bound - start) * 2 >= last - start) {
+        compactLog(bound);
+    }
+}
+
+size_t AbstractNode::compactLog(long throughIndex) {
+    std::lock_guard<std::mutex> logLock(logMutex_);
+    auto end = std::partition_point(log_.begin(), log_.end(), [throughIndex](const model::LogEntry& entry) {
+        return entry.getId() <= throughIndex;
+    });
+    if (end == log_.begin()) {
+        return 0;
+    }
+    size_t freed = 0;
+    for (auto it = log_.begin(); it != end; ++it) {
+        freed += heapBytes(*it);
+    }
+    long startIndex = std::prev(end)->getId();
+    size_t dropped = static_cast<size_t>(end - log_.begin());
+    // Move-construct the kept tail: erasing would move-assign over the dropped entries, which
+    // keeps their string buffers and throws off the heap bytes counted at append time
+    std::vector<model::LogEntry> kept(std::make_move_iterator(end), std::make_move_iterator(log_.end()));
+    log_.swap(kept);
+    logHeapBytes_ -= freed;
+    logStartIndex_ = startIndex;
+    return dropped;
+}
+
+void AbstractNode::recoverMissingImage(const model::LogEntry& entry) {
+    std::cout << "Node " << id_ << " stopped before log entry " << entry.getId() 
+              << ", its bulk image is missing or corrupt" << std::endl;
+}
+
+void AbstractNode::recoverCorruptSnapshot(const storage::SnapshotReader& snapshot) {
+    std::cout << "Node " << id_ << " loaded only part of snapshot " << snapshot.getPath() 
+              << ", a block failed its checksum" << std::endl;
+}
+
+void AbstractNode::setApplyParallelism(size_t threads) {
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    if (threads <= 1) {
+        parallelApplier_.reset();
+    } else if (!parallelApplier_ || parallelApplier_->getThreadCount() != threads) {
+        parallelApplier_ = std::make_unique<ParallelApplier>(threads);
+    }
+}
+
+bool AbstractNode::setStorageEngine(storage::StripedStore::Engine engine, const storage::LsmConfig& lsm) {
+    if (!dataStore_.setEngine(engine, lsm)) {
+        std::cout << "Node " << id_ << " could not open LSM storage in " << lsm.directory << std::endl;
+        return false;
+    }
+    return true;
+}
+
+storage::StripedStore::Engine AbstractNode::getStorageEngine() const {
+    return dataStore_.getEngine();
+}
+
+void AbstractNode::closeStorage() {
+    dataStore_.closeEngine();
+}
+
+uint64_t AbstractNode::getCoalescedCount() const {
+    return coalescedCount_.load();
+}
+
+bool AbstractNode::applyInOrderLocked(const model::LogEntry& entry) {
     // Check if this log entry is the next in sequence
     if (entry.getId() != lastAppliedIndex_ + 1) {
         std::cout << "Node " << id_ << " received out-of-order log entry: " << entry.getId() 
@@ -143,23 +872,27 @@ bool AbstractNode::applyLogEntry(const model::LogEntry& entry,
     }
     
     // Apply the log entry to the data store based on operation type
+    if (!applyToDataStore(entry)) {
+        recoverMissingImage(entry);
+        return false;
+    }
     if (entry.isDelete()) {
-        // For delete operations, remove the key from the data store
-        dataStore_.erase(entry.getKey());
         std::cout << "Node " << id_ << " deleted key '" << entry.getKey() << "' from log entry" << std::endl;
+    } else if (entry.isExpire()) {
+        std::cout << "Node " << id_ << " set expiry of key '" << entry.getKey() << "' to "
+                  << entry.getExpiresAt() << " from log entry" << std::endl;
+    } else if (entry.getOperationType() == model::LogEntry::OperationType::NOOP) {
+        std::cout << "Node " << id_ << " skipped no-op log entry for key '" << entry.getKey() << "'" << std::endl;
+    } else if (entry.isLoad()) {
+        // Reported by applyToDataStore()
     } else {
-        // For write operations, put the key-value pair in the data store
-        dataStore_[entry.getKey()] = entry.getValue();
         std::cout << "Node " << id_ << " wrote " << entry.getKey() << "=" 
                  << entry.getValue() << " from log entry" << std::endl;
     }
     
     // Add to log and update index
-    {
-        std::lock_guard<std::mutex> logLock(logMutex_);
-        log_.push_back(entry);
-    }
-    lastAppliedIndex_ = entry.getId();
+    appendToLog(entry);
+    markApplied(entry);
     
     std::cout << "Node " << id_ << " applied log entry: " << entry.toString() << std::endl;
     return true;
@@ -171,17 +904,237 @@ std::vector<model::LogEntry> AbstractNode::getLogEntriesAfter(long afterIndex) c
         return {};
     }
     
-    std::vector<model::LogEntry> entries;
-    std::shared_lock<std::shared_mutex> readLock(*lock_);
     std::lock_guard<std::mutex> logLock(logMutex_);
+    auto first = std::partition_point(log_.begin(), log_.end(), [afterIndex](const model::LogEntry& entry) {
+        return entry.getId() <= afterIndex;
+    });
+    return std::vector<model::LogEntry>(first, log_.end());
+}
+
+long AbstractNode::SnapshotImage::getIndex() const {
+    return index_;
+}
+
+bool AbstractNode::SnapshotImage::forEach(
+        const std::function<bool(const std::string&, const std::string&)>& visit) const {
+    if (image_) {
+        return image_->forEach([&visit](const std::string& key, const storage::StripedStore::VersionedValue& entry) {
+            return visit(key, entry.value);
+        });
+    }
+    for (const auto& [key, value] : copy_) {
+        if (!visit(key, value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const std::unordered_map<std::string, long>& AbstractNode::SnapshotImage::getExpiries() const {
+    return expiries_;
+}
+
+std::unique_ptr<AbstractNode::SnapshotImage> AbstractNode::openSnapshotImage() const {
+    if (!up_) {
+        return nullptr;
+    }
+    std::unique_ptr<SnapshotImage> image(new SnapshotImage());
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    // The image cannot see the part of a loading snapshot that is still only mapped
+    if (!snapshotActive_) {
+        image->image_ = dataStore_.openImage();
+    }
+    if (!image->image_) {
+        image->copy_ = copyDataStore();
+    }
+    {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        image->expiries_ = expiries_;
+    }
+    image->index_ = lastAppliedIndex_.load();
+    return image;
+}
+
+bool AbstractNode::writeSnapshot(const std::string& path, storage::CompressionType compression) const {
+    auto image = openSnapshotImage();
+    if (!image) {
+        std::cout << "Node " << id_ << " is DOWN, cannot write snapshot" << std::endl;
+        return false;
+    }
+
+    storage::SnapshotWriter writer(path, image->getIndex(), storage::snapshot::kDefaultBlockSize, compression);
+    if (!writer.open()) {
+        std::cout << "Node " << id_ << " could not create snapshot " << path << std::endl;
+        return false;
+    }
+    if (!image->forEach([&writer](const std::string& key, const std::string& value) {
+            return writer.add(key, value);
+        })) {
+        return false;
+    }
+    for (const auto& [key, deadline] : image->getExpiries()) {
+        writer.addExpiry(key, deadline);
+    }
+    bool ok = writer.finish();
+    std::cout << "Node " << id_ << (ok ? " wrote" : " failed to write") << " snapshot " << path
+              << " with " << writer.getEntryCount() << " keys at log index " << image->getIndex() << std::endl;
+    return ok;
+}
+
+void AbstractNode::copyStateFrom(const AbstractNode& other) {
+    std::unique_ptr<storage::StripedStore::Image> image;
+    std::map<std::string, storage::StripedStore::VersionedValue> contents;
+    std::vector<model::LogEntry> log;
+    long logStart = 0;
+    std::unordered_map<std::string, long> expiries;
+    long lastIndex = 0;
+    long lastTimestamp = 0;
+    {
+        std::lock_guard<std::mutex> otherApplyLock(other.applyMutex_);
+        // An image cannot see the part of a loading snapshot that is still only mapped
+        if (!other.snapshotActive_) {
+            image = other.dataStore_.openImage();
+        }
+        if (!image) {
+            contents = other.copyVersionedDataStore();
+        }
+        expiries = other.expiries_;
+        {
+            std::lock_guard<std::mutex> otherLogLock(other.logMutex_);
+            log = other.log_;
+            logStart = other.logStartIndex_.load();
+        }
+        lastIndex = other.lastAppliedIndex_.load();
+        lastTimestamp = other.lastAppliedTimestamp_.load();
+    }
     
-    for (const auto& entry : log_) {
-        if (entry.getId() > afterIndex) {
-            entries.push_back(entry);
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    stateEpoch_++;
+    dataStore_.clear();
+    storage::StripedStore::Engine engine = other.getStorageEngine();
+    if (dataStore_.getEngine() != storage::StripedStore::Engine::LSM) {
+        dataStore_.setEngine(engine == storage::StripedStore::Engine::LSM ? storage::StripedStore::Engine::TREE : engine);
+    }
+    if (image) {
+        image->forEach([this](const std::string& key, const storage::StripedStore::VersionedValue& entry) {
+            dataStore_.put(key, entry.value, entry.version);
+            return true;
+        });
+        image.reset();
+    }
+    for (const auto& [key, entry] : contents) {
+        dataStore_.put(key, entry.value, entry.version);
+    }
+    {
+        std::lock_guard<std::mutex> logLock(logMutex_);
+        log_ = std::move(log);
+        logStartIndex_ = logStart;
+        size_t heap = 0;
+        for (const auto& entry : log_) {
+            heap += heapBytes(entry);
         }
+        logHeapBytes_ = heap;
+    }
+    {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        expiries_ = std::move(expiries);
+        expiringKeys_ = expiries_.size();
+    }
+    lastAppliedTimestamp_ = lastTimestamp;
+    lastAppliedIndex_ = lastIndex;
+    historyFloor_ = lastIndex;  // History of the replaced state went with it
+    notifyProgress();
+}
+
+bool AbstractNode::isLoadingSnapshot() const {
+    return snapshotActive_.load();
+}
+
+void AbstractNode::installSnapshot(std::shared_ptr<storage::SnapshotReader> snapshot) {
+    {
+        std::lock_guard<std::mutex> applyLock(applyMutex_);
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+        stateEpoch_++;
+        dataStore_.clear();
+        snapshotTombstones_.clear();
+        {
+            std::lock_guard<std::mutex> logLock(logMutex_);
+            log_.clear();
+            logHeapBytes_ = 0;
+            logStartIndex_ = snapshot->getLastIndex();
+        }
+        {
+            // Deadlines set after the snapshot are replayed from the log
+            std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+            expiries_.clear();
+            for (const auto& [key, deadline] : snapshot->getExpiries()) {
+                expiries_[std::string(key)] = deadline;
+            }
+            expiringKeys_ = expiries_.size();
+        }
+        snapshot_ = snapshot;
+        snapshotActive_ = true;
+        lastAppliedTimestamp_ = 0;  // Unknown until the next entry is applied
+        lastAppliedIndex_ = snapshot->getLastIndex();
+        historyFloor_ = snapshot->getLastIndex();
+    }
+    notifyProgress();
+
+    std::cout << "Node " << id_ << " serving snapshot " << snapshot->getPath() << " ("
+              << snapshot->getEntryCount() << " keys, log index " << snapshot->getLastIndex() 
+              << ") while loading in background" << std::endl;
+
+    replicationExecutor_->execute([this, snapshot]() {
+        loadSnapshot(snapshot);
+    });
+}
+
+void AbstractNode::loadSnapshot(std::shared_ptr<storage::SnapshotReader> snapshot) {
+    std::vector<std::pair<std::string, std::string>> pairs;
+
+    for (size_t block = 0; block < snapshot->getBlockCount(); block++) {
+        if (stopping_) {
+            return;
+        }
+
+        // Decode outside the lock; only the inserts block snapshot fall-through reads
+        pairs.clear();
+        bool intact = snapshot->forEachInBlock(block, [&pairs](std::string_view key, std::string_view value) {
+            pairs.emplace_back(std::string(key), std::string(value));
+        });
+
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+        if (snapshot_ != snapshot) {
+            return;  // Superseded by another snapshot
+        }
+        if (!intact) {
+            // Stop serving from the snapshot; its keys in this block are lost
+            snapshot_.reset();
+            snapshotTombstones_.clear();
+            snapshotActive_ = false;
+            snapshotLock.unlock();
+            recoverCorruptSnapshot(*snapshot);
+            notifyProgress();
+            return;
+        }
+        for (const auto& [key, value] : pairs) {
+            // Entries applied since the snapshot win over its contents
+            if (snapshotTombstones_.count(key) == 0) {
+                dataStore_.putIfAbsent(key, value, snapshot->getLastIndex());
+            }
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex_);
+    if (snapshot_ == snapshot) {
+        snapshot_.reset();
+        snapshotTombstones_.clear();
+        snapshotActive_ = false;
+        std::cout << "Node " << id_ << " finished loading snapshot " << snapshot->getPath() << std::endl;
     }
-    return entries;
+    snapshotLock.unlock();
+    notifyProgress();
 }
 
 } // namespace node
-} // namespace replication
\ No newline at end of file
+} // namespace replication
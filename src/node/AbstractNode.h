@@ -2,10 +2,16 @@
 #define ABSTRACT_NODE_H
 
 #include "node/Node.h"
+#include "node/Executor.h"
+#include "node/ParallelApplier.h"
 #include "model/LogEntry.h"
+#include "storage/SnapshotReader.h"
+#include "storage/StripedStore.h"
 
 #include <string>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <mutex>
@@ -15,6 +21,7 @@
 #include <atomic>
 #include <queue>
 #include <functional>
+#include <chrono>
 
 namespace replication {
 namespace node {
@@ -27,8 +34,10 @@ class AbstractNode : public Node {
 public:
     /**
      * Constructs a node with the given ID.
+     * @param executor runs the node's asynchronous work; a private thread
+     *        pool is created when null
      */
-    explicit AbstractNode(const std::string& id);
+    explicit AbstractNode(const std::string& id, std::shared_ptr<Executor> executor = nullptr);
     
     /**
      * Virtual destructor to ensure proper cleanup.
@@ -44,53 +53,597 @@ public:
     bool deleteKey(const std::string& key) override;
     std::map<std::string, std::string> getDataStore() const override;
     long getLastLogIndex() const override;
-    bool applyLogEntry(const model::LogEntry& entry, 
-                      std::shared_ptr<std::shared_mutex> lock) override;
+    bool applyLogEntry(const model::LogEntry& entry) override;
     std::vector<model::LogEntry> getLogEntriesAfter(long afterIndex) const override;
 
+    /**
+     * Reads a key together with its version: the ID of the log entry that
+     * last wrote it, or the snapshot index for keys loaded from a snapshot
+     * and not written since. Versions only grow, so they can be handed back
+     * to compareAndSetVersion() on the master.
+     * @return true if the node is up and the key is present
+     */
+    bool readVersioned(const std::string& key, std::string& value, long& version);
+
+    /**
+     * Reads several keys, locking only the stripe of each key in turn.
+     * @param keys the keys to read
+     * @return the values in the order of keys (empty string if not found)
+     */
+    std::vector<std::string> readMany(const std::vector<std::string>& keys);
+
+    /**
+     * Reads several keys like readMany().
+     * @param found receives, in the order of keys, whether each key is present
+     */
+    std::vector<std::string> readMany(const std::vector<std::string>& keys, std::vector<bool>& found);
+
+    /**
+     * Reads every key starting with a prefix, in ascending key order. Every
+     * stripe of the data store is held while the keys are gathered, so the
+     * result is consistent with respect to single-key writes.
+     * @param limit the most keys to return; 0 returns them all
+     * @return the keys and values, empty if the node is down
+     */
+    std::vector<std::pair<std::string, std::string>> scanPrefix(const std::string& prefix, size_t limit = 0);
+
+    /**
+     * A point-in-time view of the data store at one applied log index.
+     * While any view is open, the node keeps the values that later entries
+     * replace, so the view reads the same data however far the applier
+     * moves on. Closed when the last reference is dropped; must not outlive
+     * the node.
+     *
+     * Views open at the last applied index, or at an earlier one within the
+     * history horizon (see setHistoryHorizon()).
+     */
+    class ReadView {
+    public:
+        ~ReadView();
+
+        ReadView(const ReadView&) = delete;
+        ReadView& operator=(const ReadView&) = delete;
+
+        /**
+         * Gets the log index the view reads at.
+         */
+        long getIndex() const;
+
+    private:
+        friend class AbstractNode;
+        ReadView(AbstractNode& node, long index, uint64_t epoch);
+
+        AbstractNode& node_;
+        long index_;
+        uint64_t epoch_;
+    };
+
+    /**
+     * Opens a view at the last applied log index. Opening briefly waits for
+     * an in-progress apply; reading through the view never blocks it.
+     * @return the view, or null if the node is down or loading a snapshot
+     */
+    std::shared_ptr<ReadView> openReadView();
+
+    /**
+     * Opens a view at an earlier applied log index.
+     * @param index an index from getOldestReadableIndex() up to the last
+     *        applied one
+     * @return the view, or null if the index is out of that range, or the
+     *         node is down or loading a snapshot
+     */
+    std::shared_ptr<ReadView> openReadView(long index);
+
+    /**
+     * Keeps the values replaced by the last entries applied, so views can
+     * open at those earlier indices. Values are kept per key until the key
+     * is next written past the horizon, capped by setVersionRetention().
+     * Indices applied before the horizon was raised cannot be read.
+     * @param entries how many applied entries back views may open; 0 (the
+     *        default) only allows views at the last applied index
+     */
+    void setHistoryHorizon(long entries);
+
+    /**
+     * Gets the oldest log index a view can open at.
+     */
+    long getOldestReadableIndex() const;
+
+    /**
+     * Reads several keys as of a view's index.
+     * @param values receives the values in the order of keys (empty string if not found)
+     * @return false if the node's state was replaced since the view was
+     *         opened, or a value the view needs was dropped from the bounded
+     *         per-key history; open a new view and retry
+     */
+    bool readAt(const ReadView& view, const std::vector<std::string>& keys,
+                std::vector<std::string>& values) const;
+
+    /**
+     * Reads several keys consistently: every value is as of the same log
+     * index, even while entries keep being applied. Retries with a fresh
+     * view a few times if history was dropped.
+     * @param values receives the values in the order of keys (empty string if not found)
+     * @param index receives the log index the values are consistent at
+     * @return true if a consistent read succeeded
+     */
+    bool readConsistent(const std::vector<std::string>& keys, std::vector<std::string>& values,
+                        long& index);
+
+    /**
+     * Sets how many replaced values are kept per key for open views.
+     * A key rewritten more often than this while a view is open can no
+     * longer be read through that view.
+     */
+    void setVersionRetention(size_t versionsPerKey);
+
+    /**
+     * A point-in-time image of the data store at one applied log index,
+     * for writing a snapshot file or streaming the state elsewhere. The
+     * image is copy-on-write: entries applied after it was opened copy a
+     * key's old value aside the first time they change it, so reading the
+     * image out never holds up the applier. Must not outlive the node.
+     */
+    class SnapshotImage {
+    public:
+        /**
+         * Gets the log index the image is consistent with.
+         */
+        long getIndex() const;
+
+        /**
+         * Visits every key and value of the image in ascending key order.
+         * @param visit returns false to stop early
+         * @return false if visit stopped early
+         */
+        bool forEach(const std::function<bool(const std::string&, const std::string&)>& visit) const;
+
+        /**
+         * Gets the expiry deadlines as of the image's index.
+         */
+        const std::unordered_map<std::string, long>& getExpiries() const;
+
+    private:
+        friend class AbstractNode;
+        SnapshotImage() = default;
+
+        long index_ = 0;
+        std::unordered_map<std::string, long> expiries_;
+        std::unique_ptr<storage::StripedStore::Image> image_;
+        std::map<std::string, std::string> copy_;  // Used instead of image_ when none could be opened
+    };
+
+    /**
+     * Opens an image of the data store at the last applied log index.
+     * Opening briefly waits for an in-progress apply. While a snapshot is
+     * still loading, or another image is open, the data store is copied
+     * instead.
+     * @return the image, or null if the node is down
+     */
+    std::unique_ptr<SnapshotImage> openSnapshotImage() const;
+
+    /**
+     * Writes the current data store to a snapshot file, consistent with
+     * the last applied log index. Entries keep being applied while the
+     * file is written (see SnapshotImage).
+     * @param path the snapshot file path
+     * @param compression how the data blocks are compressed
+     * @return true if the snapshot was written and synced
+     */
+    bool writeSnapshot(const std::string& path,
+                       storage::CompressionType compression = storage::CompressionType::NONE) const;
+
+    /**
+     * Checks whether a snapshot is still being loaded into the data store.
+     */
+    bool isLoadingSnapshot() const;
+
+    /**
+     * Gets the highest leader term this node has seen.
+     */
+    long getTerm() const;
+
+    /**
+     * Raises this node's term, so entries from leaders of older terms are refused.
+     * @param term the new term; lower terms are ignored
+     */
+    void observeTerm(long term);
+
+    /**
+     * Applies a log entry sent by a leader, refusing it if the leader's term
+     * is older than this node's, i.e. the leader has since been deposed.
+     * @param entry the log entry to apply
+     * @param leaderTerm the term of the leader sending the entry
+     * @return true if applied successfully
+     */
+    bool applyFromLeader(const model::LogEntry& entry, long leaderTerm);
+
+    /**
+     * Applies consecutive log entries sent by a leader in one step.
+     * With coalescing, only the last operation on each key within the batch
+     * reaches the data store; every entry is still logged and the index
+     * advances to the last one, so the log stays identical to the leader's.
+     * @param entries consecutive log entries, in order
+     * @param leaderTerm the term of the leader sending the entries
+     * @param coalesce whether to skip operations overwritten later in the batch
+     * @return the number of entries applied (stops at the first out-of-order one)
+     */
+    size_t applyBatchFromLeader(const std::vector<model::LogEntry>& entries, long leaderTerm,
+                                bool coalesce);
+
+    /**
+     * Applies batches from a leader on several threads. Entries are
+     * partitioned by the data store stripe of their key, so entries for
+     * the same key stay in log order on one thread while other stripes
+     * are applied at the same time; the log and the last applied index
+     * are only updated once the whole batch is in.
+     * @param threads the threads applying a batch, including the caller;
+     *        1 (the default) applies sequentially
+     */
+    void setApplyParallelism(size_t threads);
+
+    /**
+     * Drops log entries once every slave this node feeds has applied them,
+     * so the log stops growing with the history. A slave that is down, or
+     * further behind than the log reaches, catches up from a copy of this
+     * node's state instead.
+     * @param enabled whether to compact the log
+     * @param maxBytes when nonzero, a log grown past this many bytes is
+     *        trimmed to about half of it, even past lagging slaves
+     * Under the LSM engine the log is always compacted, and never past the
+     * entries the engine still holds only in memtables.
+     */
+    void setLogCompaction(bool enabled, size_t maxBytes = 0);
+
+    /**
+     * Gets the index of the last entry compacted out of the log, or of the
+     * snapshot the node was bootstrapped from; the log holds the entries
+     * after it. 0 if the log holds every entry.
+     */
+    long getLogStartIndex() const;
+
+    /**
+     * Gets the bytes held by the log entries, as getMemoryUsage() counts
+     * them but without spare vector capacity. Takes no lock.
+     */
+    size_t getLogFootprint() const;
+
+    /**
+     * Sets how the data store orders its keys, moving the keys already
+     * held. The radix engine stores shared key prefixes once; the LSM
+     * engine keeps the keys in sorted runs on disk.
+     * @param lsm the directory and tuning of the LSM engine
+     * @return false if the LSM engine could not open its directory
+     */
+    bool setStorageEngine(storage::StripedStore::Engine engine, const storage::LsmConfig& lsm = storage::LsmConfig());
+
+    storage::StripedStore::Engine getStorageEngine() const;
+
+    /**
+     * Flushes the storage engine and stops its background work, when the
+     * node is shut down. Reads keep working.
+     */
+    void closeStorage();
+
+    /**
+     * Gets how many data store operations coalescing has skipped so far.
+     */
+    uint64_t getCoalescedCount() const;
+
+    /**
+     * Gets the expiry deadline of a key, as set by the last logged expire
+     * operation since the key was written.
+     * @return milliseconds since epoch, or 0 if the key does not expire
+     */
+    long getExpiresAt(const std::string& key) const;
+
+    /**
+     * Gets the number of keys that have an expiry deadline.
+     */
+    size_t getExpiringKeyCount() const;
+
+    /**
+     * Bytes this node holds in memory, estimated from allocation sizes
+     * (see storage/MemoryAccounting.h).
+     */
+    struct MemoryUsage {
+        size_t keyBytes = 0;       // Characters of the keys in the data store
+        size_t valueBytes = 0;     // Characters of the values in the data store
+        size_t overheadBytes = 0;  // Tree nodes, string buffers, allocator rounding and kept history
+        size_t keyCount = 0;
+        size_t logBytes = 0;       // Log entries with their strings, and unused log capacity
+        size_t logEntries = 0;
+        size_t replicationBytes = 0;  // Streams to slaves and subscribers, with their queued batches
+    };
+
+    /**
+     * Gets the bytes held by the data store, the log and the replication streams.
+     */
+    MemoryUsage getMemoryUsage() const;
+
+    /**
+     * Gets the timestamp of the last applied log entry. Published alongside
+     * the last log index, so routing can bound staleness without locking.
+     * @return milliseconds since epoch, or 0 if unknown
+     */
+    long getLastAppliedTimestamp() const;
+
+    /**
+     * Gets the index of the last applied log entry, also while the node is
+     * down, where getLastLogIndex() reports -1.
+     */
+    long getAppliedIndex() const;
+
+    /**
+     * Gets when this node last went down, in steady-clock milliseconds.
+     * @return the time, or -1 if the node is up
+     */
+    long getDownSinceMillis() const;
+
+    /**
+     * Waits until this node has applied the given log index and finished
+     * loading any snapshot. Woken by every apply, so it returns as soon as
+     * the entry lands rather than polling.
+     * @param index the log index to wait for
+     * @param timeout how long to wait at most
+     * @return true if the index was applied, false on timeout or if the node is down
+     */
+    bool waitForIndex(long index, std::chrono::milliseconds timeout) const;
+
 protected:
+    /**
+     * Replaces this node's state with a mapped snapshot. Reads are served
+     * from the mapping immediately while a background task copies it into
+     * the data store block by block.
+     * @param snapshot the opened snapshot
+     */
+    void installSnapshot(std::shared_ptr<storage::SnapshotReader> snapshot);
+
+    /**
+     * Copies the data store, including any part of a snapshot not loaded yet.
+     * Hold applyMutex_ to make the copy consistent with lastAppliedIndex_.
+     */
+    std::map<std::string, std::string> copyDataStore() const;
+
+    /**
+     * Copies the data store with the version of every key.
+     * Hold applyMutex_ to make the copy consistent with lastAppliedIndex_.
+     */
+    std::map<std::string, storage::StripedStore::VersionedValue> copyVersionedDataStore() const;
+
+    /**
+     * Looks up a key in the data store, falling through to a snapshot
+     * that is still being loaded.
+     * @return true and sets value if the key is present
+     */
+    bool lookup(const std::string& key, std::string& value) const;
+
+    /**
+     * Looks up a key and its version, like lookup().
+     */
+    bool lookup(const std::string& key, std::string& value, long& version) const;
+
+    /**
+     * Mutates the data store according to a log entry. Writes and deletes
+     * clear the key's expiry deadline; expire operations set it if the key
+     * exists; load operations write every pair of their image file.
+     * Caller must hold applyMutex_.
+     * @return false if the entry is a load whose image cannot be opened or
+     *         has a corrupt block, in which case nothing was changed (a
+     *         block that passes its checksum but fails to decode leaves
+     *         the earlier blocks applied)
+     */
+    bool applyToDataStore(const model::LogEntry& entry);
+
+    /**
+     * Writes the pairs of a bulk load at one version, clearing their expiry
+     * deadlines like writes do. Each stripe is locked once for all of its
+     * keys, and the stripes are split across the parallel applier when
+     * there is one. Caller must hold applyMutex_.
+     * @return the number of pairs written
+     */
+    size_t applyLoad(const std::vector<std::pair<std::string, std::string>>& pairs, long version);
+
+    /**
+     * Publishes an entry as the last one applied, updating the index and
+     * timestamp watermarks. Caller must hold applyMutex_.
+     */
+    void markApplied(const model::LogEntry& entry);
+
+    /**
+     * Wakes threads in waitForIndex() after the last applied index or the
+     * up/down state changed. Cheap when nobody is waiting.
+     */
+    void notifyProgress();
+
+    /**
+     * Appends an applied entry to the in-memory log.
+     * Caller must hold applyMutex_ so the log stays in index order.
+     */
+    void appendToLog(const model::LogEntry& entry);
+
+    /**
+     * Replaces this node's data store, log and last index with a copy of
+     * another node's, taken consistently with that node's applies. The
+     * keys are streamed from an image of the other store, a run at a time
+     * under the LSM engine, so neither side holds the whole copy in memory.
+     * A node on the LSM engine keeps it; any other adopts the other node's
+     * in-memory engine (an LSM directory belongs to one node, so a copy
+     * from an LSM node goes to the tree engine until an engine is set).
+     * @param other the node to copy from
+     */
+    void copyStateFrom(const AbstractNode& other);
+
+    /**
+     * Applies the next log entry in sequence. Caller must hold applyMutex_.
+     * @return false if the entry is not the next one
+     */
+    bool applyInOrderLocked(const model::LogEntry& entry);
+
+    /**
+     * Applies a batch for applyBatchFromLeader(), which compacts the log
+     * once it is done.
+     */
+    size_t applyLeaderBatch(const std::vector<model::LogEntry>& entries, long leaderTerm, bool coalesce);
+
+    /**
+     * Called after applyBatchFromLeader() applied the first count entries,
+     * with applyMutex_ still held so successive calls stay in log order.
+     * Relaying slaves forward them; the default does nothing.
+     */
+    virtual void relayApplied(const std::vector<model::LogEntry>& entries, size_t count);
+
+    /**
+     * Gets the bytes held by the streams this node feeds, with their
+     * queues and acknowledgement watermarks. The default holds none.
+     */
+    virtual size_t getReplicationMemoryUsage() const;
+
+    /**
+     * Gets the index every node this one feeds has applied, so compaction
+     * keeps the log entries after it. Nodes that are down do not count.
+     * The default, for a node feeding nobody, is the last applied index.
+     */
+    virtual long getLogCompactionBound() const;
+
+    /**
+     * Compacts the log, if enabled or under the LSM engine, once at least
+     * half of it can be dropped. Caller must not hold applyMutex_ or
+     * logMutex_.
+     */
+    void compactLogIfDue();
+
+    /**
+     * Drops the log entries up to an index.
+     * @return the number of entries dropped
+     */
+    size_t compactLog(long throughIndex);
+
+    /**
+     * Called when the next entry to apply is a load whose image cannot be
+     * opened or read, with applyMutex_ held. The node cannot replay past it
+     * without diverging; the default only reports it, leaving the node behind.
+     */
+    virtual void recoverMissingImage(const model::LogEntry& entry);
+
+    /**
+     * Called when a block of the installed snapshot fails its checksum,
+     * after the snapshot has been released. The store holds only part of
+     * the snapshot; the default only reports it, leaving the node incomplete.
+     */
+    virtual void recoverCorruptSnapshot(const storage::SnapshotReader& snapshot);
+
+    /**
+     * Copies the installed snapshot into the data store, then releases it.
+     */
+    void loadSnapshot(std::shared_ptr<storage::SnapshotReader> snapshot);
+
+    /**
+     * Unregisters a closed view, dropping kept history once none are open.
+     */
+    void closeReadView(long index);
+
+    /**
+     * Gets the oldest index a view can open at. Caller must hold applyMutex_.
+     */
+    long oldestReadableIndexLocked() const;
+
     // Thread pool implementation for asynchronous execution
-    class ThreadPool {
+    class ThreadPool : public Executor {
     public:
         explicit ThreadPool(size_t num_threads);
-        ~ThreadPool();
+        ~ThreadPool() override;
         
         template<class F>
         void enqueue(F&& f);
+
+        void execute(std::function<void()> task) override;
         
     private:
+        // Shared with the workers, so one can outlive the pool if a task destroys it
+        struct State {
+            std::queue<std::function<void()>> tasks;
+            std::mutex queue_mutex;
+            std::condition_variable condition;
+            bool stop = false;
+        };
+
         std::vector<std::thread> workers;
-        std::queue<std::function<void()>> tasks;
-        
-        std::mutex queue_mutex;
-        std::condition_variable condition;
-        bool stop;
+        std::shared_ptr<State> state;
     };
     
     std::string id_;
     std::atomic<bool> up_;
-    std::map<std::string, std::string> dataStore_;
+    storage::StripedStore dataStore_;
     std::vector<model::LogEntry> log_;
-    std::shared_ptr<std::shared_mutex> lock_;
+    // Heap bytes of the strings in log_, and the index log_ continues
+    // from; updated under logMutex_, readable without it
+    std::atomic<size_t> logHeapBytes_;
+    std::atomic<long> logStartIndex_;
+    std::atomic<bool> logCompaction_;
+    std::atomic<size_t> maxLogBytes_;
     std::atomic<long> lastAppliedIndex_;
-    std::unique_ptr<ThreadPool> replicationExecutor_;
+    std::atomic<long> lastAppliedTimestamp_;
+    std::atomic<long> term_;
+    std::atomic<long> downSinceMillis_;
+    std::atomic<uint64_t> coalescedCount_;
+    std::shared_ptr<Executor> replicationExecutor_;
+
+    // Snapshot still being loaded lazily, and keys deleted since it was taken.
+    // Guarded by snapshotMutex_, which is only taken while snapshotActive_ is set.
+    std::shared_ptr<storage::SnapshotReader> snapshot_;
+    std::set<std::string> snapshotTombstones_;
+    std::atomic<bool> snapshotActive_;
+    mutable std::shared_mutex snapshotMutex_;
+    std::atomic<bool> stopping_;
+
+    // Expiry deadline of every key that has one, replicated through the log.
+    // Updated under applyMutex_ and expiryMutex_; expiringKeys_ mirrors its
+    // size so appliers can skip the lock while no key expires.
+    std::unordered_map<std::string, long> expiries_;
+    mutable std::mutex expiryMutex_;
+    std::atomic<size_t> expiringKeys_;
+    
+    // Applies large batches from a leader in parallel; null when sequential.
+    // Replaced and used under applyMutex_.
+    std::unique_ptr<ParallelApplier> parallelApplier_;
+
+    // Index of every open ReadView, and the oldest one published to the store.
+    // Views register under applyMutex_, so no apply can slip in unrecorded;
+    // stateEpoch_ changes whenever the state is replaced wholesale.
+    std::multiset<long> openViews_;
+    mutable std::mutex viewsMutex_;
+    std::atomic<uint64_t> stateEpoch_;
+
+    // Entries of history kept without a view, and the oldest index that
+    // history is complete from (raised when the horizon grows or the state
+    // is replaced). The floor is updated under applyMutex_.
+    std::atomic<long> historyHorizon_;
+    long historyFloor_;
     
-    // Mutex for thread-safe access to the log and data store
+    // Serializes mutations so entries are applied and logged in index order.
+    // Readers never take it; they only lock the stripe holding their key.
+    mutable std::mutex applyMutex_;
+    // Guards log_ only, so log scans do not block data store access
     mutable std::mutex logMutex_;
-    mutable std::mutex dataStoreMutex_;
+
+    // Threads blocked in waitForIndex(); appliers only lock when there are any
+    mutable std::mutex progressMutex_;
+    mutable std::condition_variable progressCondition_;
+    mutable std::atomic<int> progressWaiters_;
 };
 
 // Template implementation must be in the header
 template<class F>
 void AbstractNode::ThreadPool::enqueue(F&& f) {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        if(stop) {
+        std::unique_lock<std::mutex> lock(state->queue_mutex);
+        if(state->stop) {
             throw std::runtime_error("enqueue on stopped ThreadPool");
         }
-        tasks.emplace(std::forward<F>(f));
+        state->tasks.emplace(std::forward<F>(f));
     }
-    condition.notify_one();
+    state->condition.notify_one();
 }
 
 } // namespace node
@@ -0,0 +1,60 @@
+#include "node/ChangeSubscription.h"
+
+#include <algorithm>
+
+namespace replication {
+namespace node {
+
+ChangeSubscription::ChangeSubscription(long id, long afterIndex, Callback callback, size_t maxPending)
+    : id_(id),
+      cursor_(afterIndex),
+      callback_(std::move(callback)),
+      stream_(nullptr, maxPending),
+      closed_(false) {
+}
+
+long ChangeSubscription::getId() const {
+    return id_;
+}
+
+long ChangeSubscription::getCursor() const {
+    return cursor_.load();
+}
+
+ReplicationStream& ChangeSubscription::getStream() {
+    return stream_;
+}
+
+bool ChangeSubscription::deliver(const std::vector<model::LogEntry>& entries) {
+    if (closed_) {
+        return false;
+    }
+
+    // Entries up to the cursor were already delivered, e.g. by a catch-up from the log
+    long cursor = cursor_.load();
+    auto first = std::find_if(entries.begin(), entries.end(), [cursor](const model::LogEntry& entry) {
+        return entry.getId() > cursor;
+    });
+    if (first == entries.end()) {
+        return true;
+    }
+
+    std::vector<model::LogEntry> fresh(first, entries.end());
+    if (!callback_(fresh)) {
+        closed_ = true;
+        return false;
+    }
+    cursor_ = fresh.back().getId();
+    return true;
+}
+
+void ChangeSubscription::close() {
+    closed_ = true;
+}
+
+bool ChangeSubscription::isClosed() const {
+    return closed_.load();
+}
+
+} // namespace node
+} // namespace replication
@@ -0,0 +1,76 @@
+#ifndef CHANGE_SUBSCRIPTION_H
+#define CHANGE_SUBSCRIPTION_H
+
+#include "model/LogEntry.h"
+#include "node/ReplicationStream.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+namespace replication {
+namespace node {
+
+/**
+ * A downstream consumer of a master's committed log entries.
+ *
+ * Entries reach it through the same bounded ReplicationStream a slave
+ * uses, drained by one task at a time, so batches arrive in log order.
+ * The cursor is the last index handed to the consumer; when the stream
+ * overflows or a resumed subscription starts behind the log, the master
+ * reads the gap after the cursor from its log instead.
+ */
+class ChangeSubscription {
+public:
+    /**
+     * Receives consecutive committed entries, in order.
+     * @return false to disconnect the subscription
+     */
+    using Callback = std::function<bool(const std::vector<model::LogEntry>&)>;
+
+    /**
+     * @param id the subscription ID, unique per master
+     * @param afterIndex the last index the consumer already has
+     * @param callback receives every later entry
+     * @param maxPending the number of queued entries beyond which the
+     *        stream overflows to reading from the log
+     */
+    ChangeSubscription(long id, long afterIndex, Callback callback,
+                       size_t maxPending = ReplicationStream::kDefaultMaxPending);
+
+    long getId() const;
+
+    /**
+     * Gets the last log index delivered, from which a consumer resumes.
+     */
+    long getCursor() const;
+
+    ReplicationStream& getStream();
+
+    /**
+     * Hands the entries after the cursor to the consumer and advances it.
+     * @param entries consecutive log entries, in order, starting at or
+     *        before the entry after the cursor
+     * @return false if the consumer disconnected
+     */
+    bool deliver(const std::vector<model::LogEntry>& entries);
+
+    /**
+     * Stops deliveries; entries still queued are dropped.
+     */
+    void close();
+    bool isClosed() const;
+
+private:
+    long id_;
+    std::atomic<long> cursor_;
+    Callback callback_;
+    ReplicationStream stream_;
+    std::atomic<bool> closed_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // CHANGE_SUBSCRIPTION_H
@@ -0,0 +1,130 @@
+#include "node/EventLoop.h"
+
+#include <algorithm>
+
+namespace replication {
+namespace node {
+
+EventLoop::EventLoop(size_t threads) : state_(std::make_shared<State>()) {
+    for (size_t i = 0; i < std::max<size_t>(1, threads); i++) {
+        workers_.emplace_back(&EventLoop::work, state_);
+    }
+}
+
+EventLoop::~EventLoop() {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+    }
+    state_->workCondition.notify_all();
+
+    for (std::thread& worker : workers_) {
+        // A task may drop the last reference to the loop, e.g. by releasing a retired node
+        if (worker.get_id() == std::this_thread::get_id()) {
+            worker.detach();
+        } else {
+            worker.join();
+        }
+    }
+}
+
+void EventLoop::execute(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->queue.push_back({state_->nextSequence++, std::move(task)});
+    }
+    state_->workCondition.notify_one();
+}
+
+void EventLoop::retire(std::shared_ptr<const void> object) {
+    std::vector<std::shared_ptr<const void>> released;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->retired.emplace_back(state_->nextSequence, std::move(object));
+        state_->collectRetired(released);
+    }
+    // Destroyed here, outside the lock, if nothing queued earlier is still pending
+}
+
+bool EventLoop::waitForIdle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    return state_->idleCondition.wait_for(lock, timeout, [this] { return state_->isIdle(); });
+}
+
+size_t EventLoop::getThreadCount() const {
+    return workers_.size();
+}
+
+size_t EventLoop::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->queue.size();
+}
+
+uint64_t EventLoop::getTasksRun() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->tasksRun;
+}
+
+bool EventLoop::State::isIdle() const {
+    return queue.empty() && running.empty() && releasing == 0;
+}
+
+uint64_t EventLoop::State::oldestUnfinished() const {
+    uint64_t oldest = nextSequence;
+    if (!running.empty()) {
+        oldest = std::min(oldest, *running.begin());
+    }
+    if (!queue.empty()) {
+        oldest = std::min(oldest, queue.front().sequence);
+    }
+    return oldest;
+}
+
+void EventLoop::State::collectRetired(std::vector<std::shared_ptr<const void>>& released) {
+    uint64_t oldest = oldestUnfinished();
+    while (!retired.empty() && retired.front().first <= oldest) {
+        released.push_back(std::move(retired.front().second));
+        retired.pop_front();
+    }
+}
+
+void EventLoop::work(std::shared_ptr<State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        state->workCondition.wait(lock, [&state] {
+            return state->stopping || !state->queue.empty();
+        });
+        if (state->queue.empty()) {
+            return;
+        }
+
+        Task task = std::move(state->queue.front());
+        state->queue.pop_front();
+        state->running.insert(task.sequence);
+        lock.unlock();
+
+        task.run();
+        task.run = nullptr;
+
+        std::vector<std::shared_ptr<const void>> released;
+        lock.lock();
+        state->running.erase(task.sequence);
+        state->tasksRun++;
+        state->collectRetired(released);
+
+        // Retired nodes may queue work or take locks of their own while being destroyed
+        if (!released.empty()) {
+            state->releasing++;
+            lock.unlock();
+            released.clear();
+            lock.lock();
+            state->releasing--;
+        }
+        if (state->isIdle()) {
+            state->idleCondition.notify_all();
+        }
+    }
+}
+
+} // namespace node
+} // namespace replication
@@ -0,0 +1,128 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "node/Executor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace replication {
+namespace node {
+
+/**
+ * Executor shared by many nodes, so a large cluster runs in one process on
+ * a few threads. Without one, every node starts a private pool of five
+ * threads. With one, each node's stream drains, recoveries and snapshot
+ * loads are tasks on a single FIFO run queue served by a fixed set of
+ * workers, and a node costs no threads of its own. A stream is still
+ * drained by one task at a time, so each slave receives its batches in
+ * log order as before.
+ *
+ * Queued tasks refer to the node that queued them, so a node must outlive
+ * them. Once a node leaves the cluster, pass its last reference to
+ * retire() instead of dropping it.
+ */
+class EventLoop : public Executor {
+public:
+    /**
+     * Starts the workers.
+     * @param threads the number of workers (at least one)
+     */
+    explicit EventLoop(size_t threads);
+
+    /**
+     * Runs every queued task, then stops the workers.
+     */
+    ~EventLoop() override;
+
+    void execute(std::function<void()> task) override;
+
+    /**
+     * Keeps an object alive until every task queued so far has finished,
+     * then releases it on a worker.
+     * @param object typically a node removed from the cluster
+     */
+    void retire(std::shared_ptr<const void> object);
+
+    /**
+     * Waits until no task is queued or running.
+     * @param timeout how long to wait at most
+     * @return true if the loop went idle before the timeout
+     */
+    bool waitForIdle(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /**
+     * Gets the number of workers.
+     */
+    size_t getThreadCount() const;
+
+    /**
+     * Gets the number of tasks queued but not yet started.
+     */
+    size_t getPendingCount() const;
+
+    /**
+     * Gets the number of tasks run so far.
+     */
+    uint64_t getTasksRun() const;
+
+private:
+    struct Task {
+        uint64_t sequence;
+        std::function<void()> run;
+    };
+
+    // Shared with the workers, so one can outlive the loop if a task destroys it
+    struct State {
+        std::mutex mutex;
+        std::condition_variable workCondition;
+        std::condition_variable idleCondition;
+        std::deque<Task> queue;
+        // Sequence numbers of the tasks being run
+        std::set<uint64_t> running;
+        // Retired objects and the sequence number every earlier task is below
+        std::deque<std::pair<uint64_t, std::shared_ptr<const void>>> retired;
+        // Workers destroying released objects
+        int releasing = 0;
+        uint64_t nextSequence = 0;
+        uint64_t tasksRun = 0;
+        bool stopping = false;
+
+        /**
+         * Checks that no task is queued or running and nothing is being
+         * released. Caller must hold mutex.
+         */
+        bool isIdle() const;
+
+        /**
+         * Gets the lowest sequence number of a task not yet finished.
+         * Caller must hold mutex.
+         */
+        uint64_t oldestUnfinished() const;
+
+        /**
+         * Moves the retired objects no unfinished task can still use into
+         * released. Caller must hold mutex.
+         */
+        void collectRetired(std::vector<std::shared_ptr<const void>>& released);
+    };
+
+    static void work(std::shared_ptr<State> state);
+
+    std::shared_ptr<State> state_;
+    std::vector<std::thread> workers_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // EVENT_LOOP_H
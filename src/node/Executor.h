@@ -0,0 +1,28 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <functional>
+
+namespace replication {
+namespace node {
+
+/**
+ * Runs a node's asynchronous work: replication drains, slave recovery and
+ * snapshot loading. Nodes default to a private thread pool; a simulation
+ * can substitute an executor that decides task order deterministically.
+ */
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    /**
+     * Schedules a task to run asynchronously.
+     * @param task the task to run
+     */
+    virtual void execute(std::function<void()> task) = 0;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // EXECUTOR_H
@@ -0,0 +1,75 @@
+#include "node/LogRing.h"
+#include <thread>
+
+namespace replication {
+namespace node {
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+LogRing::LogRing(size_t capacity, long firstIndex)
+    : capacity_(roundUpToPowerOfTwo(capacity == 0 ? 1 : capacity)),
+      mask_(capacity_ - 1),
+      slots_(new Slot[capacity_]) {
+    reset(firstIndex);
+}
+
+void LogRing::reset(long firstIndex) {
+    // Slot p is free for the first ID at or after firstIndex that maps to p
+    for (size_t i = 0; i < capacity_; i++) {
+        long index = firstIndex + static_cast<long>(i);
+        Slot& slot = slots_[static_cast<size_t>(index) & mask_];
+        slot.sequence.store(index, std::memory_order_relaxed);
+        slot.operation = nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LogRing::publish(const model::LogEntry& entry, PendingOperation* operation) {
+    long index = entry.getId();
+    Slot& slot = slots_[static_cast<size_t>(index) & mask_];
+
+    // Wait for the consumer to free this slot from the previous lap
+    while (slot.sequence.load(std::memory_order_acquire) != index) {
+        std::this_thread::yield();
+    }
+
+    slot.entry.emplace(entry);
+    slot.operation = operation;
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+bool LogRing::isReady(long index) const {
+    const Slot& slot = slots_[static_cast<size_t>(index) & mask_];
+    return slot.sequence.load(std::memory_order_acquire) == index + 1;
+}
+
+std::optional<model::LogEntry> LogRing::tryConsume(long index, PendingOperation*& operation) {
+    Slot& slot = slots_[static_cast<size_t>(index) & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+        return std::nullopt;
+    }
+
+    std::optional<model::LogEntry> entry = std::move(slot.entry);
+    slot.entry.reset();
+    operation = slot.operation;
+    slot.operation = nullptr;
+    slot.sequence.store(index + static_cast<long>(capacity_), std::memory_order_release);
+    return entry;
+}
+
+size_t LogRing::getCapacity() const {
+    return capacity_;
+}
+
+} // namespace node
+} // namespace replication
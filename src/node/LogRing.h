@@ -0,0 +1,109 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include "model/LogEntry.h"
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <cstddef>
+
+namespace replication {
+namespace node {
+
+/**
+ * The part of a write the sequencer resolves against the current state
+ * when it applies the entry, e.g. a comparison or an increment. Owned by
+ * the publishing writer, which waits until its entry has been applied
+ * before reading the outcome.
+ */
+struct PendingOperation {
+    enum class Kind {
+        DELETE,           // Reports whether the key existed
+        COMPARE_VALUE,    // Writes the entry's value if the key holds expectedValue
+        COMPARE_VERSION,  // Writes the entry's value if the key is at expectedVersion (0: absent)
+        INCREMENT,        // Adds delta to the key's integer value (a missing key counts as 0)
+        APPEND,           // Appends the entry's value to the key's value
+        LOAD,             // Writes pairs at the entry's ID instead of reading back the image file
+        EVICT             // Deletes the key if it is still at expectedVersion, the version sampled
+    };
+
+    Kind kind = Kind::DELETE;
+    std::string expectedValue;
+    long expectedVersion = 0;
+    long long delta = 0;
+    const std::vector<std::pair<std::string, std::string>>* pairs = nullptr;
+
+    // Written by the sequencer before the entry's index is applied
+    bool succeeded = false;
+    std::string result;  // The value written, when the operation succeeded
+};
+
+/**
+ * Lock-free multi-producer ring of log entries indexed by log ID.
+ *
+ * Producers reserve a log ID elsewhere (an atomic fetch-add) and publish the
+ * entry into the slot that ID maps to; a single consumer takes entries back
+ * out strictly in ID order. Each slot carries a sequence number: it equals
+ * the ID the slot is free for, and that ID plus one once the entry is
+ * published. A producer that laps the consumer spins until its slot is freed.
+ */
+class LogRing {
+public:
+    /**
+     * @param capacity the number of slots, rounded up to a power of two
+     * @param firstIndex the first log ID that will be published
+     */
+    explicit LogRing(size_t capacity = 1024, long firstIndex = 1);
+
+    LogRing(const LogRing&) = delete;
+    LogRing& operator=(const LogRing&) = delete;
+
+    /**
+     * Publishes the entry for a reserved log ID.
+     * @param entry the entry, whose ID must have been reserved by the caller
+     * @param operation what the sequencer must resolve when applying the
+     *        entry, if anything; it must stay alive until then
+     */
+    void publish(const model::LogEntry& entry, PendingOperation* operation = nullptr);
+
+    /**
+     * Checks whether the entry with the given log ID has been published.
+     */
+    bool isReady(long index) const;
+
+    /**
+     * Takes the published entry with the given log ID, freeing its slot.
+     * Only the single consumer may call this, in ID order.
+     * @param operation receives the publisher's pending operation, if any
+     * @return the entry, or nothing if it has not been published yet
+     */
+    std::optional<model::LogEntry> tryConsume(long index, PendingOperation*& operation);
+
+    /**
+     * Re-bases an empty ring so the next published ID is firstIndex.
+     * Must not race with producers or the consumer.
+     */
+    void reset(long firstIndex);
+
+    size_t getCapacity() const;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<long> sequence;
+        std::optional<model::LogEntry> entry;
+        PendingOperation* operation = nullptr;
+    };
+
+    size_t capacity_;
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // LOG_RING_H
@@ -1,59 +1,373 @@
 #include "node/MasterNode.h"
 #include "node/SlaveNode.h"
+#include "storage/SnapshotWriter.h"
 #include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 
 namespace replication {
 namespace node {
 
-MasterNode::MasterNode(const std::string& id)
-    : AbstractNode(id),
-      nextLogId_(1) {
+namespace {
+
+// Upper bound on entries one sequencer pass applies before letting its writer return
+constexpr size_t kMaxSequencerBatch = 1024;
+
+// Safety net for a writer whose entry was published while another held the sequencer
+constexpr std::chrono::milliseconds kSequencerPoll(1);
+
+// Stream batches at least this large are applied with write coalescing
+constexpr size_t kCoalesceMinBatch = 64;
+
+// Resolution of the expiry timing wheel
+constexpr std::chrono::milliseconds kExpiryTick(10);
+
+// Keys compared per eviction, and evictions one writer sequences at most before returning
+constexpr size_t kEvictionSamples = 5;
+constexpr size_t kMaxEvictionsPerWrite = 1024;
+
+} // namespace
+
+MasterNode::MasterNode(const std::string& id, std::shared_ptr<Executor> executor)
+    : AbstractNode(id, std::move(executor)),
+      nextSubscriptionId_(1),
+      nextLogId_(1),
+      fenced_(false),
+      ring_(kMaxSequencerBatch, 1),
+      activeDrains_(0),
+      expiryWheel_(kExpiryTick.count(), model::LogEntry::currentTimeMillis()),
+      expiryStopping_(false),
+      memoryLimit_(0),
+      evictionCount_(0) {
 }
 
 MasterNode::~MasterNode() {
     shutdown();
+    // A private pool finishes queued stream drains while the members they use are still alive
+    replicationExecutor_.reset();
 }
 
 void MasterNode::registerSlave(std::shared_ptr<SlaveNode> slave) {
     std::lock_guard<std::mutex> guard(slavesMutex_);
-    slaves_.insert(slave);
+    for (const auto& stream : streams_) {
+        if (stream->getSlave() == slave) {
+            return;
+        }
+    }
+    streams_.push_back(std::make_shared<ReplicationStream>(slave));
     std::cout << "Master " << id_ << " registered slave: " << slave->getId() << std::endl;
 }
 
-bool MasterNode::write(const std::string& key, const std::string& value) {
+long MasterNode::subscribe(long afterIndex, ChangeSubscription::Callback callback, size_t maxPending) {
     if (!up_) {
-        std::cout << "Master " << id_ << " is DOWN, cannot write" << std::endl;
+        std::cout << "Master " << id_ << " is DOWN, cannot subscribe" << std::endl;
+        return -1;
+    }
+
+    // No entry can commit in between, so everything after afterIndex is either logged or offered later
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+    if (std::max(0L, afterIndex) < logStartIndex_.load()) {
+        std::cout << "Master " << id_ << " cannot subscribe after log index " << afterIndex
+                  << ", the log starts after " << logStartIndex_.load() << std::endl;
+        return -1;
+    }
+    std::shared_ptr<ChangeSubscription> subscription;
+    {
+        std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+        subscription = std::make_shared<ChangeSubscription>(nextSubscriptionId_++, std::max(0L, afterIndex),
+                                                            std::move(callback), maxPending);
+        subscriptions_.push_back(subscription);
+    }
+    std::cout << "Master " << id_ << " registered subscription " << subscription->getId() 
+              << " after log index " << subscription->getCursor() << std::endl;
+
+    if (subscription->getCursor() < lastAppliedIndex_.load() && subscription->getStream().requestCatchUp()) {
+        activeDrains_++;
+        replicationExecutor_->execute([this, subscription]() {
+            drainSubscription(subscription);
+        });
+    }
+    return subscription->getId();
+}
+
+bool MasterNode::unsubscribe(long subscriptionId) {
+    std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+    auto it = std::find_if(subscriptions_.begin(), subscriptions_.end(), [subscriptionId](const auto& subscription) {
+        return subscription->getId() == subscriptionId;
+    });
+    if (it == subscriptions_.end()) {
         return false;
     }
+    (*it)->close();
+    std::cout << "Master " << id_ << " removed subscription " << subscriptionId 
+              << " at log index " << (*it)->getCursor() << std::endl;
+    subscriptions_.erase(it);
+    return true;
+}
 
-    std::unique_lock<std::shared_mutex> writeLock(*lock_);
-    
-    // Create a new log entry for write operation
-    model::LogEntry entry(nextLogId_++, key, value, model::LogEntry::OperationType::WRITE);
-    
-    // Apply to the master's data store first
-    dataStore_[key] = value;
-    
-    // Add to log
+long MasterNode::getSubscriptionCursor(long subscriptionId) const {
+    std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+    for (const auto& subscription : subscriptions_) {
+        if (subscription->getId() == subscriptionId) {
+            return subscription->getCursor();
+        }
+    }
+    return -1;
+}
+
+size_t MasterNode::getReplicationMemoryUsage() const {
+    size_t bytes = 0;
     {
-        std::lock_guard<std::mutex> logLock(logMutex_);
-        log_.push_back(entry);
+        std::lock_guard<std::mutex> guard(slavesMutex_);
+        bytes += streams_.capacity() * sizeof(std::shared_ptr<ReplicationStream>);
+        for (const auto& stream : streams_) {
+            bytes += stream->getMemoryUsage();
+        }
     }
-    
-    lastAppliedIndex_ = entry.getId();
-    
-    std::cout << "Master " << id_ << " wrote " << key << "=" << value 
-              << " (Log ID: " << entry.getId() << ")" << std::endl;
-    
-    // Track replication status
+    std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+    bytes += subscriptions_.capacity() * sizeof(std::shared_ptr<ChangeSubscription>);
+    for (const auto& subscription : subscriptions_) {
+        bytes += sizeof(ChangeSubscription) + subscription->getStream().getMemoryUsage();
+    }
+    return bytes;
+}
+
+void MasterNode::recoverMissingImage(const model::LogEntry& entry) {
+    AbstractNode::recoverMissingImage(entry);
+    goDown();
+}
+
+long MasterNode::getReplicatedIndex(const std::string& slaveId) const {
+    std::lock_guard<std::mutex> guard(slavesMutex_);
+    for (const auto& stream : streams_) {
+        if (stream->getSlave()->getId() == slaveId) {
+            return stream->getAcknowledgedIndex();
+        }
+    }
+    return -1;
+}
+
+long MasterNode::getLogCompactionBound() const {
+    long bound = lastAppliedIndex_.load();
+    std::lock_guard<std::mutex> guard(slavesMutex_);
+    for (const auto& stream : streams_) {
+        std::shared_ptr<SlaveNode> slave = stream->getSlave();
+        if (slave->isUp()) {
+            bound = std::min(bound, std::max(stream->getAcknowledgedIndex(), slave->getLastLogIndex()));
+        }
+    }
+    return bound;
+}
+
+void MasterNode::unregisterSlave(std::shared_ptr<SlaveNode> slave) {
+    std::lock_guard<std::mutex> guard(slavesMutex_);
+    auto it = std::find_if(streams_.begin(), streams_.end(), [&slave](const auto& stream) {
+        return stream->getSlave() == slave;
+    });
+    if (it != streams_.end()) {
+        streams_.erase(it);
+        std::cout << "Master " << id_ << " unregistered slave: " << slave->getId() << std::endl;
+    }
+}
+
+bool MasterNode::removeSlave(std::shared_ptr<SlaveNode> slave, std::chrono::milliseconds timeout) {
+    std::shared_ptr<ReplicationStream> stream;
     {
-        std::lock_guard<std::mutex> pendingLock(pendingReplicationsMutex_);
-        pendingReplications_[entry.getId()] = std::set<std::string>();
+        std::lock_guard<std::mutex> guard(slavesMutex_);
+        auto it = std::find_if(streams_.begin(), streams_.end(), [&slave](const auto& candidate) {
+            return candidate->getSlave() == slave;
+        });
+        if (it != streams_.end()) {
+            stream = *it;
+            streams_.erase(it);
+        }
     }
-    
-    // Asynchronously replicate to slaves
-    replicateToSlaves(entry);
-    
+
+    // Nothing is offered to the stream any more, so its drain task ends once the queue is empty
+    bool drained = true;
+    if (stream) {
+        std::unique_lock<std::mutex> drainsLock(drainsMutex_);
+        drained = drainsCondition_.wait_for(drainsLock, timeout, [&stream] { return !stream->isDraining(); });
+    }
+
+    // Its watermark went with the stream; no other replication state refers to the slave
+    std::cout << "Master " << id_ << " removed slave: " << slave->getId()
+              << (stream ? " at log index " + std::to_string(stream->getAcknowledgedIndex()) : "")
+              << (drained ? "" : " (queue not drained)") << std::endl;
+    return drained;
+}
+
+void MasterNode::goUp() {
+    AbstractNode::goUp();
+
+    std::vector<std::shared_ptr<ReplicationStream>> currentStreams;
+    {
+        std::lock_guard<std::mutex> guard(slavesMutex_);
+        currentStreams = streams_;
+    }
+    for (const auto& stream : currentStreams) {
+        std::shared_ptr<SlaveNode> slave = stream->getSlave();
+        if (slave->isUp() && slave->getMaster().get() == this) {
+            slave->requestRecovery();
+        }
+    }
+}
+
+bool MasterNode::waitForReplication(long index, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::vector<std::shared_ptr<SlaveNode>> followers;
+    {
+        std::lock_guard<std::mutex> guard(slavesMutex_);
+        for (const auto& stream : streams_) {
+            followers.push_back(stream->getSlave());
+        }
+    }
+    // Include every slave fed through a relay
+    for (size_t i = 0; i < followers.size(); i++) {
+        for (auto& downstream : followers[i]->getDownstream()) {
+            followers.push_back(std::move(downstream));
+        }
+    }
+
+    // Repeat until one pass finds no lagging slave, since a slave may come
+    // back up (behind) while we are waiting on another
+    bool lagging = true;
+    while (lagging) {
+        lagging = false;
+        for (const auto& slave : followers) {
+            if (!slave->isUp() || slave->getMaster().get() != this ||
+                (slave->getLastLogIndex() >= index && !slave->isLoadingSnapshot())) {
+                continue;
+            }
+            lagging = true;
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now());
+            if (remaining.count() <= 0) {
+                return false;
+            }
+            // A slave that goes down while we wait no longer counts
+            slave->waitForIndex(index, remaining);
+        }
+    }
+    return true;
+}
+
+bool MasterNode::quiesce(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    long index = lastAppliedIndex_.load();  // getLastLogIndex() hides it while down
+
+    // Let queued deliveries finish first, so none lands after we return
+    {
+        std::unique_lock<std::mutex> drainsLock(drainsMutex_);
+        if (!drainsCondition_.wait_until(drainsLock, deadline, [this] { return activeDrains_ == 0; })) {
+            return false;
+        }
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (!waitForReplication(index, std::max(remaining, std::chrono::milliseconds(0)))) {
+        return false;
+    }
+    compactLogIfDue();
+    return true;
+}
+
+bool MasterNode::write(const std::string& key, const std::string& value) {
+    if (!up_) {
+        std::cout << "Master " << id_ << " is DOWN, cannot write" << std::endl;
+        return false;
+    }
+    if (fenced_) {
+        std::cout << "Master " << id_ << " is fenced (deposed), cannot write" << std::endl;
+        return false;
+    }
+
+    long index = publish(key, value, model::LogEntry::OperationType::WRITE, nullptr);
+    sequence(index);
+    evictToLimit();
+    return true;
+}
+
+bool MasterNode::compareAndSet(const std::string& key, const std::string& expected, const std::string& value) {
+    PendingOperation operation;
+    operation.kind = PendingOperation::Kind::COMPARE_VALUE;
+    operation.expectedValue = expected;
+    return execute(key, value, operation);
+}
+
+bool MasterNode::compareAndSetVersion(const std::string& key, long expectedVersion, const std::string& value) {
+    PendingOperation operation;
+    operation.kind = PendingOperation::Kind::COMPARE_VERSION;
+    operation.expectedVersion = expectedVersion;
+    return execute(key, value, operation);
+}
+
+bool MasterNode::increment(const std::string& key, long long delta, long long& result) {
+    PendingOperation operation;
+    operation.kind = PendingOperation::Kind::INCREMENT;
+    operation.delta = delta;
+    if (!execute(key, "", operation)) {
+        return false;
+    }
+    result = std::stoll(operation.result);
+    return true;
+}
+
+bool MasterNode::append(const std::string& key, const std::string& suffix, size_t& length) {
+    PendingOperation operation;
+    operation.kind = PendingOperation::Kind::APPEND;
+    if (!execute(key, suffix, operation)) {
+        return false;
+    }
+    length = operation.result.size();
+    return true;
+}
+
+bool MasterNode::execute(const std::string& key, const std::string& value, PendingOperation& operation) {
+    if (!up_) {
+        std::cout << "Master " << id_ << " is DOWN, cannot write" << std::endl;
+        return false;
+    }
+    if (fenced_) {
+        std::cout << "Master " << id_ << " is fenced (deposed), cannot write" << std::endl;
+        return false;
+    }
+
+    long index = publish(key, value, model::LogEntry::OperationType::WRITE, &operation);
+    sequence(index);
+    evictToLimit();
+    return operation.succeeded;
+}
+
+bool MasterNode::write(const std::string& key, const std::string& value, std::chrono::milliseconds ttl) {
+    if (!up_) {
+        std::cout << "Master " << id_ << " is DOWN, cannot write" << std::endl;
+        return false;
+    }
+    if (fenced_) {
+        std::cout << "Master " << id_ << " is fenced (deposed), cannot write" << std::endl;
+        return false;
+    }
+    if (ttl.count() <= 0) {
+        std::cout << "Master " << id_ << " rejected write of '" << key << "' with TTL "
+                  << ttl.count() << " ms" << std::endl;
+        return false;
+    }
+
+    // Consecutive IDs, so no other operation on the key can land in between
+    long index = nextLogId_.fetch_add(2);
+    long timestamp = model::LogEntry::currentTimeMillis();
+    long term = term_.load();
+    ring_.publish(model::LogEntry(index, key, value, model::LogEntry::OperationType::WRITE,
+                                  timestamp, term));
+    ring_.publish(model::LogEntry(index + 1, key, std::to_string(timestamp + ttl.count()),
+                                  model::LogEntry::OperationType::EXPIRE, timestamp, term));
+    sequence(index + 1);
+    startExpiryThread();
+    evictToLimit();
     return true;
 }
 
@@ -62,82 +376,557 @@ bool MasterNode::deleteKey(const std::string& key) {
         std::cout << "Master " << id_ << " is DOWN, cannot delete" << std::endl;
         return false;
     }
+    if (fenced_) {
+        std::cout << "Master " << id_ << " is fenced (deposed), cannot delete" << std::endl;
+        return false;
+    }
 
-    std::unique_lock<std::shared_mutex> writeLock(*lock_);
-    
-    // Check if the key exists before attempting to delete
-    auto it = dataStore_.find(key);
-    if (it == dataStore_.end()) {
+    // Check if the key exists before attempting to delete, so misses do not use up a log ID
+    std::string existing;
+    if (!lookup(key, existing)) {
         std::cout << "Master " << id_ << " could not delete key '" << key << "' (not found)" << std::endl;
         return false;
     }
     
-    // Create a new log entry for delete operation
-    model::LogEntry entry(nextLogId_++, key, "", model::LogEntry::OperationType::DELETE);
+    // A concurrent delete may still win; the sequencer reports what it found when applying
+    PendingOperation operation;
+    long index = publish(key, "", model::LogEntry::OperationType::DELETE, &operation);
+    sequence(index);
     
-    // Remove the key from the data store
-    dataStore_.erase(it);
-    
-    // Add to log
-    {
-        std::lock_guard<std::mutex> logLock(logMutex_);
-        log_.push_back(entry);
+    if (!operation.succeeded) {
+        std::cout << "Master " << id_ << " could not delete key '" << key << "' (not found)" << std::endl;
     }
+    return operation.succeeded;
+}
+
+bool MasterNode::bulkLoad(const std::vector<std::pair<std::string, std::string>>& pairs,
+                          const std::string& imagePath) {
+    if (!up_) {
+        std::cout << "Master " << id_ << " is DOWN, cannot bulk load" << std::endl;
+        return false;
+    }
+    if (fenced_) {
+        std::cout << "Master " << id_ << " is fenced (deposed), cannot bulk load" << std::endl;
+        return false;
+    }
+
+    // The pairs take the load entry's ID, which is not known yet, so the image records index 0
+    storage::SnapshotWriter writer(imagePath, 0);
+    bool written = writer.open();
+    for (size_t i = 0; written && i < pairs.size(); i++) {
+        written = writer.add(pairs[i].first, pairs[i].second);
+    }
+    if (!written || !writer.finish()) {
+        std::cout << "Master " << id_ << " could not write bulk image " << imagePath << std::endl;
+        return false;
+    }
+
+    PendingOperation operation;
+    operation.kind = PendingOperation::Kind::LOAD;
+    operation.pairs = &pairs;
+    long index = publish("", imagePath, model::LogEntry::OperationType::LOAD, &operation);
+    sequence(index);
+    evictToLimit();
+    return true;
+}
+
+long MasterNode::publish(const std::string& key, const std::string& value,
+                         model::LogEntry::OperationType type, PendingOperation* operation) {
+    long index = nextLogId_.fetch_add(1);
+    ring_.publish(model::LogEntry(index, key, value, type, model::LogEntry::currentTimeMillis(), 
+                                  term_.load()), operation);
+    return index;
+}
+
+void MasterNode::sequence(long index) {
+    while (lastAppliedIndex_ < index) {
+        if (applyMutex_.try_lock()) {
+            bool progressed = drainRing();
+            applyMutex_.unlock();
+            
+            // Wake writers only after releasing, so one of them can take over at once
+            if (progressed) {
+                { std::lock_guard<std::mutex> guard(appliedMutex_); }
+                appliedCondition_.notify_all();
+                compactLogIfDue();
+            }
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> waitLock(appliedMutex_);
+        appliedCondition_.wait_for(waitLock, kSequencerPoll, [this, index]() {
+            return lastAppliedIndex_ >= index;
+        });
+    }
+}
+
+bool MasterNode::drainRing() {
+    std::vector<model::LogEntry> batch;
+    long next = lastAppliedIndex_ + 1;
+    PendingOperation* operation = nullptr;
     
-    lastAppliedIndex_ = entry.getId();
-    
-    std::cout << "Master " << id_ << " deleted key '" << key 
-              << "' (Log ID: " << entry.getId() << ")" << std::endl;
-    
-    // Track replication status
-    {
-        std::lock_guard<std::mutex> pendingLock(pendingReplicationsMutex_);
-        pendingReplications_[entry.getId()] = std::set<std::string>();
+    while (batch.size() < kMaxSequencerBatch) {
+        std::optional<model::LogEntry> entry = ring_.tryConsume(next, operation);
+        if (!entry) {
+            break;
+        }
+        
+        bool expiryRequest = entry->isExpire() && entry->getExpiresAt() <= entry->getTimestamp();
+        bool evictionRequest = operation && operation->kind == PendingOperation::Kind::EVICT;
+        if (expiryRequest) {
+            entry = resolveExpiry(*entry);
+        } else if (evictionRequest) {
+            entry = resolveEviction(*entry, *operation);
+        } else if (operation && operation->kind != PendingOperation::Kind::DELETE &&
+                   operation->kind != PendingOperation::Kind::LOAD) {
+            entry = resolveOperation(*entry, *operation);
+        }
+        
+        if (entry->isLoad()) {
+            // The pairs are still in memory; only replicas read them back from the image
+            size_t loaded = applyLoad(*operation->pairs, entry->getId());
+            operation->succeeded = true;
+            std::cout << "Master " << id_ << " loaded " << loaded << " keys from bulk image " 
+                      << entry->getValue() << " (Log ID: " << entry->getId() << ")" << std::endl;
+        } else if (entry->isDelete()) {
+            std::string existing;
+            bool existed = lookup(entry->getKey(), existing);
+            if (operation) {
+                operation->succeeded = existed;
+            }
+            std::cout << "Master " << id_ << " deleted key '" << entry->getKey() 
+                      << "' (Log ID: " << entry->getId()
+                      << (expiryRequest ? ", expired" : evictionRequest ? ", evicted" : "") << ")" << std::endl;
+        } else if (entry->isExpire()) {
+            if (!expiryRequest && entry->getExpiresAt() > 0) {
+                std::lock_guard<std::mutex> wheelLock(wheelMutex_);
+                expiryWheel_.schedule(entry->getKey(), entry->getExpiresAt());
+            }
+            std::cout << "Master " << id_ << " set expiry of key '" << entry->getKey() << "' to "
+                      << entry->getExpiresAt() << " (Log ID: " << entry->getId() << ")" << std::endl;
+        } else if (entry->getOperationType() == model::LogEntry::OperationType::NOOP) {
+            std::cout << "Master " << id_ << " left key '" << entry->getKey() << "' unchanged (Log ID: "
+                      << entry->getId() << ", condition failed)" << std::endl;
+        } else {
+            std::cout << "Master " << id_ << " wrote " << entry->getKey() << "=" << entry->getValue()
+                      << " (Log ID: " << entry->getId() << ")" << std::endl;
+        }
+        
+        // Apply to the master's data store first, then log it outside the stripe lock
+        if (!entry->isLoad()) {
+            applyToDataStore(*entry);
+        }
+        appendToLog(*entry);
+        if (wal_) {
+            wal_->append(*entry);
+        }
+        batch.push_back(std::move(*entry));
+        next++;
     }
     
-    // Asynchronously replicate to slaves
-    replicateToSlaves(entry);
+    if (batch.empty()) {
+        return false;
+    }
+    markApplied(batch.back());
     
+    // Asynchronously replicate to slaves and subscribers
+    replicateToSlaves(batch);
+    publishToSubscribers(batch);
     return true;
 }
 
-void MasterNode::replicateToSlaves(const model::LogEntry& entry) {
-    std::vector<std::shared_ptr<SlaveNode>> currentSlaves;
+void MasterNode::replicateToSlaves(const std::vector<model::LogEntry>& entries) {
+    std::vector<std::shared_ptr<ReplicationStream>> currentStreams;
     
     {
         std::lock_guard<std::mutex> guard(slavesMutex_);
-        for (const auto& slave : slaves_) {
-            currentSlaves.push_back(slave);
-        }
-    }
-
-    for (const auto& slave : currentSlaves) {
-        replicationExecutor_->enqueue([this, slave, entry]() {
-            if (slave->isUp()) {
-                bool success = slave->applyLogEntry(entry, lock_);
-                if (success) {
-                    // Track successful replication
-                    std::lock_guard<std::mutex> pendingLock(pendingReplicationsMutex_);
-                    auto it = pendingReplications_.find(entry.getId());
-                    if (it != pendingReplications_.end()) {
-                        it->second.insert(slave->getId());
-                        std::cout << "Master " << id_ << " replicated log entry " << entry.getId() 
-                                  << " to slave " << slave->getId() << std::endl;
-                    }
-                } else {
-                    slave->recoverSlave();
-                }
+        currentStreams = streams_;
+    }
+
+    for (const auto& stream : currentStreams) {
+        if (stream->offer(entries)) {
+            activeDrains_++;
+            replicationExecutor_->execute([this, stream]() {
+                drainStream(stream);
+            });
+        }
+    }
+}
+
+void MasterNode::drainStream(std::shared_ptr<ReplicationStream> stream) {
+    std::shared_ptr<SlaveNode> slave = stream->getSlave();
+    
+    do {
+        bool overflowed = false;
+        std::vector<model::LogEntry> entries = stream->take(overflowed);
+        
+        if (!slave->isUp()) {
+            // The slave recovers missed entries from the log when it comes back up;
+            // slaves it relays to are fed directly meanwhile
+            std::cout << "Master " << id_ << " couldn't replicate " << entries.size() 
+                      << " log entries to slave " << slave->getId() << " (DOWN)" << std::endl;
+            if (overflowed) {
+                slave->recoverRelayed();
             } else {
-                std::cout << "Master " << id_ << " couldn't replicate to slave " 
-                          << slave->getId() << " (DOWN)" << std::endl;
+                slave->receiveRelayed(entries, getTerm());
             }
-        });
+            continue;
+        }
+        if (overflowed) {
+            std::cout << "Master " << id_ << " stream to slave " << slave->getId() 
+                      << " overflowed, switching to catch-up" << std::endl;
+            slave->recoverSlave();
+            continue;
+        }
+        
+        // A batch this large means the slave fell behind; skip overwritten values
+        long term = getTerm();
+        size_t applied = slave->applyBatchFromLeader(entries, term, entries.size() >= kCoalesceMinBatch);
+        
+        // Track successful replication; entries are applied in order, so the last one covers the rest
+        if (applied > 0) {
+            stream->acknowledge(entries[applied - 1].getId());
+            std::cout << "Master " << id_ << " replicated log entries up to " << entries[applied - 1].getId()
+                      << " to slave " << slave->getId() << std::endl;
+            compactLogIfDue();  // The slowest slave may just have moved the bound
+        }
+        
+        if (applied < entries.size()) {
+            if (slave->getTerm() > term) {
+                // A newer leader exists; stop replicating rather than retrying
+                std::cout << "Master " << id_ << " (term " << term << ") fenced by slave " 
+                          << slave->getId() << " at term " << slave->getTerm() << std::endl;
+                fence();
+            } else {
+                slave->recoverSlave();
+            }
+        }
+    } while (stream->finishDrain());
+    finishDrainTask();
+}
+
+void MasterNode::publishToSubscribers(const std::vector<model::LogEntry>& entries) {
+    std::vector<std::shared_ptr<ChangeSubscription>> currentSubscriptions;
+    {
+        std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+        if (subscriptions_.empty()) {
+            return;
+        }
+        currentSubscriptions = subscriptions_;
+    }
+
+    for (const auto& subscription : currentSubscriptions) {
+        if (subscription->getStream().offer(entries)) {
+            activeDrains_++;
+            replicationExecutor_->execute([this, subscription]() {
+                drainSubscription(subscription);
+            });
+        }
+    }
+}
+
+void MasterNode::drainSubscription(std::shared_ptr<ChangeSubscription> subscription) {
+    ReplicationStream& stream = subscription->getStream();
+
+    do {
+        bool overflowed = false;
+        std::vector<model::LogEntry> entries = stream.take(overflowed);
+        if (subscription->isClosed()) {
+            continue;
+        }
+
+        // Read the gap after the cursor from the log; it covers everything logged so far
+        long cursor = subscription->getCursor();
+        bool compactedPast = false;
+        if (overflowed || (!entries.empty() && entries.front().getId() > cursor + 1)) {
+            std::lock_guard<std::mutex> logLock(logMutex_);
+            compactedPast = cursor < logStartIndex_.load();
+            auto first = std::partition_point(log_.begin(), log_.end(), [cursor](const model::LogEntry& entry) {
+                return entry.getId() <= cursor;
+            });
+            entries.assign(first, log_.end());
+        }
+        if (compactedPast) {
+            std::cout << "Master " << id_ << " subscription " << subscription->getId() 
+                      << " fell behind the compacted log at log index " << cursor << std::endl;
+            unsubscribe(subscription->getId());
+            continue;
+        }
+
+        if (!subscription->deliver(entries)) {
+            std::cout << "Master " << id_ << " subscription " << subscription->getId() 
+                      << " disconnected at log index " << subscription->getCursor() << std::endl;
+            unsubscribe(subscription->getId());
+        }
+    } while (stream.finishDrain());
+    finishDrainTask();
+}
+
+void MasterNode::finishDrainTask() {
+    // removeSlave() waits for a single stream, so every finished drain wakes the waiters
+    std::lock_guard<std::mutex> drainsLock(drainsMutex_);
+    activeDrains_--;
+    drainsCondition_.notify_all();
+}
+
+model::LogEntry MasterNode::resolveOperation(const model::LogEntry& request, PendingOperation& operation) {
+    std::string current;
+    long version = 0;
+    bool exists = lookup(request.getKey(), current, version);
+
+    std::string value;
+    switch (operation.kind) {
+        case PendingOperation::Kind::COMPARE_VALUE:
+            operation.succeeded = exists && current == operation.expectedValue;
+            value = request.getValue();
+            break;
+        case PendingOperation::Kind::COMPARE_VERSION:
+            operation.succeeded = operation.expectedVersion == 0 ? !exists
+                                                                 : exists && version == operation.expectedVersion;
+            value = request.getValue();
+            break;
+        case PendingOperation::Kind::INCREMENT: {
+            long long number = 0;
+            const char* text = current.c_str();
+            char* end = nullptr;
+            errno = 0;
+            if (exists) {
+                number = std::strtoll(text, &end, 10);
+            }
+            long long sum = 0;
+            operation.succeeded = (!exists || (!current.empty() && errno == 0 && *end == '\0')) &&
+                                  !__builtin_add_overflow(number, operation.delta, &sum);
+            value = std::to_string(sum);
+            break;
+        }
+        case PendingOperation::Kind::APPEND:
+            operation.succeeded = true;
+            value = current + request.getValue();
+            break;
+        case PendingOperation::Kind::DELETE:
+        case PendingOperation::Kind::LOAD:
+        case PendingOperation::Kind::EVICT:
+            break;
+    }
+
+    if (!operation.succeeded) {
+        return model::LogEntry(request.getId(), request.getKey(), "", model::LogEntry::OperationType::NOOP,
+                               request.getTimestamp(), request.getTerm());
+    }
+    operation.result = value;
+    return model::LogEntry(request.getId(), request.getKey(), value, model::LogEntry::OperationType::WRITE,
+                           request.getTimestamp(), request.getTerm());
+}
+
+model::LogEntry MasterNode::resolveExpiry(const model::LogEntry& request) {
+    long deadline = getExpiresAt(request.getKey());
+    std::string existing;
+    if (deadline > 0 && deadline <= request.getTimestamp() && lookup(request.getKey(), existing)) {
+        return model::LogEntry(request.getId(), request.getKey(), "", model::LogEntry::OperationType::DELETE,
+                               request.getTimestamp(), request.getTerm());
+    }
+    return model::LogEntry(request.getId(), request.getKey(), deadline > 0 ? std::to_string(deadline) : "",
+                           model::LogEntry::OperationType::EXPIRE, request.getTimestamp(), request.getTerm());
+}
+
+model::LogEntry MasterNode::resolveEviction(const model::LogEntry& request, PendingOperation& operation) {
+    std::string existing;
+    long version = 0;
+    if (dataStore_.get(request.getKey(), existing, version) && version == operation.expectedVersion) {
+        evictionCount_++;
+        return model::LogEntry(request.getId(), request.getKey(), "", model::LogEntry::OperationType::DELETE,
+                               request.getTimestamp(), request.getTerm());
+    }
+    return model::LogEntry(request.getId(), request.getKey(), "", model::LogEntry::OperationType::NOOP,
+                           request.getTimestamp(), request.getTerm());
+}
+
+void MasterNode::setMemoryLimit(size_t bytes, storage::StripedStore::EvictionPolicy policy) {
+    dataStore_.setEvictionPolicy(bytes > 0 ? policy : storage::StripedStore::EvictionPolicy::NONE);
+    memoryLimit_ = bytes;
+    // The log counts against the limit, so it gets at most half before lagging slaves are left to a state copy
+    setLogCompaction(bytes > 0, bytes / 4);
+    if (bytes > 0) {
+        std::cout << "Master " << id_ << " memory limit set to " << bytes << " bytes" << std::endl;
+        evictToLimit();
+    }
+}
+
+size_t MasterNode::getMemoryLimit() const {
+    return memoryLimit_.load();
+}
+
+uint64_t MasterNode::getEvictionCount() const {
+    return evictionCount_.load();
+}
+
+size_t MasterNode::evictToLimit() {
+    size_t limit = memoryLimit_.load();
+    if (limit == 0 || dataStore_.getFootprint() + getLogFootprint() <= limit || !up_ || fenced_) {
+        return 0;
+    }
+    // Other writers carry on while one evicts for everybody
+    std::unique_lock<std::mutex> evictionLock(evictionMutex_, std::try_to_lock);
+    if (!evictionLock.owns_lock()) {
+        return 0;
+    }
+
+    // The sampled version rides with the delete; the sequencer checks it still stands
+    size_t requested = 0;
+    while (requested < kMaxEvictionsPerWrite &&
+           dataStore_.getFootprint() + getLogFootprint() > memoryLimit_.load() && up_ && !fenced_) {
+        std::string key;
+        long version = 0;
+        if (!dataStore_.sampleEvictionCandidate(kEvictionSamples, key, version)) {
+            break;
+        }
+        PendingOperation operation;
+        operation.kind = PendingOperation::Kind::EVICT;
+        operation.expectedVersion = version;
+        sequence(publish(key, "", model::LogEntry::OperationType::DELETE, &operation));
+        requested++;
+    }
+    return requested;
+}
+
+size_t MasterNode::expireDue() {
+    // Timers stay on the wheel while the master is down, and fire once it is back
+    if (!up_ || fenced_) {
+        return 0;
+    }
+
+    std::vector<std::pair<std::string, long>> fired;
+    {
+        std::lock_guard<std::mutex> wheelLock(wheelMutex_);
+        expiryWheel_.advance(model::LogEntry::currentTimeMillis(), fired);
+    }
+
+    // Skip timers made stale by a later write, delete or new deadline. Sequence
+    // before the ring fills, as nobody else may be around to drain it.
+    long last = 0;
+    size_t requested = 0;
+    for (const auto& [key, deadline] : fired) {
+        if (getExpiresAt(key) == deadline) {
+            last = publish(key, std::to_string(deadline), model::LogEntry::OperationType::EXPIRE, nullptr);
+            requested++;
+            if (requested % (kMaxSequencerBatch - 1) == 0) {
+                sequence(last);
+                last = 0;
+            }
+        }
+    }
+    if (last > 0) {
+        sequence(last);
+    }
+    return requested;
+}
+
+void MasterNode::rebuildExpiryWheel() {
+    std::unordered_map<std::string, long> expiries;
+    {
+        std::lock_guard<std::mutex> expiryLock(expiryMutex_);
+        expiries = expiries_;
+    }
+    {
+        std::lock_guard<std::mutex> wheelLock(wheelMutex_);
+        expiryWheel_.clear(model::LogEntry::currentTimeMillis());
+        for (const auto& [key, deadline] : expiries) {
+            expiryWheel_.schedule(key, deadline);
+        }
+    }
+    if (!expiries.empty()) {
+        startExpiryThread();
+    }
+}
+
+void MasterNode::startExpiryThread() {
+    std::lock_guard<std::mutex> threadLock(expiryThreadMutex_);
+    if (expiryThread_.joinable() || expiryStopping_) {
+        return;
+    }
+    expiryThread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> threadLock(expiryThreadMutex_);
+        while (!expiryCondition_.wait_for(threadLock, kExpiryTick, [this] { return expiryStopping_; })) {
+            threadLock.unlock();
+            expireDue();
+            threadLock.lock();
+        }
+    });
+}
+
+void MasterNode::assumeLeadership(const AbstractNode& predecessor, long term) {
+    copyStateFrom(predecessor);
+    observeTerm(term);
+    
+    {
+        std::lock_guard<std::mutex> applyLock(applyMutex_);
+        nextLogId_ = lastAppliedIndex_.load() + 1;
+        ring_.reset(nextLogId_.load());
+    }
+    fenced_ = false;
+    rebuildExpiryWheel();
+    
+    std::cout << "Master " << id_ << " assumed leadership for term " << term 
+              << " at log index " << lastAppliedIndex_ << std::endl;
+}
+
+void MasterNode::fence() {
+    if (!fenced_.exchange(true)) {
+        std::cout << "Master " << id_ << " fenced at term " << getTerm() << std::endl;
+    }
+}
+
+bool MasterNode::isFenced() const {
+    return fenced_.load();
+}
+
+void MasterNode::attachWriteAheadLog(std::shared_ptr<storage::WriteAheadLog> wal) {
+    std::lock_guard<std::mutex> applyLock(applyMutex_);
+
+    // Replay anything persisted beyond what this node already holds
+    std::vector<model::LogEntry> recovered = wal->readEntriesAfter(lastAppliedIndex_.load());
+    for (const auto& entry : recovered) {
+        // Stop short, and go down, rather than log past keys that were never loaded
+        if (!applyToDataStore(entry)) {
+            recoverMissingImage(entry);
+            break;
+        }
+        appendToLog(entry);
+        markApplied(entry);
     }
+    nextLogId_ = lastAppliedIndex_.load() + 1;
+    ring_.reset(nextLogId_.load());
+    wal_ = std::move(wal);
+    rebuildExpiryWheel();
+
+    std::cout << "Master " << id_ << " recovered " << recovered.size() 
+              << " log entries from WAL (last index " << lastAppliedIndex_ << ")" << std::endl;
 }
 
 void MasterNode::shutdown() {
     // Thread pool is cleaned up in the AbstractNode destructor
+    std::thread expiryThread;
+    {
+        std::lock_guard<std::mutex> threadLock(expiryThreadMutex_);
+        expiryStopping_ = true;
+        expiryThread = std::move(expiryThread_);
+    }
+    expiryCondition_.notify_all();
+    if (expiryThread.joinable()) {
+        expiryThread.join();
+    }
+
+    // Drains already scheduled keep their stream until they finish
+    {
+        std::lock_guard<std::mutex> guard(slavesMutex_);
+        streams_.clear();
+    }
+    std::lock_guard<std::mutex> guard(subscriptionsMutex_);
+    for (const auto& subscription : subscriptions_) {
+        subscription->close();
+    }
+    subscriptions_.clear();
 }
 
 } // namespace node
-} // namespace replication
\ No newline at end of file
+} // namespace replication
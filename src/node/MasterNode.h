@@ -2,11 +2,18 @@
 #define MASTER_NODE_H
 
 #include "node/AbstractNode.h"
-#include <set>
+#include "node/LogRing.h"
+#include "node/ReplicationStream.h"
+#include "node/ChangeSubscription.h"
+#include "node/TimingWheel.h"
+#include "storage/WriteAheadLog.h"
 #include <unordered_map>
 #include <atomic>
 #include <memory>
 #include <future>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
 
 namespace replication {
 namespace node {
@@ -18,13 +25,20 @@ class SlaveNode;
  * Implementation of the master node in the replication system.
  * The master node is responsible for handling write operations and replicating
  * them to slave nodes.
+ *
+ * Writers never take a node-wide exclusive lock: each reserves a log ID with an
+ * atomic fetch-add and publishes its entry into a lock-free ring. Whichever
+ * writer acquires the apply mutex acts as the sequencer, applying every
+ * published entry in ID order and fanning batches out to per-slave streams,
+ * while the other writers wait for their own ID to be applied.
  */
 class MasterNode : public AbstractNode {
 public:
     /**
      * Constructs a master node with the given ID.
+     * @param executor runs replication work; a private thread pool when null
      */
-    explicit MasterNode(const std::string& id);
+    explicit MasterNode(const std::string& id, std::shared_ptr<Executor> executor = nullptr);
     
     /**
      * Destructor
@@ -36,15 +50,125 @@ public:
      * @param slave the slave node to register
      */
     void registerSlave(std::shared_ptr<SlaveNode> slave);
+
+    /**
+     * Stops feeding a slave directly, e.g. once a relay feeds it instead.
+     * @param slave the slave to drop
+     */
+    void unregisterSlave(std::shared_ptr<SlaveNode> slave);
+
+    /**
+     * Removes a slave for good, e.g. when scaling read replicas down. No
+     * batch is queued for it from now on, and its stream, along with the
+     * acknowledgement watermark it holds, is dropped at once; the batches
+     * already queued are still delivered.
+     * @param slave the slave to remove
+     * @param timeout how long to wait for the queued batches at most
+     * @return true if the queue was drained before the timeout
+     */
+    bool removeSlave(std::shared_ptr<SlaveNode> slave,
+                     std::chrono::milliseconds timeout = std::chrono::seconds(5));
     
+    /**
+     * Subscribes a downstream consumer to committed log entries. Batches
+     * are delivered in log order on a replication task, through the same
+     * bounded streams as slaves: a consumer that falls too far behind, or
+     * resumes from an older index, is fed from the log instead, so no
+     * entry is skipped or repeated. After a failover, subscribe again on
+     * the new master from the last delivered index. With log compaction on
+     * (see setLogCompaction()), a consumer that needs entries compacted out
+     * of the log is unsubscribed.
+     * @param afterIndex the last index the consumer already has (0 for everything)
+     * @param callback receives consecutive batches; returning false unsubscribes
+     * @param maxPending queued entries beyond which delivery falls back to the log
+     * @return the subscription ID, or -1 if the master is down or afterIndex
+     *         is older than the log reaches
+     */
+    long subscribe(long afterIndex, ChangeSubscription::Callback callback,
+                   size_t maxPending = ReplicationStream::kDefaultMaxPending);
+
+    /**
+     * Ends a subscription. A batch being delivered may still complete.
+     * @return true if the subscription existed
+     */
+    bool unsubscribe(long subscriptionId);
+
+    /**
+     * Gets the last log index delivered to a subscription.
+     * @return the index, or -1 if there is no such subscription
+     */
+    long getSubscriptionCursor(long subscriptionId) const;
+
+    /**
+     * Gets the last log index a slave fed by this master acknowledged.
+     * @return the index, or -1 if the slave acknowledged nothing or is not fed by this master
+     */
+    long getReplicatedIndex(const std::string& slaveId) const;
+
     /**
      * Writes a key-value pair to the master and replicates it to the slaves.
+     * Safe to call from many threads at once; returns once the write has
+     * been applied to the master.
      * @param key the key to write
      * @param value the value to write
      * @return true if the write was successful
      */
     bool write(const std::string& key, const std::string& value);
+
+    /**
+     * Writes a key-value pair that expires after the given time to live.
+     * The write and an expire operation carrying the absolute deadline are
+     * logged as consecutive entries, so every replica agrees on the
+     * deadline. Once it passes, the master deletes the key through the log;
+     * a later write without a TTL cancels the expiry.
+     * @param key the key to write
+     * @param value the value to write
+     * @param ttl the time to live, which must be positive
+     * @return true if the write was successful
+     */
+    bool write(const std::string& key, const std::string& value, std::chrono::milliseconds ttl);
     
+    /**
+     * Writes a key only if it currently holds the expected value. The
+     * comparison runs in the sequencer, in log order, and only the
+     * resolved write is replicated.
+     * @param key the key to write
+     * @param expected the value the key must hold
+     * @param value the value to write
+     * @return true if the key held the expected value and was written
+     */
+    bool compareAndSet(const std::string& key, const std::string& expected, const std::string& value);
+
+    /**
+     * Writes a key only if it is still at the expected version, as
+     * returned by readVersioned().
+     * @param key the key to write
+     * @param expectedVersion the version the key must be at, or 0 if it must not exist
+     * @param value the value to write
+     * @return true if the version matched and the key was written
+     */
+    bool compareAndSetVersion(const std::string& key, long expectedVersion, const std::string& value);
+
+    /**
+     * Adds to the integer value of a key in one logged step, treating a
+     * missing key as 0. Slaves receive the resulting value as a write.
+     * @param key the counter key
+     * @param delta the amount to add (negative to decrement)
+     * @param result receives the new value
+     * @return false if the value is not an integer or the sum would overflow
+     */
+    bool increment(const std::string& key, long long delta, long long& result);
+
+    /**
+     * Appends to the value of a key in one logged step, creating the key
+     * if it is missing. Slaves receive the resulting value as a write.
+     * @param key the key to append to
+     * @param suffix the bytes to append
+     * @param length receives the length of the new value
+     * @return true if the append was applied
+     */
+    bool append(const std::string& key, const std::string& suffix, size_t& length);
+
     /**
      * Deletes a key-value pair from the master and replicates the delete operation to the slaves.
      * @param key the key to delete
@@ -53,22 +177,262 @@ public:
     bool deleteKey(const std::string& key) override;
     
     /**
-     * Shuts down the replication executor service.
+     * Writes many pairs in one logged step, for seeding or rebuilding a
+     * cluster. The pairs are written to an image file in the snapshot
+     * format, then a single load entry naming the file is sequenced like
+     * any write: the master writes the pairs straight into its data store,
+     * one lock per stripe, and slaves, recovery and WAL replay read them
+     * back from the image when they apply the entry. Every pair takes the
+     * load entry's ID as its version. The image must stay readable for as
+     * long as the entry may be replayed; a slave that cannot open it copies
+     * the master's state instead of replaying past the entry.
+     * @param pairs keys in strictly ascending order (see storage::BulkReader)
+     * @param imagePath where to write the image file
+     * @return false if the master is down or fenced, or the image could not be written
+     */
+    bool bulkLoad(const std::vector<std::pair<std::string, std::string>>& pairs, const std::string& imagePath);
+
+    /**
+     * Persists every subsequent log entry to the given write-ahead log.
+     * Entries already in the WAL beyond this node's last index are replayed
+     * first, restoring the data store and log after a restart.
+     * Appends do not wait for the disk; use the WAL's waitForDurable() when
+     * durability is required.
+     * @param wal an opened write-ahead log
+     */
+    void attachWriteAheadLog(std::shared_ptr<storage::WriteAheadLog> wal);
+
+    /**
+     * Brings the master back up after a failure and asks every slave that
+     * is up to catch up, since slaves cannot recover while it is down.
+     */
+    void goUp() override;
+
+    /**
+     * Takes over as leader for a new term, starting from a copy of the given
+     * node's data store and log (normally the most up-to-date slave).
+     * @param predecessor the node whose state to adopt
+     * @param term the new leader term, stamped on every entry written from now on
+     */
+    void assumeLeadership(const AbstractNode& predecessor, long term);
+
+    /**
+     * Fences this master after a newer leader was elected: writes and
+     * deletes are refused from now on, even once the node comes back up.
+     */
+    void fence();
+
+    /**
+     * Checks whether this master has been fenced.
+     */
+    bool isFenced() const;
+
+    /**
+     * Waits until every slave that is up and following this master,
+     * directly or through relays, has applied the given log index. Slaves that are down are not waited for;
+     * one that comes back up during the wait must catch up before this returns.
+     * @param index the log index to wait for
+     * @param timeout how long to wait at most
+     * @return true if all up slaves reached the index before the timeout
+     */
+    bool waitForReplication(long index, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /**
+     * Waits until every stream has delivered what was queued on it and
+     * every up slave has applied everything this master has written so far,
+     * then compacts the log if compaction is on.
+     * @param timeout how long to wait at most
+     * @return true if replication caught up before the timeout
+     */
+    bool quiesce(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /**
+     * Deletes, through the log, every key whose expiry deadline has passed.
+     * Driven by the timing wheel, so only keys that are due are examined.
+     * Runs every tick on the expiry thread once any key expires.
+     * @return the number of expirations sequenced
+     */
+    size_t expireDue();
+
+    /**
+     * Bounds the data store and log to a number of bytes, so this master
+     * runs as a bounded cache. A write that takes them past the limit
+     * evicts keys chosen by the policy until they are back under. Each
+     * eviction is a logged delete, so slaves evict the same keys. The log
+     * is compacted as slaves apply it, and kept to a quarter of the limit
+     * even if one lags (see setLogCompaction()).
+     * @param bytes the limit on the data store and log (see getMemoryUsage()); 0 removes it
+     * @param policy how the keys to evict are chosen
+     */
+    void setMemoryLimit(size_t bytes,
+                        storage::StripedStore::EvictionPolicy policy = storage::StripedStore::EvictionPolicy::LRU);
+
+    /**
+     * Gets the data store limit, or 0 if there is none.
+     */
+    size_t getMemoryLimit() const;
+
+    /**
+     * Evicts keys through the log until the data store and log are within the
+     * memory limit. Runs after every write; one writer evicts at a time.
+     * @return the number of evictions sequenced
+     */
+    size_t evictToLimit();
+
+    /**
+     * Gets how many keys have been evicted so far.
+     */
+    uint64_t getEvictionCount() const;
+
+    /**
+     * Stops the expiry thread and drops every slave stream and
+     * subscription, so nothing is replicated from now on and the slaves,
+     * which refer back to this master, no longer keep each other alive.
+     * The replication executor is cleaned up with the node.
      */
     void shutdown();
 
+protected:
+    size_t getReplicationMemoryUsage() const override;
+
+    /**
+     * Gets the lowest index the slaves that are up have acknowledged or
+     * applied. Subscriptions do not hold the log back; one that falls
+     * behind it is disconnected.
+     */
+    long getLogCompactionBound() const override;
+
+    /**
+     * Goes down: entries logged from here on would reuse the IDs of those
+     * after the load, so a replica has to take over instead.
+     */
+    void recoverMissingImage(const model::LogEntry& entry) override;
+
 private:
     /**
-     * Replicates a log entry to all registered slave nodes asynchronously.
-     * @param entry the log entry to replicate
+     * Reserves the next log ID and publishes an entry for it into the ring.
+     * @param operation what the sequencer resolves when applying the entry, if anything
+     * @return the reserved log ID
+     */
+    long publish(const std::string& key, const std::string& value,
+                 model::LogEntry::OperationType type, PendingOperation* operation);
+
+    /**
+     * Publishes a conditional or read-modify-write operation and waits
+     * until the sequencer has resolved and applied it.
+     * @return whether the operation succeeded
+     */
+    bool execute(const std::string& key, const std::string& value, PendingOperation& operation);
+
+    /**
+     * Waits until the given log ID has been applied, acting as the
+     * sequencer whenever the apply mutex is free.
+     * @param index the log ID to wait for
+     */
+    void sequence(long index);
+
+    /**
+     * Applies published entries in ID order, appends them to the log and
+     * WAL, and hands them to the slave streams. Caller must hold applyMutex_.
+     * @return true if at least one entry was applied
+     */
+    bool drainRing();
+
+    /**
+     * Queues a batch of applied entries on every slave's stream, scheduling
+     * a drain task for streams that are idle. Caller must hold applyMutex_.
+     * @param entries consecutive log entries, in order
+     */
+    void replicateToSlaves(const std::vector<model::LogEntry>& entries);
+
+    /**
+     * Delivers everything queued on a stream to its slave, in order.
+     * @param stream the stream to drain
+     */
+    void drainStream(std::shared_ptr<ReplicationStream> stream);
+
+    /**
+     * Queues a batch of applied entries for every subscription, like
+     * replicateToSlaves(). Caller must hold applyMutex_.
+     * @param entries consecutive log entries, in order
+     */
+    void publishToSubscribers(const std::vector<model::LogEntry>& entries);
+
+    /**
+     * Delivers everything queued for a subscription, reading from the log
+     * after its cursor when the stream overflowed or skipped ahead.
+     * @param subscription the subscription to drain
+     */
+    void drainSubscription(std::shared_ptr<ChangeSubscription> subscription);
+
+    /**
+     * Marks a drain task finished, waking quiesce() after the last one.
+     */
+    void finishDrainTask();
+
+    /**
+     * Evaluates a pending operation against the current state and returns
+     * the entry to log in its place: a write of the resolved value, or a
+     * no-op when a condition fails. Caller must hold applyMutex_.
      */
-    void replicateToSlaves(const model::LogEntry& entry);
+    model::LogEntry resolveOperation(const model::LogEntry& request, PendingOperation& operation);
 
-    std::set<std::shared_ptr<SlaveNode>> slaves_;
-    std::unordered_map<long, std::set<std::string>> pendingReplications_;
+    /**
+     * Turns an expiry request into the operation to log: a delete if the
+     * key's deadline still stands, otherwise an expire operation restating
+     * its current deadline (empty when none), as a write may have replaced
+     * the key since the request was published. Caller must hold applyMutex_.
+     */
+    model::LogEntry resolveExpiry(const model::LogEntry& request);
+
+    /**
+     * Turns an eviction request into the operation to log: a delete if the
+     * key still holds the sampled version, otherwise a no-op, as a write
+     * may have refreshed the key since it was sampled. Caller must hold applyMutex_.
+     */
+    model::LogEntry resolveEviction(const model::LogEntry& request, PendingOperation& operation);
+
+    /**
+     * Reschedules every expiring key, after the data store was replaced.
+     */
+    void rebuildExpiryWheel();
+
+    /**
+     * Starts the expiry thread unless it is running or was shut down.
+     */
+    void startExpiryThread();
+
+    std::vector<std::shared_ptr<ReplicationStream>> streams_;
+    std::vector<std::shared_ptr<ChangeSubscription>> subscriptions_;
+    long nextSubscriptionId_;
+    mutable std::mutex subscriptionsMutex_;
+    std::shared_ptr<storage::WriteAheadLog> wal_;
     std::atomic<long> nextLogId_;
+    std::atomic<bool> fenced_;
+    LogRing ring_;
     mutable std::mutex slavesMutex_;
-    mutable std::mutex pendingReplicationsMutex_;
+    
+    // Stream drains scheduled but not finished, so quiesce() can wait them out
+    std::atomic<int> activeDrains_;
+    std::mutex drainsMutex_;
+    std::condition_variable drainsCondition_;
+
+    // Pending expirations; the thread advancing it starts with the first TTL
+    TimingWheel expiryWheel_;
+    std::mutex wheelMutex_;
+    std::thread expiryThread_;
+    std::mutex expiryThreadMutex_;
+    std::condition_variable expiryCondition_;
+    bool expiryStopping_;
+
+    // Data store limit, and the writer currently evicting down to it
+    std::atomic<size_t> memoryLimit_;
+    std::atomic<uint64_t> evictionCount_;
+    std::mutex evictionMutex_;
+
+    // Writers waiting for the sequencer to apply their entry
+    std::mutex appliedMutex_;
+    std::condition_variable appliedCondition_;
 };
 
 } // namespace node
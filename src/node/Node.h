@@ -70,18 +70,18 @@ public:
     virtual long getLastLogIndex() const = 0;
     
     /**
-     * Applies a log entry to this node.
+     * Applies a log entry to this node. Entries are accepted strictly in
+     * index order; the node serializes concurrent applies itself.
      * @param entry the log entry to apply
-     * @param lock the lock to use for thread safety
      * @return true if applied successfully
      */
-    virtual bool applyLogEntry(const model::LogEntry& entry, 
-                              std::shared_ptr<std::shared_mutex> lock) = 0;
+    virtual bool applyLogEntry(const model::LogEntry& entry) = 0;
     
     /**
      * Gets all log entries after the specified index.
      * @param afterIndex the index after which to get log entries
-     * @return a list of log entries
+     * @return a list of log entries, starting later than afterIndex + 1 if
+     *         the log has been compacted past it
      */
     virtual std::vector<model::LogEntry> getLogEntriesAfter(long afterIndex) const = 0;
 };
@@ -0,0 +1,117 @@
+#include "node/ParallelApplier.h"
+
+#include <algorithm>
+
+namespace replication {
+namespace node {
+
+ParallelApplier::ParallelApplier(size_t threads)
+    : threads_(std::max<size_t>(1, threads)),
+      task_(nullptr),
+      partitions_(0),
+      generation_(0),
+      stopping_(false),
+      nextPartition_(0),
+      finished_(0),
+      activeWorkers_(0) {
+    for (size_t i = 1; i < threads_; i++) {
+        workers_.emplace_back([this]() {
+            workerLoop();
+        });
+    }
+}
+
+ParallelApplier::~ParallelApplier() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    startCondition_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ParallelApplier::getThreadCount() const {
+    return threads_;
+}
+
+void ParallelApplier::run(size_t partitions, const std::function<void(size_t)>& task) {
+    if (partitions == 0) {
+        return;
+    }
+    if (workers_.empty() || partitions == 1) {
+        for (size_t p = 0; p < partitions; p++) {
+            task(p);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(runMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        partitions_ = partitions;
+        nextPartition_ = 0;
+        finished_ = 0;
+        generation_++;
+    }
+    startCondition_.notify_all();
+
+    size_t done = work(task, partitions);
+
+    // Wait out workers still inside the batch, so none touches the task after it goes out of scope
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_ += done;
+    doneCondition_.wait(lock, [this]() {
+        return finished_ == partitions_ && activeWorkers_ == 0;
+    });
+    task_ = nullptr;
+}
+
+size_t ParallelApplier::work(const std::function<void(size_t)>& task, size_t partitions) {
+    size_t done = 0;
+    size_t partition;
+    while ((partition = nextPartition_.fetch_add(1)) < partitions) {
+        task(partition);
+        done++;
+    }
+    return done;
+}
+
+void ParallelApplier::workerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+        const std::function<void(size_t)>* task;
+        size_t partitions;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            startCondition_.wait(lock, [this, seen]() {
+                return stopping_ || generation_ != seen;
+            });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+            // Woken only after that batch ended
+            if (!task_) {
+                continue;
+            }
+            task = task_;
+            partitions = partitions_;
+            activeWorkers_++;
+        }
+
+        size_t done = work(*task, partitions);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ += done;
+        activeWorkers_--;
+        if (finished_ == partitions_ && activeWorkers_ == 0) {
+            doneCondition_.notify_all();
+        }
+    }
+}
+
+} // namespace node
+} // namespace replication
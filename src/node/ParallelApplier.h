@@ -0,0 +1,77 @@
+#ifndef PARALLEL_APPLIER_H
+#define PARALLEL_APPLIER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace replication {
+namespace node {
+
+/**
+ * Dedicated worker threads that run the partitions of one batch at once.
+ *
+ * The calling thread works alongside the workers, claiming partitions from
+ * a shared counter, and returns once every partition has finished. The
+ * workers are not shared with the node's executor, so a replication task
+ * that applies a batch can never wait on itself. One batch runs at a time.
+ */
+class ParallelApplier {
+public:
+    /**
+     * @param threads the total number of threads applying a batch,
+     *        including the caller (so threads - 1 workers are started)
+     */
+    explicit ParallelApplier(size_t threads);
+    ~ParallelApplier();
+
+    ParallelApplier(const ParallelApplier&) = delete;
+    ParallelApplier& operator=(const ParallelApplier&) = delete;
+
+    /**
+     * Gets the number of threads applying a batch, including the caller.
+     */
+    size_t getThreadCount() const;
+
+    /**
+     * Runs task(p) for every partition p in [0, partitions), each exactly
+     * once and possibly in parallel, and waits for all of them.
+     */
+    void run(size_t partitions, const std::function<void(size_t)>& task);
+
+private:
+    /**
+     * Claims and runs partitions of the current batch until none are left.
+     * @return the number of partitions run
+     */
+    size_t work(const std::function<void(size_t)>& task, size_t partitions);
+
+    void workerLoop();
+
+    size_t threads_;
+    std::vector<std::thread> workers_;
+    std::mutex runMutex_;
+
+    // The current batch, published to the workers under mutex_. A batch is
+    // over once every partition finished and no worker is still inside it.
+    std::mutex mutex_;
+    std::condition_variable startCondition_;
+    std::condition_variable doneCondition_;
+    const std::function<void(size_t)>* task_;
+    size_t partitions_;
+    uint64_t generation_;
+    bool stopping_;
+    std::atomic<size_t> nextPartition_;
+    size_t finished_;
+    size_t activeWorkers_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // PARALLEL_APPLIER_H
@@ -0,0 +1,99 @@
+#include "node/ReplicationStream.h"
+#include "storage/MemoryAccounting.h"
+
+namespace replication {
+namespace node {
+
+ReplicationStream::ReplicationStream(std::shared_ptr<SlaveNode> slave, size_t maxPending)
+    : slave_(std::move(slave)),
+      maxPending_(maxPending),
+      draining_(false),
+      overflowed_(false),
+      acknowledgedIndex_(-1) {
+}
+
+std::shared_ptr<SlaveNode> ReplicationStream::getSlave() const {
+    return slave_;
+}
+
+bool ReplicationStream::offer(const std::vector<model::LogEntry>& entries) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    
+    // Once overflowed, the slave catches up from the log; queuing more is pointless
+    if (!overflowed_) {
+        if (pending_.size() + entries.size() > maxPending_) {
+            pending_.clear();
+            pending_.shrink_to_fit();
+            overflowed_ = true;
+        } else {
+            pending_.insert(pending_.end(), entries.begin(), entries.end());
+        }
+    }
+
+    if (draining_) {
+        return false;
+    }
+    draining_ = true;
+    return true;
+}
+
+bool ReplicationStream::requestCatchUp() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_.clear();
+    overflowed_ = true;
+    if (draining_) {
+        return false;
+    }
+    draining_ = true;
+    return true;
+}
+
+std::vector<model::LogEntry> ReplicationStream::take(bool& overflowed) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    std::vector<model::LogEntry> entries;
+    entries.swap(pending_);
+    overflowed = overflowed_;
+    overflowed_ = false;
+    return entries;
+}
+
+bool ReplicationStream::finishDrain() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!pending_.empty() || overflowed_) {
+        return true;
+    }
+    draining_ = false;
+    return false;
+}
+
+size_t ReplicationStream::getPendingCount() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return pending_.size();
+}
+
+bool ReplicationStream::isDraining() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return draining_;
+}
+
+void ReplicationStream::acknowledge(long index) {
+    long current = acknowledgedIndex_.load();
+    while (index > current && !acknowledgedIndex_.compare_exchange_weak(current, index)) {
+    }
+}
+
+long ReplicationStream::getAcknowledgedIndex() const {
+    return acknowledgedIndex_.load();
+}
+
+size_t ReplicationStream::getMemoryUsage() const {
+    std::lock_guard<std::mutex> guard(mutex_);
+    size_t bytes = sizeof(*this) + pending_.capacity() * sizeof(model::LogEntry);
+    for (const auto& entry : pending_) {
+        bytes += storage::heapBytes(entry.getKey()) + storage::heapBytes(entry.getValue());
+    }
+    return bytes;
+}
+
+} // namespace node
+} // namespace replication
@@ -0,0 +1,109 @@
+#ifndef REPLICATION_STREAM_H
+#define REPLICATION_STREAM_H
+
+#include "model/LogEntry.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+
+namespace replication {
+namespace node {
+
+// Forward declaration
+class SlaveNode;
+
+/**
+ * Ordered, bounded queue of log entries on their way to one slave or
+ * change subscription.
+ *
+ * The master's sequencer offers entries in log order; at most one drain task
+ * per stream is scheduled at a time, so a slave always receives entries in
+ * order and in batches instead of one executor task per entry. If the slave
+ * falls more than maxPending entries behind, the queue is dropped and the
+ * slave catches up from the master's log instead.
+ */
+class ReplicationStream {
+public:
+    static constexpr size_t kDefaultMaxPending = 65536;
+
+    /**
+     * @param slave the slave receiving the entries, or null for a change subscription
+     * @param maxPending the number of queued entries beyond which the
+     *        stream overflows to catch-up
+     */
+    explicit ReplicationStream(std::shared_ptr<SlaveNode> slave, 
+                               size_t maxPending = kDefaultMaxPending);
+
+    std::shared_ptr<SlaveNode> getSlave() const;
+
+    /**
+     * Queues entries for the slave.
+     * @param entries consecutive log entries, in order
+     * @return true if no drain is scheduled and the caller must schedule one
+     */
+    bool offer(const std::vector<model::LogEntry>& entries);
+
+    /**
+     * Drops whatever is queued and makes the next take() report an
+     * overflow, so the receiver catches up from the log.
+     * @return true if no drain is scheduled and the caller must schedule one
+     */
+    bool requestCatchUp();
+
+    /**
+     * Takes everything queued so far.
+     * @param overflowed set to true if entries were dropped since the last take
+     * @return the queued entries, in order
+     */
+    std::vector<model::LogEntry> take(bool& overflowed);
+
+    /**
+     * Ends the current drain unless more entries arrived in the meantime.
+     * @return true if the drain must continue with another take()
+     */
+    bool finishDrain();
+
+    /**
+     * Gets the number of entries waiting to be drained.
+     */
+    size_t getPendingCount() const;
+
+    /**
+     * Checks whether a drain is scheduled or running.
+     */
+    bool isDraining() const;
+
+    /**
+     * Records that the receiver applied every entry up to the given index.
+     * @param index the last log index applied; lower values are ignored
+     */
+    void acknowledge(long index);
+
+    /**
+     * Gets the highest log index the receiver acknowledged, or -1 if none.
+     */
+    long getAcknowledgedIndex() const;
+
+    /**
+     * Gets the bytes the stream holds: itself, its queue and the queued entries' strings.
+     */
+    size_t getMemoryUsage() const;
+
+private:
+    std::shared_ptr<SlaveNode> slave_;
+    size_t maxPending_;
+    mutable std::mutex mutex_;
+    std::vector<model::LogEntry> pending_;
+    bool draining_;
+    bool overflowed_;
+    // Written by the drain task, read by anyone without taking mutex_
+    std::atomic<long> acknowledgedIndex_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // REPLICATION_STREAM_H
@@ -2,16 +2,40 @@
 #include "node/SlaveNode.h"
 #include "node/MasterNode.h"
 #include <iostream>
+#include <algorithm>
 
 namespace replication {
 namespace node {
 
-SlaveNode::SlaveNode(const std::string& id, std::shared_ptr<MasterNode> master)
-    : AbstractNode(id),
+namespace {
+
+// Relayed batches at least this large are applied with write coalescing
+constexpr size_t kCoalesceMinBatch = 64;
+
+} // namespace
+
+SlaveNode::SlaveNode(const std::string& id, std::shared_ptr<MasterNode> master,
+                     std::shared_ptr<Executor> executor)
+    : AbstractNode(id, std::move(executor)),
       master_(master) {
     // We need to defer registration until the object is fully constructed
 }
 
+SlaveNode::~SlaveNode() {
+    // A private pool finishes queued recoveries while master_ is still alive
+    replicationExecutor_.reset();
+}
+
+void SlaveNode::setMaster(std::shared_ptr<MasterNode> master) {
+    std::lock_guard<std::mutex> guard(masterMutex_);
+    master_ = std::move(master);
+}
+
+std::shared_ptr<MasterNode> SlaveNode::getMaster() const {
+    std::lock_guard<std::mutex> guard(masterMutex_);
+    return master_;
+}
+
 void SlaveNode::requestRecovery() {
     if (!up_) {
         std::cout << "Slave " << id_ << " is DOWN, cannot request recovery" << std::endl;
@@ -22,6 +46,25 @@ void SlaveNode::requestRecovery() {
     recoverSlave();
 }
 
+bool SlaveNode::bootstrapFromSnapshot(const std::string& path) {
+    if (!up_) {
+        std::cout << "Slave " << id_ << " is DOWN, cannot bootstrap" << std::endl;
+        return false;
+    }
+
+    auto snapshot = storage::SnapshotReader::open(path);
+    if (!snapshot) {
+        std::cout << "Slave " << id_ << " could not open snapshot " << path << std::endl;
+        return false;
+    }
+
+    installSnapshot(snapshot);
+    
+    // Fetch whatever the master logged after the snapshot was taken
+    requestRecovery();
+    return true;
+}
+
 void SlaveNode::goUp() {
     AbstractNode::goUp();
     // When coming back up, request recovery from the master
@@ -29,28 +72,252 @@ void SlaveNode::goUp() {
 }
 
 void SlaveNode::recoverSlave() {
-    if (!up_ || !master_->isUp()) {
+    std::shared_ptr<MasterNode> master = getMaster();
+
+    // Recover from the nearest relay above this slave that is up, sparing the master
+    std::shared_ptr<SlaveNode> relay = getUpstream();
+    while (relay && (!relay->isUp() || relay->isLoadingSnapshot())) {
+        relay = relay->getUpstream();
+    }
+    if (!up_ || (!relay && !master->isUp())) {
         std::cout << "Master or Slave " << id_ << " is DOWN, cannot recover" << std::endl;
         return;
     }
 
-    std::cout << "Master starting recovery for slave " << id_ << std::endl;
+    std::cout << "Master starting recovery for slave " << id_ 
+              << (relay ? " via relay " + relay->getId() : std::string()) << std::endl;
+
+    replicationExecutor_->execute([this, master, relay]() {
+        // A slave that went down meanwhile (e.g. to copy the master) recovers when it comes back up
+        if (!this->up_) {
+            return;
+        }
+        long slaveLastIndex = this->lastAppliedIndex_.load();
+        std::shared_ptr<AbstractNode> source = relay ? std::static_pointer_cast<AbstractNode>(relay)
+                                                     : std::static_pointer_cast<AbstractNode>(master);
+        std::vector<model::LogEntry> missingEntries = source->getLogEntriesAfter(slaveLastIndex);
+
+        // A relay whose log does not reach back far enough (e.g. it loaded a snapshot) cannot serve the gap
+        if (relay && source->getLogStartIndex() > slaveLastIndex && master->isUp()) {
+            source = master;
+            missingEntries = master->getLogEntriesAfter(slaveLastIndex);
+        }
 
-    replicationExecutor_->enqueue([this]() {
-        long slaveLastIndex = this->getLastLogIndex();
-        std::vector<model::LogEntry> missingEntries = master_->getLogEntriesAfter(slaveLastIndex);
+        // The start only moves forward, so checking it after the read proves the read was complete
+        if (source->getLogStartIndex() > slaveLastIndex) {
+            std::cout << "Slave " << this->id_ << " is behind the log of " << source->getId() 
+                      << ", fetching the master's state instead" << std::endl;
+            this->resyncFromMaster();
+            return;
+        }
 
         std::cout << "Master sending " << missingEntries.size() 
                   << " log entries to slave " << this->id_ << std::endl;
 
-        for (const auto& entry : missingEntries) {
-            this->applyLogEntry(entry, lock_);
-        }
+        // Intermediate versions of a key are overwritten by the end of the range
+        long term = source->getTerm();
+        this->applyBatchFromLeader(missingEntries, term, this->coalescedCatchUp_.load());
 
         std::cout << "Master completed recovery for slave " 
                   << this->id_ << " up to log index " << this->lastAppliedIndex_ << std::endl;
     });
 }
 
+void SlaveNode::setUpstream(std::shared_ptr<SlaveNode> upstream) {
+    std::lock_guard<std::mutex> guard(masterMutex_);
+    upstream_ = upstream;
+}
+
+std::shared_ptr<SlaveNode> SlaveNode::getUpstream() const {
+    std::lock_guard<std::mutex> guard(masterMutex_);
+    return upstream_.lock();
+}
+
+void SlaveNode::addDownstream(std::shared_ptr<SlaveNode> downstream) {
+    std::lock_guard<std::mutex> guard(downstreamMutex_);
+    for (const auto& stream : downstream_) {
+        if (stream->getSlave() == downstream) {
+            return;
+        }
+    }
+    downstream_.push_back(std::make_shared<ReplicationStream>(downstream));
+    std::cout << "Slave " << id_ << " relaying to slave: " << downstream->getId() << std::endl;
+}
+
+void SlaveNode::clearDownstream() {
+    std::lock_guard<std::mutex> guard(downstreamMutex_);
+    downstream_.clear();
+}
+
+std::vector<std::shared_ptr<SlaveNode>> SlaveNode::getDownstream() const {
+    std::lock_guard<std::mutex> guard(downstreamMutex_);
+    std::vector<std::shared_ptr<SlaveNode>> slaves;
+    for (const auto& stream : downstream_) {
+        slaves.push_back(stream->getSlave());
+    }
+    return slaves;
+}
+
+void SlaveNode::relayApplied(const std::vector<model::LogEntry>& entries, size_t count) {
+    std::vector<std::shared_ptr<ReplicationStream>> currentStreams;
+    {
+        std::lock_guard<std::mutex> guard(downstreamMutex_);
+        if (downstream_.empty()) {
+            return;
+        }
+        currentStreams = downstream_;
+    }
+
+    std::vector<model::LogEntry> applied(entries.begin(), entries.begin() + count);
+    for (const auto& stream : currentStreams) {
+        if (stream->offer(applied)) {
+            replicationExecutor_->execute([this, stream]() {
+                drainDownstream(stream);
+            });
+        }
+    }
+}
+
+size_t SlaveNode::getReplicationMemoryUsage() const {
+    std::lock_guard<std::mutex> guard(downstreamMutex_);
+    size_t bytes = downstream_.capacity() * sizeof(std::shared_ptr<ReplicationStream>);
+    for (const auto& stream : downstream_) {
+        bytes += stream->getMemoryUsage();
+    }
+    return bytes;
+}
+
+long SlaveNode::getLogCompactionBound() const {
+    long bound = lastAppliedIndex_.load();
+    std::lock_guard<std::mutex> guard(downstreamMutex_);
+    for (const auto& stream : downstream_) {
+        std::shared_ptr<SlaveNode> downstream = stream->getSlave();
+        if (downstream->isUp()) {
+            bound = std::min(bound, downstream->getLastLogIndex());
+        }
+    }
+    return bound;
+}
+
+void SlaveNode::recoverMissingImage(const model::LogEntry& entry) {
+    std::cout << "Slave " << id_ << " cannot replay bulk load " << entry.getId() 
+              << " from its image, fetching the master's state instead" << std::endl;
+    resyncFromMaster();
+}
+
+void SlaveNode::recoverCorruptSnapshot(const storage::SnapshotReader& snapshot) {
+    std::cout << "Slave " << id_ << " found a corrupt block in snapshot " << snapshot.getPath() 
+              << ", fetching the master's state instead" << std::endl;
+    resyncFromMaster();
+}
+
+void SlaveNode::resyncFromMaster() {
+    goDown();
+
+    replicationExecutor_->execute([this]() {
+        std::shared_ptr<MasterNode> master = getMaster();
+        if (!master->isUp()) {
+            std::cout << "Master is DOWN, slave " << id_ << " stays DOWN until it is brought up" << std::endl;
+            return;
+        }
+        copyStateFrom(*master);
+        goUp();
+    });
+}
+
+void SlaveNode::drainDownstream(std::shared_ptr<ReplicationStream> stream) {
+    std::shared_ptr<SlaveNode> downstream = stream->getSlave();
+
+    do {
+        bool overflowed = false;
+        std::vector<model::LogEntry> entries = stream->take(overflowed);
+        if (overflowed) {
+            std::cout << "Slave " << id_ << " stream to slave " << downstream->getId() 
+                      << " overflowed, switching to catch-up" << std::endl;
+            downstream->recoverRelayed();
+            continue;
+        }
+        downstream->receiveRelayed(entries, getTerm());
+    } while (stream->finishDrain());
+}
+
+void SlaveNode::receiveRelayed(const std::vector<model::LogEntry>& entries, long leaderTerm) {
+    if (!up_) {
+        for (const auto& downstream : getDownstream()) {
+            downstream->receiveRelayed(entries, leaderTerm);
+        }
+        return;
+    }
+
+    // A slave that recovered on its own may already hold a prefix of the batch
+    long last = lastAppliedIndex_.load();
+    auto first = std::find_if(entries.begin(), entries.end(), [last](const model::LogEntry& entry) {
+        return entry.getId() > last;
+    });
+    if (first == entries.end()) {
+        return;
+    }
+
+    std::vector<model::LogEntry> fresh(first, entries.end());
+    size_t applied = applyBatchFromLeader(fresh, leaderTerm, fresh.size() >= kCoalesceMinBatch);
+    if (applied < fresh.size() && getTerm() <= leaderTerm) {
+        recoverSlave();
+    }
+}
+
+void SlaveNode::recoverRelayed() {
+    if (up_) {
+        recoverSlave();
+        return;
+    }
+    for (const auto& downstream : getDownstream()) {
+        downstream->recoverRelayed();
+    }
+}
+
+void SlaveNode::setCoalescedCatchUp(bool enabled) {
+    coalescedCatchUp_ = enabled;
+}
+
+size_t SlaveNode::reconcileWith(const std::vector<model::LogEntry>& formerLog) {
+    std::shared_ptr<MasterNode> master = getMaster();
+    std::vector<model::LogEntry> currentLog = master->getLogEntriesAfter(0);
+
+    // Keep the longest prefix on which both logs agree; an entry with the same
+    // ID and term was written by the same leader, so everything before it matches.
+    // Logs that do not both continue from this slave's index (e.g. after a
+    // snapshot) share nothing usable, and everything is recovered instead.
+    size_t common = 0;
+    long firstId = lastAppliedIndex_.load() + 1;
+    if (!formerLog.empty() && !currentLog.empty() && 
+        formerLog.front().getId() == firstId && currentLog.front().getId() == firstId) {
+        while (common < formerLog.size() && common < currentLog.size() &&
+               formerLog[common].getId() == currentLog[common].getId() &&
+               formerLog[common].getTerm() == currentLog[common].getTerm()) {
+            common++;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> applyLock(applyMutex_);
+        for (size_t i = 0; i < common; i++) {
+            // Recovery below meets the same entry again and handles it
+            if (!applyToDataStore(formerLog[i])) {
+                break;
+            }
+            appendToLog(formerLog[i]);
+            markApplied(formerLog[i]);
+        }
+    }
+    observeTerm(master->getTerm());
+
+    size_t discarded = formerLog.size() - common;
+    std::cout << "Slave " << id_ << " reconciled with master " << master->getId() << ": kept " 
+              << common << " log entries, discarded " << discarded << " divergent entries" << std::endl;
+
+    requestRecovery();
+    return discarded;
+}
+
 } // namespace node
 } // namespace replication
\ No newline at end of file
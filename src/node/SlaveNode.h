@@ -3,7 +3,10 @@
 #define SLAVE_NODE_H
 
 #include "node/AbstractNode.h"
+#include "node/ReplicationStream.h"
 #include <memory>
+#include <atomic>
+#include <vector>
 
 namespace replication {
 namespace node {
@@ -15,6 +18,10 @@ class MasterNode;
  * Implementation of a slave node in the replication system.
  * Slave nodes receive and apply log entries from the master,
  * and handle read operations.
+ *
+ * A slave can also relay: every batch it applies from upstream is queued
+ * on a ReplicationStream per downstream slave and forwarded by its own
+ * executor, so in a chain or relay tree the master only feeds the roots.
  */
 class SlaveNode : public AbstractNode, 
                  public std::enable_shared_from_this<SlaveNode> {
@@ -23,13 +30,15 @@ public:
      * Constructs a slave node with the given ID and master reference.
      * @param id The slave node's ID
      * @param master The master node reference
+     * @param executor runs recovery work; a private thread pool when null
      */
-    SlaveNode(const std::string& id, std::shared_ptr<MasterNode> master);
+    SlaveNode(const std::string& id, std::shared_ptr<MasterNode> master,
+              std::shared_ptr<Executor> executor = nullptr);
     
     /**
      * Destructor
      */
-    ~SlaveNode() override = default;
+    ~SlaveNode() override;
 
     /**
      * Requests recovery from the master node.
@@ -38,18 +47,146 @@ public:
     void requestRecovery();
     
     /**
-     * Recovers a slave node by sending it all missing log entries.
+     * Recovers a slave node by sending it all missing log entries, taken
+     * from the nearest upstream relay that is up, or from the master.
+     * In coalesced catch-up mode (the default) only the net effect of the
+     * missing range reaches the data store: the last write or delete of
+     * each key. Every entry is still logged and the applied index advances
+     * to the end of the range.
      */
     void recoverSlave();
+
+    /**
+     * Enables or disables coalesced catch-up for later recoveries.
+     * @param enabled false to apply every missing entry in turn
+     */
+    void setCoalescedCatchUp(bool enabled);
     
+    /**
+     * Bootstraps this slave from a snapshot file instead of replaying the
+     * master's full log. The snapshot is served read-only straight from
+     * its memory mapping while it is loaded into the data store in the
+     * background; entries after the snapshot index are then recovered
+     * from the master.
+     * @param path the snapshot file written by writeSnapshot()
+     * @return false if the snapshot could not be opened or is corrupt
+     */
+    bool bootstrapFromSnapshot(const std::string& path);
+
     /**
      * Brings the node back up after a failure.
      * Overrides the base implementation to also trigger recovery.
      */
     void goUp() override;
 
+    /**
+     * Points this slave at a newly elected master.
+     * @param master the new master
+     */
+    void setMaster(std::shared_ptr<MasterNode> master);
+
+    /**
+     * Gets the master this slave replicates from.
+     */
+    std::shared_ptr<MasterNode> getMaster() const;
+
+    /**
+     * Rebuilds this slave from the log of a deposed master rejoining the
+     * shard. Entries that match the current master's log by ID and term are
+     * kept; the divergent suffix the old master never replicated is
+     * discarded, and the rest is recovered from the current master.
+     * @param formerLog the deposed master's full log
+     * @return the number of discarded entries
+     */
+    size_t reconcileWith(const std::vector<model::LogEntry>& formerLog);
+
+    /**
+     * Sets the slave this one receives entries and recovers from.
+     * @param upstream the relay feeding this slave, or null for the master
+     */
+    void setUpstream(std::shared_ptr<SlaveNode> upstream);
+
+    /**
+     * Gets the relay feeding this slave, or null if the master does.
+     */
+    std::shared_ptr<SlaveNode> getUpstream() const;
+
+    /**
+     * Forwards every batch applied from now on to another slave.
+     * @param downstream the slave to feed
+     */
+    void addDownstream(std::shared_ptr<SlaveNode> downstream);
+
+    /**
+     * Stops forwarding to every downstream slave.
+     */
+    void clearDownstream();
+
+    /**
+     * Gets the slaves this one forwards to.
+     */
+    std::vector<std::shared_ptr<SlaveNode>> getDownstream() const;
+
+    /**
+     * Applies a batch forwarded from upstream, skipping entries already
+     * applied and recovering on a gap. A slave that is down is passed over:
+     * the batch goes straight to its own downstream, so one failed relay
+     * does not stall its subtree.
+     * @param entries consecutive log entries, in order
+     * @param leaderTerm the term of the leader the entries came from
+     */
+    void receiveRelayed(const std::vector<model::LogEntry>& entries, long leaderTerm);
+
+    /**
+     * Catches up after entries were dropped on the way here: this slave
+     * recovers if it is up, otherwise its downstream does.
+     */
+    void recoverRelayed();
+
+protected:
+    /**
+     * Queues an applied batch on every downstream stream. Called with applyMutex_ held.
+     */
+    void relayApplied(const std::vector<model::LogEntry>& entries, size_t count) override;
+
+    size_t getReplicationMemoryUsage() const override;
+
+    /**
+     * Gets the lowest index the downstream slaves that are up have applied.
+     */
+    long getLogCompactionBound() const override;
+
+    /**
+     * Goes down, so nothing is read from a replica missing the load's keys,
+     * then copies the master's state in place of replaying the log and comes
+     * back up to recover whatever was logged after the copy.
+     */
+    void recoverMissingImage(const model::LogEntry& entry) override;
+
+    /**
+     * Goes down and copies the master's state, as for a missing image.
+     */
+    void recoverCorruptSnapshot(const storage::SnapshotReader& snapshot) override;
+
 private:
+    /**
+     * Goes down, then replaces this node's state with a copy of the
+     * master's on the replication executor and comes back up.
+     */
+    void resyncFromMaster();
+
+    /**
+     * Delivers everything queued on a downstream stream, in order.
+     */
+    void drainDownstream(std::shared_ptr<ReplicationStream> stream);
+
     std::shared_ptr<MasterNode> master_;
+    // Not owning, so a relay and the slaves it feeds do not keep each other alive
+    std::weak_ptr<SlaveNode> upstream_;
+    mutable std::mutex masterMutex_;
+    std::vector<std::shared_ptr<ReplicationStream>> downstream_;
+    mutable std::mutex downstreamMutex_;
+    std::atomic<bool> coalescedCatchUp_{true};
 };
 
 } // namespace node
@@ -0,0 +1,117 @@
+#include "node/TimingWheel.h"
+
+#include <algorithm>
+
+namespace replication {
+namespace node {
+
+TimingWheel::TimingWheel(long tickMillis, long nowMillis)
+    : tickMillis_(std::max(1L, tickMillis)),
+      currentTick_(nowMillis / tickMillis_),
+      count_(0),
+      slots_(kLevels * kSlots),
+      levelCounts_{} {
+}
+
+void TimingWheel::schedule(const std::string& key, long deadlineMillis) {
+    place(Timer{key, deadlineMillis});
+    count_++;
+}
+
+void TimingWheel::place(Timer timer) {
+    // Round up, so a timer never fires before its deadline
+    long tick = (timer.deadline + tickMillis_ - 1) / tickMillis_;
+    if (tick <= currentTick_) {
+        due_.push_back(std::move(timer));
+        return;
+    }
+
+    long distance = tick - currentTick_;
+    for (size_t level = 0; level < kLevels; level++) {
+        if (distance < (1L << (kSlotBits * (level + 1)))) {
+            size_t slot = static_cast<size_t>(tick >> (kSlotBits * level)) & (kSlots - 1);
+            slots_[level * kSlots + slot].push_back(std::move(timer));
+            levelCounts_[level]++;
+            return;
+        }
+    }
+
+    // Beyond the top level: park in its farthest slot until that cascades
+    long farthest = currentTick_ + (1L << (kSlotBits * kLevels)) - 1;
+    size_t slot = static_cast<size_t>(farthest >> (kSlotBits * (kLevels - 1))) & (kSlots - 1);
+    slots_[(kLevels - 1) * kSlots + slot].push_back(std::move(timer));
+    levelCounts_[kLevels - 1]++;
+}
+
+void TimingWheel::cascade(size_t level, size_t slot) {
+    std::vector<Timer> timers;
+    timers.swap(slots_[level * kSlots + slot]);
+    levelCounts_[level] -= timers.size();
+    for (auto& timer : timers) {
+        place(std::move(timer));
+    }
+}
+
+void TimingWheel::advance(long nowMillis, std::vector<std::pair<std::string, long>>& expired) {
+    auto fire = [&](std::vector<Timer>& timers) {
+        for (auto& timer : timers) {
+            expired.emplace_back(std::move(timer.key), timer.deadline);
+        }
+        count_ -= timers.size();
+        timers.clear();
+    };
+
+    fire(due_);
+    long target = nowMillis / tickMillis_;
+    if (count_ == 0) {
+        currentTick_ = std::max(currentTick_, target);
+        return;
+    }
+
+    while (currentTick_ < target && count_ > 0) {
+        // Nothing fires before the lowest occupied level next cascades, so skip ahead
+        size_t lowest = 0;
+        while (lowest + 1 < kLevels && levelCounts_[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest > 0 && levelCounts_[0] == 0) {
+            long span = 1L << (kSlotBits * lowest);
+            long boundary = (currentTick_ / span + 1) * span;
+            currentTick_ = std::min(boundary, target + 1) - 1;
+            if (currentTick_ >= target) {
+                break;
+            }
+        }
+
+        currentTick_++;
+        // Higher levels first, so their timers land in the slots cascaded next
+        for (size_t level = kLevels - 1; level > 0; level--) {
+            long span = 1L << (kSlotBits * level);
+            if ((currentTick_ & (span - 1)) == 0) {
+                cascade(level, static_cast<size_t>(currentTick_ >> (kSlotBits * level)) & (kSlots - 1));
+            }
+        }
+        fire(due_);
+        auto& slot = slots_[static_cast<size_t>(currentTick_) & (kSlots - 1)];
+        levelCounts_[0] -= slot.size();
+        fire(slot);
+    }
+    currentTick_ = std::max(currentTick_, target);
+}
+
+void TimingWheel::clear(long nowMillis) {
+    for (auto& slot : slots_) {
+        slot.clear();
+    }
+    due_.clear();
+    levelCounts_.fill(0);
+    count_ = 0;
+    currentTick_ = nowMillis / tickMillis_;
+}
+
+size_t TimingWheel::size() const {
+    return count_;
+}
+
+} // namespace node
+} // namespace replication
@@ -0,0 +1,91 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <array>
+#include <cstddef>
+
+namespace replication {
+namespace node {
+
+/**
+ * Hierarchical timing wheel of key deadlines.
+ *
+ * Four levels of 64 slots each; a level-0 slot spans one tick, and each
+ * slot of a higher level spans a whole rotation of the level below. A
+ * timer is placed on the lowest level whose range covers it and cascades
+ * down a level each time the wheel below completes a rotation, so
+ * scheduling is O(1) and advancing costs O(1) per tick plus the timers
+ * that actually fire; stretches with nothing due are skipped a rotation at
+ * a time. Deadlines beyond the top level wait in its last slot and are
+ * re-placed when it cascades.
+ *
+ * Timers cannot be cancelled: callers compare a fired deadline with the
+ * key's current one and ignore stale timers. Not thread-safe.
+ */
+class TimingWheel {
+public:
+    static constexpr size_t kLevels = 4;
+    static constexpr size_t kSlotBits = 6;
+    static constexpr size_t kSlots = size_t(1) << kSlotBits;
+
+    /**
+     * @param tickMillis the resolution of the wheel
+     * @param nowMillis the current time; earlier deadlines fire on the next advance
+     */
+    explicit TimingWheel(long tickMillis = 10, long nowMillis = 0);
+
+    /**
+     * Schedules a key to fire once the given deadline has passed.
+     * @param deadlineMillis milliseconds since epoch
+     */
+    void schedule(const std::string& key, long deadlineMillis);
+
+    /**
+     * Moves the wheel forward to the given time.
+     * @param nowMillis the current time
+     * @param expired receives (key, deadline) for every timer whose deadline
+     *        has passed, in deadline order up to the tick resolution (appended)
+     */
+    void advance(long nowMillis, std::vector<std::pair<std::string, long>>& expired);
+
+    /**
+     * Drops every timer and restarts the wheel at the given time.
+     */
+    void clear(long nowMillis);
+
+    /**
+     * Gets the number of scheduled timers, including stale ones.
+     */
+    size_t size() const;
+
+private:
+    struct Timer {
+        std::string key;
+        long deadline;
+    };
+
+    /**
+     * Places a timer on the level and slot covering its tick.
+     */
+    void place(Timer timer);
+
+    /**
+     * Re-places the timers of one slot, moving them to lower levels.
+     */
+    void cascade(size_t level, size_t slot);
+
+    long tickMillis_;
+    long currentTick_;
+    size_t count_;
+    std::vector<std::vector<Timer>> slots_;  // kLevels * kSlots
+    std::vector<Timer> due_;                 // Already due when scheduled
+    std::array<size_t, kLevels> levelCounts_;
+};
+
+} // namespace node
+} // namespace replication
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,495 @@
+#include "server/ReplicationServer.h"
+#include "server/RespProtocol.h"
+#include "model/LogEntry.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace replication {
+namespace server {
+
+namespace {
+
+constexpr size_t kReadChunkSize = 64 * 1024;
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+std::string toUpper(const std::string& input) {
+    std::string result = input;
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return result;
+}
+
+std::string toLower(const std::string& input) {
+    std::string result = input;
+    std::transform(result.begin(), result.end(), result.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return result;
+}
+
+void appendWrongArity(std::string& out, const std::string& command) {
+    RespWriter::appendError(out, "ERR wrong number of arguments for '" + command + "' command");
+}
+
+bool parseInteger(const std::string& text, long long& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoll(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+} // namespace
+
+ReplicationServer::ReplicationServer(system::ReplicationSystem& system, const ServerConfig& config)
+    : system_(system),
+      config_(config),
+      listenFd_(-1),
+      wakeupPipe_{-1, -1},
+      boundPort_(0),
+      running_(false) {
+}
+
+ReplicationServer::~ReplicationServer() {
+    stop();
+}
+
+bool ReplicationServer::start() {
+    if (running_) {
+        return true;
+    }
+
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+        std::cerr << "Server could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int reuse = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(config_.port);
+    if (::inet_pton(AF_INET, config_.bindAddress.c_str(), &address.sin_addr) != 1) {
+        std::cerr << "Server has invalid bind address " << config_.bindAddress << std::endl;
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd_, config_.backlog) != 0 ||
+        !setNonBlocking(listenFd_) ||
+        ::pipe(wakeupPipe_) != 0) {
+        std::cerr << "Server could not listen on " << config_.bindAddress << ":" << config_.port
+                  << ": " << std::strerror(errno) << std::endl;
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    setNonBlocking(wakeupPipe_[0]);
+
+    socklen_t addressLength = sizeof(address);
+    ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&address), &addressLength);
+    boundPort_ = ntohs(address.sin_port);
+
+    running_ = true;
+    loopThread_ = std::thread(&ReplicationServer::eventLoop, this);
+
+    std::cout << "Server listening on " << config_.bindAddress << ":" << boundPort_ << std::endl;
+    return true;
+}
+
+void ReplicationServer::stop() {
+    if (running_.exchange(false)) {
+        // Wake the event loop so it notices the stop request
+        char signal = 1;
+        ssize_t ignored = ::write(wakeupPipe_[1], &signal, 1);
+        (void)ignored;
+    }
+
+    // The loop may also have ended on its own after a poll failure
+    if (loopThread_.joinable()) {
+        loopThread_.join();
+    }
+    if (listenFd_ < 0) {
+        return;
+    }
+
+    for (auto& [fd, connection] : connections_) {
+        ::close(fd);
+    }
+    connections_.clear();
+
+    ::close(listenFd_);
+    ::close(wakeupPipe_[0]);
+    ::close(wakeupPipe_[1]);
+    listenFd_ = -1;
+    wakeupPipe_[0] = wakeupPipe_[1] = -1;
+
+    std::cout << "Server stopped" << std::endl;
+}
+
+bool ReplicationServer::isRunning() const {
+    return running_.load();
+}
+
+uint16_t ReplicationServer::getPort() const {
+    return boundPort_;
+}
+
+void ReplicationServer::eventLoop() {
+    std::vector<pollfd> pollFds;
+
+    while (running_) {
+        pollFds.clear();
+        pollFds.push_back({wakeupPipe_[0], POLLIN, 0});
+        pollFds.push_back({listenFd_, POLLIN, 0});
+
+        bool hasPendingInput = false;
+        for (const auto& [fd, connection] : connections_) {
+            short events = 0;
+            // Apply backpressure to clients that do not read their replies
+            if (!connection.closing && connection.output.size() < config_.maxOutputBuffer) {
+                events |= POLLIN;
+            }
+            if (connection.outputOffset < connection.output.size()) {
+                events |= POLLOUT;
+            }
+            hasPendingInput = hasPendingInput || connection.pendingInput;
+            pollFds.push_back({fd, events, 0});
+        }
+
+        int ready = ::poll(pollFds.data(), pollFds.size(), hasPendingInput ? 0 : -1);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Server poll failed: " << std::strerror(errno) << std::endl;
+            // Let isRunning() report the failure; stop() still releases the sockets
+            running_ = false;
+            break;
+        }
+
+        if (pollFds[0].revents & POLLIN) {
+            char buffer[64];
+            while (::read(wakeupPipe_[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        if (!running_) {
+            break;
+        }
+        if (pollFds[1].revents & POLLIN) {
+            acceptConnections();
+        }
+
+        for (size_t i = 2; i < pollFds.size(); i++) {
+            auto it = connections_.find(pollFds[i].fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            short revents = pollFds[i].revents;
+            bool keep = true;
+
+            if (revents & (POLLERR | POLLNVAL)) {
+                keep = false;
+            } else {
+                if (revents & (POLLIN | POLLHUP)) {
+                    keep = readFromConnection(connection);
+                }
+                if (keep && (connection.pendingInput || (revents & (POLLIN | POLLHUP)))) {
+                    keep = processInput(connection);
+                }
+                if (keep && connection.outputOffset < connection.output.size()) {
+                    keep = flushOutput(connection);
+                }
+                if (keep && connection.closing && connection.outputOffset >= connection.output.size()) {
+                    keep = false;
+                }
+            }
+
+            if (!keep) {
+                closeConnection(pollFds[i].fd);
+            }
+        }
+    }
+}
+
+void ReplicationServer::acceptConnections() {
+    while (true) {
+        int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Server accept failed: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+        if (!setNonBlocking(fd)) {
+            ::close(fd);
+            continue;
+        }
+        int noDelay = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        Connection connection;
+        connection.fd = fd;
+        connections_.emplace(fd, std::move(connection));
+    }
+}
+
+bool ReplicationServer::readFromConnection(Connection& connection) {
+    char buffer[kReadChunkSize];
+    while (true) {
+        ssize_t bytesRead = ::read(connection.fd, buffer, sizeof(buffer));
+        if (bytesRead > 0) {
+            connection.input.append(buffer, static_cast<size_t>(bytesRead));
+            if (static_cast<size_t>(bytesRead) < sizeof(buffer)) {
+                return true;
+            }
+        } else if (bytesRead == 0) {
+            // Peer closed; still answer whatever it already sent
+            connection.closing = true;
+            return true;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return true;
+        } else if (errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+bool ReplicationServer::processInput(Connection& connection) {
+    std::vector<std::string> args;
+    size_t executed = 0;
+    connection.pendingInput = false;
+
+    while (connection.inputOffset < connection.input.size()) {
+        if (executed == config_.maxBatchSize) {
+            connection.pendingInput = true;
+            break;
+        }
+
+        size_t consumed = 0;
+        auto status = RespParser::parseCommand(connection.input.data() + connection.inputOffset,
+                                               connection.input.size() - connection.inputOffset,
+                                               args, consumed);
+        if (status == RespParser::Status::INCOMPLETE) {
+            break;
+        }
+        if (status == RespParser::Status::ERROR) {
+            RespWriter::appendError(connection.output, "ERR Protocol error");
+            connection.closing = true;
+            connection.input.clear();
+            connection.inputOffset = 0;
+            return true;
+        }
+
+        connection.inputOffset += consumed;
+        executed++;
+        if (args.empty()) {
+            continue;  // Blank inline line
+        }
+
+        bool close = false;
+        executeCommand(args, connection.output, close);
+        if (close) {
+            connection.closing = true;
+            break;
+        }
+    }
+
+    // Drop the consumed prefix so the buffer does not grow without bound
+    if (connection.inputOffset > 0) {
+        connection.input.erase(0, connection.inputOffset);
+        connection.inputOffset = 0;
+    }
+    return true;
+}
+
+bool ReplicationServer::flushOutput(Connection& connection) {
+    while (connection.outputOffset < connection.output.size()) {
+        ssize_t written = ::send(connection.fd,
+                                 connection.output.data() + connection.outputOffset,
+                                 connection.output.size() - connection.outputOffset,
+                                 MSG_NOSIGNAL);
+        if (written > 0) {
+            connection.outputOffset += static_cast<size_t>(written);
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+
+    connection.output.clear();
+    connection.outputOffset = 0;
+    return true;
+}
+
+void ReplicationServer::closeConnection(int fd) {
+    ::close(fd);
+    connections_.erase(fd);
+}
+
+void ReplicationServer::executeCommand(const std::vector<std::string>& args,
+                                       std::string& out, bool& close) {
+    std::string command = toUpper(args[0]);
+
+    if (command == "GET") {
+        if (args.size() != 2) {
+            appendWrongArity(out, "get");
+            return;
+        }
+        // A key holding the empty string is not a missing key
+        std::string value;
+        long version = 0;
+        if (system_.readVersioned(args[1], value, version)) {
+            RespWriter::appendBulkString(out, value);
+        } else {
+            RespWriter::appendNullBulkString(out);
+        }
+    } else if (command == "SET") {
+        if (args.size() != 3 && args.size() != 5) {
+            appendWrongArity(out, "set");
+            return;
+        }
+        bool written = false;
+        if (args.size() == 5) {
+            // SET key value EX seconds | PX milliseconds
+            std::string unit = toUpper(args[3]);
+            long long amount = 0;
+            if (unit != "EX" && unit != "PX") {
+                RespWriter::appendError(out, "ERR syntax error");
+                return;
+            }
+            // Seconds are scaled to milliseconds, and the deadline is the write's timestamp plus the TTL
+            if (!parseInteger(args[4], amount) ||
+                (unit == "EX" && amount > std::numeric_limits<long long>::max() / 1000)) {
+                RespWriter::appendError(out, "ERR value is not an integer or out of range");
+                return;
+            }
+            long long milliseconds = unit == "EX" ? amount * 1000 : amount;
+            if (amount <= 0 ||
+                milliseconds > std::numeric_limits<long long>::max() - model::LogEntry::currentTimeMillis()) {
+                RespWriter::appendError(out, "ERR invalid expire time in 'set' command");
+                return;
+            }
+            std::chrono::milliseconds ttl(milliseconds);
+            written = system_.write(args[1], args[2], ttl);
+        } else {
+            written = system_.write(args[1], args[2]);
+        }
+        if (written) {
+            RespWriter::appendSimpleString(out, "OK");
+        } else {
+            RespWriter::appendError(out, "ERR write rejected (master down)");
+        }
+    } else if (command == "INCR" || command == "DECR" || command == "INCRBY" || command == "DECRBY") {
+        bool by = command.size() == 6;
+        if (args.size() != (by ? 3u : 2u)) {
+            appendWrongArity(out, toLower(command));
+            return;
+        }
+        long long delta = 1;
+        // The negation of the smallest integer does not fit
+        if (by && (!parseInteger(args[2], delta) ||
+                   (command[0] == 'D' && delta == std::numeric_limits<long long>::min()))) {
+            RespWriter::appendError(out, "ERR value is not an integer or out of range");
+            return;
+        }
+        if (command[0] == 'D') {
+            delta = -delta;
+        }
+        long long result = 0;
+        if (system_.increment(args[1], delta, result)) {
+            RespWriter::appendInteger(out, result);
+        } else {
+            RespWriter::appendError(out, "ERR value is not an integer or out of range");
+        }
+    } else if (command == "APPEND") {
+        if (args.size() != 3) {
+            appendWrongArity(out, "append");
+            return;
+        }
+        size_t length = 0;
+        if (system_.append(args[1], args[2], length)) {
+            RespWriter::appendInteger(out, static_cast<long long>(length));
+        } else {
+            RespWriter::appendError(out, "ERR write rejected (master down)");
+        }
+    } else if (command == "DEL") {
+        if (args.size() < 2) {
+            appendWrongArity(out, "del");
+            return;
+        }
+        long long deleted = 0;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (system_.deleteKey(args[i])) {
+                deleted++;
+            }
+        }
+        RespWriter::appendInteger(out, deleted);
+    } else if (command == "MGET") {
+        if (args.size() < 2) {
+            appendWrongArity(out, "mget");
+            return;
+        }
+        std::vector<std::string> keys(args.begin() + 1, args.end());
+        std::vector<bool> found;
+        std::vector<std::string> values = system_.multiGet(keys, found);
+        RespWriter::appendArrayHeader(out, values.size());
+        for (size_t i = 0; i < values.size(); i++) {
+            if (found[i]) {
+                RespWriter::appendBulkString(out, values[i]);
+            } else {
+                RespWriter::appendNullBulkString(out);
+            }
+        }
+    } else if (command == "PING") {
+        if (args.size() > 1) {
+            RespWriter::appendBulkString(out, args[1]);
+        } else {
+            RespWriter::appendSimpleString(out, "PONG");
+        }
+    } else if (command == "ECHO") {
+        if (args.size() != 2) {
+            appendWrongArity(out, "echo");
+            return;
+        }
+        RespWriter::appendBulkString(out, args[1]);
+    } else if (command == "QUIT") {
+        RespWriter::appendSimpleString(out, "OK");
+        close = true;
+    } else if (command == "SELECT") {
+        RespWriter::appendSimpleString(out, "OK");
+    } else if (command == "CONFIG" || command == "COMMAND") {
+        // Handshake probes from redis-cli/redis-benchmark; nothing to report
+        RespWriter::appendArrayHeader(out, 0);
+    } else {
+        RespWriter::appendError(out, "ERR unknown command '" + args[0] + "'");
+    }
+}
+
+} // namespace server
+} // namespace replication
@@ -0,0 +1,113 @@
+#ifndef REPLICATION_SERVER_H
+#define REPLICATION_SERVER_H
+
+#include "system/ReplicationSystem.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+namespace replication {
+namespace server {
+
+/**
+ * Configuration for the client-facing replication server.
+ */
+struct ServerConfig {
+    std::string bindAddress = "127.0.0.1";
+    uint16_t port = 6380;              // 0 picks an ephemeral port
+    int backlog = 128;
+    size_t maxBatchSize = 1024;        // Commands executed per connection per loop iteration
+    size_t maxOutputBuffer = 64 * 1024 * 1024;  // Stop reading from a client past this
+};
+
+/**
+ * Network front end for a ReplicationSystem speaking a RESP2 subset
+ * (PING, ECHO, GET, SET with optional EX/PX, INCR, INCRBY, DECR, DECRBY,
+ * APPEND, DEL, MGET plus the handshake commands sent by redis-cli and
+ * redis-benchmark).
+ *
+ * A single event-loop thread multiplexes all connections with non-blocking
+ * sockets and poll(). Every complete command currently buffered on a
+ * connection is executed as one batch and the replies are flushed with a
+ * single write, so pipelined clients pay one system call per batch instead
+ * of one per command. Writes are routed to the master and reads follow the
+ * system's read routing.
+ */
+class ReplicationServer {
+public:
+    /**
+     * Creates a server for the given system. The server does not own the system.
+     * @param system the replication system to serve
+     * @param config the server configuration
+     */
+    ReplicationServer(system::ReplicationSystem& system, const ServerConfig& config);
+
+    /**
+     * Destructor that stops the event loop.
+     */
+    ~ReplicationServer();
+
+    ReplicationServer(const ReplicationServer&) = delete;
+    ReplicationServer& operator=(const ReplicationServer&) = delete;
+
+    /**
+     * Binds the listening socket and starts the event loop thread.
+     * @return true if the server is listening
+     */
+    bool start();
+
+    /**
+     * Stops the event loop and closes all client connections.
+     */
+    void stop();
+
+    /**
+     * Checks whether the event loop is running.
+     */
+    bool isRunning() const;
+
+    /**
+     * Gets the port the server is listening on (resolved when configured as 0).
+     */
+    uint16_t getPort() const;
+
+private:
+    /**
+     * Per-client state owned by the event loop thread.
+     */
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        size_t inputOffset = 0;
+        std::string output;
+        size_t outputOffset = 0;
+        bool pendingInput = false;  // Complete commands left after hitting the batch limit
+        bool closing = false;       // Close once the output has been flushed
+    };
+
+    void eventLoop();
+    void acceptConnections();
+    bool readFromConnection(Connection& connection);
+    bool processInput(Connection& connection);
+    bool flushOutput(Connection& connection);
+    void closeConnection(int fd);
+    void executeCommand(const std::vector<std::string>& args, std::string& out, bool& close);
+
+    system::ReplicationSystem& system_;
+    ServerConfig config_;
+    int listenFd_;
+    int wakeupPipe_[2];
+    uint16_t boundPort_;
+    std::atomic<bool> running_;
+    std::thread loopThread_;
+    std::unordered_map<int, Connection> connections_;
+};
+
+} // namespace server
+} // namespace replication
+
+#endif // REPLICATION_SERVER_H
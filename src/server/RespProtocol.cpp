@@ -0,0 +1,267 @@
+#include "server/RespProtocol.h"
+#include <cstring>
+
+namespace replication {
+namespace server {
+
+namespace {
+
+// Upper bounds that protect the server from hostile or corrupted input
+constexpr long long kMaxBulkLength = 512LL * 1024 * 1024;
+constexpr long long kMaxArrayLength = 1024 * 1024;
+// Bulk strings of one command together, so a command buffers at most this much
+constexpr long long kMaxCommandLength = kMaxBulkLength;
+// Inline commands, and header lines of arrays and bulk strings
+constexpr size_t kMaxInlineLength = 64 * 1024;
+
+/**
+ * Finds the CRLF terminating the line that starts at pos.
+ * @return the offset of '\r', or npos if the line is not complete yet
+ */
+size_t findLineEnd(const char* data, size_t length, size_t pos) {
+    for (size_t i = pos; i + 1 < length; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n') {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+/**
+ * Parses the signed decimal integer in data[begin, end).
+ */
+bool parseInteger(const char* data, size_t begin, size_t end, long long& value) {
+    if (begin >= end) {
+        return false;
+    }
+    bool negative = false;
+    if (data[begin] == '-') {
+        negative = true;
+        begin++;
+        if (begin >= end) {
+            return false;
+        }
+    }
+    value = 0;
+    for (size_t i = begin; i < end; i++) {
+        if (data[i] < '0' || data[i] > '9' || value > kMaxBulkLength) {
+            return false;
+        }
+        value = value * 10 + (data[i] - '0');
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+/**
+ * Reads a "<prefix><integer>\r\n" header starting at pos.
+ */
+RespParser::Status readHeader(const char* data, size_t length, size_t& pos,
+                              char prefix, long long& value) {
+    if (pos >= length) {
+        return RespParser::Status::INCOMPLETE;
+    }
+    if (data[pos] != prefix) {
+        return RespParser::Status::ERROR;
+    }
+    size_t lineEnd = findLineEnd(data, length, pos + 1);
+    if (lineEnd == std::string::npos) {
+        return length - pos > kMaxInlineLength ? RespParser::Status::ERROR
+                                               : RespParser::Status::INCOMPLETE;
+    }
+    if (!parseInteger(data, pos + 1, lineEnd, value)) {
+        return RespParser::Status::ERROR;
+    }
+    pos = lineEnd + 2;
+    return RespParser::Status::COMPLETE;
+}
+
+RespParser::Status parseInline(const char* data, size_t length,
+                               std::vector<std::string>& args, size_t& consumed) {
+    const char* newline = static_cast<const char*>(std::memchr(data, '\n', length));
+    if (newline == nullptr) {
+        return length > kMaxInlineLength ? RespParser::Status::ERROR
+                                         : RespParser::Status::INCOMPLETE;
+    }
+
+    size_t lineLength = static_cast<size_t>(newline - data);
+    size_t end = lineLength;
+    if (end > 0 && data[end - 1] == '\r') {
+        end--;
+    }
+
+    args.clear();
+    size_t i = 0;
+    while (i < end) {
+        while (i < end && (data[i] == ' ' || data[i] == '\t')) {
+            i++;
+        }
+        size_t start = i;
+        while (i < end && data[i] != ' ' && data[i] != '\t') {
+            i++;
+        }
+        if (i > start) {
+            args.emplace_back(data + start, i - start);
+        }
+    }
+
+    consumed = lineLength + 1;
+    return RespParser::Status::COMPLETE;
+}
+
+RespParser::Status skipReplyAt(const char* data, size_t length, size_t& pos, bool& isError) {
+    if (pos >= length) {
+        return RespParser::Status::INCOMPLETE;
+    }
+
+    char type = data[pos];
+    switch (type) {
+        case '+':
+        case '-':
+        case ':': {
+            size_t lineEnd = findLineEnd(data, length, pos + 1);
+            if (lineEnd == std::string::npos) {
+                return RespParser::Status::INCOMPLETE;
+            }
+            isError = isError || type == '-';
+            pos = lineEnd + 2;
+            return RespParser::Status::COMPLETE;
+        }
+        case '$': {
+            long long bulkLength = 0;
+            auto status = readHeader(data, length, pos, '$', bulkLength);
+            if (status != RespParser::Status::COMPLETE || bulkLength < 0) {
+                return status;
+            }
+            if (length - pos < static_cast<size_t>(bulkLength) + 2) {
+                return RespParser::Status::INCOMPLETE;
+            }
+            pos += static_cast<size_t>(bulkLength) + 2;
+            return RespParser::Status::COMPLETE;
+        }
+        case '*': {
+            long long count = 0;
+            auto status = readHeader(data, length, pos, '*', count);
+            if (status != RespParser::Status::COMPLETE) {
+                return status;
+            }
+            for (long long i = 0; i < count; i++) {
+                status = skipReplyAt(data, length, pos, isError);
+                if (status != RespParser::Status::COMPLETE) {
+                    return status;
+                }
+            }
+            return RespParser::Status::COMPLETE;
+        }
+        default:
+            return RespParser::Status::ERROR;
+    }
+}
+
+} // namespace
+
+RespParser::Status RespParser::parseCommand(const char* data, size_t length,
+                                            std::vector<std::string>& args, size_t& consumed) {
+    if (length == 0) {
+        return Status::INCOMPLETE;
+    }
+    if (data[0] != '*') {
+        return parseInline(data, length, args, consumed);
+    }
+
+    size_t pos = 0;
+    long long count = 0;
+    Status status = readHeader(data, length, pos, '*', count);
+    if (status != Status::COMPLETE) {
+        return status;
+    }
+    if (count < 0 || count > kMaxArrayLength) {
+        return Status::ERROR;
+    }
+
+    args.clear();
+    args.reserve(static_cast<size_t>(count));
+    long long commandLength = 0;
+    for (long long i = 0; i < count; i++) {
+        long long bulkLength = 0;
+        status = readHeader(data, length, pos, '$', bulkLength);
+        if (status != Status::COMPLETE) {
+            return status;
+        }
+        commandLength += bulkLength;
+        if (bulkLength < 0 || bulkLength > kMaxBulkLength || commandLength > kMaxCommandLength) {
+            return Status::ERROR;
+        }
+        size_t size = static_cast<size_t>(bulkLength);
+        if (length - pos < size + 2) {
+            return Status::INCOMPLETE;
+        }
+        if (data[pos + size] != '\r' || data[pos + size + 1] != '\n') {
+            return Status::ERROR;
+        }
+        args.emplace_back(data + pos, size);
+        pos += size + 2;
+    }
+
+    consumed = pos;
+    return Status::COMPLETE;
+}
+
+RespParser::Status RespParser::skipReply(const char* data, size_t length,
+                                         size_t& consumed, bool& isError) {
+    size_t pos = 0;
+    isError = false;
+    Status status = skipReplyAt(data, length, pos, isError);
+    if (status == Status::COMPLETE) {
+        consumed = pos;
+    }
+    return status;
+}
+
+void RespWriter::appendSimpleString(std::string& out, const std::string& value) {
+    out += '+';
+    out += value;
+    out += "\r\n";
+}
+
+void RespWriter::appendError(std::string& out, const std::string& message) {
+    out += '-';
+    out += message;
+    out += "\r\n";
+}
+
+void RespWriter::appendInteger(std::string& out, long long value) {
+    out += ':';
+    out += std::to_string(value);
+    out += "\r\n";
+}
+
+void RespWriter::appendBulkString(std::string& out, const std::string& value) {
+    out += '$';
+    out += std::to_string(value.size());
+    out += "\r\n";
+    out += value;
+    out += "\r\n";
+}
+
+void RespWriter::appendNullBulkString(std::string& out) {
+    out += "$-1\r\n";
+}
+
+void RespWriter::appendArrayHeader(std::string& out, size_t count) {
+    out += '*';
+    out += std::to_string(count);
+    out += "\r\n";
+}
+
+void RespWriter::appendCommand(std::string& out, const std::vector<std::string>& args) {
+    appendArrayHeader(out, args.size());
+    for (const auto& arg : args) {
+        appendBulkString(out, arg);
+    }
+}
+
+} // namespace server
+} // namespace replication
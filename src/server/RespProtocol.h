@@ -0,0 +1,78 @@
+#ifndef RESP_PROTOCOL_H
+#define RESP_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace replication {
+namespace server {
+
+/**
+ * Incremental parser and encoder for the subset of the Redis serialization
+ * protocol (RESP2) spoken by the replication server.
+ *
+ * Requests are either RESP arrays of bulk strings or inline commands
+ * (space separated, terminated by CRLF). The parser never blocks and never
+ * copies more than a single command, so a connection can feed it whatever
+ * bytes are currently buffered and execute every complete command in one
+ * pipelined batch.
+ */
+class RespParser {
+public:
+    /**
+     * Outcome of a single parse attempt.
+     */
+    enum class Status {
+        COMPLETE,    // A full command was parsed
+        INCOMPLETE,  // More bytes are needed
+        ERROR        // The input is not valid RESP
+    };
+
+    /**
+     * Parses one command from the front of the buffer.
+     * @param data the buffered bytes
+     * @param length the number of buffered bytes
+     * @param args receives the command name and its arguments
+     * @param consumed receives the number of bytes used by the command
+     * @return the parse status
+     */
+    static Status parseCommand(const char* data, size_t length,
+                               std::vector<std::string>& args, size_t& consumed);
+
+    /**
+     * Skips one reply (of any RESP2 type) from the front of the buffer.
+     * Used by clients that only need to count replies.
+     * @param data the buffered bytes
+     * @param length the number of buffered bytes
+     * @param consumed receives the number of bytes used by the reply
+     * @param isError set to true if the reply is an error reply
+     * @return the parse status
+     */
+    static Status skipReply(const char* data, size_t length, size_t& consumed, bool& isError);
+};
+
+/**
+ * Appends RESP2 encoded values to an output buffer.
+ */
+class RespWriter {
+public:
+    static void appendSimpleString(std::string& out, const std::string& value);
+    static void appendError(std::string& out, const std::string& message);
+    static void appendInteger(std::string& out, long long value);
+    static void appendBulkString(std::string& out, const std::string& value);
+    static void appendNullBulkString(std::string& out);
+    static void appendArrayHeader(std::string& out, size_t count);
+
+    /**
+     * Encodes a command as a RESP array of bulk strings.
+     * @param out the output buffer
+     * @param args the command name followed by its arguments
+     */
+    static void appendCommand(std::string& out, const std::vector<std::string>& args);
+};
+
+} // namespace server
+} // namespace replication
+
+#endif // RESP_PROTOCOL_H
@@ -0,0 +1,96 @@
+#include "sim/ConsistencyChecker.h"
+
+#include <map>
+#include <sstream>
+
+namespace replication {
+namespace sim {
+
+namespace {
+
+bool sameEntry(const model::LogEntry& a, const model::LogEntry& b) {
+    return a.getId() == b.getId() && a.getTerm() == b.getTerm() &&
+           a.getOperationType() == b.getOperationType() &&
+           a.getKey() == b.getKey() && a.getValue() == b.getValue();
+}
+
+// Describes the first key on which two stores disagree
+std::string firstDifference(const std::map<std::string, std::string>& expected,
+                            const std::map<std::string, std::string>& actual) {
+    for (const auto& [key, value] : expected) {
+        auto it = actual.find(key);
+        if (it == actual.end()) {
+            return "missing key '" + key + "'";
+        }
+        if (it->second != value) {
+            return "key '" + key + "' is '" + it->second + "', expected '" + value + "'";
+        }
+    }
+    for (const auto& [key, value] : actual) {
+        if (expected.count(key) == 0) {
+            return "unexpected key '" + key + "'";
+        }
+    }
+    return "";
+}
+
+} // namespace
+
+std::vector<std::string> ConsistencyChecker::check(const node::MasterNode& master,
+                                                   const std::vector<std::shared_ptr<node::SlaveNode>>& slaves) {
+    std::vector<std::string> violations;
+    std::vector<model::LogEntry> masterLog = master.getLogEntriesAfter(0);
+    std::map<std::string, std::string> masterStore = master.getDataStore();
+
+    // The master's store must be exactly what its log describes
+    std::map<std::string, std::string> replayed;
+    for (const auto& entry : masterLog) {
+        if (entry.isDelete()) {
+            replayed.erase(entry.getKey());
+        } else {
+            replayed[entry.getKey()] = entry.getValue();
+        }
+    }
+    std::string difference = firstDifference(replayed, masterStore);
+    if (!difference.empty()) {
+        violations.push_back("master " + master.getId() + " store diverges from its log: " + difference);
+    }
+
+    for (const auto& slave : slaves) {
+        if (!slave->isUp()) {
+            continue;
+        }
+        std::ostringstream prefix;
+        prefix << "slave " << slave->getId() << ": ";
+
+        if (slave->getLastLogIndex() != master.getLastLogIndex()) {
+            std::ostringstream message;
+            message << prefix.str() << "last index " << slave->getLastLogIndex() 
+                    << ", master at " << master.getLastLogIndex();
+            violations.push_back(message.str());
+        }
+
+        std::vector<model::LogEntry> slaveLog = slave->getLogEntriesAfter(0);
+        if (slaveLog.size() != masterLog.size()) {
+            std::ostringstream message;
+            message << prefix.str() << slaveLog.size() << " log entries, master has " << masterLog.size();
+            violations.push_back(message.str());
+        } else {
+            for (size_t i = 0; i < slaveLog.size(); i++) {
+                if (!sameEntry(slaveLog[i], masterLog[i])) {
+                    violations.push_back(prefix.str() + "log differs at " + slaveLog[i].toString());
+                    break;
+                }
+            }
+        }
+
+        difference = firstDifference(masterStore, slave->getDataStore());
+        if (!difference.empty()) {
+            violations.push_back(prefix.str() + difference);
+        }
+    }
+    return violations;
+}
+
+} // namespace sim
+} // namespace replication
@@ -0,0 +1,34 @@
+#ifndef CONSISTENCY_CHECKER_H
+#define CONSISTENCY_CHECKER_H
+
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace replication {
+namespace sim {
+
+/**
+ * Verifies replication invariants once a system has quiesced:
+ * the master's data store equals a replay of its own log, and every slave
+ * that is up holds the same log index, log and data store as the master.
+ */
+class ConsistencyChecker {
+public:
+    /**
+     * Compares every up slave with the master.
+     * @param master the master node
+     * @param slaves the master's slaves
+     * @return one description per violation; empty if consistent
+     */
+    static std::vector<std::string> check(const node::MasterNode& master,
+                                          const std::vector<std::shared_ptr<node::SlaveNode>>& slaves);
+};
+
+} // namespace sim
+} // namespace replication
+
+#endif // CONSISTENCY_CHECKER_H
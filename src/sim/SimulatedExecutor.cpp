@@ -0,0 +1,67 @@
+#include "sim/SimulatedExecutor.h"
+
+namespace replication {
+namespace sim {
+
+SimulatedExecutor::SimulatedExecutor(VirtualClock& clock, uint64_t seed, long maxDelayMicros)
+    : clock_(clock),
+      random_(seed),
+      maxDelayMicros_(maxDelayMicros < 0 ? 0 : maxDelayMicros),
+      nextSequence_(0),
+      tasksRun_(0) {
+}
+
+void SimulatedExecutor::execute(std::function<void()> task) {
+    // Raw engine output is specified by the standard, unlike distributions
+    long delay = static_cast<long>(random_() % static_cast<uint64_t>(maxDelayMicros_ + 1));
+    queue_.push(ScheduledTask{clock_.now() + delay, random_(), nextSequence_++, std::move(task)});
+}
+
+bool SimulatedExecutor::runNext() {
+    if (queue_.empty()) {
+        return false;
+    }
+
+    // Pop before running: the task may schedule more work
+    ScheduledTask next = queue_.top();
+    queue_.pop();
+    clock_.advanceTo(next.dueMicros);
+    tasksRun_++;
+    next.task();
+    return true;
+}
+
+size_t SimulatedExecutor::runUntil(long micros) {
+    size_t run = 0;
+    while (!queue_.empty() && queue_.top().dueMicros <= micros) {
+        runNext();
+        run++;
+    }
+    clock_.advanceTo(micros);
+    return run;
+}
+
+size_t SimulatedExecutor::runUntilQuiescent(size_t maxTasks) {
+    size_t run = 0;
+    while (run < maxTasks && runNext()) {
+        run++;
+    }
+    return run;
+}
+
+void SimulatedExecutor::clear() {
+    while (!queue_.empty()) {
+        queue_.pop();
+    }
+}
+
+size_t SimulatedExecutor::getPendingCount() const {
+    return queue_.size();
+}
+
+size_t SimulatedExecutor::getTasksRun() const {
+    return tasksRun_;
+}
+
+} // namespace sim
+} // namespace replication
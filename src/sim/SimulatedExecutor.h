@@ -0,0 +1,96 @@
+#ifndef SIMULATED_EXECUTOR_H
+#define SIMULATED_EXECUTOR_H
+
+#include "node/Executor.h"
+#include "sim/VirtualClock.h"
+
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+#include <cstdint>
+
+namespace replication {
+namespace sim {
+
+/**
+ * Deterministic executor shared by every node in a simulation.
+ *
+ * Each scheduled task is given a seeded random delay on the virtual clock,
+ * which models message latency and decides the order in which nodes'
+ * asynchronous work interleaves. Tasks only run when the driver calls
+ * runNext(), on the driver's thread, so a seed fully determines a run.
+ * Not thread-safe: all nodes must be driven from a single thread.
+ */
+class SimulatedExecutor : public node::Executor {
+public:
+    /**
+     * @param clock the virtual clock to schedule against
+     * @param seed seeds the delay and tie-break choices
+     * @param maxDelayMicros upper bound of the random delay per task
+     */
+    SimulatedExecutor(VirtualClock& clock, uint64_t seed, long maxDelayMicros);
+
+    void execute(std::function<void()> task) override;
+
+    /**
+     * Runs the earliest due task, advancing the clock to its due time.
+     * @return false if no task is pending
+     */
+    bool runNext();
+
+    /**
+     * Runs every task due at or before the given time, then advances the
+     * clock to it.
+     * @param micros the virtual time to run up to
+     * @return the number of tasks run
+     */
+    size_t runUntil(long micros);
+
+    /**
+     * Runs tasks until none are pending.
+     * @param maxTasks stops after this many tasks, to catch livelocks
+     * @return the number of tasks run
+     */
+    size_t runUntilQuiescent(size_t maxTasks);
+
+    /**
+     * Drops every pending task without running it.
+     */
+    void clear();
+
+    size_t getPendingCount() const;
+    size_t getTasksRun() const;
+
+private:
+    struct ScheduledTask {
+        long dueMicros;
+        uint64_t tieBreak;
+        uint64_t sequence;
+        std::function<void()> task;
+    };
+
+    struct Later {
+        bool operator()(const ScheduledTask& a, const ScheduledTask& b) const {
+            if (a.dueMicros != b.dueMicros) {
+                return a.dueMicros > b.dueMicros;
+            }
+            if (a.tieBreak != b.tieBreak) {
+                return a.tieBreak > b.tieBreak;
+            }
+            return a.sequence > b.sequence;
+        }
+    };
+
+    VirtualClock& clock_;
+    std::mt19937_64 random_;
+    long maxDelayMicros_;
+    uint64_t nextSequence_;
+    size_t tasksRun_;
+    std::priority_queue<ScheduledTask, std::vector<ScheduledTask>, Later> queue_;
+};
+
+} // namespace sim
+} // namespace replication
+
+#endif // SIMULATED_EXECUTOR_H
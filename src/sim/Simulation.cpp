@@ -0,0 +1,192 @@
+#include "sim/Simulation.h"
+#include "sim/ConsistencyChecker.h"
+
+#include <algorithm>
+#include <iostream>
+#include <streambuf>
+
+namespace replication {
+namespace sim {
+
+namespace {
+
+// Discards everything written to it
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+};
+
+// Silences std::cout for its lifetime
+class QuietScope {
+public:
+    explicit QuietScope(bool enabled) : previous_(nullptr) {
+        if (enabled) {
+            previous_ = std::cout.rdbuf(&nullBuffer_);
+        }
+    }
+
+    ~QuietScope() {
+        if (previous_) {
+            std::cout.rdbuf(previous_);
+        }
+    }
+
+private:
+    NullBuffer nullBuffer_;
+    std::streambuf* previous_;
+};
+
+uint64_t fnv1a(uint64_t hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace
+
+Simulation::Simulation(const SimulationConfig& config)
+    : config_(config),
+      executor_(std::make_shared<SimulatedExecutor>(clock_, config.seed, config.maxTaskDelayMicros)),
+      random_(config.seed ^ 0x9e3779b97f4a7c15ULL),
+      nextFault_(0),
+      masterOutageOps_(0) {
+    QuietScope quiet(config_.quiet);
+
+    master_ = std::make_shared<node::MasterNode>("master", executor_);
+    for (int i = 0; i < config_.numSlaves; i++) {
+        auto slave = std::make_shared<node::SlaveNode>("slave-" + std::to_string(i), master_, executor_);
+        master_->registerSlave(slave);
+        slaves_.push_back(slave);
+    }
+
+    // Faults fire in index order
+    std::stable_sort(config_.faults.begin(), config_.faults.end(),
+                     [](const FaultEvent& a, const FaultEvent& b) { return a.atIndex < b.atIndex; });
+}
+
+Simulation::~Simulation() {
+    // Pending tasks refer to the nodes; drop them before the nodes go away
+    executor_->clear();
+}
+
+SimulationResult Simulation::run() {
+    QuietScope quiet(config_.quiet);
+    SimulationResult result;
+
+    injectDueFaults(result);
+    for (int op = 0; op < config_.numOperations; op++) {
+        // Let replication progress for one operation interval of virtual time
+        executor_->runUntil(clock_.now() + config_.operationIntervalMicros);
+
+        std::string key = "key-" + std::to_string(random_() % static_cast<uint64_t>(config_.keySpace));
+        bool isDelete = static_cast<double>(random_() % 10000) / 10000.0 < config_.deleteRatio;
+        bool accepted = isDelete ? master_->deleteKey(key)
+                                 : master_->write(key, "value-" + std::to_string(op));
+        if (accepted) {
+            result.operationsAccepted++;
+        } else {
+            result.operationsRejected++;
+        }
+
+        injectDueFaults(result);
+    }
+
+    // Heal: the master first, so slaves coming up can recover from it
+    if (!master_->isUp()) {
+        master_->goUp();
+    }
+    for (const auto& slave : slaves_) {
+        if (!slave->isUp()) {
+            slave->goUp();
+        }
+    }
+    executor_->runUntilQuiescent(config_.maxQuiesceTasks);
+
+    result.violations = ConsistencyChecker::check(*master_, slaves_);
+    if (executor_->getPendingCount() > 0) {
+        result.violations.push_back("did not quiesce within " + std::to_string(config_.maxQuiesceTasks) + " tasks");
+    }
+    result.consistent = result.violations.empty();
+    result.tasksRun = executor_->getTasksRun();
+    result.virtualTimeMicros = clock_.now();
+    result.finalLogIndex = master_->getLastLogIndex();
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& entry : master_->getLogEntriesAfter(0)) {
+        hash = fnv1a(hash, std::to_string(entry.getId()) + (entry.isDelete() ? "D" : "W") + 
+                           entry.getKey() + "=" + entry.getValue() + ";");
+    }
+    hash = fnv1a(hash, std::to_string(result.tasksRun) + "/" + std::to_string(result.virtualTimeMicros));
+    result.fingerprint = hash;
+    return result;
+}
+
+void Simulation::injectDueFaults(SimulationResult& result) {
+    if (!master_->isUp() && ++masterOutageOps_ >= config_.maxMasterOutageOps) {
+        master_->goUp();
+        result.faultsInjected++;
+    }
+    if (master_->isUp()) {
+        masterOutageOps_ = 0;
+    }
+
+    while (nextFault_ < config_.faults.size() && 
+           config_.faults[nextFault_].atIndex <= master_->getLastLogIndex()) {
+        const FaultEvent& fault = config_.faults[nextFault_++];
+        node::AbstractNode* target = nullptr;
+        if (fault.node < 0) {
+            target = master_.get();
+        } else if (fault.node < static_cast<int>(slaves_.size())) {
+            target = slaves_[fault.node].get();
+        }
+        if (!target) {
+            continue;
+        }
+
+        bool down = fault.action == FaultEvent::Action::NODE_DOWN;
+        if (down && target->isUp()) {
+            target->goDown();
+        } else if (!down && !target->isUp()) {
+            target->goUp();
+        }
+        result.faultsInjected++;
+    }
+}
+
+std::vector<FaultEvent> Simulation::randomFaults(uint64_t seed, int numSlaves, long maxIndex, 
+                                                 int count, bool includeMaster) {
+    std::mt19937_64 random(seed);
+    std::vector<FaultEvent> faults;
+    int choices = numSlaves + (includeMaster ? 1 : 0);
+    if (choices == 0 || maxIndex <= 0) {
+        return faults;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int node = static_cast<int>(random() % static_cast<uint64_t>(choices)) - (includeMaster ? 1 : 0);
+        long downAt = static_cast<long>(random() % static_cast<uint64_t>(maxIndex));
+        long upAt = downAt + 1 + static_cast<long>(random() % 20);
+        faults.push_back(FaultEvent{downAt, node, FaultEvent::Action::NODE_DOWN});
+        faults.push_back(FaultEvent{upAt, node, FaultEvent::Action::NODE_UP});
+    }
+    return faults;
+}
+
+std::shared_ptr<node::MasterNode> Simulation::getMaster() const {
+    return master_;
+}
+
+const std::vector<std::shared_ptr<node::SlaveNode>>& Simulation::getSlaves() const {
+    return slaves_;
+}
+
+SimulatedExecutor& Simulation::getExecutor() {
+    return *executor_;
+}
+
+} // namespace sim
+} // namespace replication
@@ -0,0 +1,132 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "sim/VirtualClock.h"
+#include "sim/SimulatedExecutor.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+namespace replication {
+namespace sim {
+
+/**
+ * A failure injected when the master's log reaches a given index.
+ */
+struct FaultEvent {
+    enum class Action {
+        NODE_DOWN,
+        NODE_UP
+    };
+
+    // Fires once the master's last log index is at least this value.
+    // The index cannot advance while the master is down, so master outages
+    // also end after SimulationConfig::maxMasterOutageOps operations.
+    long atIndex;
+    // -1 for the master, otherwise the slave number
+    int node;
+    Action action;
+};
+
+/**
+ * Parameters of one simulated run.
+ */
+struct SimulationConfig {
+    uint64_t seed = 1;
+    int numSlaves = 3;
+    int numOperations = 200;
+    int keySpace = 16;
+    double deleteRatio = 0.2;
+    // Random delivery delay per asynchronous task, in virtual microseconds
+    long maxTaskDelayMicros = 2000;
+    // Virtual time between client operations
+    long operationIntervalMicros = 500;
+    // Client operations rejected by a down master before it is brought back up
+    int maxMasterOutageOps = 10;
+    // Upper bound on tasks run while settling, to catch livelocks
+    size_t maxQuiesceTasks = 1000000;
+    std::vector<FaultEvent> faults;
+    // Suppress node logging while the simulation runs
+    bool quiet = true;
+};
+
+/**
+ * Outcome of one simulated run.
+ */
+struct SimulationResult {
+    bool consistent = false;
+    std::vector<std::string> violations;
+    long operationsAccepted = 0;
+    long operationsRejected = 0;
+    size_t faultsInjected = 0;
+    size_t tasksRun = 0;
+    long virtualTimeMicros = 0;
+    long finalLogIndex = 0;
+    // Hash of the master's final log and the schedule; equal for equal seeds
+    uint64_t fingerprint = 0;
+};
+
+/**
+ * Deterministic simulation of one master and its slaves.
+ *
+ * Every node runs its asynchronous work on a shared SimulatedExecutor, so
+ * replication, recovery and client operations interleave in an order fixed
+ * by the seed, on a virtual clock rather than wall-clock threads. A seeded
+ * workload of writes and deletes is issued while faults fire at exact log
+ * indices; afterwards every node is brought back up, the system is run to
+ * quiescence and checked with the ConsistencyChecker.
+ */
+class Simulation {
+public:
+    explicit Simulation(const SimulationConfig& config);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    /**
+     * Runs the workload, heals every node and checks consistency.
+     * Call at most once per Simulation.
+     */
+    SimulationResult run();
+
+    /**
+     * Generates a seeded fault plan: nodes going down at random log indices
+     * and coming back up a little later.
+     * @param seed seeds the plan
+     * @param numSlaves the number of slaves that may fail
+     * @param maxIndex faults fire at indices below this
+     * @param count the number of outages
+     * @param includeMaster whether the master may fail too
+     */
+    static std::vector<FaultEvent> randomFaults(uint64_t seed, int numSlaves, long maxIndex, 
+                                                int count, bool includeMaster);
+
+    std::shared_ptr<node::MasterNode> getMaster() const;
+    const std::vector<std::shared_ptr<node::SlaveNode>>& getSlaves() const;
+    SimulatedExecutor& getExecutor();
+
+private:
+    /**
+     * Fires every fault whose index the master's log has reached.
+     */
+    void injectDueFaults(SimulationResult& result);
+
+    SimulationConfig config_;
+    VirtualClock clock_;
+    std::shared_ptr<SimulatedExecutor> executor_;
+    std::shared_ptr<node::MasterNode> master_;
+    std::vector<std::shared_ptr<node::SlaveNode>> slaves_;
+    std::mt19937_64 random_;
+    size_t nextFault_;
+    int masterOutageOps_;
+};
+
+} // namespace sim
+} // namespace replication
+
+#endif // SIMULATION_H
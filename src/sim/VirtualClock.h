@@ -0,0 +1,35 @@
+#ifndef VIRTUAL_CLOCK_H
+#define VIRTUAL_CLOCK_H
+
+namespace replication {
+namespace sim {
+
+/**
+ * Simulated time in microseconds. It only moves when the scheduler runs a
+ * task due later than the current time, so a simulation never waits on the
+ * wall clock and replays identically for the same seed.
+ */
+class VirtualClock {
+public:
+    long now() const {
+        return nowMicros_;
+    }
+
+    /**
+     * Moves time forward; earlier times are ignored.
+     * @param micros the new time in microseconds
+     */
+    void advanceTo(long micros) {
+        if (micros > nowMicros_) {
+            nowMicros_ = micros;
+        }
+    }
+
+private:
+    long nowMicros_ = 0;
+};
+
+} // namespace sim
+} // namespace replication
+
+#endif // VIRTUAL_CLOCK_H
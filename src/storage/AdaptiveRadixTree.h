@@ -0,0 +1,862 @@
+#ifndef ADAPTIVE_RADIX_TREE_H
+#define ADAPTIVE_RADIX_TREE_H
+
+#include "storage/MemoryAccounting.h"
+
+#include <string>
+#include <functional>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace replication {
+namespace storage {
+
+/**
+ * Ordered map from byte-string keys to values, laid out as an adaptive
+ * radix tree (Leis et al., ICDE 2013).
+ *
+ * Each inner node branches on one key byte and grows through four layouts
+ * as children are added: 4 and 16 sorted key bytes (Node16 is searched
+ * with one SSE2 compare where available), a 256-entry index into 48
+ * children, and a direct array of 256 children; it shrinks back as they
+ * are removed. Paths are compressed: a node stores the bytes every key
+ * below it shares, and a leaf the rest of its key, so a key is spread over
+ * the path to its leaf and shared prefixes are stored once. Short
+ * prefixes are held inline in the node header.
+ *
+ * A key that ends where others continue is the terminal leaf of the inner
+ * node its path ends at. Keys compare as unsigned bytes, the order of
+ * std::map<std::string, V>. Values are constructed in place and never
+ * move. Not thread-safe.
+ */
+template <typename V>
+class AdaptiveRadixTree {
+public:
+    /**
+     * Receives a key and its value; returns false to stop.
+     */
+    using Visitor = std::function<bool(const std::string&, V&)>;
+
+    AdaptiveRadixTree() = default;
+    ~AdaptiveRadixTree();
+
+    AdaptiveRadixTree(const AdaptiveRadixTree&) = delete;
+    AdaptiveRadixTree& operator=(const AdaptiveRadixTree&) = delete;
+
+    /**
+     * Looks up a key.
+     * @return the value, or null if the key is absent
+     */
+    V* find(const std::string& key) const;
+
+    /**
+     * Inserts a default-constructed value for a key if it is absent.
+     * @return the key's value, and true if it was inserted
+     */
+    std::pair<V*, bool> insert(const std::string& key);
+
+    /**
+     * Removes a key.
+     * @return true if the key was present
+     */
+    bool erase(const std::string& key);
+
+    /**
+     * Visits the keys greater than a bound in ascending order.
+     * @param after the bound, or null to visit every key
+     * @return false if visit stopped early
+     */
+    bool forEachAfter(const std::string* after, const Visitor& visit) const;
+
+    /**
+     * Visits the keys starting with a prefix in ascending order.
+     * @return false if visit stopped early
+     */
+    bool forEachWithPrefix(const std::string& prefix, const Visitor& visit) const;
+
+    void clear();
+    size_t size() const;
+
+    /**
+     * Gets the bytes of the nodes, leaves and prefix buffers.
+     */
+    size_t getFootprint() const;
+
+    /**
+     * Gets the key bytes held: compressed prefixes plus one byte per branch.
+     */
+    size_t getKeyBytes() const;
+
+private:
+    static constexpr size_t kInlinePrefix = sizeof(char*);
+
+    enum class Kind : uint8_t { LEAF, NODE4, NODE16, NODE48, NODE256 };
+
+    struct Node {
+        explicit Node(Kind kind) : kind(kind), count(0), prefixLength(0) {}
+
+        Kind kind;
+        uint16_t count;          // Children of an inner node
+        uint32_t prefixLength;
+        union {
+            char bytes[kInlinePrefix];
+            char* heap;          // When longer than kInlinePrefix
+        } prefix;
+    };
+
+    struct Leaf : Node {
+        Leaf() : Node(Kind::LEAF) {}
+        V value;
+    };
+
+    struct Inner : Node {
+        explicit Inner(Kind kind) : Node(kind) {}
+        Leaf* terminal = nullptr;  // The key ending at this node, with an empty prefix
+    };
+
+    struct Node4 : Inner {
+        Node4() : Inner(Kind::NODE4) {}
+        uint8_t keys[4] = {};
+        Node* children[4] = {};
+    };
+
+    struct Node16 : Inner {
+        Node16() : Inner(Kind::NODE16) {}
+        uint8_t keys[16] = {};
+        Node* children[16] = {};
+    };
+
+    struct Node48 : Inner {
+        Node48() : Inner(Kind::NODE48) {}
+        uint8_t index[256] = {};  // Child slot plus one; 0 if there is no child
+        Node* children[48] = {};
+    };
+
+    struct Node256 : Inner {
+        Node256() : Inner(Kind::NODE256) {}
+        Node* children[256] = {};
+    };
+
+    static const char* prefixOf(const Node* node);
+    static size_t nodeBytes(Kind kind);
+
+    template <typename T>
+    T* allocate();
+    Leaf* newLeaf(const char* suffix, size_t length);
+    void assignPrefix(Node* node, const char* data, size_t length);
+    void freePrefix(Node* node);
+    void destroy(Node* node);
+    void destroyTree(Node* node);
+
+    static Node** findChild(Inner* node, uint8_t byte);
+
+    /**
+     * Visits the children of a node in byte order until visit returns false.
+     */
+    template <typename F>
+    static bool forEachChild(const Inner* node, F visit);
+
+    /**
+     * Adds a child, growing the node into the next layout if it is full.
+     * @param slot the pointer to the node, updated if it grows
+     */
+    void addChild(Node** slot, Inner* node, uint8_t byte, Node* child);
+
+    /**
+     * Removes a child, shrinking the node into the previous layout below
+     * its lower bound.
+     */
+    void removeChild(Node** slot, Inner* node, uint8_t byte);
+
+    /**
+     * Replaces a node left with a terminal only by that leaf, and one left
+     * with a single child by the child, its prefix extended.
+     */
+    void collapse(Node** slot);
+
+    bool eraseBelow(Node** slot, const std::string& key, size_t depth);
+
+    /**
+     * Visits a subtree in order. path holds the key bytes above the node;
+     * after, if set, is a bound that path is a prefix of.
+     */
+    bool walk(Node* node, std::string& path, const std::string* after, const Visitor& visit) const;
+
+    Node* root_ = nullptr;
+    size_t size_ = 0;
+    size_t footprint_ = 0;
+    size_t keyBytes_ = 0;
+};
+
+// Template implementation must be in the header
+
+template <typename V>
+AdaptiveRadixTree<V>::~AdaptiveRadixTree() {
+    clear();
+}
+
+template <typename V>
+const char* AdaptiveRadixTree<V>::prefixOf(const Node* node) {
+    return node->prefixLength > kInlinePrefix ? node->prefix.heap : node->prefix.bytes;
+}
+
+template <typename V>
+size_t AdaptiveRadixTree<V>::nodeBytes(Kind kind) {
+    switch (kind) {
+    case Kind::LEAF:
+        return allocationSize(sizeof(Leaf));
+    case Kind::NODE4:
+        return allocationSize(sizeof(Node4));
+    case Kind::NODE16:
+        return allocationSize(sizeof(Node16));
+    case Kind::NODE48:
+        return allocationSize(sizeof(Node48));
+    case Kind::NODE256:
+        return allocationSize(sizeof(Node256));
+    }
+    return 0;
+}
+
+template <typename V>
+template <typename T>
+T* AdaptiveRadixTree<V>::allocate() {
+    T* node = new T();
+    footprint_ += nodeBytes(node->kind);
+    return node;
+}
+
+template <typename V>
+typename AdaptiveRadixTree<V>::Leaf* AdaptiveRadixTree<V>::newLeaf(const char* suffix, size_t length) {
+    Leaf* leaf = allocate<Leaf>();
+    assignPrefix(leaf, suffix, length);
+    return leaf;
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::assignPrefix(Node* node, const char* data, size_t length) {
+    // data may point into the node's own prefix, so copy it out before freeing
+    char* heap = nullptr;
+    char bytes[kInlinePrefix];
+    if (length > kInlinePrefix) {
+        heap = new char[length];
+        std::memcpy(heap, data, length);
+    } else if (length > 0) {
+        std::memcpy(bytes, data, length);
+    }
+    freePrefix(node);
+    if (heap != nullptr) {
+        node->prefix.heap = heap;
+        footprint_ += allocationSize(length);
+    } else if (length > 0) {
+        std::memcpy(node->prefix.bytes, bytes, length);
+    }
+    node->prefixLength = static_cast<uint32_t>(length);
+    keyBytes_ += length;
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::freePrefix(Node* node) {
+    if (node->prefixLength > kInlinePrefix) {
+        delete[] node->prefix.heap;
+        footprint_ -= allocationSize(node->prefixLength);
+    }
+    keyBytes_ -= node->prefixLength;
+    node->prefixLength = 0;
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::destroy(Node* node) {
+    freePrefix(node);
+    footprint_ -= nodeBytes(node->kind);
+    switch (node->kind) {
+    case Kind::LEAF:
+        delete static_cast<Leaf*>(node);
+        return;
+    case Kind::NODE4:
+        delete static_cast<Node4*>(node);
+        return;
+    case Kind::NODE16:
+        delete static_cast<Node16*>(node);
+        return;
+    case Kind::NODE48:
+        delete static_cast<Node48*>(node);
+        return;
+    case Kind::NODE256:
+        delete static_cast<Node256*>(node);
+        return;
+    }
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::destroyTree(Node* node) {
+    if (node->kind != Kind::LEAF) {
+        Inner* inner = static_cast<Inner*>(node);
+        if (inner->terminal != nullptr) {
+            destroy(inner->terminal);
+        }
+        forEachChild(inner, [this](uint8_t, Node* child) {
+            destroyTree(child);
+            return true;
+        });
+    }
+    destroy(node);
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::clear() {
+    if (root_ != nullptr) {
+        destroyTree(root_);
+    }
+    root_ = nullptr;
+    size_ = 0;
+    footprint_ = 0;
+    keyBytes_ = 0;
+}
+
+template <typename V>
+size_t AdaptiveRadixTree<V>::size() const {
+    return size_;
+}
+
+template <typename V>
+size_t AdaptiveRadixTree<V>::getFootprint() const {
+    return footprint_;
+}
+
+template <typename V>
+size_t AdaptiveRadixTree<V>::getKeyBytes() const {
+    return keyBytes_;
+}
+
+template <typename V>
+typename AdaptiveRadixTree<V>::Node** AdaptiveRadixTree<V>::findChild(Inner* node, uint8_t byte) {
+    switch (node->kind) {
+    case Kind::NODE4: {
+        Node4* n = static_cast<Node4*>(node);
+        for (size_t i = 0; i < n->count; i++) {
+            if (n->keys[i] == byte) {
+                return &n->children[i];
+            }
+        }
+        return nullptr;
+    }
+    case Kind::NODE16: {
+        Node16* n = static_cast<Node16*>(node);
+#ifdef __SSE2__
+        // Compare all 16 key bytes at once and mask off the unused ones
+        __m128i matches = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(byte)),
+                                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches)) & ((1u << n->count) - 1);
+        return mask != 0 ? &n->children[__builtin_ctz(mask)] : nullptr;
+#else
+        for (size_t i = 0; i < n->count; i++) {
+            if (n->keys[i] == byte) {
+                return &n->children[i];
+            }
+        }
+        return nullptr;
+#endif
+    }
+    case Kind::NODE48: {
+        Node48* n = static_cast<Node48*>(node);
+        return n->index[byte] != 0 ? &n->children[n->index[byte] - 1] : nullptr;
+    }
+    case Kind::NODE256: {
+        Node256* n = static_cast<Node256*>(node);
+        return n->children[byte] != nullptr ? &n->children[byte] : nullptr;
+    }
+    case Kind::LEAF:
+        break;
+    }
+    return nullptr;
+}
+
+template <typename V>
+template <typename F>
+bool AdaptiveRadixTree<V>::forEachChild(const Inner* node, F visit) {
+    switch (node->kind) {
+    case Kind::NODE4: {
+        const Node4* n = static_cast<const Node4*>(node);
+        for (size_t i = 0; i < n->count; i++) {
+            if (!visit(n->keys[i], n->children[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case Kind::NODE16: {
+        const Node16* n = static_cast<const Node16*>(node);
+        for (size_t i = 0; i < n->count; i++) {
+            if (!visit(n->keys[i], n->children[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case Kind::NODE48: {
+        const Node48* n = static_cast<const Node48*>(node);
+        for (size_t byte = 0; byte < 256; byte++) {
+            if (n->index[byte] != 0 && !visit(static_cast<uint8_t>(byte), n->children[n->index[byte] - 1])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case Kind::NODE256: {
+        const Node256* n = static_cast<const Node256*>(node);
+        for (size_t byte = 0; byte < 256; byte++) {
+            if (n->children[byte] != nullptr && !visit(static_cast<uint8_t>(byte), n->children[byte])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    case Kind::LEAF:
+        break;
+    }
+    return true;
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::addChild(Node** slot, Inner* node, uint8_t byte, Node* child) {
+    keyBytes_ += 1;
+    switch (node->kind) {
+    case Kind::NODE4: {
+        Node4* n = static_cast<Node4*>(node);
+        if (n->count < 4) {
+            size_t at = std::lower_bound(n->keys, n->keys + n->count, byte) - n->keys;
+            std::copy_backward(n->keys + at, n->keys + n->count, n->keys + n->count + 1);
+            std::copy_backward(n->children + at, n->children + n->count, n->children + n->count + 1);
+            n->keys[at] = byte;
+            n->children[at] = child;
+            n->count++;
+            return;
+        }
+        Node16* grown = allocate<Node16>();
+        std::copy(n->keys, n->keys + 4, grown->keys);
+        std::copy(n->children, n->children + 4, grown->children);
+        grown->count = 4;
+        grown->terminal = n->terminal;
+        grown->prefix = n->prefix;
+        grown->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = grown;
+        keyBytes_ -= 1;
+        addChild(slot, grown, byte, child);
+        return;
+    }
+    case Kind::NODE16: {
+        Node16* n = static_cast<Node16*>(node);
+        if (n->count < 16) {
+            size_t at = std::lower_bound(n->keys, n->keys + n->count, byte) - n->keys;
+            std::copy_backward(n->keys + at, n->keys + n->count, n->keys + n->count + 1);
+            std::copy_backward(n->children + at, n->children + n->count, n->children + n->count + 1);
+            n->keys[at] = byte;
+            n->children[at] = child;
+            n->count++;
+            return;
+        }
+        Node48* grown = allocate<Node48>();
+        for (size_t i = 0; i < 16; i++) {
+            grown->index[n->keys[i]] = static_cast<uint8_t>(i + 1);
+            grown->children[i] = n->children[i];
+        }
+        grown->count = 16;
+        grown->terminal = n->terminal;
+        grown->prefix = n->prefix;
+        grown->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = grown;
+        keyBytes_ -= 1;
+        addChild(slot, grown, byte, child);
+        return;
+    }
+    case Kind::NODE48: {
+        Node48* n = static_cast<Node48*>(node);
+        if (n->count < 48) {
+            size_t free = 0;
+            while (n->children[free] != nullptr) {
+                free++;
+            }
+            n->children[free] = child;
+            n->index[byte] = static_cast<uint8_t>(free + 1);
+            n->count++;
+            return;
+        }
+        Node256* grown = allocate<Node256>();
+        for (size_t b = 0; b < 256; b++) {
+            if (n->index[b] != 0) {
+                grown->children[b] = n->children[n->index[b] - 1];
+            }
+        }
+        grown->count = 48;
+        grown->terminal = n->terminal;
+        grown->prefix = n->prefix;
+        grown->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = grown;
+        keyBytes_ -= 1;
+        addChild(slot, grown, byte, child);
+        return;
+    }
+    case Kind::NODE256: {
+        Node256* n = static_cast<Node256*>(node);
+        n->children[byte] = child;
+        n->count++;
+        return;
+    }
+    case Kind::LEAF:
+        return;
+    }
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::removeChild(Node** slot, Inner* node, uint8_t byte) {
+    keyBytes_ -= 1;
+    switch (node->kind) {
+    case Kind::NODE4: {
+        Node4* n = static_cast<Node4*>(node);
+        size_t at = std::find(n->keys, n->keys + n->count, byte) - n->keys;
+        std::copy(n->keys + at + 1, n->keys + n->count, n->keys + at);
+        std::copy(n->children + at + 1, n->children + n->count, n->children + at);
+        n->count--;
+        return;
+    }
+    case Kind::NODE16: {
+        Node16* n = static_cast<Node16*>(node);
+        size_t at = std::find(n->keys, n->keys + n->count, byte) - n->keys;
+        std::copy(n->keys + at + 1, n->keys + n->count, n->keys + at);
+        std::copy(n->children + at + 1, n->children + n->count, n->children + at);
+        n->count--;
+        if (n->count > 3) {
+            return;
+        }
+        Node4* shrunk = allocate<Node4>();
+        std::copy(n->keys, n->keys + n->count, shrunk->keys);
+        std::copy(n->children, n->children + n->count, shrunk->children);
+        shrunk->count = n->count;
+        shrunk->terminal = n->terminal;
+        shrunk->prefix = n->prefix;
+        shrunk->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = shrunk;
+        return;
+    }
+    case Kind::NODE48: {
+        Node48* n = static_cast<Node48*>(node);
+        n->children[n->index[byte] - 1] = nullptr;
+        n->index[byte] = 0;
+        n->count--;
+        if (n->count > 12) {
+            return;
+        }
+        Node16* shrunk = allocate<Node16>();
+        forEachChild(n, [shrunk](uint8_t b, Node* child) {
+            shrunk->keys[shrunk->count] = b;
+            shrunk->children[shrunk->count++] = child;
+            return true;
+        });
+        shrunk->terminal = n->terminal;
+        shrunk->prefix = n->prefix;
+        shrunk->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = shrunk;
+        return;
+    }
+    case Kind::NODE256: {
+        Node256* n = static_cast<Node256*>(node);
+        n->children[byte] = nullptr;
+        n->count--;
+        if (n->count > 37) {
+            return;
+        }
+        Node48* shrunk = allocate<Node48>();
+        forEachChild(n, [shrunk](uint8_t b, Node* child) {
+            shrunk->index[b] = static_cast<uint8_t>(shrunk->count + 1);
+            shrunk->children[shrunk->count++] = child;
+            return true;
+        });
+        shrunk->terminal = n->terminal;
+        shrunk->prefix = n->prefix;
+        shrunk->prefixLength = n->prefixLength;
+        footprint_ -= nodeBytes(n->kind);
+        delete n;
+        *slot = shrunk;
+        return;
+    }
+    case Kind::LEAF:
+        return;
+    }
+}
+
+template <typename V>
+void AdaptiveRadixTree<V>::collapse(Node** slot) {
+    Inner* node = static_cast<Inner*>(*slot);
+    if (node->count == 0) {
+        Leaf* terminal = node->terminal;
+        assignPrefix(terminal, prefixOf(node), node->prefixLength);
+        destroy(node);
+        *slot = terminal;
+    } else if (node->count == 1 && node->terminal == nullptr) {
+        uint8_t byte = 0;
+        Node* child = nullptr;
+        forEachChild(node, [&byte, &child](uint8_t b, Node* c) {
+            byte = b;
+            child = c;
+            return false;
+        });
+        std::string merged(prefixOf(node), node->prefixLength);
+        merged.push_back(static_cast<char>(byte));
+        merged.append(prefixOf(child), child->prefixLength);
+        assignPrefix(child, merged.data(), merged.size());
+        keyBytes_ -= 1;
+        destroy(node);
+        *slot = child;
+    }
+}
+
+template <typename V>
+V* AdaptiveRadixTree<V>::find(const std::string& key) const {
+    Node* node = root_;
+    size_t depth = 0;
+    while (node != nullptr) {
+        size_t length = node->prefixLength;
+        if (key.size() - depth < length || std::memcmp(key.data() + depth, prefixOf(node), length) != 0) {
+            return nullptr;
+        }
+        depth += length;
+        if (node->kind == Kind::LEAF) {
+            return depth == key.size() ? &static_cast<Leaf*>(node)->value : nullptr;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        if (depth == key.size()) {
+            return inner->terminal != nullptr ? &inner->terminal->value : nullptr;
+        }
+        Node** child = findChild(inner, static_cast<uint8_t>(key[depth++]));
+        node = child != nullptr ? *child : nullptr;
+    }
+    return nullptr;
+}
+
+template <typename V>
+std::pair<V*, bool> AdaptiveRadixTree<V>::insert(const std::string& key) {
+    Node** slot = &root_;
+    size_t depth = 0;
+    while (true) {
+        Node* node = *slot;
+        if (node == nullptr) {
+            Leaf* leaf = newLeaf(key.data() + depth, key.size() - depth);
+            *slot = leaf;
+            size_++;
+            return {&leaf->value, true};
+        }
+
+        const char* prefix = prefixOf(node);
+        size_t length = node->prefixLength;
+        size_t remaining = key.size() - depth;
+        size_t common = 0;
+        while (common < length && common < remaining && prefix[common] == key[depth + common]) {
+            common++;
+        }
+        bool isLeaf = node->kind == Kind::LEAF;
+        if (isLeaf && common == length && common == remaining) {
+            return {&static_cast<Leaf*>(node)->value, false};
+        }
+
+        if (common < length || isLeaf) {
+            // Split the path where the key leaves it
+            Node4* parent = allocate<Node4>();
+            Node* parentSlot = parent;  // A new Node4 never grows from two children
+            assignPrefix(parent, prefix, common);
+            if (common == length) {
+                assignPrefix(node, nullptr, 0);  // The leaf's key ends here
+                parent->terminal = static_cast<Leaf*>(node);
+            } else {
+                uint8_t byte = static_cast<uint8_t>(prefix[common]);
+                assignPrefix(node, prefix + common + 1, length - common - 1);
+                addChild(&parentSlot, parent, byte, node);
+            }
+            Leaf* leaf;
+            if (common == remaining) {
+                leaf = newLeaf(nullptr, 0);
+                parent->terminal = leaf;
+            } else {
+                leaf = newLeaf(key.data() + depth + common + 1, remaining - common - 1);
+                addChild(&parentSlot, parent, static_cast<uint8_t>(key[depth + common]), leaf);
+            }
+            *slot = parent;
+            size_++;
+            return {&leaf->value, true};
+        }
+
+        depth += length;
+        Inner* inner = static_cast<Inner*>(node);
+        if (depth == key.size()) {
+            if (inner->terminal != nullptr) {
+                return {&inner->terminal->value, false};
+            }
+            inner->terminal = newLeaf(nullptr, 0);
+            size_++;
+            return {&inner->terminal->value, true};
+        }
+        uint8_t byte = static_cast<uint8_t>(key[depth]);
+        Node** child = findChild(inner, byte);
+        if (child == nullptr) {
+            Leaf* leaf = newLeaf(key.data() + depth + 1, key.size() - depth - 1);
+            addChild(slot, inner, byte, leaf);
+            size_++;
+            return {&leaf->value, true};
+        }
+        slot = child;
+        depth++;
+    }
+}
+
+template <typename V>
+bool AdaptiveRadixTree<V>::erase(const std::string& key) {
+    if (root_ != nullptr && root_->kind == Kind::LEAF) {
+        if (root_->prefixLength != key.size() || std::memcmp(prefixOf(root_), key.data(), key.size()) != 0) {
+            return false;
+        }
+        destroy(root_);
+        root_ = nullptr;
+        size_--;
+        return true;
+    }
+    return root_ != nullptr && eraseBelow(&root_, key, 0);
+}
+
+template <typename V>
+bool AdaptiveRadixTree<V>::eraseBelow(Node** slot, const std::string& key, size_t depth) {
+    Inner* node = static_cast<Inner*>(*slot);
+    size_t length = node->prefixLength;
+    if (key.size() - depth < length || std::memcmp(key.data() + depth, prefixOf(node), length) != 0) {
+        return false;
+    }
+    depth += length;
+    if (depth == key.size()) {
+        if (node->terminal == nullptr) {
+            return false;
+        }
+        destroy(node->terminal);
+        node->terminal = nullptr;
+        size_--;
+        collapse(slot);
+        return true;
+    }
+
+    uint8_t byte = static_cast<uint8_t>(key[depth]);
+    Node** child = findChild(node, byte);
+    if (child == nullptr) {
+        return false;
+    }
+    Node* target = *child;
+    if (target->kind != Kind::LEAF) {
+        return eraseBelow(child, key, depth + 1);
+    }
+    size_t rest = key.size() - depth - 1;
+    if (target->prefixLength != rest || std::memcmp(prefixOf(target), key.data() + depth + 1, rest) != 0) {
+        return false;
+    }
+    destroy(target);
+    removeChild(slot, node, byte);
+    size_--;
+    collapse(slot);
+    return true;
+}
+
+template <typename V>
+bool AdaptiveRadixTree<V>::walk(Node* node, std::string& path, const std::string* after,
+                                const Visitor& visit) const {
+    size_t base = path.size();
+    path.append(prefixOf(node), node->prefixLength);
+    if (after != nullptr) {
+        size_t common = std::min(path.size(), after->size());
+        int order = path.compare(0, common, *after, 0, common);
+        if (order < 0) {
+            path.resize(base);
+            return true;  // The whole subtree sorts before the bound
+        }
+        if (order > 0 || path.size() > after->size()) {
+            after = nullptr;  // The whole subtree sorts after it
+        }
+    }
+
+    bool more = true;
+    if (node->kind == Kind::LEAF) {
+        if (after == nullptr) {
+            more = visit(path, static_cast<Leaf*>(node)->value);
+        }
+    } else {
+        Inner* inner = static_cast<Inner*>(node);
+        if (inner->terminal != nullptr && after == nullptr) {
+            more = visit(path, inner->terminal->value);
+        }
+        if (more) {
+            more = forEachChild(inner, [&](uint8_t byte, Node* child) {
+                const std::string* bound = nullptr;
+                if (after != nullptr && path.size() < after->size()) {
+                    uint8_t next = static_cast<uint8_t>((*after)[path.size()]);
+                    if (byte < next) {
+                        return true;
+                    }
+                    bound = byte == next ? after : nullptr;
+                }
+                path.push_back(static_cast<char>(byte));
+                bool keepGoing = walk(child, path, bound, visit);
+                path.pop_back();
+                return keepGoing;
+            });
+        }
+    }
+    path.resize(base);
+    return more;
+}
+
+template <typename V>
+bool AdaptiveRadixTree<V>::forEachAfter(const std::string* after, const Visitor& visit) const {
+    std::string path;
+    return root_ == nullptr || walk(root_, path, after, visit);
+}
+
+template <typename V>
+bool AdaptiveRadixTree<V>::forEachWithPrefix(const std::string& prefix, const Visitor& visit) const {
+    Node* node = root_;
+    size_t depth = 0;
+    while (node != nullptr) {
+        size_t length = node->prefixLength;
+        size_t remaining = prefix.size() - depth;
+        if (std::memcmp(prefixOf(node), prefix.data() + depth, std::min(length, remaining)) != 0) {
+            return true;
+        }
+        if (remaining <= length) {
+            // Every key below the node starts with the prefix
+            std::string path = prefix.substr(0, depth);
+            return walk(node, path, nullptr, visit);
+        }
+        if (node->kind == Kind::LEAF) {
+            return true;
+        }
+        depth += length;
+        Node** child = findChild(static_cast<Inner*>(node), static_cast<uint8_t>(prefix[depth++]));
+        node = child != nullptr ? *child : nullptr;
+    }
+    return true;
+}
+
+} // namespace storage
+} // namespace replication
+
+#endif // ADAPTIVE_RADIX_TREE_H
@@ -0,0 +1,297 @@
+#include "storage/BulkReader.h"
+#include "storage/Encoding.h"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+// Smaller ranges are not worth a thread of their own
+constexpr size_t kMinRangeBytes = 64 * 1024;
+
+// Reads one length-prefixed field of a binary record
+bool readField(const char*& cursor, const char* end, const char*& field, uint64_t& length) {
+    if (!decodeVarint64(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) {
+        return false;
+    }
+    field = cursor;
+    cursor += length;
+    return true;
+}
+
+// Sorts the records of a range by key, keeping the last record of each key
+void sortKeepingLast(BulkReader::Pairs& pairs) {
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    size_t kept = 0;
+    for (size_t i = 0; i < pairs.size(); i++) {
+        if (i + 1 < pairs.size() && pairs[i + 1].first == pairs[i].first) {
+            continue;
+        }
+        if (kept != i) {
+            pairs[kept] = std::move(pairs[i]);
+        }
+        kept++;
+    }
+    pairs.resize(kept);
+}
+
+} // namespace
+
+BulkReader::BulkReader(Format format, size_t threads)
+    : format_(format),
+      threads_(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      recordCount_(0) {
+}
+
+bool BulkReader::read(const std::string& path, Pairs& pairs) {
+    pairs.clear();
+    error_.clear();
+    recordCount_ = 0;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        error_ = "cannot open " + path;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size == 0) {
+        ::close(fd);
+        return true;
+    }
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        error_ = "cannot map " + path;
+        return false;
+    }
+    const char* data = static_cast<const char*>(mapping);
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+    std::vector<size_t> bounds;
+    bool ok = split(data, size, bounds);
+    size_t ranges = ok ? bounds.size() - 1 : 0;
+    std::vector<Pairs> parsed(ranges);
+    std::vector<uint64_t> records(ranges, 0);
+    std::vector<std::string> errors(ranges);
+    std::vector<char> succeeded(ranges, 0);
+    std::vector<std::thread> workers;
+    for (size_t r = 1; r < ranges; r++) {
+        workers.emplace_back([&, r]() {
+            succeeded[r] = parseRange(data, bounds[r], bounds[r + 1], parsed[r], records[r], errors[r]);
+        });
+    }
+    if (ranges > 0) {
+        succeeded[0] = parseRange(data, bounds[0], bounds[1], parsed[0], records[0], errors[0]);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ::munmap(mapping, size);
+
+    for (size_t r = 0; r < ranges; r++) {
+        recordCount_ += records[r];
+        if (!succeeded[r] && ok) {
+            error_ = errors[r];
+            ok = false;
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+
+    // Merge the sorted ranges; on equal keys the later range holds the later record
+    size_t total = 0;
+    for (const auto& range : parsed) {
+        total += range.size();
+    }
+    pairs.reserve(total);
+    std::vector<size_t> positions(ranges, 0);
+    auto after = [&parsed, &positions](size_t a, size_t b) {
+        const std::string& keyA = parsed[a][positions[a]].first;
+        const std::string& keyB = parsed[b][positions[b]].first;
+        return keyA != keyB ? keyA > keyB : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heads(after);
+    for (size_t r = 0; r < ranges; r++) {
+        if (!parsed[r].empty()) {
+            heads.push(r);
+        }
+    }
+    while (!heads.empty()) {
+        size_t r = heads.top();
+        heads.pop();
+        auto& pair = parsed[r][positions[r]];
+        if (!pairs.empty() && pairs.back().first == pair.first) {
+            pairs.back().second = std::move(pair.second);
+        } else {
+            pairs.push_back(std::move(pair));
+        }
+        if (++positions[r] < parsed[r].size()) {
+            heads.push(r);
+        } else {
+            Pairs().swap(parsed[r]);
+        }
+    }
+    return true;
+}
+
+bool BulkReader::split(const char* data, size_t size, std::vector<size_t>& bounds) {
+    size_t ranges = std::max<size_t>(1, std::min(threads_, size / kMinRangeBytes));
+    size_t target = size / ranges;
+    bounds.assign(1, 0);
+
+    if (format_ == Format::CSV) {
+        for (size_t r = 1; r < ranges; r++) {
+            const void* newline = std::memchr(data + r * target, '\n', size - r * target);
+            if (newline == nullptr) {
+                break;
+            }
+            size_t bound = static_cast<size_t>(static_cast<const char*>(newline) - data) + 1;
+            if (bound > bounds.back() && bound < size) {
+                bounds.push_back(bound);
+            }
+        }
+        bounds.push_back(size);
+        return true;
+    }
+
+    // Binary records can only be found from the start, by their length prefixes
+    const char* cursor = data;
+    const char* end = data + size;
+    size_t next = target;
+    while (cursor < end) {
+        size_t offset = static_cast<size_t>(cursor - data);
+        if (offset >= next) {
+            bounds.push_back(offset);
+            next = offset + target;
+        }
+        const char* field;
+        uint64_t keyLength;
+        uint64_t valueLength;
+        if (!readField(cursor, end, field, keyLength) || !readField(cursor, end, field, valueLength)) {
+            error_ = "truncated record at byte " + std::to_string(offset);
+            return false;
+        }
+    }
+    bounds.push_back(size);
+    return true;
+}
+
+bool BulkReader::parseRange(const char* data, size_t begin, size_t end, Pairs& pairs, uint64_t& records,
+                            std::string& error) const {
+    const char* cursor = data + begin;
+    const char* limit = data + end;
+    records = 0;
+
+    while (cursor < limit) {
+        const char* record = cursor;
+        std::string key;
+        std::string value;
+        if (format_ == Format::CSV) {
+            const char* newline = static_cast<const char*>(std::memchr(cursor, '\n', limit - cursor));
+            const char* lineEnd = newline ? newline : limit;
+            cursor = newline ? newline + 1 : limit;
+            if (lineEnd > record && lineEnd[-1] == '\r') {
+                lineEnd--;
+            }
+            if (lineEnd == record) {
+                continue;
+            }
+            if (!parseCsvLine(record, lineEnd, key, value)) {
+                error = "malformed CSV record at byte " + std::to_string(record - data);
+                return false;
+            }
+        } else {
+            const char* keyField;
+            const char* valueField;
+            uint64_t keyLength;
+            uint64_t valueLength;
+            if (!readField(cursor, limit, keyField, keyLength) || !readField(cursor, limit, valueField, valueLength)) {
+                error = "truncated record at byte " + std::to_string(record - data);
+                return false;
+            }
+            key.assign(keyField, keyLength);
+            value.assign(valueField, valueLength);
+        }
+        pairs.emplace_back(std::move(key), std::move(value));
+        records++;
+    }
+
+    sortKeepingLast(pairs);
+    return true;
+}
+
+bool BulkReader::parseCsvLine(const char* begin, const char* end, std::string& key, std::string& value) const {
+    // Reads a field up to the given delimiter, or to the end of the line when it is 0
+    auto field = [end](const char*& cursor, char delimiter, std::string& out) {
+        if (cursor < end && *cursor == '"') {
+            cursor++;
+            while (true) {
+                const char* quote = static_cast<const char*>(std::memchr(cursor, '"', end - cursor));
+                if (quote == nullptr) {
+                    return false;
+                }
+                out.append(cursor, quote);
+                cursor = quote + 1;
+                if (cursor < end && *cursor == '"') {
+                    out.push_back('"');
+                    cursor++;
+                    continue;
+                }
+                break;
+            }
+            if (delimiter == 0) {
+                return cursor == end;
+            }
+            return cursor < end && *cursor++ == delimiter;
+        }
+        if (delimiter == 0) {
+            out.assign(cursor, end);
+            cursor = end;
+            return true;
+        }
+        const char* found = static_cast<const char*>(std::memchr(cursor, delimiter, end - cursor));
+        if (found == nullptr) {
+            return false;
+        }
+        out.assign(cursor, found);
+        cursor = found + 1;
+        return true;
+    };
+
+    const char* cursor = begin;
+    return field(cursor, ',', key) && field(cursor, 0, value);
+}
+
+void BulkReader::appendBinaryRecord(std::string& out, const std::string& key, const std::string& value) {
+    appendVarint64(out, key.size());
+    out += key;
+    appendVarint64(out, value.size());
+    out += value;
+}
+
+const std::string& BulkReader::getError() const {
+    return error_;
+}
+
+uint64_t BulkReader::getRecordCount() const {
+    return recordCount_;
+}
+
+} // namespace storage
+} // namespace replication
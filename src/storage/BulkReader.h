@@ -0,0 +1,94 @@
+#ifndef BULK_READER_H
+#define BULK_READER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Parses a bulk import file into key-value pairs sorted by key.
+ *
+ * The file is mapped and cut into one range per thread at record
+ * boundaries; every range is parsed and sorted on its own thread, and the
+ * sorted ranges are merged. When a key appears more than once, its last
+ * record wins, as if the records had been written in file order.
+ *
+ * CSV files hold one "key,value" record per line. A field may be quoted
+ * to hold commas, with a quote inside written twice, but no field may
+ * span lines, so any line break ends a record. Blank lines are skipped.
+ *
+ * Binary files hold records back to back: a varint key length, the key,
+ * a varint value length and the value. Finding the range boundaries
+ * walks the length prefixes only; the copying happens in parallel.
+ */
+class BulkReader {
+public:
+    enum class Format {
+        CSV,
+        BINARY
+    };
+
+    using Pairs = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @param format how records are laid out in the file
+     * @param threads the threads parsing at once; 0 uses one per core
+     */
+    explicit BulkReader(Format format, size_t threads = 0);
+
+    /**
+     * Parses a whole file.
+     * @param pairs receives the pairs in ascending key order, one per key
+     * @return false if the file cannot be read or a record is malformed
+     */
+    bool read(const std::string& path, Pairs& pairs);
+
+    /**
+     * Gets why the last read() failed.
+     */
+    const std::string& getError() const;
+
+    /**
+     * Gets the number of records the last read() parsed, before later
+     * records replaced earlier ones for the same key.
+     */
+    uint64_t getRecordCount() const;
+
+    /**
+     * Appends a record in the binary format.
+     */
+    static void appendBinaryRecord(std::string& out, const std::string& key, const std::string& value);
+
+private:
+    /**
+     * Cuts the file into about threads_ ranges that start at a record.
+     * @return the range boundaries, from 0 to size
+     */
+    bool split(const char* data, size_t size, std::vector<size_t>& bounds);
+
+    /**
+     * Parses the records of the range [begin, end) of the file, then sorts
+     * them keeping the last record of each key.
+     * @param records receives the number of records parsed
+     * @return false and sets error if a record is malformed
+     */
+    bool parseRange(const char* data, size_t begin, size_t end, Pairs& pairs, uint64_t& records,
+                    std::string& error) const;
+
+    bool parseCsvLine(const char* begin, const char* end, std::string& key, std::string& value) const;
+
+    Format format_;
+    size_t threads_;
+    std::string error_;
+    uint64_t recordCount_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // BULK_READER_H
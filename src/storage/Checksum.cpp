@@ -0,0 +1,34 @@
+#include "storage/Checksum.h"
+#include <array>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+std::array<uint32_t, 256> buildTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+} // namespace
+
+uint32_t crc32(const char* data, size_t length, uint32_t seed) {
+    static const std::array<uint32_t, 256> table = buildTable();
+
+    uint32_t crc = ~seed;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+} // namespace storage
+} // namespace replication
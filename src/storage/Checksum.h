@@ -0,0 +1,22 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Computes the CRC-32 (IEEE 802.3 polynomial) of a buffer.
+ * @param data the bytes to checksum
+ * @param length the number of bytes
+ * @param seed a previous CRC to continue from, or 0
+ * @return the checksum
+ */
+uint32_t crc32(const char* data, size_t length, uint32_t seed = 0);
+
+} // namespace storage
+} // namespace replication
+
+#endif // CHECKSUM_H
@@ -0,0 +1,240 @@
+#include "storage/Compression.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr size_t kMinMatch = 4;
+constexpr size_t kMaxOffset = 65535;
+constexpr int kHashBits = 14;
+
+uint32_t hashAt(const char* position) {
+    uint32_t word;
+    std::memcpy(&word, position, sizeof(word));
+    return (word * 2654435761u) >> (32 - kHashBits);
+}
+
+void appendLength(std::string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+    uint8_t byte;
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * Appends one sequence; a matchLength of 0 marks the final, literals-only one.
+ */
+void appendSequence(std::string& out, const char* literals, size_t literalLength,
+                    size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength > 0 ? matchLength - kMinMatch : 0;
+    uint8_t token = static_cast<uint8_t>((std::min<size_t>(literalLength, 15) << 4) |
+                                         std::min<size_t>(matchCode, 15));
+    out.push_back(static_cast<char>(token));
+    if (literalLength >= 15) {
+        appendLength(out, literalLength - 15);
+    }
+    out.append(literals, literalLength);
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (matchCode >= 15) {
+        appendLength(out, matchCode - 15);
+    }
+}
+
+} // namespace
+
+std::shared_ptr<Compressor> Compressor::create(CompressionType type, const std::string& dictionary) {
+    switch (type) {
+        case CompressionType::FAST:
+            return std::make_shared<LzCompressor>();
+        case CompressionType::DICTIONARY:
+            return std::make_shared<LzCompressor>(dictionary);
+        case CompressionType::NONE:
+        default:
+            return std::make_shared<NullCompressor>();
+    }
+}
+
+std::string Compressor::trainDictionary(const std::vector<std::string>& samples, size_t maxSize) {
+    maxSize = std::min(maxSize, kMaxDictionarySize);
+
+    std::unordered_map<std::string, size_t> counts;
+    for (const auto& sample : samples) {
+        if (sample.size() >= kMinMatch && sample.size() <= maxSize) {
+            counts[sample]++;
+        }
+    }
+
+    // Rank by the bytes each sample would save across the set
+    std::vector<std::pair<std::string, size_t>> ranked(counts.begin(), counts.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        size_t benefitA = a.second * a.first.size();
+        size_t benefitB = b.second * b.first.size();
+        return benefitA != benefitB ? benefitA > benefitB : a.first < b.first;
+    });
+
+    std::vector<const std::string*> chosen;
+    size_t total = 0;
+    for (const auto& [sample, count] : ranked) {
+        if (total + sample.size() <= maxSize) {
+            chosen.push_back(&sample);
+            total += sample.size();
+        }
+    }
+
+    std::string dictionary;
+    dictionary.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+        dictionary += **it;
+    }
+    return dictionary;
+}
+
+CompressionType NullCompressor::getType() const {
+    return CompressionType::NONE;
+}
+
+void NullCompressor::compress(const char* data, size_t length, std::string& out) const {
+    out.append(data, length);
+}
+
+bool NullCompressor::decompress(const char* data, size_t length, size_t rawLength,
+                                std::string& out) const {
+    if (length != rawLength) {
+        return false;
+    }
+    out.append(data, length);
+    return true;
+}
+
+LzCompressor::LzCompressor(const std::string& dictionary)
+    : dictionary_(dictionary.size() > kMaxDictionarySize
+                      ? dictionary.substr(dictionary.size() - kMaxDictionarySize)
+                      : dictionary) {
+}
+
+CompressionType LzCompressor::getType() const {
+    return dictionary_.empty() ? CompressionType::FAST : CompressionType::DICTIONARY;
+}
+
+void LzCompressor::compress(const char* data, size_t length, std::string& out) const {
+    // Matches search the dictionary and the block as one window
+    std::string window;
+    window.reserve(dictionary_.size() + length);
+    window += dictionary_;
+    window.append(data, length);
+    const char* base = window.data();
+    const size_t end = window.size();
+
+    std::vector<int32_t> table(size_t(1) << kHashBits, -1);
+    for (size_t position = 0; position + kMinMatch <= dictionary_.size(); position++) {
+        table[hashAt(base + position)] = static_cast<int32_t>(position);
+    }
+
+    size_t anchor = dictionary_.size();
+    size_t position = anchor;
+    size_t misses = 0;
+    while (position + kMinMatch <= end) {
+        uint32_t hash = hashAt(base + position);
+        int32_t candidate = table[hash];
+        table[hash] = static_cast<int32_t>(position);
+
+        if (candidate >= 0 && position - candidate <= kMaxOffset &&
+            std::memcmp(base + candidate, base + position, kMinMatch) == 0) {
+            size_t matchLength = kMinMatch;
+            while (position + matchLength < end &&
+                   base[candidate + matchLength] == base[position + matchLength]) {
+                matchLength++;
+            }
+            appendSequence(out, base + anchor, position - anchor, position - candidate, matchLength);
+            position += matchLength;
+            anchor = position;
+            misses = 0;
+            if (position + kMinMatch <= end) {
+                table[hashAt(base + position - 2)] = static_cast<int32_t>(position - 2);
+            }
+        } else {
+            // Skip faster through data that does not compress
+            position += 1 + (misses++ >> 5);
+        }
+    }
+    appendSequence(out, base + anchor, end - anchor, 0, 0);
+}
+
+bool LzCompressor::decompress(const char* data, size_t length, size_t rawLength,
+                              std::string& out) const {
+    std::string buffer;
+    buffer.reserve(dictionary_.size() + rawLength);
+    buffer += dictionary_;
+    const size_t limit = dictionary_.size() + rawLength;
+
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = in + length;
+    while (true) {
+        if (in >= end) {
+            return false;
+        }
+        uint8_t token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(in, end, literalLength)) {
+            return false;
+        }
+        if (static_cast<size_t>(end - in) < literalLength || buffer.size() + literalLength > limit) {
+            return false;
+        }
+        buffer.append(reinterpret_cast<const char*>(in), literalLength);
+        in += literalLength;
+        if (in == end) {
+            break;  // Final sequence
+        }
+
+        if (end - in < 2) {
+            return false;
+        }
+        size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t matchLength = (token & 0x0F) + kMinMatch;
+        if ((token & 0x0F) == 15 && !readLength(in, end, matchLength)) {
+            return false;
+        }
+        if (offset == 0 || offset > buffer.size() || buffer.size() + matchLength > limit) {
+            return false;
+        }
+        // Byte by byte, since a match may overlap the bytes it produces
+        size_t from = buffer.size() - offset;
+        for (size_t i = 0; i < matchLength; i++) {
+            buffer.push_back(buffer[from + i]);
+        }
+    }
+
+    if (buffer.size() != limit) {
+        return false;
+    }
+    out.append(buffer, dictionary_.size(), std::string::npos);
+    return true;
+}
+
+} // namespace storage
+} // namespace replication
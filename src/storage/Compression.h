@@ -0,0 +1,103 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Selects how batches of log entries and snapshot blocks are compressed.
+ * The value is stored alongside compressed data, so it must stay stable.
+ */
+enum class CompressionType : uint8_t {
+    NONE = 0,       // Stored as is
+    FAST = 1,       // Byte-oriented LZ77 in the style of LZ4: cheap to encode and decode
+    DICTIONARY = 2  // FAST primed with a trained dictionary, for batches of small values
+};
+
+/**
+ * Compresses and decompresses independent blocks of bytes.
+ *
+ * Implementations are stateless after construction and safe to share
+ * between threads.
+ */
+class Compressor {
+public:
+    static constexpr size_t kMaxDictionarySize = 32 * 1024;
+
+    virtual ~Compressor() = default;
+
+    virtual CompressionType getType() const = 0;
+
+    /**
+     * Appends the compressed form of a block to out.
+     */
+    virtual void compress(const char* data, size_t length, std::string& out) const = 0;
+
+    /**
+     * Appends the decompressed form of a block to out.
+     * @param rawLength the exact length of the original block
+     * @return false if the input is malformed or does not expand to rawLength
+     */
+    virtual bool decompress(const char* data, size_t length, size_t rawLength,
+                            std::string& out) const = 0;
+
+    /**
+     * Creates a compressor of the requested type.
+     * @param dictionary the preset dictionary for DICTIONARY (ignored otherwise)
+     */
+    static std::shared_ptr<Compressor> create(CompressionType type,
+                                              const std::string& dictionary = "");
+
+    /**
+     * Builds a dictionary from sample values, favouring the most frequent
+     * ones and placing them last so matches against them use short offsets.
+     * @param samples typical values (or keys) the dictionary should cover
+     * @param maxSize the dictionary size limit
+     */
+    static std::string trainDictionary(const std::vector<std::string>& samples,
+                                       size_t maxSize = kMaxDictionarySize);
+};
+
+/**
+ * Pass-through compressor for CompressionType::NONE.
+ */
+class NullCompressor : public Compressor {
+public:
+    CompressionType getType() const override;
+    void compress(const char* data, size_t length, std::string& out) const override;
+    bool decompress(const char* data, size_t length, size_t rawLength,
+                    std::string& out) const override;
+};
+
+/**
+ * LZ77 compressor with a 64 KiB window and an optional preset dictionary.
+ *
+ * Output is a series of sequences, each a token byte (literal length in the
+ * high nibble, match length minus 4 in the low nibble, 15 meaning "more
+ * follows" as 255-byte runs), the literals, then a 2-byte little-endian
+ * match offset. The last sequence carries literals only. With a dictionary,
+ * matches may reach back into it as if it preceded the block.
+ */
+class LzCompressor : public Compressor {
+public:
+    explicit LzCompressor(const std::string& dictionary = "");
+
+    CompressionType getType() const override;
+    void compress(const char* data, size_t length, std::string& out) const override;
+    bool decompress(const char* data, size_t length, size_t rawLength,
+                    std::string& out) const override;
+
+private:
+    std::string dictionary_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // COMPRESSION_H
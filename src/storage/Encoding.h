@@ -0,0 +1,91 @@
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace replication {
+namespace storage {
+
+// Little-endian fixed-width integer helpers shared by the on-disk formats.
+
+inline void encodeFixed32(char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+inline void encodeFixed64(char* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+inline uint32_t decodeFixed32(const char* in) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+inline uint64_t decodeFixed64(const char* in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+inline void appendFixed32(std::string& out, uint32_t value) {
+    char buffer[4];
+    encodeFixed32(buffer, value);
+    out.append(buffer, 4);
+}
+
+inline void appendFixed64(std::string& out, uint64_t value) {
+    char buffer[8];
+    encodeFixed64(buffer, value);
+    out.append(buffer, 8);
+}
+
+// LEB128 variable-length integers, for compact batch encodings
+
+inline void appendVarint64(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * Decodes a varint and advances the cursor past it.
+ * @return false if the input ends first or the varint is too long
+ */
+inline bool decodeVarint64(const char*& cursor, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*cursor++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Maps signed deltas to unsigned so small negative values stay short
+inline uint64_t zigZagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline int64_t zigZagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+} // namespace storage
+} // namespace replication
+
+#endif // ENCODING_H
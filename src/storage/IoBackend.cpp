@@ -0,0 +1,117 @@
+#include "storage/IoBackend.h"
+#include "storage/UringIoBackend.h"
+
+#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr size_t kBufferAlignment = 4096;
+
+} // namespace
+
+IoBackend::IoBackend(size_t bufferCount, size_t bufferSize)
+    : bufferSize_((bufferSize + kBufferAlignment - 1) / kBufferAlignment * kBufferAlignment) {
+    for (size_t i = 0; i < bufferCount; i++) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, kBufferAlignment, bufferSize_) != 0) {
+            for (char* buffer : buffers_) {
+                std::free(buffer);
+            }
+            throw std::bad_alloc();
+        }
+        buffers_.push_back(static_cast<char*>(memory));
+    }
+}
+
+IoBackend::~IoBackend() {
+    for (char* buffer : buffers_) {
+        std::free(buffer);
+    }
+}
+
+size_t IoBackend::getBufferCount() const {
+    return buffers_.size();
+}
+
+size_t IoBackend::getBufferSize() const {
+    return bufferSize_;
+}
+
+char* IoBackend::getBuffer(size_t index) const {
+    return buffers_.at(index);
+}
+
+std::unique_ptr<IoBackend> IoBackend::create(IoBackendType type, size_t bufferCount,
+                                             size_t bufferSize) {
+#ifdef REPLICATION_HAVE_IO_URING
+    if (type != IoBackendType::POSIX) {
+        auto backend = UringIoBackend::tryCreate(bufferCount, bufferSize);
+        if (backend) {
+            return backend;
+        }
+        if (type == IoBackendType::IO_URING) {
+            std::cout << "io_uring unavailable, falling back to POSIX I/O" << std::endl;
+        }
+    }
+#else
+    if (type == IoBackendType::IO_URING) {
+        std::cout << "io_uring not supported on this platform, using POSIX I/O" << std::endl;
+    }
+#endif
+    return std::make_unique<PosixIoBackend>(bufferCount, bufferSize);
+}
+
+PosixIoBackend::PosixIoBackend(size_t bufferCount, size_t bufferSize)
+    : IoBackend(bufferCount, bufferSize) {
+}
+
+std::string PosixIoBackend::getName() const {
+    return "posix";
+}
+
+bool PosixIoBackend::writeAndSync(int fd, uint64_t offset, const std::vector<IoSlice>& slices,
+                                  bool sync) {
+    for (const auto& slice : slices) {
+        size_t written = 0;
+        while (written < slice.length) {
+            ssize_t result = ::pwrite(fd, slice.data + written, slice.length - written,
+                                      static_cast<off_t>(offset + written));
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        offset += slice.length;
+    }
+
+    if (!sync) {
+        return true;
+    }
+#ifdef __APPLE__
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+ssize_t PosixIoBackend::readAt(int fd, uint64_t offset, char* out, size_t length) {
+    while (true) {
+        ssize_t result = ::pread(fd, out, length, static_cast<off_t>(offset));
+        if (result >= 0 || errno != EINTR) {
+            return result;
+        }
+    }
+}
+
+} // namespace storage
+} // namespace replication
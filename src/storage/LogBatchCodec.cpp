@@ -0,0 +1,237 @@
+#include "storage/LogBatchCodec.h"
+#include "storage/Checksum.h"
+#include "storage/Encoding.h"
+
+#include <unordered_map>
+#include <iterator>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+// Entry flags; the low bits hold the operation type
+constexpr uint8_t kOperationMask = 0x0F;
+constexpr uint8_t kKeyReference = 0x10;
+constexpr uint8_t kRepeatedValue = 0x20;
+constexpr uint8_t kNewTerm = 0x40;
+
+// compression + raw body length
+constexpr size_t kFramePrefixSize = 1 + 4;
+
+// Anything larger is treated as corruption rather than allocated
+constexpr uint32_t kMaxPayloadSize = 256u * 1024 * 1024;
+
+bool readBytes(const char*& cursor, const char* end, std::string& out) {
+    uint64_t length;
+    if (!decodeVarint64(cursor, end, length) || static_cast<uint64_t>(end - cursor) < length) {
+        return false;
+    }
+    out.assign(cursor, static_cast<size_t>(length));
+    cursor += length;
+    return true;
+}
+
+void appendBytes(std::string& out, const std::string& bytes) {
+    appendVarint64(out, bytes.size());
+    out += bytes;
+}
+
+} // namespace
+
+LogBatchCodec::LogBatchCodec(CompressionType compression, const std::string& dictionary)
+    : none_(Compressor::create(CompressionType::NONE)),
+      fast_(Compressor::create(CompressionType::FAST)),
+      dictionary_(Compressor::create(CompressionType::DICTIONARY, dictionary)) {
+    switch (compression) {
+        case CompressionType::FAST:
+            compressor_ = fast_;
+            break;
+        case CompressionType::DICTIONARY:
+            compressor_ = dictionary_;
+            break;
+        case CompressionType::NONE:
+        default:
+            compressor_ = none_;
+            break;
+    }
+}
+
+CompressionType LogBatchCodec::getCompressionType() const {
+    return compressor_->getType();
+}
+
+const Compressor* LogBatchCodec::compressorFor(CompressionType type) const {
+    for (const auto* candidate : {none_.get(), fast_.get(), dictionary_.get()}) {
+        if (candidate->getType() == type) {
+            return candidate;
+        }
+    }
+    return nullptr;  // Unknown type, or a dictionary frame without a dictionary
+}
+
+bool LogBatchCodec::isFrame(const char* data) {
+    return (decodeFixed32(data) & kFrameFlag) != 0;
+}
+
+void LogBatchCodec::encode(const std::vector<model::LogEntry>& entries, std::string& out) const {
+    std::string body;
+    appendVarint64(body, entries.size());
+
+    std::unordered_map<std::string, size_t> keyTable;
+    std::vector<const std::string*> lastValues;
+    long previousId = 0;
+    long previousTimestamp = 0;
+    long previousTerm = 0;
+
+    for (const auto& entry : entries) {
+        auto known = keyTable.find(entry.getKey());
+        bool repeated = known != keyTable.end() && lastValues[known->second] != nullptr &&
+                        *lastValues[known->second] == entry.getValue();
+
+        uint8_t flags = static_cast<uint8_t>(entry.getOperationType()) & kOperationMask;
+        if (known != keyTable.end()) {
+            flags |= kKeyReference;
+        }
+        if (repeated) {
+            flags |= kRepeatedValue;
+        }
+        if (entry.getTerm() != previousTerm) {
+            flags |= kNewTerm;
+        }
+        body.push_back(static_cast<char>(flags));
+
+        appendVarint64(body, static_cast<uint64_t>(entry.getId() - previousId));
+        appendVarint64(body, zigZagEncode(entry.getTimestamp() - previousTimestamp));
+        if (flags & kNewTerm) {
+            appendVarint64(body, static_cast<uint64_t>(entry.getTerm()));
+        }
+
+        size_t keyIndex;
+        if (known != keyTable.end()) {
+            keyIndex = known->second;
+            appendVarint64(body, keyIndex);
+        } else {
+            keyIndex = lastValues.size();
+            keyTable.emplace(entry.getKey(), keyIndex);
+            lastValues.push_back(nullptr);
+            appendBytes(body, entry.getKey());
+        }
+        if (!repeated) {
+            appendBytes(body, entry.getValue());
+        }
+        lastValues[keyIndex] = &entry.getValue();
+
+        previousId = entry.getId();
+        previousTimestamp = entry.getTimestamp();
+        previousTerm = entry.getTerm();
+    }
+
+    size_t frameStart = out.size();
+    out.resize(frameStart + kHeaderSize);
+    out.push_back(static_cast<char>(compressor_->getType()));
+    appendFixed32(out, static_cast<uint32_t>(body.size()));
+    compressor_->compress(body.data(), body.size(), out);
+
+    size_t payloadSize = out.size() - frameStart - kHeaderSize;
+    encodeFixed32(&out[frameStart], kFrameFlag | static_cast<uint32_t>(payloadSize));
+    encodeFixed32(&out[frameStart + 4], crc32(&out[frameStart + kHeaderSize], payloadSize));
+}
+
+LogCodec::Status LogBatchCodec::decode(const char* data, size_t length, size_t& consumed,
+                                       std::vector<model::LogEntry>& entries) const {
+    if (length < kHeaderSize) {
+        return LogCodec::Status::INCOMPLETE;
+    }
+
+    uint32_t word = decodeFixed32(data);
+    uint32_t payloadSize = word & ~kFrameFlag;
+    if ((word & kFrameFlag) == 0 || payloadSize < kFramePrefixSize || payloadSize > kMaxPayloadSize) {
+        return LogCodec::Status::CORRUPT;
+    }
+    if (length - kHeaderSize < payloadSize) {
+        return LogCodec::Status::INCOMPLETE;
+    }
+    const char* payload = data + kHeaderSize;
+    if (crc32(payload, payloadSize) != decodeFixed32(data + 4)) {
+        return LogCodec::Status::CORRUPT;
+    }
+
+    auto type = static_cast<CompressionType>(payload[0]);
+    uint32_t rawSize = decodeFixed32(payload + 1);
+    const Compressor* compressor = compressorFor(type);
+    std::string body;
+    if (compressor == nullptr || rawSize > kMaxPayloadSize ||
+        !compressor->decompress(payload + kFramePrefixSize, payloadSize - kFramePrefixSize,
+                                rawSize, body)) {
+        return LogCodec::Status::CORRUPT;
+    }
+
+    const char* cursor = body.data();
+    const char* end = cursor + body.size();
+    uint64_t count;
+    if (!decodeVarint64(cursor, end, count) || count > body.size()) {
+        return LogCodec::Status::CORRUPT;
+    }
+
+    std::vector<std::string> keyTable;
+    std::vector<std::string> lastValues;
+    long id = 0;
+    long timestamp = 0;
+    long term = 0;
+    std::vector<model::LogEntry> decoded;
+    decoded.reserve(static_cast<size_t>(count));
+
+    for (uint64_t i = 0; i < count; i++) {
+        if (cursor >= end) {
+            return LogCodec::Status::CORRUPT;
+        }
+        uint8_t flags = static_cast<uint8_t>(*cursor++);
+        uint64_t idDelta, timestampDelta;
+        if (!decodeVarint64(cursor, end, idDelta) || !decodeVarint64(cursor, end, timestampDelta)) {
+            return LogCodec::Status::CORRUPT;
+        }
+        id += static_cast<long>(idDelta);
+        timestamp += static_cast<long>(zigZagDecode(timestampDelta));
+        if (flags & kNewTerm) {
+            uint64_t newTerm;
+            if (!decodeVarint64(cursor, end, newTerm)) {
+                return LogCodec::Status::CORRUPT;
+            }
+            term = static_cast<long>(newTerm);
+        }
+
+        size_t keyIndex;
+        if (flags & kKeyReference) {
+            uint64_t reference;
+            if (!decodeVarint64(cursor, end, reference) || reference >= keyTable.size()) {
+                return LogCodec::Status::CORRUPT;
+            }
+            keyIndex = static_cast<size_t>(reference);
+        } else {
+            keyIndex = keyTable.size();
+            keyTable.emplace_back();
+            lastValues.emplace_back();
+            if (!readBytes(cursor, end, keyTable.back())) {
+                return LogCodec::Status::CORRUPT;
+            }
+        }
+        if (!(flags & kRepeatedValue) && !readBytes(cursor, end, lastValues[keyIndex])) {
+            return LogCodec::Status::CORRUPT;
+        }
+
+        auto operation = static_cast<model::LogEntry::OperationType>(flags & kOperationMask);
+        decoded.emplace_back(id, keyTable[keyIndex], lastValues[keyIndex], operation, timestamp, term);
+    }
+    if (cursor != end) {
+        return LogCodec::Status::CORRUPT;
+    }
+
+    entries.insert(entries.end(), std::make_move_iterator(decoded.begin()),
+                   std::make_move_iterator(decoded.end()));
+    consumed = kHeaderSize + payloadSize;
+    return LogCodec::Status::COMPLETE;
+}
+
+} // namespace storage
+} // namespace replication
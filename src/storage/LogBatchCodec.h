@@ -0,0 +1,84 @@
+#ifndef LOG_BATCH_CODEC_H
+#define LOG_BATCH_CODEC_H
+
+#include "model/LogEntry.h"
+#include "storage/Compression.h"
+#include "storage/LogCodec.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Compact encoding of a batch of log entries written together.
+ *
+ * Frame layout (little-endian):
+ *   u32 (kFrameFlag | payload length) | u32 CRC-32 of payload |
+ *   u8 compression | u32 raw body length | compressed body
+ *
+ * The body is delta- and dedup-encoded before compression:
+ *   varint count | then per entry:
+ *     u8 flags (operation, key reference, repeated value, new term) |
+ *     varint id delta | zigzag varint timestamp delta | [varint term] |
+ *     key: varint table index, or varint length + bytes on first use |
+ *     value: omitted if it repeats the key's previous value in the batch,
+ *            else varint length + bytes
+ *
+ * so a hot key overwritten many times in one batch costs its bytes once,
+ * and IDs and timestamps cost a byte or two. The flag bit in the length
+ * word never occurs in a LogCodec record, so frames and plain records can
+ * share a segment.
+ */
+class LogBatchCodec {
+public:
+    static constexpr uint32_t kFrameFlag = 0x80000000u;
+    static constexpr size_t kHeaderSize = 8;
+
+    /**
+     * @param compression how encoded bodies are compressed
+     * @param dictionary the preset dictionary for DICTIONARY; frames of that
+     *        type can only be read back with the same dictionary
+     */
+    explicit LogBatchCodec(CompressionType compression = CompressionType::NONE,
+                           const std::string& dictionary = "");
+
+    /**
+     * Appends a frame holding the entries, which must have increasing IDs.
+     */
+    void encode(const std::vector<model::LogEntry>& entries, std::string& out) const;
+
+    /**
+     * Decodes the frame at the front of the buffer, whatever its compression
+     * type (DICTIONARY frames need this codec's dictionary).
+     * @param consumed receives the size of the frame when complete
+     * @param entries receives the decoded entries when complete (appended)
+     */
+    LogCodec::Status decode(const char* data, size_t length, size_t& consumed,
+                            std::vector<model::LogEntry>& entries) const;
+
+    /**
+     * Checks whether a buffer of at least 4 bytes starts with a batch
+     * frame rather than a single LogCodec record.
+     */
+    static bool isFrame(const char* data);
+
+    CompressionType getCompressionType() const;
+
+private:
+    const Compressor* compressorFor(CompressionType type) const;
+
+    std::shared_ptr<Compressor> compressor_;
+    std::shared_ptr<Compressor> none_;
+    std::shared_ptr<Compressor> fast_;
+    std::shared_ptr<Compressor> dictionary_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // LOG_BATCH_CODEC_H
@@ -0,0 +1,102 @@
+#include "storage/LogCodec.h"
+#include "storage/Checksum.h"
+#include "storage/Encoding.h"
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+// id + timestamp + term + operation + two length prefixes
+constexpr size_t kFixedPayloadSize = 8 + 8 + 8 + 1 + 4 + 4;
+
+// Anything larger is treated as corruption rather than allocated
+constexpr uint32_t kMaxPayloadSize = 256u * 1024 * 1024;
+
+} // namespace
+
+size_t LogCodec::encodedSize(const model::LogEntry& entry) {
+    return kHeaderSize + kFixedPayloadSize + entry.getKey().size() + entry.getValue().size();
+}
+
+void LogCodec::encodeTo(const model::LogEntry& entry, char* out) {
+    const std::string& key = entry.getKey();
+    const std::string& value = entry.getValue();
+    size_t payloadSize = kFixedPayloadSize + key.size() + value.size();
+
+    char* payload = out + kHeaderSize;
+    char* cursor = payload;
+    encodeFixed64(cursor, static_cast<uint64_t>(entry.getId()));
+    cursor += 8;
+    encodeFixed64(cursor, static_cast<uint64_t>(entry.getTimestamp()));
+    cursor += 8;
+    encodeFixed64(cursor, static_cast<uint64_t>(entry.getTerm()));
+    cursor += 8;
+    *cursor++ = static_cast<char>(entry.getOperationType());
+    encodeFixed32(cursor, static_cast<uint32_t>(key.size()));
+    cursor += 4;
+    std::memcpy(cursor, key.data(), key.size());
+    cursor += key.size();
+    encodeFixed32(cursor, static_cast<uint32_t>(value.size()));
+    cursor += 4;
+    std::memcpy(cursor, value.data(), value.size());
+
+    encodeFixed32(out, static_cast<uint32_t>(payloadSize));
+    encodeFixed32(out + 4, crc32(payload, payloadSize));
+}
+
+void LogCodec::encode(const model::LogEntry& entry, std::string& out) {
+    size_t offset = out.size();
+    out.resize(offset + encodedSize(entry));
+    encodeTo(entry, &out[offset]);
+}
+
+LogCodec::Status LogCodec::decode(const char* data, size_t length, size_t& consumed,
+                                  std::optional<model::LogEntry>& entry) {
+    if (length < kHeaderSize) {
+        return Status::INCOMPLETE;
+    }
+
+    uint32_t payloadSize = decodeFixed32(data);
+    uint32_t checksum = decodeFixed32(data + 4);
+    if (payloadSize < kFixedPayloadSize || payloadSize > kMaxPayloadSize) {
+        return Status::CORRUPT;
+    }
+    if (length - kHeaderSize < payloadSize) {
+        return Status::INCOMPLETE;
+    }
+
+    const char* payload = data + kHeaderSize;
+    if (crc32(payload, payloadSize) != checksum) {
+        return Status::CORRUPT;
+    }
+
+    const char* cursor = payload;
+    long id = static_cast<long>(decodeFixed64(cursor));
+    cursor += 8;
+    long timestamp = static_cast<long>(decodeFixed64(cursor));
+    cursor += 8;
+    long term = static_cast<long>(decodeFixed64(cursor));
+    cursor += 8;
+    auto operation = static_cast<model::LogEntry::OperationType>(*cursor++);
+    uint32_t keySize = decodeFixed32(cursor);
+    cursor += 4;
+    if (keySize > payloadSize - kFixedPayloadSize) {
+        return Status::CORRUPT;
+    }
+    std::string key(cursor, keySize);
+    cursor += keySize;
+    uint32_t valueSize = decodeFixed32(cursor);
+    cursor += 4;
+    if (valueSize != payloadSize - kFixedPayloadSize - keySize) {
+        return Status::CORRUPT;
+    }
+    std::string value(cursor, valueSize);
+
+    entry.emplace(id, key, value, operation, timestamp, term);
+    consumed = kHeaderSize + payloadSize;
+    return Status::COMPLETE;
+}
+
+} // namespace storage
+} // namespace replication
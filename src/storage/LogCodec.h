@@ -0,0 +1,66 @@
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include "model/LogEntry.h"
+
+#include <string>
+#include <optional>
+#include <cstddef>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Binary encoding of log entries for write-ahead log segments.
+ *
+ * Record layout (little-endian):
+ *   u32 payload length | u32 CRC-32 of payload |
+ *   i64 id | i64 timestamp | i64 term | u8 operation | u32 key length | key | u32 value length | value
+ *
+ * The checksum lets recovery detect a torn final record after a crash and
+ * stop replay at the last intact entry.
+ */
+class LogCodec {
+public:
+    /**
+     * Outcome of decoding one record.
+     */
+    enum class Status {
+        COMPLETE,
+        INCOMPLETE,  // The buffer ends in the middle of a record
+        CORRUPT      // Checksum or framing mismatch
+    };
+
+    static constexpr size_t kHeaderSize = 8;
+
+    /**
+     * Gets the number of bytes the encoded entry occupies.
+     */
+    static size_t encodedSize(const model::LogEntry& entry);
+
+    /**
+     * Encodes an entry into a buffer of at least encodedSize(entry) bytes.
+     */
+    static void encodeTo(const model::LogEntry& entry, char* out);
+
+    /**
+     * Appends an encoded entry to a string.
+     */
+    static void encode(const model::LogEntry& entry, std::string& out);
+
+    /**
+     * Decodes the record at the front of the buffer.
+     * @param data the buffered bytes
+     * @param length the number of buffered bytes
+     * @param consumed receives the size of the record when complete
+     * @param entry receives the decoded entry when complete
+     * @return the decode status
+     */
+    static Status decode(const char* data, size_t length, size_t& consumed,
+                         std::optional<model::LogEntry>& entry);
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // LOG_CODEC_H
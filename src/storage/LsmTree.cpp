@@ -0,0 +1,777 @@
+#include "storage/LsmTree.h"
+#include "storage/MemoryAccounting.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr size_t kMaxLevels = 7;
+constexpr const char* kManifestFile = "MANIFEST";
+constexpr const char* kRunSuffix = ".run";
+
+// Pause before retrying a flush or compaction that failed
+constexpr auto kRetryDelay = std::chrono::milliseconds(100);
+
+using RecordMap = std::map<std::string, LsmRecord>;
+using Level = std::vector<std::shared_ptr<SortedRun>>;
+
+size_t recordBytes(const std::string& key, const LsmRecord& record) {
+    return allocationSize(kTreeNodeHeader + sizeof(std::pair<const std::string, LsmRecord>)) + heapBytes(key) +
+           heapBytes(record.value);
+}
+
+bool hasPrefix(const std::string& key, const std::string& prefix) {
+    return key.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool overlaps(const SortedRun& run, const std::string& smallest, const std::string& largest) {
+    return !(run.getLargestKey() < smallest || largest < run.getSmallestKey());
+}
+
+uint64_t levelBytes(const Level& level) {
+    uint64_t total = 0;
+    for (const auto& run : level) {
+        total += run->getFileBytes();
+    }
+    return total;
+}
+
+/**
+ * Looks a key up in the runs of every level, newest data first.
+ */
+bool findInRuns(const std::vector<Level>& levels, const std::string& key, LsmRecord& record) {
+    for (size_t level = 0; level < levels.size(); level++) {
+        const Level& runs = levels[level];
+        if (level == 0) {
+            for (const auto& run : runs) {
+                if (run->get(key, record)) {
+                    return true;
+                }
+            }
+            continue;
+        }
+        auto it = std::lower_bound(runs.begin(), runs.end(), key,
+                                   [](const std::shared_ptr<SortedRun>& run, const std::string& target) {
+                                       return run->getLargestKey() < target;
+                                   });
+        if (it != runs.end() && (*it)->get(key, record)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * A key-ordered stream of records, from a memtable or the runs of a level.
+ */
+class Source {
+public:
+    virtual ~Source() = default;
+    virtual bool valid() const = 0;
+    virtual const std::string& key() const = 0;
+    virtual const LsmRecord& record() const = 0;
+    virtual void next() = 0;
+    virtual bool ok() const = 0;
+};
+
+class MemtableSource : public Source {
+public:
+    MemtableSource(std::shared_ptr<const RecordMap> records, const std::string& prefix)
+        : records_(std::move(records)),
+          it_(records_->lower_bound(prefix)) {
+    }
+
+    bool valid() const override { return it_ != records_->end(); }
+    const std::string& key() const override { return it_->first; }
+    const LsmRecord& record() const override { return it_->second; }
+    void next() override { ++it_; }
+    bool ok() const override { return true; }
+
+private:
+    std::shared_ptr<const RecordMap> records_;
+    RecordMap::const_iterator it_;
+};
+
+// Runs that do not overlap, read one after another
+class LevelSource : public Source {
+public:
+    LevelSource(Level runs, const std::string& prefix) : runs_(std::move(runs)), index_(0), ok_(true) {
+        while (index_ < runs_.size() && runs_[index_]->getLargestKey() < prefix) {
+            index_++;
+        }
+        if (index_ < runs_.size()) {
+            iterator_ = std::make_unique<SortedRun::Iterator>(runs_[index_]);
+            iterator_->seek(prefix);
+            skipExhausted();
+        }
+    }
+
+    bool valid() const override { return ok_ && iterator_ && iterator_->valid(); }
+    const std::string& key() const override { return iterator_->key(); }
+    const LsmRecord& record() const override { return iterator_->record(); }
+
+    void next() override {
+        iterator_->next();
+        skipExhausted();
+    }
+
+    bool ok() const override { return ok_; }
+
+private:
+    void skipExhausted() {
+        while (iterator_ && !iterator_->valid()) {
+            ok_ = ok_ && iterator_->ok();
+            if (!ok_ || ++index_ == runs_.size()) {
+                iterator_.reset();
+                return;
+            }
+            iterator_ = std::make_unique<SortedRun::Iterator>(runs_[index_]);
+            iterator_->seekToFirst();
+        }
+    }
+
+    Level runs_;
+    size_t index_;
+    std::unique_ptr<SortedRun::Iterator> iterator_;
+    bool ok_;
+};
+
+/**
+ * Merges sources given newest first, yielding each key once with its newest record.
+ */
+class Merger {
+public:
+    explicit Merger(std::vector<std::unique_ptr<Source>> sources) : sources_(std::move(sources)), current_(0) {
+        pick();
+    }
+
+    bool valid() const { return current_ < sources_.size(); }
+    const std::string& key() const { return sources_[current_]->key(); }
+    const LsmRecord& record() const { return sources_[current_]->record(); }
+
+    void next() {
+        std::string key = sources_[current_]->key();
+        for (auto& source : sources_) {
+            if (source->valid() && source->key() == key) {
+                source->next();
+            }
+        }
+        pick();
+    }
+
+    bool ok() const {
+        return std::all_of(sources_.begin(), sources_.end(), [](const auto& source) { return source->ok(); });
+    }
+
+private:
+    // The source with the smallest key; on a tie the newest
+    void pick() {
+        current_ = sources_.size();
+        for (size_t i = 0; i < sources_.size(); i++) {
+            if (sources_[i]->valid() && (current_ == sources_.size() || sources_[i]->key() < key())) {
+                current_ = i;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    size_t current_;
+};
+
+std::vector<std::unique_ptr<Source>> makeSources(const std::vector<std::shared_ptr<const RecordMap>>& memtables,
+                                                 const std::vector<Level>& levels, const std::string& prefix) {
+    std::vector<std::unique_ptr<Source>> sources;
+    for (const auto& memtable : memtables) {
+        sources.push_back(std::make_unique<MemtableSource>(memtable, prefix));
+    }
+    for (size_t level = 0; level < levels.size(); level++) {
+        if (level == 0) {
+            // Level 0 runs overlap, so each is a source of its own
+            for (const auto& run : levels[0]) {
+                sources.push_back(std::make_unique<LevelSource>(Level{run}, prefix));
+            }
+        } else if (!levels[level].empty()) {
+            sources.push_back(std::make_unique<LevelSource>(levels[level], prefix));
+        }
+    }
+    return sources;
+}
+
+bool resolve(const LsmRecord& record, std::string& value, long& version) {
+    if (record.deleted) {
+        return false;
+    }
+    value = record.value;
+    version = record.version;
+    return true;
+}
+
+} // namespace
+
+LsmTree::LsmTree(const LsmConfig& config)
+    : config_(config),
+      cache_(std::make_unique<BlockCache>(config.blockCacheBytes)),
+      active_(std::make_shared<Memtable>()),
+      version_(std::make_shared<Version>(Version{std::vector<Level>(kMaxLevels)})),
+      compactPointers_(kMaxLevels),
+      epoch_(0),
+      durableVersion_(0),
+      failed_(false),
+      stopping_(false),
+      opened_(false),
+      nextNumber_(1),
+      memtableBytes_(0),
+      runMemoryBytes_(0),
+      diskBytes_(0),
+      flushes_(0),
+      compactions_(0),
+      stalls_(0) {
+}
+
+LsmTree::~LsmTree() {
+    close();
+}
+
+bool LsmTree::open() {
+    std::error_code error;
+    std::filesystem::create_directories(config_.directory, error);
+    if (error) {
+        std::cerr << "LSM tree could not create " << config_.directory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    auto version = std::make_shared<Version>(Version{std::vector<Level>(kMaxLevels)});
+    std::unordered_set<uint64_t> live;
+    uint64_t next = 1;
+    long durable = 0;
+    std::ifstream manifest(std::filesystem::path(config_.directory) / kManifestFile);
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string kind;
+        fields >> kind;
+        if (kind == "next") {
+            fields >> next;
+        } else if (kind == "durable") {
+            fields >> durable;
+        } else if (kind == "run") {
+            size_t level = kMaxLevels;
+            uint64_t number = 0;
+            fields >> level >> number;
+            auto run = level < kMaxLevels ? SortedRun::open(runPath(number), number, cache_.get()) : nullptr;
+            if (!run) {
+                std::cerr << "LSM tree " << config_.directory << " cannot open run " << number << std::endl;
+                return false;
+            }
+            version->levels[level].push_back(run);
+            live.insert(number);
+        }
+    }
+    for (size_t level = 1; level < kMaxLevels; level++) {
+        std::sort(version->levels[level].begin(), version->levels[level].end(),
+                  [](const auto& a, const auto& b) { return a->getSmallestKey() < b->getSmallestKey(); });
+    }
+
+    // Runs never installed, or replaced but not yet deleted, are left over from before
+    for (const auto& file : std::filesystem::directory_iterator(config_.directory, error)) {
+        std::string name = file.path().filename().string();
+        bool temporary = name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0;
+        bool isRun = name.size() > std::strlen(kRunSuffix) &&
+                     name.compare(name.size() - std::strlen(kRunSuffix), std::string::npos, kRunSuffix) == 0;
+        uint64_t number = std::strtoull(name.c_str(), nullptr, 10);
+        next = std::max(next, number + 1);
+        if (temporary || (isRun && live.count(number) == 0)) {
+            std::filesystem::remove(file.path(), error);
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    nextNumber_ = next;
+    durableVersion_ = durable;
+    opened_ = true;
+    installLocked(version);
+    background_ = std::thread(&LsmTree::backgroundLoop, this);
+    return true;
+}
+
+void LsmTree::close() {
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        if (!opened_ || stopping_) {
+            return;
+        }
+        sealLocked();
+        stopping_ = true;
+    }
+    workCv_.notify_all();
+    changedCv_.notify_all();
+    background_.join();
+}
+
+bool LsmTree::get(const std::string& key, std::string& value, long& version) const {
+    std::vector<std::shared_ptr<const RecordMap>> sealed;
+    std::shared_ptr<const Version> current;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = active_->records->find(key);
+        if (it != active_->records->end()) {
+            return resolve(it->second, value, version);
+        }
+        for (auto memtable = immutables_.rbegin(); memtable != immutables_.rend(); ++memtable) {
+            sealed.push_back((*memtable)->records);
+        }
+        current = version_;
+    }
+
+    for (const auto& records : sealed) {
+        auto it = records->find(key);
+        if (it != records->end()) {
+            return resolve(it->second, value, version);
+        }
+    }
+    LsmRecord record;
+    return findInRuns(current->levels, key, record) && resolve(record, value, version);
+}
+
+void LsmTree::put(const std::string& key, const std::string& value, long version) {
+    write(key, LsmRecord{value, version, false});
+}
+
+void LsmTree::erase(const std::string& key, long version) {
+    write(key, LsmRecord{std::string(), version, true});
+}
+
+void LsmTree::write(const std::string& key, LsmRecord&& record) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (opened_ && !stopping_ && immutables_.size() >= config_.maxImmutables) {
+        stalls_++;
+        changedCv_.wait(lock, [this]() { return stopping_ || immutables_.size() < config_.maxImmutables; });
+    }
+
+    Memtable& memtable = *active_;
+    long version = record.version;
+    auto [it, inserted] = memtable.records->try_emplace(key);
+    if (!inserted) {
+        size_t replaced = recordBytes(it->first, it->second);
+        memtable.bytes -= replaced;
+        memtableBytes_ -= replaced;
+    }
+    it->second = std::move(record);
+    size_t added = recordBytes(it->first, it->second);
+    memtable.bytes += added;
+    memtableBytes_ += added;
+    if (version > 0) {
+        memtable.minVersion = memtable.minVersion == 0 ? version : std::min(memtable.minVersion, version);
+        memtable.maxVersion = std::max(memtable.maxVersion, version);
+    }
+
+    if (memtable.bytes >= config_.memtableBytes) {
+        sealLocked();
+    }
+}
+
+void LsmTree::sealLocked() {
+    if (active_->records->empty()) {
+        return;
+    }
+    immutables_.push_back(active_);
+    active_ = std::make_shared<Memtable>();
+    workCv_.notify_one();
+}
+
+void LsmTree::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    epoch_++;
+    active_ = std::make_shared<Memtable>();
+    immutables_.clear();
+    memtableBytes_ = 0;
+    for (const auto& level : version_->levels) {
+        for (const auto& run : level) {
+            run->markObsolete();
+        }
+    }
+    std::fill(compactPointers_.begin(), compactPointers_.end(), std::string());
+    durableVersion_ = 0;
+    installLocked(std::make_shared<Version>(Version{std::vector<Level>(kMaxLevels)}));
+    changedCv_.notify_all();
+}
+
+std::shared_ptr<const LsmTree::Snapshot> LsmTree::snapshot(const std::string& prefix) const {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto copied = std::make_shared<RecordMap>();
+    for (auto it = active_->records->lower_bound(prefix); it != active_->records->end() && hasPrefix(it->first, prefix);
+         ++it) {
+        copied->emplace_hint(copied->end(), *it);
+    }
+    snapshot->memtables_.push_back(std::move(copied));
+    for (auto memtable = immutables_.rbegin(); memtable != immutables_.rend(); ++memtable) {
+        snapshot->memtables_.push_back((*memtable)->records);
+    }
+    snapshot->levels_ = version_->levels;
+    return snapshot;
+}
+
+bool LsmTree::Snapshot::get(const std::string& key, std::string& value, long& version) const {
+    for (const auto& records : memtables_) {
+        auto it = records->find(key);
+        if (it != records->end()) {
+            return resolve(it->second, value, version);
+        }
+    }
+    LsmRecord record;
+    return findInRuns(levels_, key, record) && resolve(record, value, version);
+}
+
+bool LsmTree::Snapshot::forEachWithPrefix(const std::string& prefix, const Visitor& visit) const {
+    Merger merged(makeSources(memtables_, levels_, prefix));
+    for (; merged.valid() && hasPrefix(merged.key(), prefix); merged.next()) {
+        const LsmRecord& record = merged.record();
+        if (!record.deleted && !visit(merged.key(), record.value, record.version)) {
+            return false;
+        }
+    }
+    return merged.ok();
+}
+
+bool LsmTree::quiesce() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    if (!opened_ || stopping_) {
+        return false;
+    }
+    sealLocked();
+    changedCv_.wait(lock, [this]() {
+        Compaction compaction;
+        return failed_ || stopping_ || (immutables_.empty() && !pickCompaction(compaction));
+    });
+    return !failed_;
+}
+
+void LsmTree::backgroundLoop() {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    while (true) {
+        bool ok = true;
+        Compaction compaction;
+        if (!immutables_.empty()) {
+            ok = flushOldest(lock);
+        } else if (stopping_) {
+            break;
+        } else if (pickCompaction(compaction)) {
+            ok = runCompaction(lock, compaction);
+        } else {
+            workCv_.wait(lock);
+            continue;
+        }
+
+        failed_ = !ok;
+        changedCv_.notify_all();
+        if (!ok) {
+            if (stopping_) {
+                break;
+            }
+            workCv_.wait_for(lock, kRetryDelay);
+        }
+    }
+    changedCv_.notify_all();
+}
+
+bool LsmTree::flushOldest(std::unique_lock<std::shared_mutex>& lock) {
+    std::shared_ptr<Memtable> memtable = immutables_.front();
+    uint64_t epoch = epoch_;
+    lock.unlock();
+
+    Level outputs;
+    bool ok = writeRuns({memtable->records}, {}, false, 0, outputs);
+    lock.lock();
+    if (!ok) {
+        return false;
+    }
+    if (epoch != epoch_) {
+        for (const auto& run : outputs) {
+            run->markObsolete();
+        }
+        return true;
+    }
+
+    auto version = std::make_shared<Version>(*version_);
+    version->levels[0].insert(version->levels[0].begin(), outputs.begin(), outputs.end());
+    immutables_.pop_front();
+    memtableBytes_ -= memtable->bytes;
+    durableVersion_ = std::max(durableVersion_, memtable->maxVersion);
+    flushes_++;
+    installLocked(version);
+    return true;
+}
+
+bool LsmTree::pickCompaction(Compaction& compaction) const {
+    const std::vector<Level>& levels = version_->levels;
+    size_t level = kMaxLevels;
+    if (levels[0].size() >= std::max<size_t>(config_.level0Runs, 1)) {
+        level = 0;
+    } else {
+        // The level furthest over its target
+        double worst = 1.0;
+        for (size_t i = 1; i + 1 < kMaxLevels; i++) {
+            double score = static_cast<double>(levelBytes(levels[i])) / static_cast<double>(levelTarget(i));
+            if (score > worst) {
+                worst = score;
+                level = i;
+            }
+        }
+    }
+    if (level == kMaxLevels) {
+        return false;
+    }
+
+    compaction = Compaction();
+    compaction.level = level;
+    std::string smallest;
+    std::string largest;
+    if (level == 0) {
+        for (const auto& run : levels[0]) {
+            compaction.inputs.push_back(Level{run});
+        }
+        smallest = levels[0].front()->getSmallestKey();
+        largest = levels[0].front()->getLargestKey();
+        for (const auto& run : levels[0]) {
+            smallest = std::min(smallest, run->getSmallestKey());
+            largest = std::max(largest, run->getLargestKey());
+        }
+    } else {
+        // Take runs round-robin through the key space, so every key range gets merged down
+        const Level& runs = levels[level];
+        auto it = std::find_if(runs.begin(), runs.end(), [&](const auto& run) {
+            return run->getSmallestKey() > compactPointers_[level];
+        });
+        const auto& run = it == runs.end() ? runs.front() : *it;
+        compaction.inputs.push_back(Level{run});
+        smallest = run->getSmallestKey();
+        largest = run->getLargestKey();
+    }
+
+    Level below;
+    for (const auto& run : levels[level + 1]) {
+        if (overlaps(*run, smallest, largest)) {
+            below.push_back(run);
+        }
+    }
+    compaction.inputs.push_back(std::move(below));
+    compaction.bottommost = std::all_of(levels.begin() + level + 2, levels.end(),
+                                        [](const Level& deeper) { return deeper.empty(); });
+    return true;
+}
+
+bool LsmTree::runCompaction(std::unique_lock<std::shared_mutex>& lock, const Compaction& compaction) {
+    uint64_t epoch = epoch_;
+    lock.unlock();
+
+    // Every input is its own level of the merge, newer first
+    Level outputs;
+    bool ok = writeRuns({}, compaction.inputs, compaction.bottommost, config_.runBytes, outputs);
+    lock.lock();
+    if (!ok) {
+        return false;
+    }
+    if (epoch != epoch_) {
+        for (const auto& run : outputs) {
+            run->markObsolete();
+        }
+        return true;
+    }
+
+    std::unordered_set<const SortedRun*> replaced;
+    for (const auto& input : compaction.inputs) {
+        for (const auto& run : input) {
+            replaced.insert(run.get());
+            run->markObsolete();
+        }
+    }
+    auto version = std::make_shared<Version>(*version_);
+    for (auto& level : version->levels) {
+        level.erase(std::remove_if(level.begin(), level.end(),
+                                   [&replaced](const auto& run) { return replaced.count(run.get()) != 0; }),
+                    level.end());
+    }
+    Level& output = version->levels[compaction.level + 1];
+    output.insert(output.end(), outputs.begin(), outputs.end());
+    std::sort(output.begin(), output.end(),
+              [](const auto& a, const auto& b) { return a->getSmallestKey() < b->getSmallestKey(); });
+    if (compaction.level > 0) {
+        compactPointers_[compaction.level] = compaction.inputs.front().back()->getLargestKey();
+    }
+    compactions_++;
+    installLocked(version);
+    return true;
+}
+
+bool LsmTree::writeRuns(const std::vector<std::shared_ptr<const RecordMap>>& memtables,
+                        const std::vector<Level>& levels, bool dropDeletes, size_t splitBytes, Level& outputs) {
+    std::vector<std::unique_ptr<Source>> sources;
+    for (const auto& memtable : memtables) {
+        sources.push_back(std::make_unique<MemtableSource>(memtable, std::string()));
+    }
+    for (const auto& level : levels) {
+        if (!level.empty()) {
+            sources.push_back(std::make_unique<LevelSource>(level, std::string()));
+        }
+    }
+    Merger merged(std::move(sources));
+
+    std::unique_ptr<SortedRun::Writer> writer;
+    uint64_t number = 0;
+    auto finishRun = [&]() {
+        bool finished = writer->finish();
+        writer.reset();
+        auto run = finished ? SortedRun::open(runPath(number), number, cache_.get()) : nullptr;
+        if (run) {
+            outputs.push_back(run);
+        }
+        return run != nullptr;
+    };
+
+    bool ok = true;
+    for (; ok && merged.valid(); merged.next()) {
+        if (dropDeletes && merged.record().deleted) {
+            continue;
+        }
+        if (!writer) {
+            number = nextNumber_++;
+            writer = std::make_unique<SortedRun::Writer>(runPath(number), config_.blockBytes,
+                                                         config_.bloomBitsPerKey);
+            ok = writer->open();
+        }
+        ok = ok && writer->add(merged.key(), merged.record());
+        if (ok && splitBytes > 0 && writer->getFileBytes() >= splitBytes) {
+            ok = finishRun();
+        }
+    }
+    if (ok && writer) {
+        ok = finishRun();
+    }
+    ok = ok && merged.ok();
+
+    if (!ok) {
+        std::cerr << "LSM tree " << config_.directory << " failed to write run " << number << std::endl;
+        for (const auto& run : outputs) {
+            run->markObsolete();
+        }
+        outputs.clear();
+    }
+    return ok;
+}
+
+void LsmTree::installLocked(std::shared_ptr<const Version> version) {
+    size_t memoryBytes = 0;
+    uint64_t diskBytes = 0;
+    for (const auto& level : version->levels) {
+        for (const auto& run : level) {
+            memoryBytes += run->getMemoryBytes();
+            diskBytes += run->getFileBytes();
+        }
+    }
+    version_ = std::move(version);
+    runMemoryBytes_ = memoryBytes;
+    diskBytes_ = diskBytes;
+    if (opened_ && !saveManifestLocked()) {
+        std::cerr << "LSM tree " << config_.directory << " could not save its manifest" << std::endl;
+    }
+}
+
+bool LsmTree::saveManifestLocked() const {
+    std::string contents = "next " + std::to_string(nextNumber_.load()) + "\n";
+    contents += "durable " + std::to_string(durableVersion_) + "\n";
+    for (size_t level = 0; level < version_->levels.size(); level++) {
+        for (const auto& run : version_->levels[level]) {
+            contents += "run " + std::to_string(level) + " " + std::to_string(run->getNumber()) + "\n";
+        }
+    }
+
+    std::string path = (std::filesystem::path(config_.directory) / kManifestFile).string();
+    std::string tempPath = path + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 &&
+              ::write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()) &&
+              ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!ok || ::rename(tempPath.c_str(), path.c_str()) != 0) {
+        return false;
+    }
+    int directoryFd = ::open(config_.directory.c_str(), O_RDONLY);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return true;
+}
+
+long LsmTree::getDurableVersion() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    long oldest = active_->minVersion;
+    for (const auto& memtable : immutables_) {
+        if (memtable->minVersion > 0 && (oldest == 0 || memtable->minVersion < oldest)) {
+            oldest = memtable->minVersion;
+        }
+    }
+    return oldest > 0 ? oldest - 1 : durableVersion_;
+}
+
+size_t LsmTree::getMemoryBytes() const {
+    return memtableBytes_.load() + runMemoryBytes_.load() + cache_->getBytes();
+}
+
+LsmTree::Stats LsmTree::getStats() const {
+    Stats stats;
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        for (const auto& level : version_->levels) {
+            stats.runsPerLevel.push_back(level.size());
+        }
+    }
+    stats.diskBytes = diskBytes_;
+    stats.flushes = flushes_;
+    stats.compactions = compactions_;
+    stats.stalls = stalls_;
+    stats.cacheHits = cache_->getHits();
+    stats.cacheMisses = cache_->getMisses();
+    return stats;
+}
+
+const LsmConfig& LsmTree::getConfig() const {
+    return config_;
+}
+
+std::string LsmTree::runPath(uint64_t number) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%06" PRIu64 "%s", number, kRunSuffix);
+    return (std::filesystem::path(config_.directory) / name).string();
+}
+
+size_t LsmTree::levelTarget(size_t level) const {
+    size_t target = config_.levelBaseBytes;
+    for (size_t i = 1; i < level; i++) {
+        target *= std::max<size_t>(config_.levelRatio, 2);
+    }
+    return target;
+}
+
+} // namespace storage
+} // namespace replication
@@ -0,0 +1,273 @@
+#ifndef LSM_TREE_H
+#define LSM_TREE_H
+
+#include "storage/SortedRun.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Configuration for an LSM tree.
+ */
+struct LsmConfig {
+    std::string directory;
+    size_t memtableBytes = 4 * 1024 * 1024;     // Seal the memtable and flush it past this size
+    size_t maxImmutables = 4;                   // Writes stall while this many memtables await a flush
+    size_t blockBytes = 4096;                   // Target size of a run's data blocks
+    size_t blockCacheBytes = 8 * 1024 * 1024;   // Decoded blocks kept for point reads
+    size_t bloomBitsPerKey = 10;                // About 1% false positives
+    size_t level0Runs = 4;                      // Compact level 0 into level 1 at this many runs
+    size_t levelBaseBytes = 16 * 1024 * 1024;   // Target size of level 1
+    size_t levelRatio = 10;                     // Each deeper level may be this much larger
+    size_t runBytes = 2 * 1024 * 1024;          // Split compaction output into runs of this size
+};
+
+/**
+ * Log-structured merge tree keeping more data than fits in memory.
+ *
+ * Writes go to an in-memory memtable. A full memtable is sealed and a
+ * background thread flushes it to a sorted run in level 0; runs in level 0
+ * may overlap, so once there are enough of them they are merged with the
+ * overlapping part of level 1. Every deeper level holds non-overlapping
+ * runs and is allowed levelRatio times the bytes of the one above; a level
+ * over its target has one run (picked round-robin through the key space)
+ * merged into the next. Deletions are written as tombstones and dropped
+ * once merged into the deepest level holding data.
+ *
+ * A point read checks the memtables, then level 0 newest first, then one
+ * run per deeper level; each run's bloom filter skips most runs without
+ * I/O and a shared block cache serves hot blocks from memory.
+ *
+ * The tree keeps no write-ahead log of its own: records carry the version
+ * (log index) they were written at, and getDurableVersion() tells which
+ * prefix of the owner's replication log is safely in runs, so replaying
+ * the log (or the node's WAL) after it restores the memtables. The set of
+ * live runs is recorded in a MANIFEST file, replaced atomically.
+ */
+class LsmTree {
+public:
+    struct Stats {
+        std::vector<size_t> runsPerLevel;
+        uint64_t diskBytes = 0;
+        uint64_t flushes = 0;
+        uint64_t compactions = 0;
+        uint64_t stalls = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+    };
+
+    using Visitor = std::function<bool(const std::string& key, const std::string& value, long version)>;
+
+    explicit LsmTree(const LsmConfig& config);
+
+    /**
+     * Destructor that flushes the memtables and stops the background thread.
+     */
+    ~LsmTree();
+
+    LsmTree(const LsmTree&) = delete;
+    LsmTree& operator=(const LsmTree&) = delete;
+
+    /**
+     * Opens (or creates) the tree directory, loads the runs listed in the
+     * manifest and starts the background thread. Files left over from an
+     * interrupted flush or compaction are deleted.
+     * @return true if the tree is ready
+     */
+    bool open();
+
+    /**
+     * Flushes the memtables and stops the background thread.
+     */
+    void close();
+
+    /**
+     * Looks up a key.
+     * @return true and sets value and version if the key is present
+     */
+    bool get(const std::string& key, std::string& value, long& version) const;
+
+    /**
+     * Inserts or overwrites a key. Stalls while too many memtables await a flush.
+     */
+    void put(const std::string& key, const std::string& value, long version);
+
+    /**
+     * Writes a tombstone for a key.
+     */
+    void erase(const std::string& key, long version);
+
+    /**
+     * Drops every key. Runs still read by a snapshot are deleted once released.
+     */
+    void clear();
+
+    /**
+     * A consistent, read-only view of the tree. It pins the memtables and
+     * runs it reads, so it stays valid while writes, flushes and compactions
+     * carry on.
+     */
+    class Snapshot {
+    public:
+        bool get(const std::string& key, std::string& value, long& version) const;
+
+        /**
+         * Visits the keys starting with a prefix in ascending order.
+         * @return false if visit stopped early or a run could not be read
+         */
+        bool forEachWithPrefix(const std::string& prefix, const Visitor& visit) const;
+
+    private:
+        friend class LsmTree;
+        Snapshot() = default;
+
+        std::vector<std::shared_ptr<const std::map<std::string, LsmRecord>>> memtables_;  // Newest first
+        std::vector<std::vector<std::shared_ptr<SortedRun>>> levels_;
+    };
+
+    /**
+     * Opens a snapshot of the tree as it is now. The memtable being written
+     * is copied, so only the keys starting with the prefix are taken from it
+     * (the snapshot must then only be read under that prefix).
+     */
+    std::shared_ptr<const Snapshot> snapshot(const std::string& prefix = "") const;
+
+    /**
+     * Seals the memtable and waits until no flush or compaction is pending.
+     * @return false if a flush or compaction failed meanwhile
+     */
+    bool quiesce();
+
+    /**
+     * Gets the version up to which every record is in a run: below the
+     * oldest version still only in a memtable, or the newest flushed one.
+     */
+    long getDurableVersion() const;
+
+    /**
+     * Gets the bytes held in memory: memtables, run indexes and bloom
+     * filters, and the block cache. Takes no lock.
+     */
+    size_t getMemoryBytes() const;
+
+    Stats getStats() const;
+    const LsmConfig& getConfig() const;
+
+private:
+    using RecordMap = std::map<std::string, LsmRecord>;
+    using Level = std::vector<std::shared_ptr<SortedRun>>;
+
+    /**
+     * A memtable and the range of versions written to it (0 if none).
+     */
+    struct Memtable {
+        std::shared_ptr<RecordMap> records = std::make_shared<RecordMap>();
+        size_t bytes = 0;
+        long minVersion = 0;
+        long maxVersion = 0;
+    };
+
+    /**
+     * The runs of every level: level 0 newest first, deeper levels by key.
+     */
+    struct Version {
+        std::vector<Level> levels;
+    };
+
+    /**
+     * A merge of runs out of one level into the next.
+     */
+    struct Compaction {
+        size_t level = 0;
+        std::vector<Level> inputs;  // Newer first; each holds non-overlapping runs in key order
+        bool bottommost = false;    // No deeper level holds data, so tombstones can go
+    };
+
+    void write(const std::string& key, LsmRecord&& record);
+
+    /**
+     * Moves the memtable to the immutables. Caller holds mutex_ exclusively.
+     */
+    void sealLocked();
+
+    void backgroundLoop();
+
+    /**
+     * Writes the oldest immutable memtable to a level 0 run. Called and
+     * returns with mutex_ held exclusively; releases it while writing.
+     */
+    bool flushOldest(std::unique_lock<std::shared_mutex>& lock);
+
+    /**
+     * Merges a compaction's inputs into the next level. Called and returns
+     * with mutex_ held exclusively; releases it while merging.
+     */
+    bool runCompaction(std::unique_lock<std::shared_mutex>& lock, const Compaction& compaction);
+
+    /**
+     * Picks the most urgent compaction, if level 0 has too many runs or a
+     * deeper level is over its target. Caller holds mutex_.
+     */
+    bool pickCompaction(Compaction& compaction) const;
+
+    /**
+     * Merges memtables and levels (newer first) into new runs.
+     * @param dropDeletes leaves tombstones out
+     * @param splitBytes starts a new run past this size; 0 writes one run
+     * @return false if a run could not be written or an input read
+     */
+    bool writeRuns(const std::vector<std::shared_ptr<const RecordMap>>& memtables, const std::vector<Level>& levels,
+                   bool dropDeletes, size_t splitBytes, Level& outputs);
+
+    /**
+     * Installs a new version and rewrites the manifest. Caller holds mutex_ exclusively.
+     */
+    void installLocked(std::shared_ptr<const Version> version);
+    bool saveManifestLocked() const;
+
+    std::string runPath(uint64_t number) const;
+    size_t levelTarget(size_t level) const;
+
+    LsmConfig config_;
+    std::unique_ptr<BlockCache> cache_;
+
+    mutable std::shared_mutex mutex_;
+    std::condition_variable_any workCv_;     // Wakes the background thread
+    std::condition_variable_any changedCv_;  // Wakes stalled writers and quiesce()
+    std::shared_ptr<Memtable> active_;
+    std::deque<std::shared_ptr<Memtable>> immutables_;  // Oldest first
+    std::shared_ptr<const Version> version_;
+    std::vector<std::string> compactPointers_;  // Largest key last compacted out of each level
+    uint64_t epoch_;        // Bumped by clear(), so in-flight background work is discarded
+    long durableVersion_;   // Highest version flushed to a run
+    bool failed_;
+    bool stopping_;
+    bool opened_;
+
+    std::atomic<uint64_t> nextNumber_;
+    std::atomic<size_t> memtableBytes_;
+    std::atomic<size_t> runMemoryBytes_;
+    std::atomic<uint64_t> diskBytes_;
+    std::atomic<uint64_t> flushes_;
+    std::atomic<uint64_t> compactions_;
+    std::atomic<uint64_t> stalls_;
+    std::thread background_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // LSM_TREE_H
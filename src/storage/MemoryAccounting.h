@@ -0,0 +1,38 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <cstddef>
+#include <string>
+
+namespace replication {
+namespace storage {
+
+// Byte estimates for in-memory structures, modelled on glibc malloc and
+// libstdc++: each allocation carries an 8-byte header and is rounded up to
+// a 16-byte chunk of at least 32 bytes, and strings of up to 15 characters
+// are stored inline without a heap allocation.
+
+constexpr size_t kInlineStringCapacity = 15;
+
+// Header of a red-black tree node (colour, parent, left, right)
+constexpr size_t kTreeNodeHeader = 4 * sizeof(void*);
+
+/**
+ * Gets the bytes the allocator reserves for a request of the given size.
+ */
+inline size_t allocationSize(size_t requested) {
+    size_t chunk = (requested + sizeof(size_t) + 15) & ~static_cast<size_t>(15);
+    return chunk < 32 ? 32 : chunk;
+}
+
+/**
+ * Gets the heap bytes a string holds beyond its own object.
+ */
+inline size_t heapBytes(const std::string& text) {
+    return text.capacity() > kInlineStringCapacity ? allocationSize(text.capacity() + 1) : 0;
+}
+
+} // namespace storage
+} // namespace replication
+
+#endif // MEMORY_ACCOUNTING_H
@@ -0,0 +1,60 @@
+#ifndef SNAPSHOT_FORMAT_H
+#define SNAPSHOT_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+
+namespace replication {
+namespace storage {
+
+/**
+ * On-disk layout of a data store snapshot (all integers little-endian):
+ *
+ *   Header (64 bytes)
+ *     char[8] magic "RSNAPSH1" | u32 format version | u32 flags |
+ *     u64 last log index | u64 entry count | u64 block count |
+ *     u64 index offset | u64 index length | u32 index CRC | u32 header CRC
+ *
+ *   Data blocks, keys sorted ascending across the whole file
+ *     { u32 key length | u32 value length | key | value }* | u32 block CRC
+ *   or, when the flags select a compression type,
+ *     u32 raw length | compressed pairs | u32 block CRC
+ *
+ *   Block index, one record per block
+ *     u64 block offset | u32 block length (including CRC) | u32 entry count |
+ *     u32 first key length | first key
+ *   then, when the flags have kExpiriesFlag set, the expiry deadlines
+ *     u64 deadline count | { u32 key length | key | u64 deadline }*
+ *
+ * The header CRC covers the first 60 header bytes; each block and the index
+ * (deadlines included) carry their own CRC so a reader can verify blocks
+ * lazily on first touch. The low byte of the flags holds the CompressionType
+ * of the data blocks.
+ */
+namespace snapshot {
+
+constexpr char kMagic[8] = {'R', 'S', 'N', 'A', 'P', 'S', 'H', '1'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kHeaderCrcOffset = 60;
+constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+// Header field offsets
+constexpr size_t kVersionOffset = 8;
+constexpr size_t kFlagsOffset = 12;
+constexpr size_t kLastIndexOffset = 16;
+constexpr size_t kEntryCountOffset = 24;
+constexpr size_t kBlockCountOffset = 32;
+constexpr size_t kIndexOffsetOffset = 40;
+constexpr size_t kIndexLengthOffset = 48;
+constexpr size_t kIndexCrcOffset = 56;
+
+constexpr uint32_t kCompressionMask = 0xFF;
+constexpr uint32_t kExpiriesFlag = 0x100;
+
+} // namespace snapshot
+
+} // namespace storage
+} // namespace replication
+
+#endif // SNAPSHOT_FORMAT_H
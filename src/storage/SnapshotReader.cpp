@@ -0,0 +1,272 @@
+#include "storage/SnapshotReader.h"
+#include "storage/Checksum.h"
+#include "storage/Encoding.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr size_t kIndexRecordFixedSize = 8 + 4 + 4 + 4;
+constexpr size_t kRecordHeaderSize = 8;
+
+} // namespace
+
+std::shared_ptr<SnapshotReader> SnapshotReader::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < snapshot::kHeaderSize) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    std::shared_ptr<SnapshotReader> reader(
+        new SnapshotReader(path, fd, static_cast<const char*>(mapping), size));
+    if (!reader->parse()) {
+        std::cerr << "Snapshot " << path << " is corrupt" << std::endl;
+        return nullptr;
+    }
+    return reader;
+}
+
+SnapshotReader::SnapshotReader(const std::string& path, int fd, const char* data, size_t size)
+    : path_(path),
+      fd_(fd),
+      data_(data),
+      size_(size),
+      lastIndex_(0),
+      entryCount_(0) {
+}
+
+SnapshotReader::~SnapshotReader() {
+    ::munmap(const_cast<char*>(data_), size_);
+    ::close(fd_);
+}
+
+bool SnapshotReader::parse() {
+    if (std::memcmp(data_, snapshot::kMagic, sizeof(snapshot::kMagic)) != 0 ||
+        decodeFixed32(data_ + snapshot::kVersionOffset) != snapshot::kFormatVersion ||
+        decodeFixed32(data_ + snapshot::kHeaderCrcOffset) != crc32(data_, snapshot::kHeaderCrcOffset)) {
+        return false;
+    }
+
+    uint32_t flags = decodeFixed32(data_ + snapshot::kFlagsOffset);
+    auto compression = static_cast<CompressionType>(flags & snapshot::kCompressionMask);
+    if (compression != CompressionType::NONE && compression != CompressionType::FAST) {
+        return false;
+    }
+    compressor_ = Compressor::create(compression);
+
+    lastIndex_ = static_cast<long>(decodeFixed64(data_ + snapshot::kLastIndexOffset));
+    entryCount_ = decodeFixed64(data_ + snapshot::kEntryCountOffset);
+    uint64_t blockCount = decodeFixed64(data_ + snapshot::kBlockCountOffset);
+    uint64_t indexOffset = decodeFixed64(data_ + snapshot::kIndexOffsetOffset);
+    uint64_t indexLength = decodeFixed64(data_ + snapshot::kIndexLengthOffset);
+
+    if (indexOffset > size_ || indexLength > size_ - indexOffset ||
+        decodeFixed32(data_ + snapshot::kIndexCrcOffset) != crc32(data_ + indexOffset, indexLength)) {
+        return false;
+    }
+
+    const char* cursor = data_ + indexOffset;
+    const char* end = cursor + indexLength;
+    blocks_.reserve(blockCount);
+    for (uint64_t i = 0; i < blockCount; i++) {
+        if (static_cast<size_t>(end - cursor) < kIndexRecordFixedSize) {
+            return false;
+        }
+        BlockInfo block;
+        block.offset = decodeFixed64(cursor);
+        block.length = decodeFixed32(cursor + 8);
+        block.entryCount = decodeFixed32(cursor + 12);
+        uint32_t keyLength = decodeFixed32(cursor + 16);
+        cursor += kIndexRecordFixedSize;
+        if (static_cast<size_t>(end - cursor) < keyLength ||
+            block.offset < snapshot::kHeaderSize || block.length < 4 ||
+            block.offset + block.length > indexOffset) {
+            return false;
+        }
+        block.firstKey = std::string_view(cursor, keyLength);
+        cursor += keyLength;
+        blocks_.push_back(block);
+    }
+
+    if (flags & snapshot::kExpiriesFlag) {
+        if (static_cast<size_t>(end - cursor) < 8) {
+            return false;
+        }
+        uint64_t expiryCount = decodeFixed64(cursor);
+        cursor += 8;
+        for (uint64_t i = 0; i < expiryCount; i++) {
+            if (static_cast<size_t>(end - cursor) < 4) {
+                return false;
+            }
+            uint32_t keyLength = decodeFixed32(cursor);
+            cursor += 4;
+            if (static_cast<size_t>(end - cursor) < static_cast<size_t>(keyLength) + 8) {
+                return false;
+            }
+            std::string_view key(cursor, keyLength);
+            expiries_.emplace_back(key, static_cast<long>(decodeFixed64(cursor + keyLength)));
+            cursor += keyLength + 8;
+        }
+    }
+
+    blockState_.reset(new std::atomic<uint8_t>[blocks_.size()]);
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        blockState_[i] = 0;
+    }
+    expanded_.resize(blocks_.size());
+    return true;
+}
+
+bool SnapshotReader::verifyBlock(size_t block) const {
+    uint8_t state = blockState_[block].load(std::memory_order_acquire);
+    if (state == 0) {
+        const BlockInfo& info = blocks_[block];
+        const char* start = data_ + info.offset;
+        uint32_t payloadLength = info.length - 4;
+        bool intact = decodeFixed32(start + payloadLength) == crc32(start, payloadLength);
+        state = intact ? 1 : 2;
+        blockState_[block].store(state, std::memory_order_release);
+        if (!intact) {
+            std::cerr << "Snapshot " << path_ << " block " << block << " failed its checksum" << std::endl;
+        }
+    }
+    return state == 1;
+}
+
+bool SnapshotReader::blockPairs(size_t block, std::string_view& pairs,
+                                std::shared_ptr<const std::string>& holder) const {
+    if (block >= blocks_.size() || !verifyBlock(block)) {
+        return false;
+    }
+
+    const BlockInfo& info = blocks_[block];
+    const char* start = data_ + info.offset;
+    size_t storedLength = info.length - 4;
+    if (compressor_->getType() == CompressionType::NONE) {
+        pairs = std::string_view(start, storedLength);
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(expandedMutex_);
+        holder = expanded_[block];
+    }
+    if (!holder) {
+        auto expanded = std::make_shared<std::string>();
+        if (storedLength < 4 ||
+            !compressor_->decompress(start + 4, storedLength - 4, decodeFixed32(start), *expanded)) {
+            std::cerr << "Snapshot " << path_ << " block " << block << " failed to decompress" << std::endl;
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(expandedMutex_);
+        if (!expanded_[block]) {
+            expanded_[block] = expanded;
+        }
+        holder = expanded_[block];
+    }
+    pairs = *holder;
+    return true;
+}
+
+bool SnapshotReader::forEachInBlock(
+    size_t block, const std::function<void(std::string_view, std::string_view)>& visitor) const {
+    std::string_view pairs;
+    std::shared_ptr<const std::string> holder;
+    if (!blockPairs(block, pairs, holder)) {
+        return false;
+    }
+
+    const char* cursor = pairs.data();
+    const char* end = cursor + pairs.size();
+    while (static_cast<size_t>(end - cursor) >= kRecordHeaderSize) {
+        uint32_t keyLength = decodeFixed32(cursor);
+        uint32_t valueLength = decodeFixed32(cursor + 4);
+        cursor += kRecordHeaderSize;
+        if (static_cast<size_t>(end - cursor) < static_cast<size_t>(keyLength) + valueLength) {
+            return false;
+        }
+        visitor(std::string_view(cursor, keyLength), std::string_view(cursor + keyLength, valueLength));
+        cursor += keyLength + valueLength;
+    }
+    return true;
+}
+
+bool SnapshotReader::get(const std::string& key, std::string& value) const {
+    // Last block whose first key is <= key
+    auto it = std::upper_bound(blocks_.begin(), blocks_.end(), key,
+                               [](const std::string& target, const BlockInfo& block) {
+                                   return std::string_view(target) < block.firstKey;
+                               });
+    if (it == blocks_.begin()) {
+        return false;
+    }
+    size_t block = static_cast<size_t>(std::distance(blocks_.begin(), it)) - 1;
+
+    bool found = false;
+    forEachInBlock(block, [&](std::string_view candidate, std::string_view candidateValue) {
+        if (!found && candidate == key) {
+            value.assign(candidateValue.data(), candidateValue.size());
+            found = true;
+        }
+    });
+    return found;
+}
+
+const std::vector<std::pair<std::string_view, long>>& SnapshotReader::getExpiries() const {
+    return expiries_;
+}
+
+bool SnapshotReader::verifyAll() const {
+    for (size_t block = 0; block < blocks_.size(); block++) {
+        if (!verifyBlock(block)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+long SnapshotReader::getLastIndex() const {
+    return lastIndex_;
+}
+
+uint64_t SnapshotReader::getEntryCount() const {
+    return entryCount_;
+}
+
+size_t SnapshotReader::getBlockCount() const {
+    return blocks_.size();
+}
+
+const std::string& SnapshotReader::getPath() const {
+    return path_;
+}
+
+CompressionType SnapshotReader::getCompression() const {
+    return compressor_->getType();
+}
+
+} // namespace storage
+} // namespace replication
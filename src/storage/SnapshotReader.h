@@ -0,0 +1,120 @@
+#ifndef SNAPSHOT_READER_H
+#define SNAPSHOT_READER_H
+
+#include "storage/SnapshotFormat.h"
+#include "storage/Compression.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Read-only, memory-mapped view of a snapshot file.
+ *
+ * Opening only validates the header and block index; data blocks are paged
+ * in by the kernel and their checksums verified on first access. Point
+ * lookups binary-search the in-memory block index and scan a single block,
+ * so a freshly started node can serve reads immediately. Thread safe for
+ * concurrent readers.
+ *
+ * Compressed blocks are expanded on first touch and kept in memory for the
+ * lifetime of the reader.
+ */
+class SnapshotReader {
+public:
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    /**
+     * Maps and validates a snapshot file.
+     * @return the reader, or nullptr if the file is missing or corrupt
+     */
+    static std::shared_ptr<SnapshotReader> open(const std::string& path);
+
+    /**
+     * Looks up a key.
+     * @param key the key to look up
+     * @param value receives the value when found
+     * @return true if the key is present (and its block intact)
+     */
+    bool get(const std::string& key, std::string& value) const;
+
+    /**
+     * Visits every pair of one block in key order.
+     * @return false if the block failed its checksum
+     */
+    bool forEachInBlock(size_t block,
+                        const std::function<void(std::string_view, std::string_view)>& visitor) const;
+
+    /**
+     * Checks every block's checksum, so a reader can reject a damaged
+     * file before acting on any of it.
+     * @return true if all blocks are intact
+     */
+    bool verifyAll() const;
+
+    /**
+     * Gets the expiry deadlines stored with the snapshot, as key and
+     * absolute deadline pairs. The keys view the mapping.
+     */
+    const std::vector<std::pair<std::string_view, long>>& getExpiries() const;
+
+    long getLastIndex() const;
+    uint64_t getEntryCount() const;
+    size_t getBlockCount() const;
+    const std::string& getPath() const;
+    CompressionType getCompression() const;
+
+private:
+    struct BlockInfo {
+        uint64_t offset;
+        uint32_t length;
+        uint32_t entryCount;
+        std::string_view firstKey;
+    };
+
+    SnapshotReader(const std::string& path, int fd, const char* data, size_t size);
+
+    bool parse();
+    bool verifyBlock(size_t block) const;
+
+    /**
+     * Gets the pairs of a block, expanding it first if compressed.
+     * @param holder keeps an expanded block alive while the view is in use
+     * @return false if the block is corrupt
+     */
+    bool blockPairs(size_t block, std::string_view& pairs,
+                    std::shared_ptr<const std::string>& holder) const;
+
+    std::string path_;
+    int fd_;
+    const char* data_;
+    size_t size_;
+    long lastIndex_;
+    uint64_t entryCount_;
+    std::vector<BlockInfo> blocks_;
+    std::vector<std::pair<std::string_view, long>> expiries_;
+
+    // 0 = not yet verified, 1 = intact, 2 = corrupt
+    mutable std::unique_ptr<std::atomic<uint8_t>[]> blockState_;
+
+    std::shared_ptr<Compressor> compressor_;
+    // Expanded compressed blocks, filled on first touch
+    mutable std::vector<std::shared_ptr<const std::string>> expanded_;
+    mutable std::mutex expandedMutex_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // SNAPSHOT_READER_H
@@ -0,0 +1,167 @@
+#include "storage/SnapshotWriter.h"
+#include "storage/Checksum.h"
+#include "storage/Encoding.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+SnapshotWriter::SnapshotWriter(const std::string& path, long lastIndex, size_t blockSize,
+                               CompressionType compression)
+    : path_(path),
+      tempPath_(path + ".tmp"),
+      lastIndex_(lastIndex),
+      blockSize_(blockSize),
+      compressor_(Compressor::create(compression == CompressionType::DICTIONARY
+                                         ? CompressionType::FAST : compression)),
+      fd_(-1),
+      failed_(false),
+      offset_(0),
+      entryCount_(0),
+      blockCount_(0),
+      blockEntries_(0),
+      expiryCount_(0) {
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        ::unlink(tempPath_.c_str());
+    }
+}
+
+bool SnapshotWriter::open() {
+    fd_ = ::open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+    // Reserve the header; it is filled in once the index location is known
+    char header[snapshot::kHeaderSize] = {};
+    return writeAll(header, sizeof(header));
+}
+
+bool SnapshotWriter::add(const std::string& key, const std::string& value) {
+    if (fd_ < 0 || failed_ || (entryCount_ > 0 && key <= lastKey_)) {
+        failed_ = true;
+        return false;
+    }
+
+    if (blockEntries_ == 0) {
+        blockFirstKey_ = key;
+    }
+    appendFixed32(block_, static_cast<uint32_t>(key.size()));
+    appendFixed32(block_, static_cast<uint32_t>(value.size()));
+    block_ += key;
+    block_ += value;
+    blockEntries_++;
+    entryCount_++;
+    lastKey_ = key;
+
+    if (block_.size() >= blockSize_) {
+        return flushBlock();
+    }
+    return true;
+}
+
+void SnapshotWriter::addExpiry(const std::string& key, long deadline) {
+    appendFixed32(expiries_, static_cast<uint32_t>(key.size()));
+    expiries_ += key;
+    appendFixed64(expiries_, static_cast<uint64_t>(deadline));
+    expiryCount_++;
+}
+
+bool SnapshotWriter::flushBlock() {
+    if (blockEntries_ == 0) {
+        return true;
+    }
+
+    if (compressor_->getType() != CompressionType::NONE) {
+        std::string compressed;
+        appendFixed32(compressed, static_cast<uint32_t>(block_.size()));
+        compressor_->compress(block_.data(), block_.size(), compressed);
+        block_.swap(compressed);
+    }
+    appendFixed32(block_, crc32(block_.data(), block_.size()));
+
+    appendFixed64(index_, offset_);
+    appendFixed32(index_, static_cast<uint32_t>(block_.size()));
+    appendFixed32(index_, blockEntries_);
+    appendFixed32(index_, static_cast<uint32_t>(blockFirstKey_.size()));
+    index_ += blockFirstKey_;
+
+    bool ok = writeAll(block_.data(), block_.size());
+    block_.clear();
+    blockEntries_ = 0;
+    blockCount_++;
+    return ok;
+}
+
+bool SnapshotWriter::finish() {
+    if (fd_ < 0 || failed_ || !flushBlock()) {
+        return false;
+    }
+
+    uint32_t flags = static_cast<uint32_t>(compressor_->getType());
+    if (expiryCount_ > 0) {
+        flags |= snapshot::kExpiriesFlag;
+        appendFixed64(index_, expiryCount_);
+        index_ += expiries_;
+    }
+
+    uint64_t indexOffset = offset_;
+    if (!writeAll(index_.data(), index_.size())) {
+        return false;
+    }
+
+    char header[snapshot::kHeaderSize] = {};
+    std::memcpy(header, snapshot::kMagic, sizeof(snapshot::kMagic));
+    encodeFixed32(header + snapshot::kVersionOffset, snapshot::kFormatVersion);
+    encodeFixed32(header + snapshot::kFlagsOffset, flags);
+    encodeFixed64(header + snapshot::kLastIndexOffset, static_cast<uint64_t>(lastIndex_));
+    encodeFixed64(header + snapshot::kEntryCountOffset, entryCount_);
+    encodeFixed64(header + snapshot::kBlockCountOffset, blockCount_);
+    encodeFixed64(header + snapshot::kIndexOffsetOffset, indexOffset);
+    encodeFixed64(header + snapshot::kIndexLengthOffset, index_.size());
+    encodeFixed32(header + snapshot::kIndexCrcOffset, crc32(index_.data(), index_.size()));
+    encodeFixed32(header + snapshot::kHeaderCrcOffset, crc32(header, snapshot::kHeaderCrcOffset));
+
+    if (::pwrite(fd_, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+        ::fsync(fd_) != 0) {
+        failed_ = true;
+        return false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+
+    return ::rename(tempPath_.c_str(), path_.c_str()) == 0;
+}
+
+uint64_t SnapshotWriter::getEntryCount() const {
+    return entryCount_;
+}
+
+bool SnapshotWriter::writeAll(const char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = ::write(fd_, data + written, length - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed_ = true;
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    offset_ += length;
+    return true;
+}
+
+} // namespace storage
+} // namespace replication
@@ -0,0 +1,94 @@
+#ifndef SNAPSHOT_WRITER_H
+#define SNAPSHOT_WRITER_H
+
+#include "storage/SnapshotFormat.h"
+#include "storage/Compression.h"
+
+#include <string>
+#include <memory>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Streams sorted key-value pairs into a snapshot file.
+ *
+ * The file is written under a temporary name and atomically renamed into
+ * place by finish(), so readers never observe a partial snapshot.
+ */
+class SnapshotWriter {
+public:
+    /**
+     * @param path the final snapshot path
+     * @param lastIndex the log index the snapshot is consistent with
+     * @param blockSize the target size of a data block in bytes
+     * @param compression how data blocks are compressed; blocks have no
+     *        preset dictionary, so DICTIONARY is written as FAST
+     */
+    SnapshotWriter(const std::string& path, long lastIndex,
+                   size_t blockSize = snapshot::kDefaultBlockSize,
+                   CompressionType compression = CompressionType::NONE);
+
+    /**
+     * Removes the temporary file if finish() was never called.
+     */
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    /**
+     * Creates the temporary file.
+     * @return true if the writer is ready
+     */
+    bool open();
+
+    /**
+     * Adds a pair. Keys must be strictly ascending.
+     * @return false on I/O error or out-of-order key
+     */
+    bool add(const std::string& key, const std::string& value);
+
+    /**
+     * Records a key's expiry deadline, written after the block index.
+     * Deadlines may be added in any order.
+     * @param deadline the absolute deadline in milliseconds since the epoch
+     */
+    void addExpiry(const std::string& key, long deadline);
+
+    /**
+     * Writes the index and header, syncs and renames the file into place.
+     * @return true if the snapshot is complete and durable
+     */
+    bool finish();
+
+    uint64_t getEntryCount() const;
+
+private:
+    bool flushBlock();
+    bool writeAll(const char* data, size_t length);
+
+    std::string path_;
+    std::string tempPath_;
+    long lastIndex_;
+    size_t blockSize_;
+    std::shared_ptr<Compressor> compressor_;
+    int fd_;
+    bool failed_;
+    uint64_t offset_;
+    uint64_t entryCount_;
+    uint64_t blockCount_;
+    uint32_t blockEntries_;
+    std::string block_;
+    std::string blockFirstKey_;
+    std::string lastKey_;
+    std::string index_;
+    uint64_t expiryCount_;
+    std::string expiries_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // SNAPSHOT_WRITER_H
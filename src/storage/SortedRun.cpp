@@ -0,0 +1,508 @@
+#include "storage/SortedRun.h"
+#include "storage/Checksum.h"
+#include "storage/Encoding.h"
+#include "storage/MemoryAccounting.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+// Footer: index offset and size, bloom offset and size, entry count, magic
+constexpr size_t kFooterSize = 6 * 8;
+constexpr uint64_t kRunMagic = 0x4E5552544C534D31ULL;  // "1MSLTRUN"
+constexpr size_t kChecksumSize = 4;
+constexpr size_t kMinBloomBits = 64;
+constexpr uint32_t kMaxBloomProbes = 30;
+
+uint64_t hashKey(const std::string& key) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 0x100000001B3ULL;
+    }
+    return hash ^ (hash >> 29);
+}
+
+// Probes are derived from one hash by double hashing
+template<typename Probe>
+bool forEachProbe(uint64_t hash, uint32_t probes, size_t bits, Probe probe) {
+    uint64_t delta = (hash >> 33) | (hash << 31);
+    for (uint32_t i = 0; i < probes; i++) {
+        if (!probe(static_cast<size_t>(hash % bits))) {
+            return false;
+        }
+        hash += delta;
+    }
+    return true;
+}
+
+bool readAt(int fd, std::string& out, uint64_t offset, uint64_t length) {
+    out.resize(length);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t result = ::pread(fd, &out[done], length - done, static_cast<off_t>(offset + done));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(result);
+    }
+    return true;
+}
+
+// Checks and strips the checksum trailer of a block read from a run
+bool verifyBlock(std::string& block) {
+    if (block.size() < kChecksumSize) {
+        return false;
+    }
+    size_t length = block.size() - kChecksumSize;
+    if (decodeFixed32(block.data() + length) != crc32(block.data(), length)) {
+        return false;
+    }
+    block.resize(length);
+    return true;
+}
+
+bool decodeString(const char*& cursor, const char* end, std::string& out) {
+    uint64_t length;
+    if (!decodeVarint64(cursor, end, length) || length > static_cast<uint64_t>(end - cursor)) {
+        return false;
+    }
+    out.assign(cursor, length);
+    cursor += length;
+    return true;
+}
+
+} // namespace
+
+BlockCache::BlockCache(size_t capacityBytes)
+    : capacityBytes_(capacityBytes),
+      bytes_(0),
+      hits_(0),
+      misses_(0) {
+}
+
+std::shared_ptr<const BlockCache::Block> BlockCache::lookup(uint64_t run, uint64_t offset) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(Key{run, offset});
+    if (it == index_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    hits_++;
+    return it->second->second;
+}
+
+void BlockCache::insert(uint64_t run, uint64_t offset, std::shared_ptr<const Block> block) {
+    if (capacityBytes_ == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    Key key{run, offset};
+    if (index_.count(key) != 0) {
+        return;
+    }
+    bytes_ += block->bytes;
+    entries_.emplace_front(key, std::move(block));
+    index_[key] = entries_.begin();
+    while (bytes_ > capacityBytes_ && !entries_.empty()) {
+        bytes_ -= entries_.back().second->bytes;
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+size_t BlockCache::getBytes() const {
+    return bytes_;
+}
+
+uint64_t BlockCache::getHits() const {
+    return hits_;
+}
+
+uint64_t BlockCache::getMisses() const {
+    return misses_;
+}
+
+SortedRun::Writer::Writer(const std::string& path, size_t blockBytes, size_t bloomBitsPerKey)
+    : path_(path),
+      tempPath_(path + ".tmp"),
+      blockBytes_(blockBytes),
+      bloomBitsPerKey_(bloomBitsPerKey),
+      fd_(-1),
+      failed_(false),
+      offset_(0),
+      entryCount_(0) {
+}
+
+SortedRun::Writer::~Writer() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        ::unlink(tempPath_.c_str());
+    }
+}
+
+bool SortedRun::Writer::open() {
+    fd_ = ::open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return fd_ >= 0;
+}
+
+bool SortedRun::Writer::add(const std::string& key, const LsmRecord& record) {
+    if (fd_ < 0 || failed_ || (entryCount_ > 0 && key <= lastKey_)) {
+        failed_ = true;
+        return false;
+    }
+
+    if (entryCount_ == 0) {
+        smallestKey_ = key;
+    }
+    appendVarint64(block_, key.size());
+    block_ += key;
+    appendVarint64(block_, zigZagEncode(record.version));
+    block_.push_back(record.deleted ? 1 : 0);
+    appendVarint64(block_, record.value.size());
+    block_ += record.value;
+    hashes_.push_back(hashKey(key));
+    entryCount_++;
+    lastKey_ = key;
+
+    if (block_.size() >= blockBytes_) {
+        return flushBlock();
+    }
+    return true;
+}
+
+bool SortedRun::Writer::flushBlock() {
+    if (block_.empty()) {
+        return true;
+    }
+    appendFixed32(block_, crc32(block_.data(), block_.size()));
+
+    appendVarint64(index_, lastKey_.size());
+    index_ += lastKey_;
+    appendVarint64(index_, offset_);
+    appendVarint64(index_, block_.size());
+
+    bool ok = writeAll(block_.data(), block_.size());
+    block_.clear();
+    return ok;
+}
+
+bool SortedRun::Writer::finish() {
+    if (fd_ < 0 || failed_ || !flushBlock()) {
+        return false;
+    }
+
+    std::string index;
+    appendVarint64(index, smallestKey_.size());
+    index += smallestKey_;
+    index += index_;
+    appendFixed32(index, crc32(index.data(), index.size()));
+    uint64_t indexOffset = offset_;
+    if (!writeAll(index.data(), index.size())) {
+        return false;
+    }
+
+    size_t bits = std::max(kMinBloomBits, hashes_.size() * bloomBitsPerKey_);
+    bits = (bits + 7) / 8 * 8;
+    auto probes = static_cast<uint32_t>(std::lround(bloomBitsPerKey_ * 0.69));
+    probes = std::min(kMaxBloomProbes, std::max<uint32_t>(1, probes));
+    std::string bloom;
+    appendFixed32(bloom, probes);
+    size_t bitsOffset = bloom.size();
+    bloom.resize(bitsOffset + bits / 8, 0);
+    for (uint64_t hash : hashes_) {
+        forEachProbe(hash, probes, bits, [&bloom, bitsOffset](size_t bit) {
+            bloom[bitsOffset + bit / 8] |= static_cast<char>(1 << (bit % 8));
+            return true;
+        });
+    }
+    appendFixed32(bloom, crc32(bloom.data(), bloom.size()));
+    uint64_t bloomOffset = offset_;
+    if (!writeAll(bloom.data(), bloom.size())) {
+        return false;
+    }
+
+    std::string footer;
+    appendFixed64(footer, indexOffset);
+    appendFixed64(footer, index.size());
+    appendFixed64(footer, bloomOffset);
+    appendFixed64(footer, bloom.size());
+    appendFixed64(footer, entryCount_);
+    appendFixed64(footer, kRunMagic);
+    if (!writeAll(footer.data(), footer.size()) || ::fsync(fd_) != 0) {
+        failed_ = true;
+        return false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+
+    return ::rename(tempPath_.c_str(), path_.c_str()) == 0;
+}
+
+uint64_t SortedRun::Writer::getEntryCount() const {
+    return entryCount_;
+}
+
+uint64_t SortedRun::Writer::getFileBytes() const {
+    return offset_;
+}
+
+bool SortedRun::Writer::writeAll(const char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t result = ::write(fd_, data + written, length - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            failed_ = true;
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    offset_ += length;
+    return true;
+}
+
+SortedRun::Iterator::Iterator(std::shared_ptr<const SortedRun> run)
+    : run_(std::move(run)),
+      block_(0),
+      position_(0),
+      ok_(true) {
+}
+
+void SortedRun::Iterator::seekToFirst() {
+    loadBlock(0);
+    position_ = 0;
+}
+
+void SortedRun::Iterator::seek(const std::string& target) {
+    loadBlock(run_->findBlock(target));
+    if (!current_) {
+        return;
+    }
+    auto it = std::lower_bound(current_->entries.begin(), current_->entries.end(), target,
+                               [](const auto& entry, const std::string& key) { return entry.first < key; });
+    position_ = static_cast<size_t>(it - current_->entries.begin());
+}
+
+bool SortedRun::Iterator::valid() const {
+    return current_ && position_ < current_->entries.size();
+}
+
+void SortedRun::Iterator::next() {
+    if (++position_ >= current_->entries.size()) {
+        loadBlock(block_ + 1);
+        position_ = 0;
+    }
+}
+
+const std::string& SortedRun::Iterator::key() const {
+    return current_->entries[position_].first;
+}
+
+const LsmRecord& SortedRun::Iterator::record() const {
+    return current_->entries[position_].second;
+}
+
+bool SortedRun::Iterator::ok() const {
+    return ok_;
+}
+
+void SortedRun::Iterator::loadBlock(size_t block) {
+    block_ = block;
+    current_.reset();
+    if (block < run_->blocks_.size()) {
+        current_ = run_->readBlock(block);
+        ok_ = ok_ && current_ != nullptr;
+    }
+}
+
+std::shared_ptr<SortedRun> SortedRun::open(const std::string& path, uint64_t number, BlockCache* cache) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::shared_ptr<SortedRun> run(new SortedRun(path, number, fd, cache));
+
+    struct stat info;
+    std::string footer;
+    if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < kFooterSize ||
+        !readAt(fd, footer, info.st_size - kFooterSize, kFooterSize) ||
+        decodeFixed64(footer.data() + 40) != kRunMagic) {
+        std::cerr << "Sorted run " << path << " is corrupt" << std::endl;
+        return nullptr;
+    }
+    run->fileBytes_ = static_cast<uint64_t>(info.st_size);
+    uint64_t indexOffset = decodeFixed64(footer.data());
+    uint64_t indexSize = decodeFixed64(footer.data() + 8);
+    uint64_t bloomOffset = decodeFixed64(footer.data() + 16);
+    uint64_t bloomSize = decodeFixed64(footer.data() + 24);
+    run->entryCount_ = decodeFixed64(footer.data() + 32);
+
+    std::string index;
+    bool ok = indexOffset + indexSize <= bloomOffset && bloomOffset + bloomSize + kFooterSize <= run->fileBytes_ &&
+              readAt(fd, index, indexOffset, indexSize) && verifyBlock(index) &&
+              readAt(fd, run->bloom_, bloomOffset, bloomSize) && verifyBlock(run->bloom_) &&
+              run->bloom_.size() > 4;
+    const char* cursor = index.data();
+    const char* end = cursor + index.size();
+    ok = ok && decodeString(cursor, end, run->smallestKey_);
+    while (ok && cursor < end) {
+        BlockHandle handle;
+        ok = decodeString(cursor, end, handle.lastKey) && decodeVarint64(cursor, end, handle.offset) &&
+             decodeVarint64(cursor, end, handle.size) && handle.offset + handle.size <= indexOffset;
+        run->blocks_.push_back(std::move(handle));
+    }
+    if (!ok) {
+        std::cerr << "Sorted run " << path << " is corrupt" << std::endl;
+        return nullptr;
+    }
+    run->bloomProbes_ = decodeFixed32(run->bloom_.data());
+    run->bloom_.erase(0, 4);
+    return run;
+}
+
+SortedRun::SortedRun(const std::string& path, uint64_t number, int fd, BlockCache* cache)
+    : path_(path),
+      number_(number),
+      fd_(fd),
+      cache_(cache),
+      bloomProbes_(0),
+      entryCount_(0),
+      fileBytes_(0),
+      obsolete_(false) {
+}
+
+SortedRun::~SortedRun() {
+    ::close(fd_);
+    if (obsolete_) {
+        ::unlink(path_.c_str());
+    }
+}
+
+bool SortedRun::get(const std::string& key, LsmRecord& record) const {
+    if (blocks_.empty() || key < smallestKey_ || !mayContain(key)) {
+        return false;
+    }
+    size_t block = findBlock(key);
+    if (block == blocks_.size()) {
+        return false;
+    }
+
+    std::shared_ptr<const BlockCache::Block> data;
+    if (cache_) {
+        data = cache_->lookup(number_, blocks_[block].offset);
+    }
+    if (!data) {
+        data = readBlock(block);
+        if (!data) {
+            return false;
+        }
+        if (cache_) {
+            cache_->insert(number_, blocks_[block].offset, data);
+        }
+    }
+
+    auto it = std::lower_bound(data->entries.begin(), data->entries.end(), key,
+                               [](const auto& entry, const std::string& target) { return entry.first < target; });
+    if (it == data->entries.end() || it->first != key) {
+        return false;
+    }
+    record = it->second;
+    return true;
+}
+
+bool SortedRun::mayContain(const std::string& key) const {
+    const std::string& bloom = bloom_;
+    return forEachProbe(hashKey(key), bloomProbes_, bloom.size() * 8, [&bloom](size_t bit) {
+        return (bloom[bit / 8] & (1 << (bit % 8))) != 0;
+    });
+}
+
+uint64_t SortedRun::getNumber() const {
+    return number_;
+}
+
+const std::string& SortedRun::getSmallestKey() const {
+    return smallestKey_;
+}
+
+const std::string& SortedRun::getLargestKey() const {
+    return blocks_.empty() ? smallestKey_ : blocks_.back().lastKey;
+}
+
+uint64_t SortedRun::getEntryCount() const {
+    return entryCount_;
+}
+
+uint64_t SortedRun::getFileBytes() const {
+    return fileBytes_;
+}
+
+size_t SortedRun::getMemoryBytes() const {
+    size_t bytes = allocationSize(sizeof(SortedRun)) + heapBytes(bloom_) + heapBytes(smallestKey_) +
+                   allocationSize(blocks_.capacity() * sizeof(BlockHandle));
+    for (const auto& handle : blocks_) {
+        bytes += heapBytes(handle.lastKey);
+    }
+    return bytes;
+}
+
+void SortedRun::markObsolete() const {
+    obsolete_ = true;
+}
+
+std::shared_ptr<const BlockCache::Block> SortedRun::readBlock(size_t block) const {
+    const BlockHandle& handle = blocks_[block];
+    std::string data;
+    if (!readAt(fd_, data, handle.offset, handle.size) || !verifyBlock(data)) {
+        std::cerr << "Sorted run " << path_ << " has a corrupt block at " << handle.offset << std::endl;
+        return nullptr;
+    }
+
+    auto decoded = std::make_shared<BlockCache::Block>();
+    decoded->bytes = allocationSize(sizeof(BlockCache::Block));
+    const char* cursor = data.data();
+    const char* end = cursor + data.size();
+    while (cursor < end) {
+        std::pair<std::string, LsmRecord> entry;
+        uint64_t version;
+        if (!decodeString(cursor, end, entry.first) || !decodeVarint64(cursor, end, version) || cursor == end) {
+            return nullptr;
+        }
+        entry.second.version = static_cast<long>(zigZagDecode(version));
+        entry.second.deleted = *cursor++ != 0;
+        if (!decodeString(cursor, end, entry.second.value)) {
+            return nullptr;
+        }
+        decoded->bytes += heapBytes(entry.first) + heapBytes(entry.second.value);
+        decoded->entries.push_back(std::move(entry));
+    }
+    decoded->bytes += allocationSize(decoded->entries.capacity() * sizeof(decoded->entries[0]));
+    return decoded;
+}
+
+size_t SortedRun::findBlock(const std::string& key) const {
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), key,
+                               [](const BlockHandle& handle, const std::string& target) {
+                                   return handle.lastKey < target;
+                               });
+    return static_cast<size_t>(it - blocks_.begin());
+}
+
+} // namespace storage
+} // namespace replication
@@ -0,0 +1,254 @@
+#ifndef SORTED_RUN_H
+#define SORTED_RUN_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * The state of a key in an LSM tree: a value and the version it was
+ * written at, or a deletion that hides older values of the key.
+ */
+struct LsmRecord {
+    std::string value;
+    long version = 0;
+    bool deleted = false;
+};
+
+/**
+ * Least-recently-used cache of decoded sorted run blocks, shared by every
+ * run of a tree and bounded by the bytes the blocks hold. Thread-safe.
+ */
+class BlockCache {
+public:
+    struct Block {
+        std::vector<std::pair<std::string, LsmRecord>> entries;
+        size_t bytes = 0;
+    };
+
+    /**
+     * @param capacityBytes the bytes of blocks kept at most; 0 disables the cache
+     */
+    explicit BlockCache(size_t capacityBytes);
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    /**
+     * @return the cached block of a run at a file offset, or null
+     */
+    std::shared_ptr<const Block> lookup(uint64_t run, uint64_t offset);
+
+    /**
+     * Caches a block, evicting the least recently used ones past the capacity.
+     */
+    void insert(uint64_t run, uint64_t offset, std::shared_ptr<const Block> block);
+
+    size_t getBytes() const;
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+private:
+    struct Key {
+        uint64_t run;
+        uint64_t offset;
+        bool operator==(const Key& other) const { return run == other.run && offset == other.offset; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.run * 0x9E3779B97F4A7C15ULL ^ key.offset);
+        }
+    };
+
+    using Entry = std::pair<Key, std::shared_ptr<const Block>>;
+
+    size_t capacityBytes_;
+    mutable std::mutex mutex_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    std::atomic<size_t> bytes_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+/**
+ * An immutable file of records sorted by key, one level of an LSM tree.
+ *
+ * Records are packed into checksummed blocks of about the configured
+ * size. The index (the last key and location of every block) and a bloom
+ * filter over the keys are kept in memory while the run is open, so a
+ * lookup for a key the run does not hold usually costs no I/O, and one it
+ * does hold reads a single block unless the block is cached.
+ *
+ * Layout: data blocks, index block, bloom block, then a fixed footer with
+ * their locations, the record count and a magic number. Runs are shared
+ * by every snapshot that reads them; once replaced by a compaction a run
+ * is marked obsolete and its file is deleted when the last reference goes.
+ */
+class SortedRun {
+public:
+    /**
+     * Writes a new run. Records must be added in ascending key order. The
+     * file appears under its name only once finish() succeeds.
+     */
+    class Writer {
+    public:
+        Writer(const std::string& path, size_t blockBytes, size_t bloomBitsPerKey);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        bool open();
+        bool add(const std::string& key, const LsmRecord& record);
+
+        /**
+         * Writes the index, bloom filter and footer, syncs and renames the file.
+         */
+        bool finish();
+
+        uint64_t getEntryCount() const;
+        uint64_t getFileBytes() const;
+
+    private:
+        bool flushBlock();
+        bool writeAll(const char* data, size_t length);
+
+        std::string path_;
+        std::string tempPath_;
+        size_t blockBytes_;
+        size_t bloomBitsPerKey_;
+        int fd_;
+        bool failed_;
+        uint64_t offset_;
+        uint64_t entryCount_;
+        std::string block_;
+        std::string index_;
+        std::string smallestKey_;
+        std::string lastKey_;
+        std::vector<uint64_t> hashes_;
+    };
+
+    /**
+     * Reads the records of a run in key order, a block at a time. Blocks
+     * read by an iterator bypass the cache.
+     */
+    class Iterator {
+    public:
+        explicit Iterator(std::shared_ptr<const SortedRun> run);
+
+        void seekToFirst();
+
+        /**
+         * Positions at the first key not less than the target.
+         */
+        void seek(const std::string& target);
+
+        bool valid() const;
+        void next();
+        const std::string& key() const;
+        const LsmRecord& record() const;
+
+        /**
+         * @return false if a block failed its checksum
+         */
+        bool ok() const;
+
+    private:
+        void loadBlock(size_t block);
+
+        std::shared_ptr<const SortedRun> run_;
+        std::shared_ptr<const BlockCache::Block> current_;
+        size_t block_;
+        size_t position_;
+        bool ok_;
+    };
+
+    /**
+     * Opens and validates a run file, loading its index and bloom filter.
+     * @param number the run's file number, unique within its tree
+     * @param cache the cache point lookups go through; may be null
+     * @return the run, or null if the file is missing or corrupt
+     */
+    static std::shared_ptr<SortedRun> open(const std::string& path, uint64_t number, BlockCache* cache);
+
+    ~SortedRun();
+
+    SortedRun(const SortedRun&) = delete;
+    SortedRun& operator=(const SortedRun&) = delete;
+
+    /**
+     * Looks up a key.
+     * @return true and sets record if the run holds the key (possibly deleted)
+     */
+    bool get(const std::string& key, LsmRecord& record) const;
+
+    /**
+     * Checks the bloom filter: false means the run does not hold the key.
+     */
+    bool mayContain(const std::string& key) const;
+
+    uint64_t getNumber() const;
+    const std::string& getSmallestKey() const;
+    const std::string& getLargestKey() const;
+    uint64_t getEntryCount() const;
+    uint64_t getFileBytes() const;
+
+    /**
+     * Gets the bytes the open run holds in memory (index and bloom filter).
+     */
+    size_t getMemoryBytes() const;
+
+    /**
+     * Deletes the file once the run is no longer referenced.
+     */
+    void markObsolete() const;
+
+private:
+    struct BlockHandle {
+        std::string lastKey;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    SortedRun(const std::string& path, uint64_t number, int fd, BlockCache* cache);
+
+    /**
+     * Reads and decodes a block from the file.
+     * @return the block, or null if it is corrupt
+     */
+    std::shared_ptr<const BlockCache::Block> readBlock(size_t block) const;
+
+    /**
+     * Gets the block that may hold a key, or blocks_.size() if past the last.
+     */
+    size_t findBlock(const std::string& key) const;
+
+    std::string path_;
+    uint64_t number_;
+    int fd_;
+    BlockCache* cache_;
+    std::vector<BlockHandle> blocks_;
+    std::string bloom_;
+    uint32_t bloomProbes_;
+    std::string smallestKey_;
+    uint64_t entryCount_;
+    uint64_t fileBytes_;
+    mutable std::atomic<bool> obsolete_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // SORTED_RUN_H
@@ -0,0 +1,958 @@
+#include "storage/StripedStore.h"
+#include "storage/MemoryAccounting.h"
+#include "storage/AdaptiveRadixTree.h"
+#include <mutex>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <chrono>
+#include <random>
+#include <algorithm>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+// Keys read from one stripe per lock hold while reading out an image
+constexpr size_t kImageChunk = 256;
+
+// LFU counts start here, so a new key is not the first to go, and saturate at 255
+constexpr uint64_t kLfuInitialCount = 5;
+constexpr uint64_t kLfuMaxCount = 255;
+
+// The higher an LFU count, the less likely an access raises it
+constexpr double kLfuLogFactor = 10.0;
+
+uint64_t clockMicros() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+/**
+ * Keys in a red-black tree, each node holding a whole key.
+ */
+class StripedStore::TreeIndex : public StripedStore::Index {
+public:
+    Slot* find(const std::string& key) const override {
+        auto it = data_.find(key);
+        return it == data_.end() ? nullptr : const_cast<Slot*>(&it->second);
+    }
+
+    std::pair<Slot*, bool> insert(const std::string& key) override {
+        auto [it, inserted] = data_.try_emplace(key);
+        if (inserted) {
+            keyBytes_ += key.size();
+            keyHeapBytes_ += heapBytes(it->first);
+        }
+        return {&it->second, inserted};
+    }
+
+    bool erase(const std::string& key) override {
+        auto it = data_.find(key);
+        if (it == data_.end()) {
+            return false;
+        }
+        keyBytes_ -= key.size();
+        keyHeapBytes_ -= heapBytes(it->first);
+        data_.erase(it);
+        return true;
+    }
+
+    void clear() override {
+        data_.clear();
+        keyBytes_ = 0;
+        keyHeapBytes_ = 0;
+    }
+
+    size_t size() const override {
+        return data_.size();
+    }
+
+    bool forEachAfter(const std::string* after, const Visitor& visit) const override {
+        for (auto it = after == nullptr ? data_.begin() : data_.upper_bound(*after); it != data_.end(); ++it) {
+            if (!visit(it->first, const_cast<Slot&>(it->second))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool forEachWithPrefix(const std::string& prefix, const Visitor& visit) const override {
+        for (auto it = data_.lower_bound(prefix); it != data_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+             ++it) {
+            if (!visit(it->first, const_cast<Slot&>(it->second))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t getFootprint() const override {
+        return data_.size() * allocationSize(kTreeNodeHeader + sizeof(std::pair<const std::string, Slot>)) +
+               keyHeapBytes_;
+    }
+
+    size_t getKeyBytes() const override {
+        return keyBytes_;
+    }
+
+private:
+    std::map<std::string, Slot> data_;
+    size_t keyBytes_ = 0;
+    size_t keyHeapBytes_ = 0;
+};
+
+/**
+ * Keys in an adaptive radix tree, shared prefixes stored once.
+ */
+class StripedStore::RadixIndex : public StripedStore::Index {
+public:
+    Slot* find(const std::string& key) const override {
+        return tree_.find(key);
+    }
+
+    std::pair<Slot*, bool> insert(const std::string& key) override {
+        return tree_.insert(key);
+    }
+
+    bool erase(const std::string& key) override {
+        return tree_.erase(key);
+    }
+
+    void clear() override {
+        tree_.clear();
+    }
+
+    size_t size() const override {
+        return tree_.size();
+    }
+
+    bool forEachAfter(const std::string* after, const Visitor& visit) const override {
+        return tree_.forEachAfter(after, visit);
+    }
+
+    bool forEachWithPrefix(const std::string& prefix, const Visitor& visit) const override {
+        return tree_.forEachWithPrefix(prefix, visit);
+    }
+
+    size_t getFootprint() const override {
+        return tree_.getFootprint();
+    }
+
+    size_t getKeyBytes() const override {
+        return tree_.getKeyBytes();
+    }
+
+private:
+    AdaptiveRadixTree<Slot> tree_;
+};
+
+std::unique_ptr<StripedStore::Index> StripedStore::makeIndex(Engine engine) {
+    if (engine == Engine::RADIX) {
+        return std::make_unique<RadixIndex>();
+    }
+    return std::make_unique<TreeIndex>();
+}
+
+StripedStore::StripedStore(size_t stripeCount, Engine engine)
+    : stripeCount_(stripeCount == 0 ? 1 : stripeCount),
+      engine_(engine),
+      stripes_(new Stripe[stripeCount_]),
+      oldestReader_(kNoReader),
+      historyDepth_(kDefaultHistoryDepth),
+      historyHorizon_(0),
+      imageOpen_(false),
+      footprint_(0),
+      evictionPolicy_(EvictionPolicy::NONE),
+      hands_(stripeCount_),
+      nextSampleStripe_(0) {
+    for (size_t i = 0; i < stripeCount_; i++) {
+        stripes_[i].data = makeIndex(engine);
+    }
+}
+
+size_t StripedStore::stripeFor(const std::string& key) const {
+    return std::hash<std::string>()(key) % stripeCount_;
+}
+
+size_t StripedStore::getStripeCount() const {
+    return stripeCount_;
+}
+
+bool StripedStore::get(const std::string& key, std::string& value) const {
+    const Stripe& stripe = stripes_[stripeFor(key)];
+    std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+    if (lsm_) {
+        long version;
+        return lsm_->get(key, value, version);
+    }
+    const Slot* slot = stripe.data->find(key);
+    if (slot == nullptr) {
+        return false;
+    }
+    value = slot->entry.value;
+    touch(*slot, false);
+    return true;
+}
+
+bool StripedStore::get(const std::string& key, std::string& value, long& version) const {
+    const Stripe& stripe = stripes_[stripeFor(key)];
+    std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+    if (lsm_) {
+        return lsm_->get(key, value, version);
+    }
+    const Slot* slot = stripe.data->find(key);
+    if (slot == nullptr) {
+        return false;
+    }
+    value = slot->entry.value;
+    version = slot->entry.version;
+    touch(*slot, false);
+    return true;
+}
+
+bool StripedStore::contains(const std::string& key) const {
+    const Stripe& stripe = stripes_[stripeFor(key)];
+    std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+    if (lsm_) {
+        std::string value;
+        long version;
+        return lsm_->get(key, value, version);
+    }
+    return stripe.data->find(key) != nullptr;
+}
+
+void StripedStore::put(const std::string& key, const std::string& value, long version) {
+    Stripe& stripe = stripes_[stripeFor(key)];
+    std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+    putLocked(stripe, key, value, version);
+}
+
+size_t StripedStore::putMany(const std::vector<std::pair<std::string, std::string>>& pairs, long version) {
+    return putMany(pairs, groupByStripe(pairs), version);
+}
+
+std::vector<std::vector<size_t>> StripedStore::groupByStripe(
+    const std::vector<std::pair<std::string, std::string>>& pairs) const {
+    std::vector<std::vector<size_t>> byStripe(stripeCount_);
+    for (size_t i = 0; i < pairs.size(); i++) {
+        byStripe[stripeFor(pairs[i].first)].push_back(i);
+    }
+    return byStripe;
+}
+
+size_t StripedStore::putMany(const std::vector<std::pair<std::string, std::string>>& pairs,
+                             const std::vector<std::vector<size_t>>& byStripe, long version,
+                             size_t partition, size_t partitions) {
+    size_t written = 0;
+    for (size_t s = partition; s < stripeCount_; s += partitions) {
+        if (byStripe[s].empty()) {
+            continue;
+        }
+        Stripe& stripe = stripes_[s];
+        std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+        for (size_t i : byStripe[s]) {
+            putLocked(stripe, pairs[i].first, pairs[i].second, version);
+        }
+        written += byStripe[s].size();
+    }
+    return written;
+}
+
+void StripedStore::putLocked(Stripe& stripe, const std::string& key, const std::string& value, long version) {
+    if (lsm_) {
+        writeLsm(stripe, key, &value, version);
+        return;
+    }
+    if (stripe.imaged) {
+        preserve(stripe, key);
+    }
+    auto [slot, inserted] = stripe.data->insert(key);
+    if (!inserted) {
+        account(stripe, slot->entry, false);
+        if (version > 0 && keepsHistory()) {
+            retain(stripe, key, std::move(slot->entry), version);
+        }
+    }
+    slot->entry.value = value;
+    slot->entry.version = version;
+    account(stripe, slot->entry, true);
+    touch(*slot, inserted);
+    settle(stripe);
+}
+
+bool StripedStore::putIfAbsent(const std::string& key, const std::string& value, long version) {
+    Stripe& stripe = stripes_[stripeFor(key)];
+    std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+    if (lsm_) {
+        std::string current;
+        long currentVersion;
+        if (lsm_->get(key, current, currentVersion)) {
+            return false;
+        }
+        writeLsm(stripe, key, &value, version);
+        return true;
+    }
+    if (stripe.imaged) {
+        preserve(stripe, key);
+    }
+    auto [slot, inserted] = stripe.data->insert(key);
+    if (inserted) {
+        slot->entry = VersionedValue{value, version};
+        account(stripe, slot->entry, true);
+        touch(*slot, true);
+        settle(stripe);
+    }
+    return inserted;
+}
+
+bool StripedStore::erase(const std::string& key, long version) {
+    Stripe& stripe = stripes_[stripeFor(key)];
+    std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+    if (lsm_) {
+        return writeLsm(stripe, key, nullptr, version);
+    }
+    Slot* slot = stripe.data->find(key);
+    if (slot == nullptr) {
+        return false;
+    }
+    if (stripe.imaged) {
+        preserve(stripe, key);
+    }
+    account(stripe, slot->entry, false);
+    if (version > 0 && keepsHistory()) {
+        retain(stripe, key, std::move(slot->entry), version);
+    }
+    stripe.data->erase(key);
+    settle(stripe);
+    return true;
+}
+
+bool StripedStore::writeLsm(Stripe& stripe, const std::string& key, const std::string* value, long version) {
+    std::string replaced;
+    long replacedVersion = 0;
+    bool present = lsm_->get(key, replaced, replacedVersion);
+    if (!present && value == nullptr) {
+        return false;
+    }
+    if (present && version > 0 && keepsHistory()) {
+        retain(stripe, key, VersionedValue{std::move(replaced), replacedVersion}, version);
+    }
+    if (value != nullptr) {
+        lsm_->put(key, *value, version);
+        stripe.lsmKeys += present ? 0 : 1;
+    } else {
+        lsm_->erase(key, version);
+        stripe.lsmKeys--;
+    }
+    settle(stripe);
+    return present;
+}
+
+bool StripedStore::keepsHistory() const {
+    return oldestReader_.load() != kNoReader || historyHorizon_.load() > 0;
+}
+
+void StripedStore::retain(Stripe& stripe, const std::string& key, VersionedValue&& replaced, long replacedAt) {
+    long oldest = oldestReader_.load();
+    long horizon = historyHorizon_.load();
+    if (horizon > 0 && (oldest == kNoReader || replacedAt - horizon < oldest)) {
+        oldest = replacedAt - horizon;  // This write is the newest version the store has seen
+    }
+    History& history = stripe.history[key];
+    history.values.push_back(PastValue{std::move(replaced.value), replaced.version, replacedAt});
+    accountPast(stripe, history.values.back(), true);
+
+    // Values replaced at or before the oldest reader's version are invisible to every reader
+    while (!history.values.empty() && history.values.front().replacedAt <= oldest) {
+        accountPast(stripe, history.values.front(), false);
+        history.values.pop_front();
+    }
+    size_t depth = historyDepth_.load();
+    while (history.values.size() > depth) {
+        history.discardedBefore = history.values.front().replacedAt;
+        accountPast(stripe, history.values.front(), false);
+        history.values.pop_front();
+    }
+    if (history.values.empty() && history.discardedBefore <= oldest) {
+        stripe.history.erase(key);
+    }
+}
+
+StripedStore::VersionLookup StripedStore::getAt(const std::string& key, long version, std::string& value) const {
+    const Stripe& stripe = stripes_[stripeFor(key)];
+    std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+    if (lsm_) {
+        std::string current;
+        long currentVersion;
+        if (lsm_->get(key, current, currentVersion) && currentVersion <= version) {
+            value = std::move(current);
+            return VersionLookup::FOUND;
+        }
+    } else {
+        const Slot* slot = stripe.data->find(key);
+        if (slot != nullptr && slot->entry.version <= version) {
+            value = slot->entry.value;
+            return VersionLookup::FOUND;
+        }
+    }
+
+    auto history = stripe.history.find(key);
+    if (history == stripe.history.end()) {
+        return VersionLookup::MISSING;
+    }
+    const auto& values = history->second.values;
+    for (auto past = values.rbegin(); past != values.rend(); ++past) {
+        if (past->version <= version && version < past->replacedAt) {
+            value = past->value;
+            return VersionLookup::FOUND;
+        }
+    }
+    return version < history->second.discardedBefore ? VersionLookup::DISCARDED : VersionLookup::MISSING;
+}
+
+void StripedStore::setOldestReader(long version) {
+    oldestReader_ = version;
+}
+
+void StripedStore::setHistoryDepth(size_t depth) {
+    historyDepth_ = depth;
+}
+
+void StripedStore::setHistoryHorizon(long versions) {
+    historyHorizon_ = versions;
+}
+
+void StripedStore::clearHistory() {
+    for (size_t i = 0; i < stripeCount_; i++) {
+        Stripe& stripe = stripes_[i];
+        std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+        stripe.history.clear();
+        stripe.historyBytes = 0;
+        settle(stripe);
+    }
+}
+
+void StripedStore::clear() {
+    if (engine_.load() == Engine::LSM) {
+        // The tree is shared by every stripe, so its keys and their counts go together
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(stripeCount_);
+        for (size_t i = 0; i < stripeCount_; i++) {
+            locks.emplace_back(stripes_[i].mutex);
+        }
+        if (lsm_) {
+            lsm_->clear();
+        }
+        for (size_t i = 0; i < stripeCount_; i++) {
+            stripes_[i].lsmKeys = 0;
+            stripes_[i].history.clear();
+            stripes_[i].historyBytes = 0;
+            settle(stripes_[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < stripeCount_; i++) {
+        Stripe& stripe = stripes_[i];
+        std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+        if (stripe.imaged) {
+            // Hand every key not yet preserved over to the image
+            stripe.data->forEachAfter(nullptr, [&stripe](const std::string& key, Slot& slot) {
+                stripe.preserved.emplace(key, std::move(slot.entry));
+                return true;
+            });
+        }
+        stripe.data->clear();
+        stripe.history.clear();
+        stripe.valueBytes = 0;
+        stripe.valueHeapBytes = 0;
+        stripe.historyBytes = 0;
+        settle(stripe);
+    }
+}
+
+size_t StripedStore::size() const {
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(stripeCount_);
+    size_t total = 0;
+    for (size_t i = 0; i < stripeCount_; i++) {
+        locks.emplace_back(stripes_[i].mutex);
+        total += stripes_[i].data->size() + stripes_[i].lsmKeys;
+    }
+    return total;
+}
+
+bool StripedStore::setEngine(Engine engine, const LsmConfig& lsm) {
+    std::vector<std::unique_lock<std::shared_mutex>> locks;
+    locks.reserve(stripeCount_);
+    for (size_t i = 0; i < stripeCount_; i++) {
+        locks.emplace_back(stripes_[i].mutex);
+    }
+    if (engine == engine_.load() && (engine != Engine::LSM || lsm_->getConfig().directory == lsm.directory)) {
+        return true;
+    }
+
+    std::shared_ptr<LsmTree> tree;
+    if (engine == Engine::LSM) {
+        tree = std::make_shared<LsmTree>(lsm);
+        if (!tree->open()) {
+            return false;
+        }
+    }
+
+    // Under the LSM engine the stripes keep empty tree indexes
+    std::vector<std::unique_ptr<Index>> rebuilt(stripeCount_);
+    for (size_t i = 0; i < stripeCount_; i++) {
+        rebuilt[i] = makeIndex(tree ? Engine::TREE : engine);
+        stripes_[i].valueBytes = 0;
+        stripes_[i].valueHeapBytes = 0;
+        stripes_[i].lsmKeys = 0;
+    }
+    auto place = [this, &tree, &rebuilt](const std::string& key, VersionedValue&& entry, uint64_t access) {
+        if (tree) {
+            tree->put(key, entry.value, entry.version);
+            return;
+        }
+        size_t index = stripeFor(key);
+        Slot* moved = rebuilt[index]->insert(key).first;
+        moved->entry = std::move(entry);
+        moved->access.store(access, std::memory_order_relaxed);
+        account(stripes_[index], moved->entry, true);
+    };
+    if (lsm_) {
+        // The keys now live elsewhere, so the old directory must not bring them back
+        lsm_->snapshot()->forEachWithPrefix("", [&place](const std::string& key, const std::string& value,
+                                                          long version) {
+            place(key, VersionedValue{value, version}, 0);
+            return true;
+        });
+        lsm_->clear();
+    } else {
+        for (size_t i = 0; i < stripeCount_; i++) {
+            stripes_[i].data->forEachAfter(nullptr, [&place](const std::string& key, Slot& slot) {
+                place(key, std::move(slot.entry), slot.access.load(std::memory_order_relaxed));
+                return true;
+            });
+        }
+    }
+    if (tree) {
+        // Count every key the tree holds, including any from runs already in its directory
+        tree->snapshot()->forEachWithPrefix("", [this](const std::string& key, const std::string&, long) {
+            stripes_[stripeFor(key)].lsmKeys++;
+            return true;
+        });
+    }
+
+    std::atomic_store(&lsm_, tree);
+    engine_ = engine;
+    for (size_t i = 0; i < stripeCount_; i++) {
+        stripes_[i].data = std::move(rebuilt[i]);
+        settle(stripes_[i]);
+    }
+    return true;
+}
+
+StripedStore::Engine StripedStore::getEngine() const {
+    return engine_.load();
+}
+
+bool StripedStore::flushEngine() {
+    std::shared_ptr<LsmTree> lsm = currentLsm();
+    return !lsm || lsm->quiesce();
+}
+
+void StripedStore::closeEngine() {
+    if (std::shared_ptr<LsmTree> lsm = currentLsm()) {
+        lsm->close();
+    }
+}
+
+bool StripedStore::getLsmStats(LsmTree::Stats& stats) const {
+    std::shared_ptr<LsmTree> lsm = currentLsm();
+    if (!lsm) {
+        return false;
+    }
+    stats = lsm->getStats();
+    return true;
+}
+
+bool StripedStore::getDurableVersion(long& version) const {
+    std::shared_ptr<LsmTree> lsm = currentLsm();
+    if (!lsm) {
+        return false;
+    }
+    version = lsm->getDurableVersion();
+    return true;
+}
+
+std::shared_ptr<LsmTree> StripedStore::currentLsm() const {
+    return std::atomic_load(&lsm_);
+}
+
+std::vector<std::pair<std::string, StripedStore::VersionedValue>> StripedStore::scanPrefix(
+        const std::string& prefix, size_t limit) const {
+    std::vector<std::pair<std::string, VersionedValue>> result;
+    if (std::shared_ptr<LsmTree> lsm = currentLsm()) {
+        lsm->snapshot(prefix)->forEachWithPrefix(prefix, [&](const std::string& key, const std::string& value,
+                                                             long version) {
+            result.emplace_back(key, VersionedValue{value, version});
+            return limit == 0 || result.size() < limit;
+        });
+        return result;
+    }
+
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(stripeCount_);
+    for (size_t i = 0; i < stripeCount_; i++) {
+        locks.emplace_back(stripes_[i].mutex);
+    }
+
+    // Each stripe yields a sorted run of at most limit keys; merge the runs in turn
+    for (size_t i = 0; i < stripeCount_; i++) {
+        size_t runStart = result.size();
+        stripes_[i].data->forEachWithPrefix(prefix, [&](const std::string& key, Slot& slot) {
+            result.emplace_back(key, slot.entry);
+            return limit == 0 || result.size() - runStart < limit;
+        });
+        std::inplace_merge(result.begin(), result.begin() + runStart, result.end(),
+                           [](const auto& a, const auto& b) { return a.first < b.first; });
+        if (limit > 0 && result.size() > limit) {
+            result.resize(limit);
+        }
+    }
+    return result;
+}
+
+std::map<std::string, std::string> StripedStore::copy() const {
+    std::map<std::string, std::string> result;
+    if (std::shared_ptr<LsmTree> lsm = currentLsm()) {
+        lsm->snapshot()->forEachWithPrefix("", [&result](const std::string& key, const std::string& value, long) {
+            result.emplace_hint(result.end(), key, value);
+            return true;
+        });
+        return result;
+    }
+
+    // Acquire in index order so concurrent copies cannot deadlock
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(stripeCount_);
+    for (size_t i = 0; i < stripeCount_; i++) {
+        locks.emplace_back(stripes_[i].mutex);
+    }
+
+    for (size_t i = 0; i < stripeCount_; i++) {
+        stripes_[i].data->forEachAfter(nullptr, [&result](const std::string& key, Slot& slot) {
+            result.emplace(key, slot.entry.value);
+            return true;
+        });
+    }
+    return result;
+}
+
+std::map<std::string, StripedStore::VersionedValue> StripedStore::copyVersioned() const {
+    std::map<std::string, VersionedValue> result;
+    if (std::shared_ptr<LsmTree> lsm = currentLsm()) {
+        lsm->snapshot()->forEachWithPrefix("", [&result](const std::string& key, const std::string& value,
+                                                         long version) {
+            result.emplace_hint(result.end(), key, VersionedValue{value, version});
+            return true;
+        });
+        return result;
+    }
+
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(stripeCount_);
+    for (size_t i = 0; i < stripeCount_; i++) {
+        locks.emplace_back(stripes_[i].mutex);
+    }
+
+    for (size_t i = 0; i < stripeCount_; i++) {
+        stripes_[i].data->forEachAfter(nullptr, [&result](const std::string& key, Slot& slot) {
+            result.emplace(key, slot.entry);
+            return true;
+        });
+    }
+    return result;
+}
+
+void StripedStore::account(Stripe& stripe, const VersionedValue& entry, bool adding) {
+    if (adding) {
+        stripe.valueBytes += entry.value.size();
+        stripe.valueHeapBytes += heapBytes(entry.value);
+    } else {
+        stripe.valueBytes -= entry.value.size();
+        stripe.valueHeapBytes -= heapBytes(entry.value);
+    }
+}
+
+void StripedStore::accountPast(Stripe& stripe, const PastValue& past, bool adding) {
+    size_t footprint = sizeof(PastValue) + heapBytes(past.value);
+    if (adding) {
+        stripe.historyBytes += footprint;
+    } else {
+        stripe.historyBytes -= footprint;
+    }
+}
+
+void StripedStore::settle(Stripe& stripe) {
+    // The index counts the values' string objects; their heap buffers are counted here
+    size_t footprint = stripe.data->getFootprint() + stripe.valueHeapBytes + stripe.historyBytes;
+    if (footprint >= stripe.footprint) {
+        footprint_ += footprint - stripe.footprint;
+    } else {
+        footprint_ -= stripe.footprint - footprint;
+    }
+    stripe.footprint = footprint;
+}
+
+StripedStore::MemoryUsage StripedStore::getMemoryUsage() const {
+    MemoryUsage usage;
+    for (size_t i = 0; i < stripeCount_; i++) {
+        const Stripe& stripe = stripes_[i];
+        std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+        size_t keyBytes = stripe.data->getKeyBytes();
+        usage.keyBytes += keyBytes;
+        usage.valueBytes += stripe.valueBytes;
+        usage.overheadBytes += stripe.footprint - keyBytes - stripe.valueBytes;
+        usage.entryCount += stripe.data->size() + stripe.lsmKeys;
+    }
+    if (std::shared_ptr<LsmTree> lsm = currentLsm()) {
+        usage.overheadBytes += lsm->getMemoryBytes();
+    }
+    return usage;
+}
+
+size_t StripedStore::getFootprint() const {
+    std::shared_ptr<LsmTree> lsm = currentLsm();
+    return footprint_.load() + (lsm ? lsm->getMemoryBytes() : 0);
+}
+
+void StripedStore::setEvictionPolicy(EvictionPolicy policy) {
+    evictionPolicy_ = policy;
+}
+
+void StripedStore::touch(const Slot& slot, bool created) const {
+    switch (evictionPolicy_.load(std::memory_order_relaxed)) {
+    case EvictionPolicy::NONE:
+        return;
+    case EvictionPolicy::LRU:
+        slot.access.store(clockMicros(), std::memory_order_relaxed);
+        return;
+    case EvictionPolicy::LFU: {
+        if (created) {
+            slot.access.store(kLfuInitialCount, std::memory_order_relaxed);
+            return;
+        }
+        // Morris-style counter: a count of c is raised with probability 1 / ((c - initial) * factor + 1)
+        uint64_t count = slot.access.load(std::memory_order_relaxed);
+        if (count >= kLfuMaxCount) {
+            return;
+        }
+        thread_local std::minstd_rand random(std::random_device{}());
+        double above = count > kLfuInitialCount ? static_cast<double>(count - kLfuInitialCount) : 0.0;
+        if (std::uniform_real_distribution<double>(0.0, 1.0)(random) * (above * kLfuLogFactor + 1) < 1.0) {
+            slot.access.store(count + 1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    }
+}
+
+bool StripedStore::sampleEvictionCandidate(size_t samples, std::string& key, long& version) {
+    EvictionPolicy policy = evictionPolicy_.load();
+    uint64_t now = clockMicros();
+    std::lock_guard<std::mutex> evictionLock(evictionMutex_);
+
+    bool found = false;
+    uint64_t bestScore = 0;  // Higher is evicted first
+    size_t emptyInARow = 0;
+    for (size_t taken = 0; taken < samples && emptyInARow < stripeCount_;) {
+        size_t index = nextSampleStripe_++ % stripeCount_;
+        const Stripe& stripe = stripes_[index];
+        std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+        if (stripe.data->size() == 0) {
+            emptyInARow++;
+            continue;
+        }
+        emptyInARow = 0;
+        taken++;
+
+        // Advance the hand to the next key, wrapping at the end of the stripe
+        std::string& hand = hands_[index];
+        Slot* sampled = nullptr;
+        auto first = [&hand, &sampled](const std::string& next, Slot& slot) {
+            hand = next;
+            sampled = &slot;
+            return false;
+        };
+        if (hand.empty() || stripe.data->forEachAfter(&hand, first)) {
+            stripe.data->forEachAfter(nullptr, first);
+        }
+
+        uint64_t access = sampled->access.load(std::memory_order_relaxed);
+        uint64_t score;
+        if (policy == EvictionPolicy::LFU) {
+            score = kLfuMaxCount - std::min(access, kLfuMaxCount);
+            if (access > 0) {
+                sampled->access.store(access - 1, std::memory_order_relaxed);
+            }
+        } else {
+            score = now > access ? now - access : 0;  // Idle time
+        }
+        if (!found || score > bestScore) {
+            found = true;
+            bestScore = score;
+            key = hand;
+            version = sampled->entry.version;
+        }
+    }
+    return found;
+}
+
+void StripedStore::preserve(Stripe& stripe, const std::string& key) {
+    if (stripe.preserved.count(key) != 0) {
+        return;
+    }
+    const Slot* slot = stripe.data->find(key);
+    if (slot == nullptr) {
+        stripe.preserved.emplace(key, std::nullopt);
+    } else {
+        stripe.preserved.emplace(key, slot->entry);
+    }
+}
+
+std::unique_ptr<StripedStore::Image> StripedStore::openImage() const {
+    if (imageOpen_.exchange(true)) {
+        return nullptr;
+    }
+    std::unique_ptr<Image> image(new Image(*this));
+    for (size_t i = 0; i < stripeCount_; i++) {
+        std::unique_lock<std::shared_mutex> writeLock(stripes_[i].mutex);
+        stripes_[i].imaged = true;
+        if (i == 0 && lsm_) {
+            image->lsmSnapshot_ = lsm_->snapshot();
+        }
+    }
+    return image;
+}
+
+StripedStore::Image::Image(const StripedStore& store) : store_(store) {
+}
+
+StripedStore::Image::~Image() {
+    for (size_t i = 0; i < store_.stripeCount_; i++) {
+        Stripe& stripe = store_.stripes_[i];
+        std::unique_lock<std::shared_mutex> writeLock(stripe.mutex);
+        stripe.imaged = false;
+        stripe.preserved.clear();
+    }
+    store_.imageOpen_ = false;
+}
+
+size_t StripedStore::Image::getPreservedCount() const {
+    size_t total = 0;
+    for (size_t i = 0; i < store_.stripeCount_; i++) {
+        std::shared_lock<std::shared_mutex> readLock(store_.stripes_[i].mutex);
+        total += store_.stripes_[i].preserved.size();
+    }
+    return total;
+}
+
+bool StripedStore::Image::forEach(
+        const std::function<bool(const std::string&, const VersionedValue&)>& visit) const {
+    if (lsmSnapshot_) {
+        return lsmSnapshot_->forEachWithPrefix("", [&visit](const std::string& key, const std::string& value,
+                                                            long version) {
+            return visit(key, VersionedValue{value, version});
+        });
+    }
+
+    // Each stripe is read a chunk at a time, resuming after the last key seen. A key changed
+    // between chunks was preserved first, so every chunk sees the image, not the live data.
+    struct Cursor {
+        std::vector<std::pair<std::string, VersionedValue>> chunk;
+        size_t next = 0;
+        std::string after;
+        bool started = false;
+        bool done = false;
+    };
+    auto fill = [this](size_t index, Cursor& cursor) {
+        const Stripe& stripe = store_.stripes_[index];
+        cursor.chunk.clear();
+        cursor.next = 0;
+        while (cursor.chunk.empty() && !cursor.done) {
+            std::shared_lock<std::shared_mutex> readLock(stripe.mutex);
+            std::string from = cursor.after;
+            auto kept = cursor.started ? stripe.preserved.upper_bound(from) : stripe.preserved.begin();
+            size_t steps = 0;
+            auto takeKept = [&]() {
+                if (kept->second) {
+                    cursor.chunk.emplace_back(kept->first, *kept->second);
+                }
+                cursor.after = kept->first;
+                cursor.started = true;
+                ++kept;
+                steps++;
+            };
+            // Walk the live keys, taking preserved states in key order in between;
+            // a preserved state stands in for the live key it shares
+            bool liveDone = stripe.data->forEachAfter(cursor.started ? &from : nullptr,
+                                                      [&](const std::string& key, Slot& slot) {
+                while (steps < kImageChunk && kept != stripe.preserved.end() && kept->first < key) {
+                    takeKept();
+                }
+                if (steps == kImageChunk) {
+                    return false;
+                }
+                if (kept != stripe.preserved.end() && kept->first == key) {
+                    takeKept();
+                } else {
+                    cursor.chunk.emplace_back(key, slot.entry);
+                    cursor.after = key;
+                    cursor.started = true;
+                    steps++;
+                }
+                return true;
+            });
+            while (liveDone && steps < kImageChunk && kept != stripe.preserved.end()) {
+                takeKept();
+            }
+            cursor.done = liveDone && kept == stripe.preserved.end();
+        }
+    };
+
+    // Stripes partition keys by hash, so merge their ordered streams
+    std::vector<Cursor> cursors(store_.stripeCount_);
+    auto later = [&cursors](size_t a, size_t b) {
+        return cursors[a].chunk[cursors[a].next].first > cursors[b].chunk[cursors[b].next].first;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heads(later);
+    for (size_t i = 0; i < cursors.size(); i++) {
+        fill(i, cursors[i]);
+        if (!cursors[i].chunk.empty()) {
+            heads.push(i);
+        }
+    }
+    while (!heads.empty()) {
+        size_t index = heads.top();
+        heads.pop();
+        Cursor& cursor = cursors[index];
+        const auto& [key, entry] = cursor.chunk[cursor.next];
+        if (!visit(key, entry)) {
+            return false;
+        }
+        if (++cursor.next == cursor.chunk.size()) {
+            fill(index, cursor);
+        }
+        if (cursor.next < cursor.chunk.size()) {
+            heads.push(index);
+        }
+    }
+    return true;
+}
+
+} // namespace storage
+} // namespace replication
@@ -0,0 +1,520 @@
+#ifndef STRIPED_STORE_H
+#define STRIPED_STORE_H
+
+#include "storage/LsmTree.h"
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Key-value map split into independently locked stripes.
+ *
+ * Each key hashes to exactly one stripe, and every single-key operation
+ * locks only that stripe, so readers and writers touching different keys
+ * never contend on the same mutex. Stripes are cache-line aligned to avoid
+ * false sharing between their lock words. Operations spanning all keys
+ * (copy, size, clear) lock every stripe in index order.
+ *
+ * While a reader holds an older version open (see setOldestReader()), a
+ * write or erase moves the value it replaces into a per-key history, so
+ * getAt() can still answer for that version. With a history horizon set,
+ * replaced values are also kept for that many versions after they were
+ * replaced, reader or not. History is pruned on the next write to the key
+ * once neither keeps it, and capped per key.
+ *
+ * An Image is an unbounded, copy-on-write picture of the whole store: once
+ * one is open, the first write, insert or erase of each key saves the key's
+ * previous state, so the image can be read out while writes carry on.
+ *
+ * The store keeps a running count of the bytes it holds, and with an
+ * eviction policy set it records accesses so a sampling clock hand can
+ * pick the key to evict next.
+ *
+ * Each stripe orders its keys with the selected engine: a red-black tree
+ * (std::map), or an adaptive radix tree that stores shared key prefixes
+ * once and so holds keys such as "tenant/123/user/..." in far less memory.
+ *
+ * Under the LSM engine the keys live in one LSM tree on disk instead, so
+ * the store can hold more than fits in memory. Stripe locks still order
+ * the operations on each key, and history stays in the stripes: a write
+ * reads the value it replaces first. Eviction never picks a key, since
+ * the keys are not held in memory.
+ */
+class StripedStore {
+public:
+    static constexpr size_t kDefaultStripeCount = 16;
+
+    /**
+     * A value and the version it was written at (the log ID of the write).
+     */
+    struct VersionedValue {
+        std::string value;
+        long version = 0;
+    };
+
+    /**
+     * Outcome of a lookup as of a past version.
+     */
+    enum class VersionLookup {
+        FOUND,      // The key held a value at that version
+        MISSING,    // The key did not exist at that version
+        DISCARDED   // The value it held has been dropped from the history
+    };
+
+    /**
+     * Which key an eviction sample picks.
+     */
+    enum class EvictionPolicy {
+        NONE,   // Accesses are not tracked
+        LRU,    // The key read or written least recently
+        LFU     // The key with the lowest logarithmic access count, aged as the hand passes
+    };
+
+    /**
+     * How each stripe orders its keys.
+     */
+    enum class Engine {
+        TREE,   // A red-black tree node per key, holding the whole key
+        RADIX,  // An adaptive radix tree; keys sharing a prefix store it once
+        LSM     // A log-structured merge tree on disk, for more data than fits in memory
+    };
+
+    /**
+     * Bytes held by the store. Keys and values count their characters
+     * (under the radix engine, the key characters actually stored);
+     * tree nodes, string objects and heap buffers, allocator rounding and
+     * kept history count as overhead. Under the LSM engine keys and values
+     * are on disk, and the memory the tree holds counts as overhead.
+     */
+    struct MemoryUsage {
+        size_t keyBytes = 0;
+        size_t valueBytes = 0;
+        size_t overheadBytes = 0;
+        size_t entryCount = 0;
+    };
+
+    static constexpr long kNoReader = -1;
+    static constexpr size_t kDefaultHistoryDepth = 16;
+
+    /**
+     * @param stripeCount the number of independently locked partitions
+     * @param engine how each stripe orders its keys
+     */
+    explicit StripedStore(size_t stripeCount = kDefaultStripeCount, Engine engine = Engine::TREE);
+
+    StripedStore(const StripedStore&) = delete;
+    StripedStore& operator=(const StripedStore&) = delete;
+
+    /**
+     * Looks up a key.
+     * @return true and sets value if the key is present
+     */
+    bool get(const std::string& key, std::string& value) const;
+
+    /**
+     * Looks up a key and the version it was last written at.
+     * @return true and sets value and version if the key is present
+     */
+    bool get(const std::string& key, std::string& value, long& version) const;
+
+    bool contains(const std::string& key) const;
+
+    /**
+     * Inserts or overwrites a key.
+     * @param version the version the value is written at
+     */
+    void put(const std::string& key, const std::string& value, long version = 0);
+
+    /**
+     * Inserts or overwrites many keys at one version, locking each stripe
+     * once for all of its keys rather than once per key.
+     * @return the number of keys written
+     */
+    size_t putMany(const std::vector<std::pair<std::string, std::string>>& pairs, long version);
+
+    /**
+     * Groups pairs by the stripe their key maps to, hashing each key once.
+     * @return for every stripe, the positions of its pairs in order
+     */
+    std::vector<std::vector<size_t>> groupByStripe(
+        const std::vector<std::pair<std::string, std::string>>& pairs) const;
+
+    /**
+     * Like putMany(), over pairs already grouped by groupByStripe(), so
+     * callers can split the work by stripe: only the stripes whose index
+     * modulo partitions equals partition are written.
+     * @return the number of keys written
+     */
+    size_t putMany(const std::vector<std::pair<std::string, std::string>>& pairs,
+                   const std::vector<std::vector<size_t>>& byStripe, long version,
+                   size_t partition = 0, size_t partitions = 1);
+
+    /**
+     * Inserts a key only if it is absent.
+     * @param version the version the value is written at
+     * @return true if the key was inserted
+     */
+    bool putIfAbsent(const std::string& key, const std::string& value, long version = 0);
+
+    /**
+     * Removes a key.
+     * @param version the version the key is removed at; 0 keeps no history
+     * @return true if the key was present
+     */
+    bool erase(const std::string& key, long version = 0);
+
+    /**
+     * Looks up a key as it was at a version.
+     * @param version a version no older than the oldest reader
+     * @return FOUND and sets value if the key held one at that version
+     */
+    VersionLookup getAt(const std::string& key, long version, std::string& value) const;
+
+    /**
+     * Sets the oldest version any reader may still look up with getAt().
+     * Values replaced after this call are kept while a reader can see them;
+     * kNoReader stops keeping history.
+     */
+    void setOldestReader(long version);
+
+    /**
+     * Sets how many replaced values are kept per key at most.
+     */
+    void setHistoryDepth(size_t depth);
+
+    /**
+     * Keeps each replaced value until the store has moved this many
+     * versions past the write that replaced it, whether or not a reader is
+     * set. 0 (the default) keeps history only for the oldest reader.
+     */
+    void setHistoryHorizon(long versions);
+
+    /**
+     * Drops every kept replaced value.
+     */
+    void clearHistory();
+
+    void clear();
+    size_t size() const;
+
+    /**
+     * Moves every key into stripes ordered by the given engine. All
+     * stripes are held while the keys move. An LSM tree opened on a
+     * directory that already holds runs keeps their keys too; leaving the
+     * LSM engine empties its directory.
+     * @param lsm where and how the LSM engine keeps its runs
+     * @return false if the LSM tree could not be opened; the engine is unchanged
+     */
+    bool setEngine(Engine engine, const LsmConfig& lsm = LsmConfig());
+
+    Engine getEngine() const;
+
+    /**
+     * Flushes the LSM engine's memtables and waits for its compactions.
+     * @return false if the tree failed to write a run; true under other engines
+     */
+    bool flushEngine();
+
+    /**
+     * Flushes the LSM engine's memtables and stops its background thread.
+     * The store stays readable; later writes are kept in memory only.
+     * Does nothing under other engines.
+     */
+    void closeEngine();
+
+    /**
+     * Gets the LSM engine's run and cache statistics.
+     * @return false under other engines
+     */
+    bool getLsmStats(LsmTree::Stats& stats) const;
+
+    /**
+     * Gets the version up to which the LSM engine holds every write in runs.
+     * @return false under other engines
+     */
+    bool getDurableVersion(long& version) const;
+
+    /**
+     * Gets every key starting with a prefix, in ascending key order. All
+     * stripes are held at once, like copy(), and each is searched by the
+     * prefix rather than scanned.
+     * @param limit the most keys to return; 0 returns them all
+     */
+    std::vector<std::pair<std::string, VersionedValue>> scanPrefix(const std::string& prefix,
+                                                                   size_t limit = 0) const;
+
+    /**
+     * Gets the bytes held by the store, broken down. Locks one stripe at a time.
+     */
+    MemoryUsage getMemoryUsage() const;
+
+    /**
+     * Gets the total bytes held by the store without taking any lock.
+     */
+    size_t getFootprint() const;
+
+    /**
+     * Sets which accesses are recorded for eviction. Keys not accessed
+     * since count as the oldest and least used.
+     */
+    void setEvictionPolicy(EvictionPolicy policy);
+
+    /**
+     * Samples keys under a clock hand per stripe, advancing round-robin over
+     * the stripes, and picks the one the eviction policy ranks first. Under
+     * LFU every sampled key ages by one count.
+     * @param samples how many keys to compare
+     * @return true and sets key and the version it holds, false if the store is empty
+     */
+    bool sampleEvictionCandidate(size_t samples, std::string& key, long& version);
+
+    /**
+     * A point-in-time image of the store. Opening it costs one lock per
+     * stripe; afterwards each key is copied at most once, when it is first
+     * changed, and reading the image holds a stripe only for a chunk of keys
+     * at a time. Closed when destroyed; must not outlive the store.
+     */
+    class Image {
+    public:
+        ~Image();
+
+        Image(const Image&) = delete;
+        Image& operator=(const Image&) = delete;
+
+        /**
+         * Visits every key of the image in ascending key order.
+         * @param visit returns false to stop early
+         * @return false if visit stopped early
+         */
+        bool forEach(const std::function<bool(const std::string&, const VersionedValue&)>& visit) const;
+
+        /**
+         * Gets how many keys have been copied aside since the image was opened.
+         */
+        size_t getPreservedCount() const;
+
+    private:
+        friend class StripedStore;
+        explicit Image(const StripedStore& store);
+
+        const StripedStore& store_;
+        std::shared_ptr<const LsmTree::Snapshot> lsmSnapshot_;  // Under the LSM engine
+    };
+
+    /**
+     * Opens an image of the store as it is now. The caller must keep writes
+     * out while it opens, or the image is not a consistent cut.
+     * @return the image, or null if another image is already open
+     */
+    std::unique_ptr<Image> openImage() const;
+
+    /**
+     * Copies the whole store. All stripes are held at once, so the copy is a
+     * consistent cut with respect to single-key operations.
+     */
+    std::map<std::string, std::string> copy() const;
+
+    /**
+     * Copies the whole store with the version of every key.
+     */
+    std::map<std::string, VersionedValue> copyVersioned() const;
+
+    size_t stripeFor(const std::string& key) const;
+    size_t getStripeCount() const;
+
+private:
+    /**
+     * A replaced value, which the key held for versions [version, replacedAt).
+     */
+    struct PastValue {
+        std::string value;
+        long version;
+        long replacedAt;
+    };
+
+    /**
+     * Replaced values of one key, oldest first. Lookups older than
+     * discardedBefore that miss may have needed a dropped value.
+     */
+    struct History {
+        std::deque<PastValue> values;
+        long discardedBefore = 0;
+    };
+
+    /**
+     * A live value and its access record (the last access time in
+     * microseconds under LRU, the logarithmic count under LFU).
+     */
+    struct Slot {
+        VersionedValue entry;
+        mutable std::atomic<uint64_t> access{0};
+
+        Slot() = default;
+        explicit Slot(VersionedValue value) : entry(std::move(value)) {}
+    };
+
+    /**
+     * The ordered keys of one stripe, laid out by an engine. Callers hold
+     * the stripe's lock.
+     */
+    class Index {
+    public:
+        using Visitor = std::function<bool(const std::string&, Slot&)>;
+
+        virtual ~Index() = default;
+
+        /**
+         * @return the key's slot, or null if the key is absent
+         */
+        virtual Slot* find(const std::string& key) const = 0;
+
+        /**
+         * Inserts an empty slot for a key if it is absent.
+         * @return the key's slot, and true if it was inserted
+         */
+        virtual std::pair<Slot*, bool> insert(const std::string& key) = 0;
+
+        virtual bool erase(const std::string& key) = 0;
+        virtual void clear() = 0;
+        virtual size_t size() const = 0;
+
+        /**
+         * Visits the keys greater than a bound (every key if null) in ascending order.
+         * @return false if visit stopped early
+         */
+        virtual bool forEachAfter(const std::string* after, const Visitor& visit) const = 0;
+
+        /**
+         * Visits the keys starting with a prefix in ascending order.
+         * @return false if visit stopped early
+         */
+        virtual bool forEachWithPrefix(const std::string& prefix, const Visitor& visit) const = 0;
+
+        /**
+         * Gets the bytes of the index with its keys and slots, but not the
+         * heap buffers of the values.
+         */
+        virtual size_t getFootprint() const = 0;
+
+        /**
+         * Gets the key characters the index stores.
+         */
+        virtual size_t getKeyBytes() const = 0;
+    };
+
+    class TreeIndex;
+    class RadixIndex;
+
+    static std::unique_ptr<Index> makeIndex(Engine engine);
+
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex mutex;
+        std::unique_ptr<Index> data;
+        std::unordered_map<std::string, History> history;
+
+        // Characters and heap buffers of the live values, bytes of history,
+        // and everything the stripe held when last added to footprint_
+        size_t valueBytes = 0;
+        size_t valueHeapBytes = 0;
+        size_t historyBytes = 0;
+        size_t footprint = 0;
+
+        // Keys of the stripe held by the LSM engine
+        size_t lsmKeys = 0;
+
+        // While an image is open: each changed key's state when the image
+        // was opened (empty if it did not exist then)
+        bool imaged = false;
+        std::map<std::string, std::optional<VersionedValue>> preserved;
+    };
+
+    /**
+     * Saves a key's state for the open image before its first change.
+     * Caller must hold the stripe exclusively.
+     */
+    void preserve(Stripe& stripe, const std::string& key);
+
+    /**
+     * Inserts or overwrites a key. Caller must hold the stripe exclusively.
+     */
+    void putLocked(Stripe& stripe, const std::string& key, const std::string& value, long version);
+
+    /**
+     * Writes or erases (value null) a key in the LSM tree, keeping the value
+     * it replaces for readers. Caller must hold the stripe exclusively.
+     * @return true if the key was present
+     */
+    bool writeLsm(Stripe& stripe, const std::string& key, const std::string* value, long version);
+
+    /**
+     * Gets the LSM tree without holding a stripe lock, or null under other engines.
+     */
+    std::shared_ptr<LsmTree> currentLsm() const;
+
+    /**
+     * Keeps a value replaced at the given version if a reader may need it.
+     * Caller must hold the stripe exclusively.
+     */
+    void retain(Stripe& stripe, const std::string& key, VersionedValue&& replaced, long replacedAt);
+
+    /**
+     * Checks whether a replaced value is kept at all: a reader is set or a
+     * history horizon is.
+     */
+    bool keepsHistory() const;
+
+    /**
+     * Adds or removes the bytes of a live value. Caller must hold the stripe exclusively.
+     */
+    void account(Stripe& stripe, const VersionedValue& entry, bool adding);
+
+    /**
+     * Adds or removes the bytes of a kept value. Caller must hold the stripe exclusively.
+     */
+    void accountPast(Stripe& stripe, const PastValue& past, bool adding);
+
+    /**
+     * Brings footprint_ up to date with a changed stripe. Caller must hold the stripe exclusively.
+     */
+    void settle(Stripe& stripe);
+
+    /**
+     * Records an access to a slot under the current eviction policy.
+     */
+    void touch(const Slot& slot, bool created) const;
+
+    size_t stripeCount_;
+    std::atomic<Engine> engine_;
+    std::unique_ptr<Stripe[]> stripes_;
+    std::shared_ptr<LsmTree> lsm_;  // Replaced under every stripe lock, with std::atomic_store
+    std::atomic<long> oldestReader_;
+    std::atomic<size_t> historyDepth_;
+    std::atomic<long> historyHorizon_;
+    mutable std::atomic<bool> imageOpen_;
+    std::atomic<size_t> footprint_;
+    std::atomic<EvictionPolicy> evictionPolicy_;
+
+    // Clock hand of each stripe (the last key sampled) and the next stripe to sample
+    std::mutex evictionMutex_;
+    std::vector<std::string> hands_;
+    size_t nextSampleStripe_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // STRIPED_STORE_H
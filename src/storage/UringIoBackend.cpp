@@ -0,0 +1,418 @@
+#include "storage/UringIoBackend.h"
+
+#ifdef REPLICATION_HAVE_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr unsigned kRingEntries = 64;
+// The lower half of user_data holds the slice index, or this for the fsync
+constexpr uint64_t kSyncSlot = 0xffffffffULL;
+constexpr uint64_t kSlotMask = 0xffffffffULL;
+// Lower half of the user_data of the cancel requests a call issues
+constexpr uint64_t kCancelSlot = 0xfffffffeULL;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags,
+                                      nullptr, 0));
+}
+
+int ioUringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+template<class T>
+T* offsetPointer(void* base, uint32_t offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+} // namespace
+
+std::unique_ptr<UringIoBackend> UringIoBackend::tryCreate(size_t bufferCount, size_t bufferSize) {
+    std::unique_ptr<UringIoBackend> backend(new UringIoBackend(bufferCount, bufferSize));
+    if (!backend->setup(kRingEntries)) {
+        return nullptr;
+    }
+    return backend;
+}
+
+UringIoBackend::UringIoBackend(size_t bufferCount, size_t bufferSize)
+    : IoBackend(bufferCount, bufferSize),
+      ringFd_(-1),
+      entries_(0),
+      buffersRegistered_(false),
+      broken_(false),
+      sqRing_(nullptr),
+      sqRingSize_(0),
+      sqHead_(nullptr),
+      sqTail_(nullptr),
+      sqMask_(nullptr),
+      sqArray_(nullptr),
+      sqes_(nullptr),
+      sqesSize_(0),
+      pendingSubmissions_(0),
+      generation_(0),
+      cqRing_(nullptr),
+      cqRingSize_(0),
+      cqHead_(nullptr),
+      cqTail_(nullptr),
+      cqMask_(nullptr),
+      cqes_(nullptr) {
+}
+
+UringIoBackend::~UringIoBackend() {
+    if (sqes_ != nullptr) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_) {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if (sqRing_ != nullptr) {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if (ringFd_ >= 0) {
+        ::close(ringFd_);
+    }
+}
+
+bool UringIoBackend::setup(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd_ = ioUringSetup(entries, &params);
+    if (ringFd_ < 0) {
+        return false;
+    }
+    entries_ = params.sq_entries;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        return false;
+    }
+    if (singleMmap) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            return false;
+        }
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sqHead_ = offsetPointer<unsigned>(sqRing_, params.sq_off.head);
+    sqTail_ = offsetPointer<unsigned>(sqRing_, params.sq_off.tail);
+    sqMask_ = offsetPointer<unsigned>(sqRing_, params.sq_off.ring_mask);
+    sqArray_ = offsetPointer<unsigned>(sqRing_, params.sq_off.array);
+    cqHead_ = offsetPointer<unsigned>(cqRing_, params.cq_off.head);
+    cqTail_ = offsetPointer<unsigned>(cqRing_, params.cq_off.tail);
+    cqMask_ = offsetPointer<unsigned>(cqRing_, params.cq_off.ring_mask);
+    cqes_ = offsetPointer<io_uring_cqe>(cqRing_, params.cq_off.cqes);
+
+    // Registering pins the staging buffers once; without it (e.g. a low
+    // RLIMIT_MEMLOCK) we still use io_uring but with plain writes.
+    std::vector<iovec> iovecs;
+    for (char* buffer : buffers_) {
+        iovecs.push_back({buffer, bufferSize_});
+    }
+    buffersRegistered_ = !iovecs.empty() &&
+        ioUringRegister(ringFd_, IORING_REGISTER_BUFFERS, iovecs.data(),
+                        static_cast<unsigned>(iovecs.size())) == 0;
+    return true;
+}
+
+std::string UringIoBackend::getName() const {
+    return buffersRegistered_ ? "io_uring" : "io_uring(unregistered)";
+}
+
+io_uring_sqe* UringIoBackend::nextSqe() {
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail_;
+    if (tail - head >= entries_) {
+        return nullptr;
+    }
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    pendingSubmissions_++;
+    return sqe;
+}
+
+bool UringIoBackend::submitAndWait(unsigned toSubmit, unsigned waitFor) {
+    while (true) {
+        int result = ioUringEnter(ringFd_, toSubmit, waitFor, IORING_ENTER_GETEVENTS);
+        if (result >= 0) {
+            pendingSubmissions_ -= std::min(pendingSubmissions_, static_cast<unsigned>(result));
+            return true;
+        }
+        if (errno != EINTR && errno != EAGAIN) {
+            return false;
+        }
+    }
+}
+
+bool UringIoBackend::reapCompletion(uint64_t& userData, int& result) {
+    unsigned head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    const io_uring_cqe& cqe = cqes_[head & *cqMask_];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void UringIoBackend::discardUnsubmitted() {
+    // Without SQPOLL the kernel only consumes entries inside io_uring_enter,
+    // so whatever lies between head and tail can still be withdrawn.
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    __atomic_store_n(sqTail_, head, __ATOMIC_RELEASE);
+    pendingSubmissions_ = 0;
+}
+
+bool UringIoBackend::cancelInFlight(const std::vector<uint64_t>& targets, unsigned outstanding) {
+    uint64_t generation = targets.front() & ~kSlotMask;
+    unsigned cancels = 0;
+    for (uint64_t target : targets) {
+        io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr) {
+            break;
+        }
+        // Completed targets just answer -ENOENT
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = target;
+        sqe->user_data = generation | kCancelSlot;
+        cancels++;
+    }
+
+    unsigned remaining = outstanding + cancels;
+    while (remaining > 0) {
+        uint64_t userData = 0;
+        int result = 0;
+        if (!reapCompletion(userData, result)) {
+            if (!submitAndWait(pendingSubmissions_, 1)) {
+                broken_ = true;
+                std::cerr << "io_uring: lost track of in-flight operations (" << std::strerror(errno)
+                          << "), disabling the backend" << std::endl;
+                return false;
+            }
+            continue;
+        }
+        if ((userData & ~kSlotMask) == generation) {
+            remaining--;
+        }
+    }
+    return true;
+}
+
+uint64_t UringIoBackend::nextGeneration() {
+    generation_ = (generation_ + 1) & kSlotMask;
+    return generation_ << 32;
+}
+
+bool UringIoBackend::writeAndSync(int fd, uint64_t offset, const std::vector<IoSlice>& slices,
+                                  bool sync) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (broken_) {
+        errno = EIO;
+        return false;
+    }
+
+    // Leave room for the trailing fsync in the same chain
+    if (slices.size() + 1 > entries_) {
+        return writeWithPosix(fd, offset, slices, sync);
+    }
+
+    uint64_t generation = nextGeneration();
+    uint64_t position = offset;
+    for (size_t i = 0; i < slices.size(); i++) {
+        const IoSlice& slice = slices[i];
+        io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr) {
+            discardUnsubmitted();
+            return writeWithPosix(fd, offset, slices, sync);
+        }
+        bool fixed = buffersRegistered_ && slice.bufferIndex >= 0;
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = fd;
+        sqe->off = position;
+        sqe->addr = reinterpret_cast<uint64_t>(slice.data);
+        sqe->len = static_cast<uint32_t>(slice.length);
+        if (fixed) {
+            sqe->buf_index = static_cast<uint16_t>(slice.bufferIndex);
+        }
+        sqe->user_data = generation | i;
+        if (sync || i + 1 < slices.size()) {
+            sqe->flags |= IOSQE_IO_LINK;
+        }
+        position += slice.length;
+    }
+    if (sync) {
+        io_uring_sqe* sqe = nextSqe();
+        if (sqe == nullptr) {
+            discardUnsubmitted();
+            return writeWithPosix(fd, offset, slices, sync);
+        }
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = generation | kSyncSlot;
+    }
+
+    unsigned expected = static_cast<unsigned>(slices.size()) + (sync ? 1 : 0);
+    if (!submitAndWait(pendingSubmissions_, expected)) {
+        discardUnsubmitted();
+        return writeWithPosix(fd, offset, slices, sync);
+    }
+
+    bool complete = true;
+    unsigned reaped = 0;
+    while (reaped < expected) {
+        uint64_t userData = 0;
+        int result = 0;
+        if (!reapCompletion(userData, result)) {
+            if (!submitAndWait(pendingSubmissions_, 1)) {
+                // The kernel may still read the slices; settle that before replaying them
+                std::vector<uint64_t> targets;
+                for (size_t i = 0; i < slices.size(); i++) {
+                    targets.push_back(generation | i);
+                }
+                if (sync) {
+                    targets.push_back(generation | kSyncSlot);
+                }
+                if (!cancelInFlight(targets, expected - reaped)) {
+                    errno = EIO;
+                    return false;
+                }
+                return writeWithPosix(fd, offset, slices, sync);
+            }
+            continue;
+        }
+        if ((userData & ~kSlotMask) != generation) {
+            // Left behind by an earlier call that gave up on the ring
+            continue;
+        }
+        reaped++;
+        uint64_t slot = userData & kSlotMask;
+        if (slot == kSyncSlot) {
+            complete = complete && result == 0;
+        } else if (result < 0 || static_cast<size_t>(result) != slices[slot].length) {
+            complete = false;
+        }
+    }
+
+    // Short writes cancel the rest of the chain; replaying the whole batch is
+    // idempotent because every slice targets a fixed offset.
+    return complete || writeWithPosix(fd, offset, slices, sync);
+}
+
+ssize_t UringIoBackend::readAt(int fd, uint64_t offset, char* out, size_t length) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (broken_) {
+        errno = EIO;
+        return -1;
+    }
+
+    io_uring_sqe* sqe = nextSqe();
+    if (sqe == nullptr) {
+        discardUnsubmitted();
+        return ::pread(fd, out, length, static_cast<off_t>(offset));
+    }
+    uint64_t generation = nextGeneration();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<uint64_t>(out);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->user_data = generation;
+
+    uint64_t userData = 0;
+    int result = 0;
+    if (!submitAndWait(pendingSubmissions_, 1)) {
+        discardUnsubmitted();
+        return ::pread(fd, out, length, static_cast<off_t>(offset));
+    }
+    do {
+        while (!reapCompletion(userData, result)) {
+            if (!submitAndWait(pendingSubmissions_, 1)) {
+                // The kernel may still fill out; only read into it once the read is settled
+                if (!cancelInFlight({generation}, 1)) {
+                    errno = EIO;
+                    return -1;
+                }
+                return ::pread(fd, out, length, static_cast<off_t>(offset));
+            }
+        }
+    } while ((userData & ~kSlotMask) != generation);
+    if (result == -EINVAL || result == -EOPNOTSUPP) {
+        // Kernel predates IORING_OP_READ
+        return ::pread(fd, out, length, static_cast<off_t>(offset));
+    }
+    if (result < 0) {
+        errno = -result;
+        return -1;
+    }
+    return result;
+}
+
+bool UringIoBackend::writeWithPosix(int fd, uint64_t offset, const std::vector<IoSlice>& slices,
+                                    bool sync) {
+    for (const auto& slice : slices) {
+        size_t written = 0;
+        while (written < slice.length) {
+            ssize_t result = ::pwrite(fd, slice.data + written, slice.length - written,
+                                      static_cast<off_t>(offset + written));
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<size_t>(result);
+        }
+        offset += slice.length;
+    }
+    return !sync || ::fdatasync(fd) == 0;
+}
+
+} // namespace storage
+} // namespace replication
+
+#endif // REPLICATION_HAVE_IO_URING
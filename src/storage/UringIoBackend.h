@@ -0,0 +1,113 @@
+#ifndef URING_IO_BACKEND_H
+#define URING_IO_BACKEND_H
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define REPLICATION_HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef REPLICATION_HAVE_IO_URING
+
+#include "storage/IoBackend.h"
+
+#include <mutex>
+#include <memory>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace replication {
+namespace storage {
+
+/**
+ * io_uring implementation of IoBackend, talking to the kernel through the
+ * raw system calls so no liburing dependency is required.
+ *
+ * The staging buffers are registered once at setup, so writes from them are
+ * issued as IORING_OP_WRITE_FIXED. A flush submits every slice plus the
+ * trailing fdatasync as one linked chain with a single io_uring_enter call.
+ * If the kernel rejects an operation or a write comes back short, the batch
+ * is replayed with pwrite/fdatasync so callers never observe the difference.
+ *
+ * Every call tags its operations with a fresh generation number, so
+ * completions left behind by an earlier call (such as those of its cancel
+ * requests) are skipped rather than mistaken for those of a later call.
+ *
+ * A call never returns while the kernel may still touch its buffers. If
+ * waiting fails after submission, the call cancels its operations and
+ * waits for every completion before falling back. If even that fails, the
+ * ring is marked broken and the call and every later one fail outright,
+ * since a stale write could still land from a reused staging buffer.
+ */
+class UringIoBackend : public IoBackend {
+public:
+    /**
+     * Creates the ring, or returns nullptr if the kernel does not allow it
+     * (old kernel, seccomp filter, ...).
+     */
+    static std::unique_ptr<UringIoBackend> tryCreate(size_t bufferCount, size_t bufferSize);
+
+    ~UringIoBackend() override;
+
+    std::string getName() const override;
+    bool writeAndSync(int fd, uint64_t offset, const std::vector<IoSlice>& slices,
+                      bool sync) override;
+    ssize_t readAt(int fd, uint64_t offset, char* out, size_t length) override;
+
+private:
+    UringIoBackend(size_t bufferCount, size_t bufferSize);
+
+    bool setup(unsigned entries);
+    io_uring_sqe* nextSqe();
+    bool submitAndWait(unsigned toSubmit, unsigned waitFor);
+    bool reapCompletion(uint64_t& userData, int& result);
+    void discardUnsubmitted();
+
+    /**
+     * Cancels the current call's operations and waits for their outstanding
+     * completions. Marks the ring broken if they cannot all be reaped.
+     * @param targets the user_data of every operation the call submitted
+     * @param outstanding how many of their completions are still due
+     * @return true once none of them is in flight
+     */
+    bool cancelInFlight(const std::vector<uint64_t>& targets, unsigned outstanding);
+
+    uint64_t nextGeneration();
+    bool writeWithPosix(int fd, uint64_t offset, const std::vector<IoSlice>& slices, bool sync);
+
+    int ringFd_;
+    unsigned entries_;
+    bool buffersRegistered_;
+    bool broken_;
+
+    // Submission queue
+    void* sqRing_;
+    size_t sqRingSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+    unsigned pendingSubmissions_;
+    // Upper half of the user_data of every operation queued by the current call
+    uint64_t generation_;
+
+    // Completion queue
+    void* cqRing_;
+    size_t cqRingSize_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    std::mutex mutex_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // REPLICATION_HAVE_IO_URING
+
+#endif // URING_IO_BACKEND_H
@@ -0,0 +1,473 @@
+#include "storage/WriteAheadLog.h"
+#include "storage/LogCodec.h"
+
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <optional>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace replication {
+namespace storage {
+
+namespace {
+
+constexpr const char* kSegmentPrefix = "wal-";
+constexpr const char* kSegmentSuffix = ".log";
+constexpr const char* kDictionaryFile = "wal.dict";
+constexpr size_t kReadChunkSize = 1024 * 1024;
+
+/**
+ * Decodes a segment file record by record, expanding batch frames.
+ * @param backend the backend used for reads
+ * @param codec decodes batch frames
+ * @param path the segment path
+ * @param visitor called for every intact entry
+ * @param validLength receives the length of the intact prefix
+ * @return false if the file could not be read
+ */
+bool scanSegment(IoBackend& backend, const LogBatchCodec& codec, const std::string& path,
+                 const std::function<void(model::LogEntry&&)>& visitor, uint64_t& validLength) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    std::string pending;
+    std::vector<char> chunk(kReadChunkSize);
+    uint64_t fileOffset = 0;
+    validLength = 0;
+    bool ok = true;
+
+    while (true) {
+        ssize_t bytesRead = backend.readAt(fd, fileOffset, chunk.data(), chunk.size());
+        if (bytesRead < 0) {
+            ok = false;
+            break;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        fileOffset += static_cast<uint64_t>(bytesRead);
+        pending.append(chunk.data(), static_cast<size_t>(bytesRead));
+
+        size_t position = 0;
+        bool corrupt = false;
+        while (position < pending.size()) {
+            size_t consumed = 0;
+            const char* data = pending.data() + position;
+            size_t available = pending.size() - position;
+            LogCodec::Status status;
+            if (available >= 4 && LogBatchCodec::isFrame(data)) {
+                std::vector<model::LogEntry> entries;
+                status = codec.decode(data, available, consumed, entries);
+                for (auto& entry : entries) {
+                    visitor(std::move(entry));
+                }
+            } else {
+                std::optional<model::LogEntry> entry;
+                status = LogCodec::decode(data, available, consumed, entry);
+                if (status == LogCodec::Status::COMPLETE) {
+                    visitor(std::move(*entry));
+                }
+            }
+            if (status == LogCodec::Status::INCOMPLETE) {
+                break;
+            }
+            if (status == LogCodec::Status::CORRUPT) {
+                corrupt = true;
+                break;
+            }
+            position += consumed;
+            validLength += consumed;
+        }
+        pending.erase(0, position);
+        if (corrupt) {
+            break;
+        }
+    }
+
+    ::close(fd);
+    return ok;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const WalConfig& config)
+    : config_(config),
+      open_(false),
+      stopping_(false),
+      failed_(false),
+      segmentFd_(-1),
+      segmentOffset_(0),
+      lastIndex_(0),
+      durableIndex_(0),
+      syncCount_(0) {
+    config_.bufferCount = std::max<size_t>(2, config_.bufferCount);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+bool WriteAheadLog::open() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_) {
+        return true;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(config_.directory, error);
+    if (error) {
+        std::cerr << "WAL could not create directory " << config_.directory << ": "
+                  << error.message() << std::endl;
+        return false;
+    }
+
+    backend_ = IoBackend::create(config_.backend, config_.bufferCount, config_.bufferSize);
+    if (!loadDictionary()) {
+        return false;
+    }
+    batchCodec_ = std::make_unique<LogBatchCodec>(config_.compression, config_.dictionary);
+
+    // Find the last intact entry, dropping a torn tail left by a crash
+    auto segments = listSegments();
+    long lastIndex = 0;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        uint64_t validLength = 0;
+        long segmentLast = it->firstIndex - 1;
+        scanSegment(*backend_, *batchCodec_, it->path,
+                    [&segmentLast](model::LogEntry&& entry) { segmentLast = entry.getId(); },
+                    validLength);
+
+        if (it == segments.rbegin()) {
+            segmentFd_ = ::open(it->path.c_str(), O_WRONLY);
+            if (segmentFd_ < 0 || ::ftruncate(segmentFd_, static_cast<off_t>(validLength)) != 0) {
+                std::cerr << "WAL could not reopen segment " << it->path << std::endl;
+                return false;
+            }
+            segmentOffset_ = validLength;
+        }
+        if (segmentLast >= it->firstIndex || it->firstIndex == 1) {
+            lastIndex = segmentLast;
+            break;
+        }
+    }
+    lastIndex_ = lastIndex;
+    durableIndex_ = lastIndex;
+
+    active_ = Batch{};
+    active_.bufferIndex = 0;
+    freeBuffers_.clear();
+    for (size_t i = backend_->getBufferCount(); i > 1; i--) {
+        freeBuffers_.push_back(static_cast<int>(i - 1));
+    }
+    sealed_.clear();
+    stopping_ = false;
+    failed_ = false;
+    open_ = true;
+    flusher_ = std::thread(&WriteAheadLog::flusherThread, this);
+
+    std::cout << "WAL opened at " << config_.directory << " using " << backend_->getName()
+              << " backend (last index " << lastIndex << ")" << std::endl;
+    return true;
+}
+
+void WriteAheadLog::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    flushCv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segmentFd_ >= 0) {
+        ::close(segmentFd_);
+        segmentFd_ = -1;
+    }
+    open_ = false;
+    spaceCv_.notify_all();
+    durableCv_.notify_all();
+}
+
+bool WriteAheadLog::append(const model::LogEntry& entry) {
+    size_t size = LogCodec::encodedSize(entry);
+    auto hasFreeBuffer = [this] { return failed_ || !freeBuffers_.empty(); };
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!open_ || stopping_ || failed_) {
+        return false;
+    }
+
+    if (config_.compression != CompressionType::NONE) {
+        // Keep the entry; the flusher encodes the whole batch as one frame
+        if (active_.used > 0 && active_.used + size > backend_->getBufferSize()) {
+            spaceCv_.wait(lock, hasFreeBuffer);
+            if (failed_) {
+                return false;
+            }
+            sealActive();
+        }
+        if (active_.used == 0) {
+            active_.firstIndex = entry.getId();
+        }
+        active_.entries.push_back(entry);
+        active_.used += size;
+        active_.lastIndex = entry.getId();
+    } else if (size > backend_->getBufferSize()) {
+        // Oversized record: flush it from its own allocation, after whatever
+        // is already staged so ordering is preserved
+        if (active_.used > 0) {
+            spaceCv_.wait(lock, hasFreeBuffer);
+            if (failed_) {
+                return false;
+            }
+            sealActive();
+        }
+        Batch oversized;
+        oversized.used = size;
+        oversized.firstIndex = oversized.lastIndex = entry.getId();
+        oversized.overflow.resize(size);
+        LogCodec::encodeTo(entry, &oversized.overflow[0]);
+        sealed_.push_back(std::move(oversized));
+    } else {
+        if (active_.used + size > backend_->getBufferSize()) {
+            spaceCv_.wait(lock, hasFreeBuffer);
+            if (failed_) {
+                return false;
+            }
+            sealActive();
+        }
+        if (active_.used == 0) {
+            active_.firstIndex = entry.getId();
+        }
+        LogCodec::encodeTo(entry, backend_->getBuffer(active_.bufferIndex) + active_.used);
+        active_.used += size;
+        active_.lastIndex = entry.getId();
+    }
+
+    lastIndex_ = entry.getId();
+    lock.unlock();
+    flushCv_.notify_one();
+    return true;
+}
+
+bool WriteAheadLog::waitForDurable(long index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    durableCv_.wait(lock, [this, index] {
+        return durableIndex_.load() >= index || failed_ || !open_;
+    });
+    return durableIndex_.load() >= index;
+}
+
+bool WriteAheadLog::flush() {
+    return waitForDurable(lastIndex_.load());
+}
+
+long WriteAheadLog::getLastIndex() const {
+    return lastIndex_.load();
+}
+
+long WriteAheadLog::getDurableIndex() const {
+    return durableIndex_.load();
+}
+
+uint64_t WriteAheadLog::getSyncCount() const {
+    return syncCount_.load();
+}
+
+std::string WriteAheadLog::getBackendName() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return backend_ ? backend_->getName() : "none";
+}
+
+std::vector<model::LogEntry> WriteAheadLog::readEntriesAfter(long afterIndex) const {
+    std::vector<model::LogEntry> entries;
+    auto segments = listSegments();
+
+    for (size_t i = 0; i < segments.size(); i++) {
+        // Skip segments that end at or before afterIndex
+        if (i + 1 < segments.size() && segments[i + 1].firstIndex <= afterIndex + 1) {
+            continue;
+        }
+        uint64_t validLength = 0;
+        scanSegment(*backend_, *batchCodec_, segments[i].path,
+                    [&entries, afterIndex](model::LogEntry&& entry) {
+                        if (entry.getId() > afterIndex) {
+                            entries.push_back(std::move(entry));
+                        }
+                    },
+                    validLength);
+    }
+    return entries;
+}
+
+void WriteAheadLog::sealActive() {
+    sealed_.push_back(std::move(active_));
+    active_ = Batch{};
+    active_.bufferIndex = freeBuffers_.back();
+    freeBuffers_.pop_back();
+}
+
+void WriteAheadLog::flusherThread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        flushCv_.wait(lock, [this] {
+            return stopping_ || !sealed_.empty() || active_.used > 0;
+        });
+        if (sealed_.empty() && active_.used == 0) {
+            break;  // Stopping with nothing left to write
+        }
+
+        // Group commit: take every sealed buffer plus the active one
+        if (active_.used > 0 && !freeBuffers_.empty()) {
+            sealActive();
+        }
+        std::deque<Batch> batches;
+        batches.swap(sealed_);
+        lock.unlock();
+
+        std::vector<IoSlice> slices;
+        uint64_t total = 0;
+        for (auto& batch : batches) {
+            if (!batch.entries.empty()) {
+                batchCodec_->encode(batch.entries, batch.overflow);
+                slices.push_back({batch.overflow.data(), batch.overflow.size(), -1});
+                total += batch.overflow.size();
+                continue;
+            }
+            const char* data = batch.bufferIndex >= 0 ? backend_->getBuffer(batch.bufferIndex)
+                                                      : batch.overflow.data();
+            slices.push_back({data, batch.used, batch.bufferIndex});
+            total += batch.used;
+        }
+
+        bool ok = ensureSegment(batches.front().firstIndex) &&
+                  backend_->writeAndSync(segmentFd_, segmentOffset_, slices, config_.syncOnFlush);
+
+        lock.lock();
+        if (ok) {
+            segmentOffset_ += total;
+            durableIndex_ = batches.back().lastIndex;
+            syncCount_++;
+        } else {
+            failed_ = true;
+            std::cerr << "WAL write failed: " << std::strerror(errno) << std::endl;
+        }
+        for (const auto& batch : batches) {
+            if (batch.bufferIndex >= 0) {
+                freeBuffers_.push_back(batch.bufferIndex);
+            }
+        }
+        spaceCv_.notify_all();
+        durableCv_.notify_all();
+        if (failed_) {
+            break;
+        }
+    }
+}
+
+bool WriteAheadLog::ensureSegment(long firstIndex) {
+    if (segmentFd_ >= 0 && segmentOffset_ < config_.segmentSize) {
+        return true;
+    }
+    if (segmentFd_ >= 0) {
+        ::close(segmentFd_);
+        segmentFd_ = -1;
+    }
+    return openSegment(firstIndex);
+}
+
+bool WriteAheadLog::openSegment(long firstIndex) {
+    std::string path = segmentPath(firstIndex);
+    segmentFd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (segmentFd_ < 0) {
+        return false;
+    }
+    segmentOffset_ = 0;
+
+    // Make the new directory entry durable as well
+    int directoryFd = ::open(config_.directory.c_str(), O_RDONLY);
+    if (directoryFd >= 0) {
+        ::fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    return true;
+}
+
+bool WriteAheadLog::loadDictionary() {
+    std::string path = (std::filesystem::path(config_.directory) / kDictionaryFile).string();
+    std::ifstream existing(path, std::ios::binary);
+    if (existing) {
+        config_.dictionary.assign(std::istreambuf_iterator<char>(existing), std::istreambuf_iterator<char>());
+        return true;
+    }
+    if (config_.compression != CompressionType::DICTIONARY || config_.dictionary.empty()) {
+        return true;
+    }
+
+    // Persist the dictionary before any frame depends on it
+    std::string tempPath = path + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 &&
+              ::write(fd, config_.dictionary.data(), config_.dictionary.size()) ==
+                  static_cast<ssize_t>(config_.dictionary.size()) &&
+              ::fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!ok || ::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "WAL could not save dictionary " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<WriteAheadLog::Segment> WriteAheadLog::listSegments() const {
+    std::vector<Segment> segments;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(config_.directory, error)) {
+        std::string name = file.path().filename().string();
+        if (name.size() <= std::strlen(kSegmentPrefix) + std::strlen(kSegmentSuffix) ||
+            name.compare(0, std::strlen(kSegmentPrefix), kSegmentPrefix) != 0 ||
+            name.compare(name.size() - std::strlen(kSegmentSuffix), std::string::npos,
+                         kSegmentSuffix) != 0) {
+            continue;
+        }
+        std::string number = name.substr(std::strlen(kSegmentPrefix),
+                                         name.size() - std::strlen(kSegmentPrefix) -
+                                             std::strlen(kSegmentSuffix));
+        if (number.empty() || !std::all_of(number.begin(), number.end(), ::isdigit)) {
+            continue;
+        }
+        segments.push_back({std::stol(number), file.path().string()});
+    }
+
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment& a, const Segment& b) { return a.firstIndex < b.firstIndex; });
+    return segments;
+}
+
+std::string WriteAheadLog::segmentPath(long firstIndex) const {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%s%020ld%s", kSegmentPrefix, firstIndex, kSegmentSuffix);
+    return (std::filesystem::path(config_.directory) / name).string();
+}
+
+} // namespace storage
+} // namespace replication
@@ -0,0 +1,168 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include "model/LogEntry.h"
+#include "storage/IoBackend.h"
+#include "storage/LogBatchCodec.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+namespace replication {
+namespace storage {
+
+/**
+ * Configuration for a write-ahead log.
+ */
+struct WalConfig {
+    std::string directory;
+    IoBackendType backend = IoBackendType::AUTO;
+    size_t segmentSize = 64 * 1024 * 1024;  // Roll to a new segment file past this size
+    size_t bufferSize = 1024 * 1024;        // Size of each staging buffer
+    size_t bufferCount = 4;                 // Number of staging buffers (at least 2)
+    bool syncOnFlush = true;                // fdatasync after every flush
+    // Each group commit is written as one delta-encoded, compressed frame
+    // (NONE keeps one plain record per entry)
+    CompressionType compression = CompressionType::NONE;
+    // Preset dictionary for DICTIONARY. Saved as wal.dict on first open; an
+    // existing wal.dict always wins, so old frames stay readable.
+    std::string dictionary;
+};
+
+/**
+ * Segmented, checksummed write-ahead log with group commit.
+ *
+ * append() only copies the encoded entry into a staging buffer and returns;
+ * a dedicated flusher thread writes every sealed buffer plus the partially
+ * filled active one in a single submission followed by one fdatasync. While
+ * a flush is in flight, new appends accumulate in the other buffers, so the
+ * number of syncs per second is independent of the append rate. Callers
+ * that need durability wait with waitForDurable().
+ *
+ * Segments are named wal-<first index>.log. On open, a torn record at the
+ * end of the last segment is detected by its checksum and truncated away.
+ * Entries must be appended in increasing index order.
+ *
+ * With compression enabled, appends keep the entries themselves and the
+ * flusher encodes each batch as a single LogBatchCodec frame, so a crash
+ * loses or keeps a group commit as a whole. Segments may mix frames and
+ * plain records, and are readable whatever the current setting.
+ */
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const WalConfig& config);
+
+    /**
+     * Destructor that flushes pending entries and stops the flusher.
+     */
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /**
+     * Opens (or creates) the log directory and starts the flusher thread.
+     * @return true if the log is ready for appends
+     */
+    bool open();
+
+    /**
+     * Flushes everything appended so far and stops the flusher thread.
+     */
+    void close();
+
+    /**
+     * Queues an entry for persistence without waiting for the disk.
+     * Blocks only if every staging buffer is waiting to be flushed.
+     * @param entry the entry to persist
+     * @return false if the log is not open or has failed
+     */
+    bool append(const model::LogEntry& entry);
+
+    /**
+     * Waits until the entry with the given index is durable.
+     * @return false if the log failed or was closed first
+     */
+    bool waitForDurable(long index);
+
+    /**
+     * Waits until every appended entry is durable.
+     */
+    bool flush();
+
+    /**
+     * Reads all persisted entries with an index greater than afterIndex.
+     * Used for crash recovery and to stream history to recovering nodes.
+     */
+    std::vector<model::LogEntry> readEntriesAfter(long afterIndex) const;
+
+    long getLastIndex() const;
+    long getDurableIndex() const;
+    uint64_t getSyncCount() const;
+    std::string getBackendName() const;
+
+private:
+    /**
+     * A group of encoded records waiting to be written.
+     * Fixed batches live in a backend staging buffer; oversized records are
+     * carried in their own heap allocation.
+     */
+    struct Batch {
+        int bufferIndex = -1;
+        size_t used = 0;
+        long firstIndex = 0;
+        long lastIndex = 0;
+        std::string overflow;
+        // Entries awaiting frame encoding when compression is enabled
+        std::vector<model::LogEntry> entries;
+    };
+
+    struct Segment {
+        long firstIndex;
+        std::string path;
+    };
+
+    void flusherThread();
+    bool loadDictionary();
+    bool ensureSegment(long firstIndex);
+    bool openSegment(long firstIndex);
+    void sealActive();
+    std::vector<Segment> listSegments() const;
+    std::string segmentPath(long firstIndex) const;
+
+    WalConfig config_;
+    std::unique_ptr<IoBackend> backend_;
+    std::unique_ptr<LogBatchCodec> batchCodec_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flushCv_;     // Wakes the flusher
+    std::condition_variable spaceCv_;     // Wakes appenders waiting for a buffer
+    std::condition_variable durableCv_;   // Wakes durability waiters
+    Batch active_;
+    std::deque<Batch> sealed_;
+    std::vector<int> freeBuffers_;
+    bool open_;
+    bool stopping_;
+    bool failed_;
+
+    // Owned by the flusher thread once open
+    int segmentFd_;
+    uint64_t segmentOffset_;
+
+    std::atomic<long> lastIndex_;
+    std::atomic<long> durableIndex_;
+    std::atomic<uint64_t> syncCount_;
+    std::thread flusher_;
+};
+
+} // namespace storage
+} // namespace replication
+
+#endif // WRITE_AHEAD_LOG_H
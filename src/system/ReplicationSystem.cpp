@@ -3,30 +3,65 @@
 #include <chrono>
 #include <algorithm>
 #include <random>
+#include <iterator>
+#include <filesystem>
 
 namespace replication {
 namespace system {
 
-ReplicationSystem::ReplicationSystem(int numSlaves)
-    : random_(std::random_device()()),  // Seed the random generator
+namespace {
+
+long steadyNowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+ReplicationSystem::ReplicationSystem(int numSlaves, int numShards, std::shared_ptr<node::EventLoop> eventLoop)
+    : ReplicationSystem(numSlaves, ShardRouter::hashPartitioned(numShards), std::move(eventLoop)) {
+}
+
+ReplicationSystem::ReplicationSystem(int numSlaves, const ShardRouter& router,
+                                     std::shared_ptr<node::EventLoop> eventLoop)
+    : router_(router),
+      eventLoop_(std::move(eventLoop)),
+      random_(std::random_device()()),  // Seed the random generator
       stopFailureSimulator_(true),
       failureProbability_(0.0),
       recoveryProbability_(0.0),
-      checkIntervalSeconds_(0) {
-    
-    // Create master node
-    master_ = std::make_shared<node::MasterNode>("master");
+      checkInterval_(0),
+      stopFailoverMonitor_(true),
+      pendingFailovers_(0),
+      lastFailoverMillis_(-1) {
+    createShards(numSlaves);
+    startFailoverMonitor();
+}
+
+void ReplicationSystem::createShards(int numSlaves) {
+    int numShards = router_.getShardCount();
     
-    // Create slave nodes
-    for (int i = 0; i < numSlaves; i++) {
-        std::string slaveId = "slave-" + std::to_string(i);
-        auto slave = std::make_shared<node::SlaveNode>(slaveId, master_);
-        slaves_.push_back(slave);
-        // Register slave with master
-        master_->registerSlave(slave);
+    for (int s = 0; s < numShards; s++) {
+        // Keep the historical node names for the unsharded layout
+        std::string suffix = numShards == 1 ? "" : "-" + std::to_string(s);
+        
+        // Create master node
+        Shard shard;
+        shard.master = std::make_shared<node::MasterNode>("master" + suffix, eventLoop_);
+        
+        // Create slave nodes
+        for (int i = 0; i < numSlaves; i++) {
+            std::string slaveId = "slave" + suffix + "-" + std::to_string(i);
+            auto slave = std::make_shared<node::SlaveNode>(slaveId, shard.master, eventLoop_);
+            shard.slaves.push_back(slave);
+            // Register slave with master
+            shard.master->registerSlave(slave);
+        }
+        shard.nextSlaveNumber = numSlaves;
+        shards_.push_back(std::move(shard));
     }
     
-    std::cout << "Replication system initialized with 1 master and " 
+    std::cout << "Replication system initialized with " << numShards << " shard(s), each with 1 master and " 
               << numSlaves << " slaves" << std::endl;
 }
 
@@ -35,16 +70,57 @@ ReplicationSystem::~ReplicationSystem() {
 }
 
 bool ReplicationSystem::write(const std::string& key, const std::string& value) {
-    return master_->write(key, value);
+    int shard = router_.shardFor(key);
+    bool success = getMaster(shard)->write(key, value);
+    if (success && pendingFailovers_ > 0) {
+        recordFailoverCompletion(shard);
+    }
+    return success;
+}
+
+bool ReplicationSystem::write(const std::string& key, const std::string& value, std::chrono::milliseconds ttl) {
+    int shard = router_.shardFor(key);
+    bool success = getMaster(shard)->write(key, value, ttl);
+    if (success && pendingFailovers_ > 0) {
+        recordFailoverCompletion(shard);
+    }
+    return success;
 }
 
 bool ReplicationSystem::deleteKey(const std::string& key) {
-    return master_->deleteKey(key);
+    return getMaster(router_.shardFor(key))->deleteKey(key);
+}
+
+bool ReplicationSystem::compareAndSet(const std::string& key, const std::string& expected,
+                                      const std::string& value) {
+    return getMaster(router_.shardFor(key))->compareAndSet(key, expected, value);
+}
+
+bool ReplicationSystem::compareAndSetVersion(const std::string& key, long expectedVersion,
+                                             const std::string& value) {
+    return getMaster(router_.shardFor(key))->compareAndSetVersion(key, expectedVersion, value);
+}
+
+bool ReplicationSystem::increment(const std::string& key, long long delta, long long& result) {
+    return getMaster(router_.shardFor(key))->increment(key, delta, result);
+}
+
+bool ReplicationSystem::append(const std::string& key, const std::string& suffix, size_t& length) {
+    return getMaster(router_.shardFor(key))->append(key, suffix, length);
+}
+
+bool ReplicationSystem::readVersioned(const std::string& key, std::string& value, long& version) {
+    std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(router_.shardFor(key));
+    if (!slave) {
+        std::cout << "All slaves are DOWN, cannot read" << std::endl;
+        return false;
+    }
+    return slave->readVersioned(key, value, version);
 }
 
 std::string ReplicationSystem::read(const std::string& key) {
     // Try to get a working slave
-    std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave();
+    std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(router_.shardFor(key));
     if (!slave) {
         std::cout << "All slaves are DOWN, cannot read" << std::endl;
         return "";
@@ -55,10 +131,173 @@ std::string ReplicationSystem::read(const std::string& key) {
     return value;
 }
 
-std::shared_ptr<node::SlaveNode> ReplicationSystem::getRandomUpSlave() const {
+std::string ReplicationSystem::read(const std::string& key, const StalenessBound& bound) {
+    int shard = router_.shardFor(key);
+    std::shared_ptr<node::SlaveNode> slave = getFreshUpSlave(shard, bound);
+    if (slave) {
+        std::string value = slave->read(key);
+        std::cout << "Read " << key << "=" << value << " from " << slave->getId() << std::endl;
+        return value;
+    }
+    
+    // No slave is fresh enough; the master is always current
+    std::shared_ptr<node::MasterNode> master = getMaster(shard);
+    if (!master->isUp()) {
+        std::cout << "No slave within staleness bound and master is DOWN, cannot read" << std::endl;
+        return "";
+    }
+    std::string value = master->read(key);
+    std::cout << "Read " << key << "=" << value << " from " << master->getId() 
+              << " (no slave within staleness bound)" << std::endl;
+    return value;
+}
+
+std::vector<std::vector<size_t>> ReplicationSystem::groupByShard(const std::vector<std::string>& keys) const {
+    std::vector<std::vector<size_t>> positionsByShard(shards_.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        positionsByShard[router_.shardFor(keys[i])].push_back(i);
+    }
+    return positionsByShard;
+}
+
+std::vector<std::string> ReplicationSystem::multiGet(const std::vector<std::string>& keys) {
+    std::vector<bool> found;
+    return multiGet(keys, found);
+}
+
+std::vector<std::string> ReplicationSystem::multiGet(const std::vector<std::string>& keys, std::vector<bool>& found) {
+    std::vector<std::string> values(keys.size());
+    found.assign(keys.size(), false);
+    std::vector<std::vector<size_t>> positionsByShard = groupByShard(keys);
+    
+    for (size_t s = 0; s < shards_.size(); s++) {
+        const auto& positions = positionsByShard[s];
+        if (positions.empty()) {
+            continue;
+        }
+        std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(static_cast<int>(s));
+        if (!slave) {
+            std::cout << "All slaves of shard " << s << " are DOWN, cannot read" << std::endl;
+            continue;
+        }
+        
+        std::vector<std::string> shardKeys;
+        shardKeys.reserve(positions.size());
+        for (size_t position : positions) {
+            shardKeys.push_back(keys[position]);
+        }
+        std::vector<bool> shardFound;
+        std::vector<std::string> shardValues = slave->readMany(shardKeys, shardFound);
+        for (size_t i = 0; i < positions.size() && i < shardValues.size(); i++) {
+            values[positions[i]] = std::move(shardValues[i]);
+            found[positions[i]] = shardFound[i];
+        }
+    }
+    return values;
+}
+
+std::vector<std::pair<std::string, std::string>> ReplicationSystem::scanPrefix(const std::string& prefix,
+                                                                              size_t limit) {
+    std::vector<std::pair<std::string, std::string>> result;
+    for (size_t s = 0; s < shards_.size(); s++) {
+        std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(static_cast<int>(s));
+        if (!slave) {
+            std::cout << "All slaves of shard " << s << " are DOWN, cannot read" << std::endl;
+            continue;
+        }
+        
+        // Each shard's keys come back sorted; merge them into the keys so far
+        size_t runStart = result.size();
+        auto shardResult = slave->scanPrefix(prefix, limit);
+        std::move(shardResult.begin(), shardResult.end(), std::back_inserter(result));
+        std::inplace_merge(result.begin(), result.begin() + runStart, result.end(),
+                           [](const auto& a, const auto& b) { return a.first < b.first; });
+        if (limit > 0 && result.size() > limit) {
+            result.resize(limit);
+        }
+    }
+    std::cout << "Scanned " << result.size() << " keys with prefix " << prefix << std::endl;
+    return result;
+}
+
+bool ReplicationSystem::bulkLoad(const std::string& path, storage::BulkReader::Format format,
+                                 const std::string& imageDirectory) {
+    std::lock_guard<std::mutex> bulkLoadLock(bulkLoadMutex_);
+    auto started = std::chrono::steady_clock::now();
+    storage::BulkReader reader(format);
+    storage::BulkReader::Pairs pairs;
+    if (!reader.read(path, pairs)) {
+        std::cout << "Bulk load of " << path << " failed: " << reader.getError() << std::endl;
+        return false;
+    }
+
+    // Splitting keeps each shard's pairs in key order
+    std::vector<storage::BulkReader::Pairs> byShard(shards_.size());
+    for (auto& pair : pairs) {
+        byShard[router_.shardFor(pair.first)].push_back(std::move(pair));
+    }
+    storage::BulkReader::Pairs().swap(pairs);
+
+    std::error_code error;
+    std::filesystem::create_directories(imageDirectory, error);
+    bool loaded = true;
+    for (size_t s = 0; s < byShard.size(); s++) {
+        std::shared_ptr<node::MasterNode> master = getMaster(static_cast<int>(s));
+        std::string image = master->getId() + "-term" + std::to_string(master->getTerm()) + "-at" +
+                            std::to_string(master->getLastLogIndex()) + ".image";
+        bool success = master->bulkLoad(byShard[s], (std::filesystem::path(imageDirectory) / image).string());
+        if (success && pendingFailovers_ > 0) {
+            recordFailoverCompletion(static_cast<int>(s));
+        }
+        loaded = loaded && success;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    std::cout << "Bulk loaded " << reader.getRecordCount() << " records from " << path << " into " 
+              << byShard.size() << " shards in " << elapsed.count() << " ms" << std::endl;
+    return loaded;
+}
+
+bool ReplicationSystem::multiGetConsistent(const std::vector<std::string>& keys,
+                                           std::vector<std::string>& values) {
+    values.assign(keys.size(), std::string());
+    std::vector<std::vector<size_t>> positionsByShard = groupByShard(keys);
+    
+    bool consistent = true;
+    for (size_t s = 0; s < shards_.size(); s++) {
+        const auto& positions = positionsByShard[s];
+        if (positions.empty()) {
+            continue;
+        }
+        std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(static_cast<int>(s));
+        if (!slave) {
+            std::cout << "All slaves of shard " << s << " are DOWN, cannot read" << std::endl;
+            consistent = false;
+            continue;
+        }
+        
+        std::vector<std::string> shardKeys;
+        shardKeys.reserve(positions.size());
+        for (size_t position : positions) {
+            shardKeys.push_back(keys[position]);
+        }
+        std::vector<std::string> shardValues;
+        long index = 0;
+        if (!slave->readConsistent(shardKeys, shardValues, index)) {
+            consistent = false;
+            continue;
+        }
+        for (size_t i = 0; i < positions.size(); i++) {
+            values[positions[i]] = std::move(shardValues[i]);
+        }
+    }
+    return consistent;
+}
+
+std::shared_ptr<node::SlaveNode> ReplicationSystem::getRandomUpSlave(int shard) const {
     std::vector<std::shared_ptr<node::SlaveNode>> upSlaves;
     
-    for (const auto& slave : slaves_) {
+    for (const auto& slave : getSlaves(shard)) {
         if (slave->isUp()) {
             upSlaves.push_back(slave);
         }
@@ -69,39 +308,96 @@ std::shared_ptr<node::SlaveNode> ReplicationSystem::getRandomUpSlave() const {
     }
     
     // Get a random up slave
+    return pickRandom(upSlaves);
+}
+
+std::shared_ptr<node::SlaveNode> ReplicationSystem::getFreshUpSlave(int shard, 
+                                                                  const StalenessBound& bound) const {
+    // Read the master's watermarks first; slaves only move forward, so lag is never underestimated.
+    // A master that is down keeps its watermark, so the bound still holds against what it wrote.
+    std::shared_ptr<node::MasterNode> master = getMaster(shard);
+    long masterIndex = master->getAppliedIndex();
+    long nowMillis = model::LogEntry::currentTimeMillis();
+    
+    std::vector<std::shared_ptr<node::SlaveNode>> freshSlaves;
+    for (const auto& slave : getSlaves(shard)) {
+        if (!slave->isUp()) {
+            continue;
+        }
+        long lagEntries = std::max(0L, masterIndex - slave->getLastLogIndex());
+        if (bound.maxLagEntries >= 0 && lagEntries > bound.maxLagEntries) {
+            continue;
+        }
+        if (bound.maxLagMillis >= 0 && lagEntries > 0 &&
+            nowMillis - slave->getLastAppliedTimestamp() > bound.maxLagMillis) {
+            continue;
+        }
+        freshSlaves.push_back(slave);
+    }
+    
+    if (freshSlaves.empty()) {
+        return nullptr;
+    }
+    return pickRandom(freshSlaves);
+}
+
+std::shared_ptr<node::SlaveNode> ReplicationSystem::pickRandom(
+        const std::vector<std::shared_ptr<node::SlaveNode>>& slaves) const {
     std::lock_guard<std::mutex> lock(randomMutex_);
-    std::uniform_int_distribution<int> dist(0, upSlaves.size() - 1);
-    return upSlaves[dist(random_)];
+    std::uniform_int_distribution<int> dist(0, slaves.size() - 1);
+    return slaves[dist(random_)];
 }
 
 std::map<std::string, std::string> ReplicationSystem::getDataStore() const {
-    std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave();
-    if (!slave) {
-        std::cout << "All slaves are DOWN, cannot get data store" << std::endl;
-        return {};
-    }
+    std::map<std::string, std::string> dataStore;
     
-    return slave->getDataStore();
+    for (size_t s = 0; s < shards_.size(); s++) {
+        std::shared_ptr<node::SlaveNode> slave = getRandomUpSlave(static_cast<int>(s));
+        if (!slave) {
+            std::cout << "All slaves are DOWN, cannot get data store" << std::endl;
+            continue;
+        }
+        auto shardStore = slave->getDataStore();
+        dataStore.insert(shardStore.begin(), shardStore.end());
+    }
+    return dataStore;
 }
 
 void ReplicationSystem::startFailureSimulator(double failureProbability, 
                                              double recoveryProbability, 
                                              int checkIntervalSeconds) {
+    startFailureSimulator(failureProbability, recoveryProbability,
+                          std::chrono::seconds(checkIntervalSeconds));
+}
+
+void ReplicationSystem::startFailureSimulator(double failureProbability,
+                                             double recoveryProbability,
+                                             std::chrono::milliseconds checkInterval) {
     // Stop any existing simulator thread
-    if (!stopFailureSimulator_) {
-        shutdown();
-    }
+    stopFailureSimulator();
     
     failureProbability_ = failureProbability;
     recoveryProbability_ = recoveryProbability;
-    checkIntervalSeconds_ = checkIntervalSeconds;
+    checkInterval_ = checkInterval;
     stopFailureSimulator_ = false;
     
     // Start the simulator thread
     failureSimulatorThread_ = std::thread(&ReplicationSystem::failureSimulatorThread, this);
     
     std::cout << "Started failure simulator with check interval " 
-              << checkIntervalSeconds << " seconds" << std::endl;
+              << checkInterval.count() << " ms" << std::endl;
+}
+
+void ReplicationSystem::stopFailureSimulator() {
+    {
+        std::lock_guard<std::mutex> lock(failureSimulatorMutex_);
+        stopFailureSimulator_ = true;
+    }
+    failureSimulatorCV_.notify_all();
+    
+    if (failureSimulatorThread_.joinable()) {
+        failureSimulatorThread_.join();
+    }
 }
 
 void ReplicationSystem::failureSimulatorThread() {
@@ -109,7 +405,7 @@ void ReplicationSystem::failureSimulatorThread() {
         {
             std::unique_lock<std::mutex> lock(failureSimulatorMutex_);
             failureSimulatorCV_.wait_for(lock, 
-                                      std::chrono::seconds(checkIntervalSeconds_),
+                                      checkInterval_,
                                       [this] { return stopFailureSimulator_.load(); });
             
             if (stopFailureSimulator_) {
@@ -124,10 +420,18 @@ void ReplicationSystem::failureSimulatorThread() {
 
 void ReplicationSystem::simulateFailureAndRecovery(double failureProbability, 
                                                  double recoveryProbability) {
+    std::vector<std::shared_ptr<node::SlaveNode>> slaves;
+    {
+        std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        for (const auto& shard : shards_) {
+            slaves.insert(slaves.end(), shard.slaves.begin(), shard.slaves.end());
+        }
+    }
+    
     std::lock_guard<std::mutex> lock(randomMutex_);
     std::uniform_real_distribution<double> dist(0.0, 1.0);
     
-    for (auto& slave : slaves_) {
+    for (auto& slave : slaves) {
         if (slave->isUp() && dist(random_) < failureProbability) {
             slave->goDown();
         } else if (!slave->isUp() && dist(random_) < recoveryProbability) {
@@ -137,45 +441,487 @@ void ReplicationSystem::simulateFailureAndRecovery(double failureProbability,
 }
 
 std::vector<model::LogEntry> ReplicationSystem::getLogs() const {
-    if (!master_->isUp()) {
-        std::cout << "Master is DOWN, cannot get logs" << std::endl;
+    std::vector<model::LogEntry> logs;
+    for (size_t s = 0; s < shards_.size(); s++) {
+        auto shardLogs = getLogs(static_cast<int>(s));
+        logs.insert(logs.end(), shardLogs.begin(), shardLogs.end());
+    }
+    return logs;
+}
+
+std::vector<model::LogEntry> ReplicationSystem::getLogs(int shard) const {
+    std::shared_ptr<node::MasterNode> master = getMaster(shard);
+    if (!master->isUp()) {
+        std::cout << "Master " << master->getId() << " is DOWN, cannot get logs" << std::endl;
         return {};
     }
     
-    return master_->getLogEntriesAfter(0); // Get all logs from the beginning
+    return master->getLogEntriesAfter(0); // Get all logs from the beginning
+}
+
+long ReplicationSystem::subscribe(int shard, long afterIndex, node::ChangeSubscription::Callback callback) {
+    return getMaster(shard)->subscribe(afterIndex, std::move(callback));
+}
+
+bool ReplicationSystem::unsubscribe(int shard, long subscriptionId) {
+    return getMaster(shard)->unsubscribe(subscriptionId);
+}
+
+int ReplicationSystem::getShardCount() const {
+    return static_cast<int>(shards_.size());
+}
+
+int ReplicationSystem::getShardForKey(const std::string& key) const {
+    return router_.shardFor(key);
+}
+
+bool ReplicationSystem::waitForReplication(int shard, long index, std::chrono::milliseconds timeout) {
+    return getMaster(shard)->waitForReplication(index, timeout);
+}
+
+bool ReplicationSystem::quiesce(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (int shard = 0; shard < getShardCount(); shard++) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        if (!getMaster(shard)->quiesce(std::max(remaining, std::chrono::milliseconds(0)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<node::MasterNode> ReplicationSystem::getMaster(int shard) const {
+    std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    return shards_.at(shard).master;
+}
+
+std::vector<std::shared_ptr<node::SlaveNode>> ReplicationSystem::getSlaves(int shard) const {
+    std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    return shards_.at(shard).slaves;
+}
+
+long ReplicationSystem::getTerm(int shard) const {
+    return getMaster(shard)->getTerm();
+}
+
+long ReplicationSystem::getLastFailoverMillis() const {
+    return lastFailoverMillis_.load();
 }
 
 std::map<std::string, bool> ReplicationSystem::getNodesStatus() const {
     std::map<std::string, bool> status;
+    std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
     
-    // Add master status
-    status[master_->getId()] = master_->isUp();
-    
-    // Add slave statuses
-    for (const auto& slave : slaves_) {
-        status[slave->getId()] = slave->isUp();
+    for (const auto& shard : shards_) {
+        // Add master status
+        status[shard.master->getId()] = shard.master->isUp();
+        
+        // Add slave statuses
+        for (const auto& slave : shard.slaves) {
+            status[slave->getId()] = slave->isUp();
+        }
     }
     
     return status;
 }
 
 void ReplicationSystem::shutdown() {
-    // Signal the failure simulator to stop
+    stopFailureSimulator();
+    stopFailoverMonitor();
+    
+    // Stop replication first, so no slave is written once its storage is closed
+    std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    for (auto& shard : shards_) {
+        shard.master->shutdown();
+        for (const auto& deposed : shard.deposed) {
+            deposed->shutdown();
+        }
+        for (const auto& slave : shard.slaves) {
+            slave->clearDownstream();
+        }
+    }
+    for (auto& shard : shards_) {
+        shard.master->closeStorage();
+        for (const auto& deposed : shard.deposed) {
+            deposed->closeStorage();
+        }
+        for (const auto& slave : shard.slaves) {
+            slave->closeStorage();
+        }
+    }
+    
+    std::cout << "Replication system shut down" << std::endl;
+}
+
+std::shared_ptr<node::SlaveNode> ReplicationSystem::addSlave(int shardIndex, const std::string& snapshotDirectory) {
+    if (shardIndex < 0 || shardIndex >= getShardCount()) {
+        std::cout << "No shard " << shardIndex << " to add a slave to" << std::endl;
+        return nullptr;
+    }
+    auto started = std::chrono::steady_clock::now();
+    std::shared_ptr<node::AbstractNode> source;
+    std::shared_ptr<node::SlaveNode> slave;
     {
-        std::lock_guard<std::mutex> lock(failureSimulatorMutex_);
-        stopFailureSimulator_ = true;
+        std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        Shard& shard = shards_.at(shardIndex);
+        std::string suffix = shards_.size() == 1 ? "" : "-" + std::to_string(shardIndex);
+        std::string slaveId = "slave" + suffix + "-" + std::to_string(shard.nextSlaveNumber++);
+        slave = std::make_shared<node::SlaveNode>(slaveId, shard.master, eventLoop_);
+        applyStorage(*slave, shard.master->getTerm());
+        applyMemory(*slave);
+
+        // Spare the master when a slave can supply the snapshot
+        std::vector<std::shared_ptr<node::SlaveNode>> candidates;
+        for (const auto& existing : shard.slaves) {
+            if (existing->isUp() && !existing->isLoadingSnapshot()) {
+                candidates.push_back(existing);
+            }
+        }
+        if (!candidates.empty()) {
+            source = pickRandom(candidates);
+        } else {
+            source = shard.master;
+        }
+    }
+
+    // Written and loaded outside the topology lock, so reads and failover carry on
+    std::filesystem::path directory = snapshotDirectory.empty() ? std::filesystem::temp_directory_path()
+                                                                : std::filesystem::path(snapshotDirectory);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    std::string path = (directory / (slave->getId() + ".bootstrap.snap")).string();
+    if (!source->writeSnapshot(path)) {
+        std::cout << "Shard " << shardIndex << " could not snapshot " << source->getId() 
+                  << " to add slave " << slave->getId() << std::endl;
+        std::filesystem::remove(path, error);
+        return nullptr;
+    }
+    bool bootstrapped = slave->bootstrapFromSnapshot(path);
+    // The slave keeps its mapping open, so the file is no longer needed
+    std::filesystem::remove(path, error);
+    if (!bootstrapped) {
+        retireNode(slave);
+        return nullptr;
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    {
+        std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        Shard& shard = shards_.at(shardIndex);
+        master = shard.master;
+        if (slave->getMaster() != master) {
+            // A failover happened meanwhile; follow the new master from its term on
+            slave->observeTerm(master->getTerm());
+            slave->setMaster(master);
+        }
+        master->registerSlave(slave);
+        shard.slaves.push_back(slave);
+        applyTopology(shard);
+    }
+    // Anything logged between the snapshot's recovery and registration is fetched as well
+    slave->requestRecovery();
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    std::cout << "Shard " << shardIndex << " added slave " << slave->getId() << " from a snapshot of " 
+              << source->getId() << " in " << elapsed.count() << " ms" << std::endl;
+    return slave;
+}
+
+bool ReplicationSystem::removeSlave(int shardIndex, const std::string& slaveId) {
+    if (shardIndex < 0 || shardIndex >= getShardCount()) {
+        return false;
+    }
+    std::shared_ptr<node::SlaveNode> slave;
+    std::shared_ptr<node::MasterNode> master;
+    {
+        std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        Shard& shard = shards_.at(shardIndex);
+        auto it = std::find_if(shard.slaves.begin(), shard.slaves.end(), [&slaveId](const auto& candidate) {
+            return candidate->getId() == slaveId;
+        });
+        if (it == shard.slaves.end()) {
+            return false;
+        }
+        if (shard.slaves.size() == 1) {
+            std::cout << "Shard " << shardIndex << " cannot remove its last slave " << slaveId << std::endl;
+            return false;
+        }
+        slave = *it;
+        shard.slaves.erase(it);
+
+        // Slaves it relayed to are fed by the rest of the topology from now on
+        slave->clearDownstream();
+        slave->setUpstream(nullptr);
+        applyTopology(shard);
+        master = shard.master;
+    }
+
+    master->removeSlave(slave);
+    retireNode(slave);
+    std::cout << "Shard " << shardIndex << " removed slave " << slaveId << std::endl;
+    return true;
+}
+
+void ReplicationSystem::configureFailover(const FailoverConfig& config) {
+    stopFailoverMonitor();
+    failoverConfig_ = config;
+    startFailoverMonitor();
+}
+
+void ReplicationSystem::configureTopology(const TopologyConfig& config) {
+    std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    topology_ = config;
+    for (auto& shard : shards_) {
+        applyTopology(shard);
+    }
+}
+
+void ReplicationSystem::configureMemory(const MemoryConfig& config) {
+    std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    memory_ = config;
+    for (auto& shard : shards_) {
+        shard.master->setMemoryLimit(memory_.limitBytes, memory_.policy);
+        for (const auto& slave : shard.slaves) {
+            applyMemory(*slave);
+        }
+    }
+}
+
+void ReplicationSystem::applyMemory(node::SlaveNode& slave) {
+    slave.setLogCompaction(memory_.limitBytes > 0, memory_.limitBytes / 4);
+}
+
+void ReplicationSystem::configureStorage(const StorageConfig& config) {
+    std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    storage_ = config;
+    for (auto& shard : shards_) {
+        applyStorage(*shard.master, shard.master->getTerm());
+        for (const auto& slave : shard.slaves) {
+            applyStorage(*slave, shard.master->getTerm());
+        }
+    }
+}
+
+void ReplicationSystem::applyStorage(node::AbstractNode& node, long term) {
+    applyStorage(node, term, storage_);
+}
+
+void ReplicationSystem::applyStorage(node::AbstractNode& node, long term, const StorageConfig& storage) {
+    storage::LsmConfig lsm = storage.lsm;
+    std::string name = term > 0 ? node.getId() + "-term" + std::to_string(term) : node.getId();
+    lsm.directory = (std::filesystem::path(storage.lsm.directory) / name).string();
+    node.setStorageEngine(storage.engine, lsm);
+}
+
+void ReplicationSystem::retireNode(std::shared_ptr<node::AbstractNode> node) {
+    if (eventLoop_) {
+        eventLoop_->retire(std::move(node));
+    }
+}
+
+void ReplicationSystem::applyTopology(Shard& shard) {
+    size_t fanout = shard.slaves.size();
+    if (topology_.type == TopologyConfig::Type::CHAIN) {
+        fanout = 1;
+    } else if (topology_.type == TopologyConfig::Type::TREE) {
+        fanout = static_cast<size_t>(std::max(1, topology_.fanout));
     }
-    failureSimulatorCV_.notify_all();
     
-    // Join the failure simulator thread if it's running
-    if (failureSimulatorThread_.joinable()) {
-        failureSimulatorThread_.join();
+    for (const auto& slave : shard.slaves) {
+        slave->clearDownstream();
+    }
+    for (size_t i = 0; i < shard.slaves.size(); i++) {
+        const auto& slave = shard.slaves[i];
+        if (i < fanout) {
+            slave->setUpstream(nullptr);
+            shard.master->registerSlave(slave);
+        } else {
+            const auto& relay = shard.slaves[i / fanout - 1];
+            slave->setUpstream(relay);
+            relay->addDownstream(slave);
+            shard.master->unregisterSlave(slave);
+        }
     }
+}
+
+void ReplicationSystem::startFailoverMonitor() {
+    if (!failoverConfig_.enabled) {
+        return;
+    }
+    stopFailoverMonitor_ = false;
+    failoverMonitorThread_ = std::thread(&ReplicationSystem::failoverMonitorThread, this);
+}
+
+void ReplicationSystem::stopFailoverMonitor() {
+    {
+        std::lock_guard<std::mutex> lock(failoverMonitorMutex_);
+        stopFailoverMonitor_ = true;
+    }
+    failoverMonitorCV_.notify_all();
     
-    // Shutdown the master node
-    master_->shutdown();
+    if (failoverMonitorThread_.joinable()) {
+        failoverMonitorThread_.join();
+    }
+}
+
+void ReplicationSystem::failoverMonitorThread() {
+    while (!stopFailoverMonitor_) {
+        {
+            std::unique_lock<std::mutex> lock(failoverMonitorMutex_);
+            failoverMonitorCV_.wait_for(lock, failoverConfig_.heartbeatInterval,
+                                        [this] { return stopFailoverMonitor_.load(); });
+            
+            if (stopFailoverMonitor_) {
+                break;
+            }
+        }
+        
+        for (int s = 0; s < getShardCount(); s++) {
+            rejoinDeposedMasters(s);
+            
+            std::shared_ptr<node::MasterNode> master = getMaster(s);
+            long downSince = master->getDownSinceMillis();
+            if (!master->isUp() && downSince >= 0 && 
+                steadyNowMillis() - downSince >= failoverConfig_.electionTimeout.count()) {
+                electNewMaster(s);
+            }
+        }
+    }
+}
+
+bool ReplicationSystem::electNewMaster(int shardIndex) {
+    std::shared_ptr<node::MasterNode> oldMaster;
+    std::shared_ptr<node::SlaveNode> candidate;
+    StorageConfig storage;
+    long term = 0;
+    {
+        std::shared_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        const Shard& shard = shards_.at(shardIndex);
+        oldMaster = shard.master;
+        term = oldMaster->getTerm() + 1;
+        storage = storage_;
+        
+        // Fence first: once the slaves are at the new term, the old master can no
+        // longer replicate to them, so the candidate's log stops growing
+        oldMaster->fence();
+        for (const auto& slave : shard.slaves) {
+            slave->observeTerm(term);
+        }
+        
+        // Promote the most up-to-date slave that is up
+        for (const auto& slave : shard.slaves) {
+            if (slave->isUp() && (!candidate || slave->getLastLogIndex() > candidate->getLastLogIndex())) {
+                candidate = slave;
+            }
+        }
+    }
+    if (!candidate) {
+        std::cout << "No slave of shard " << shardIndex << " is UP, cannot elect a new master" << std::endl;
+        return false;
+    }
     
-    std::cout << "Replication system shut down" << std::endl;
+    // Copying the candidate's state is the slow part; reads and other shards carry on meanwhile.
+    // The engine is opened first, so an LSM copy streams into the new directory.
+    auto newMaster = std::make_shared<node::MasterNode>(candidate->getId(), eventLoop_);
+    applyStorage(*newMaster, term, storage);
+    newMaster->assumeLeadership(*candidate, term);
+    
+    std::vector<std::shared_ptr<node::SlaveNode>> followers;
+    {
+        std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+        Shard& shard = shards_.at(shardIndex);
+        bool stillSlave = std::find(shard.slaves.begin(), shard.slaves.end(), candidate) != shard.slaves.end();
+        if (shard.master != oldMaster || !stillSlave) {
+            // The candidate was removed while its state was copied; the next check tries again
+            std::cout << "Shard " << shardIndex << " changed during the election of " << candidate->getId()
+                      << ", abandoning it" << std::endl;
+            newMaster->shutdown();
+            newMaster->closeStorage();
+            retireNode(newMaster);
+            return false;
+        }
+        
+        // Includes slaves added while the state was copied
+        for (const auto& slave : shard.slaves) {
+            if (slave == candidate) {
+                continue;
+            }
+            slave->observeTerm(term);
+            slave->setMaster(newMaster);
+            newMaster->registerSlave(slave);
+            followers.push_back(slave);
+        }
+        
+        // The promoted slave's relays are rebuilt around the new master
+        candidate->clearDownstream();
+        retireNode(candidate);
+        shard.slaves = followers;
+        shard.deposed.push_back(oldMaster);
+        shard.master = newMaster;
+        applyTopology(shard);
+        if (memory_.limitBytes > 0) {
+            newMaster->setMemoryLimit(memory_.limitBytes, memory_.policy);
+        }
+        if (shard.failoverStartedAt < 0) {
+            shard.failoverStartedAt = oldMaster->getDownSinceMillis();
+            pendingFailovers_++;
+        }
+        
+        std::cout << "Shard " << shardIndex << " elected " << newMaster->getId() << " as master for term " 
+                  << term << " at log index " << newMaster->getLastLogIndex() 
+                  << " (deposed " << oldMaster->getId() << ")" << std::endl;
+    }
+    
+    // Followers that lag behind the new master catch up from its log
+    for (const auto& slave : followers) {
+        if (slave->isUp()) {
+            slave->requestRecovery();
+        }
+    }
+    return true;
+}
+
+void ReplicationSystem::rejoinDeposedMasters(int shardIndex) {
+    std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    Shard& shard = shards_.at(shardIndex);
+    
+    for (auto it = shard.deposed.begin(); it != shard.deposed.end();) {
+        const std::shared_ptr<node::MasterNode>& oldMaster = *it;
+        if (!oldMaster->isUp()) {
+            ++it;
+            continue;
+        }
+        
+        // Rebuild the old master as a slave, dropping entries the new master never saw
+        auto slave = std::make_shared<node::SlaveNode>(oldMaster->getId(), shard.master, eventLoop_);
+        applyStorage(*slave, shard.master->getTerm());
+        applyMemory(*slave);
+        slave->reconcileWith(oldMaster->getLogEntriesAfter(0));
+        shard.master->registerSlave(slave);
+        shard.slaves.push_back(slave);
+        applyTopology(shard);
+        
+        std::cout << "Node " << oldMaster->getId() << " rejoined shard " << shardIndex 
+                  << " as a slave of " << shard.master->getId() << std::endl;
+        retireNode(oldMaster);
+        it = shard.deposed.erase(it);
+    }
+}
+
+void ReplicationSystem::recordFailoverCompletion(int shardIndex) {
+    std::unique_lock<std::shared_mutex> topologyLock(topologyMutex_);
+    Shard& shard = shards_.at(shardIndex);
+    if (shard.failoverStartedAt < 0) {
+        return;
+    }
+    
+    long elapsed = steadyNowMillis() - shard.failoverStartedAt;
+    shard.failoverStartedAt = -1;
+    pendingFailovers_--;
+    lastFailoverMillis_ = elapsed;
+    std::cout << "Shard " << shardIndex << " failover completed in " << elapsed 
+              << " ms (master down to first successful write)" << std::endl;
 }
 
 } // namespace system
@@ -3,7 +3,10 @@
 
 #include "node/MasterNode.h"
 #include "node/SlaveNode.h"
+#include "node/EventLoop.h"
 #include "model/LogEntry.h"
+#include "system/ShardRouter.h"
+#include "storage/BulkReader.h"
 
 #include <string>
 #include <vector>
@@ -12,23 +15,107 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <shared_mutex>
+#include <chrono>
 #include <condition_variable>
 
 namespace replication {
 namespace system {
 
+/**
+ * Freshness a read requires from the slave serving it. A negative limit
+ * leaves that dimension unbounded.
+ */
+struct StalenessBound {
+    // How many log entries the slave may be behind its master
+    long maxLagEntries = -1;
+    // How long ago the slave may have stopped keeping up with its master
+    long maxLagMillis = -1;
+};
+
+/**
+ * Tuning for automatic master failover.
+ */
+struct FailoverConfig {
+    bool enabled = true;
+    // How often masters are checked for failure
+    std::chrono::milliseconds heartbeatInterval{50};
+    // How long a master must stay down before a new one is elected
+    std::chrono::milliseconds electionTimeout{300};
+};
+
+/**
+ * How the slaves of each shard receive log entries.
+ */
+struct TopologyConfig {
+    enum class Type {
+        STAR,   // The master feeds every slave
+        CHAIN,  // The master feeds the first slave, which feeds the next, and so on
+        TREE    // A relay tree: the master and every slave feed `fanout` slaves each
+    };
+
+    Type type = Type::STAR;
+    // Slaves fed by each node in a TREE
+    int fanout = 2;
+};
+
+/**
+ * Memory ceiling of each shard, for running the system as a bounded cache.
+ */
+struct MemoryConfig {
+    // Bytes each shard's data store and log may hold; 0 leaves them unbounded
+    size_t limitBytes = 0;
+    storage::StripedStore::EvictionPolicy policy = storage::StripedStore::EvictionPolicy::LRU;
+};
+
+/**
+ * How every node's data store lays out its keys.
+ */
+struct StorageConfig {
+    storage::StripedStore::Engine engine = storage::StripedStore::Engine::TREE;
+    // Under the LSM engine, each node keeps its runs in a directory of its
+    // own under lsm.directory: <node id>, or <node id>-term<term> for a
+    // node that took its role in a failover
+    storage::LsmConfig lsm;
+};
+
 /**
  * Manager class for the entire replication system.
  * It manages master and slave nodes, and provides a simple API
  * for interacting with the replication system.
+ *
+ * The keyspace can be partitioned into shards, each with its own master,
+ * log and set of slaves, so writes to different shards never contend on
+ * the same master lock. A ShardRouter maps every key to its shard.
+ *
+ * A failover monitor watches every shard's master. Once a master has been
+ * down for the election timeout, the most up-to-date slave is promoted for
+ * a new term and the old master is fenced; when the old master comes back
+ * it rejoins as a slave after reconciling its log with the new master's.
  */
 class ReplicationSystem {
 public:
     /**
-     * Creates a new replication system with a master and the specified number of slaves.
-     * @param numSlaves the number of slave nodes to create
+     * Creates a new replication system with a master and the specified number of slaves
+     * per shard, hash-partitioned across numShards shards.
+     * @param numSlaves the number of slave nodes to create for each shard
+     * @param numShards the number of shards (each with its own master)
+     * @param eventLoop runs the replication work of every node, including
+     *        nodes added or promoted later; when null, each node starts a
+     *        private thread pool
      */
-    explicit ReplicationSystem(int numSlaves);
+    explicit ReplicationSystem(int numSlaves, int numShards = 1,
+                               std::shared_ptr<node::EventLoop> eventLoop = nullptr);
+
+    /**
+     * Creates a new replication system partitioned by the given router.
+     * @param numSlaves the number of slave nodes to create for each shard
+     * @param router the key-to-shard mapping
+     * @param eventLoop runs the replication work of every node; when null,
+     *        each node starts a private thread pool
+     */
+    ReplicationSystem(int numSlaves, const ShardRouter& router,
+                      std::shared_ptr<node::EventLoop> eventLoop = nullptr);
     
     /**
      * Destructor that ensures proper cleanup
@@ -42,6 +129,16 @@ public:
      * @return true if the write was successful
      */
     bool write(const std::string& key, const std::string& value);
+
+    /**
+     * Writes a key-value pair that the master deletes, through the log,
+     * once the time to live has passed.
+     * @param key the key to write
+     * @param value the value to write
+     * @param ttl the time to live, which must be positive
+     * @return true if the write was successful
+     */
+    bool write(const std::string& key, const std::string& value, std::chrono::milliseconds ttl);
     
     /**
      * Deletes a key-value pair from the master.
@@ -50,6 +147,40 @@ public:
      */
     bool deleteKey(const std::string& key);
 
+    /**
+     * Writes a key on its master only if it holds the expected value.
+     * @return true if the value matched and the key was written
+     */
+    bool compareAndSet(const std::string& key, const std::string& expected, const std::string& value);
+
+    /**
+     * Writes a key on its master only if it is at the expected version.
+     * @param expectedVersion a version from readVersioned(), or 0 if the key must not exist
+     * @return true if the version matched and the key was written
+     */
+    bool compareAndSetVersion(const std::string& key, long expectedVersion, const std::string& value);
+
+    /**
+     * Atomically adds to the integer value of a key on its master.
+     * @param result receives the new value
+     * @return false if the value is not an integer, on overflow, or if the master is down
+     */
+    bool increment(const std::string& key, long long delta, long long& result);
+
+    /**
+     * Atomically appends to the value of a key on its master.
+     * @param length receives the length of the new value
+     * @return false if the master is down
+     */
+    bool append(const std::string& key, const std::string& suffix, size_t& length);
+
+    /**
+     * Reads a value and its version from a random slave. A version read
+     * from a lagging slave is merely old, so a compare-and-set with it fails.
+     * @return true if the key was found
+     */
+    bool readVersioned(const std::string& key, std::string& value, long& version);
+
     /**
      * Reads a value from a random slave node.
      * If the chosen slave is down, tries another slave.
@@ -59,7 +190,67 @@ public:
     std::string read(const std::string& key);
 
     /**
-     * Gets the data store of a random slave that is up.
+     * Reads a value from a random slave that satisfies the staleness bound.
+     * A slave's lag is measured from its published applied-index and
+     * timestamp watermarks: entries behind the master, and, if behind at
+     * all, the time since its last applied entry was written (an upper
+     * bound on how long it has been missing data). If no slave qualifies,
+     * the read is served by the master.
+     * @param key the key to read
+     * @param bound the maximum staleness the caller accepts
+     * @return the value, or empty string if not found or no node can serve it
+     */
+    std::string read(const std::string& key, const StalenessBound& bound);
+
+    /**
+     * Reads several keys, possibly spanning shards. Keys are grouped by
+     * shard and each group is read from one slave of that shard.
+     * @param keys the keys to read
+     * @return the values in the order of keys (empty string if not found)
+     */
+    std::vector<std::string> multiGet(const std::vector<std::string>& keys);
+
+    /**
+     * Reads several keys like multiGet(), telling a missing key apart from
+     * one holding the empty string.
+     * @param found receives, in the order of keys, whether each key was found
+     */
+    std::vector<std::string> multiGet(const std::vector<std::string>& keys, std::vector<bool>& found);
+
+    /**
+     * Reads several keys with a consistent snapshot per shard: each shard's
+     * group is read from one slave as of a single log index, without
+     * pausing that slave's applier. Shards have independent logs, so there
+     * is no common index across them.
+     * @param values receives the values in the order of keys (empty string if not found)
+     * @return true if every shard's group was read consistently
+     */
+    bool multiGetConsistent(const std::vector<std::string>& keys, std::vector<std::string>& values);
+
+    /**
+     * Reads every key starting with a prefix, in ascending key order. Keys
+     * of any shard can share a prefix, so each shard is scanned on one of
+     * its slaves and the results are merged.
+     * @param limit the most keys to return; 0 returns them all
+     * @return the keys and values (shards with every slave down are skipped)
+     */
+    std::vector<std::pair<std::string, std::string>> scanPrefix(const std::string& prefix, size_t limit = 0);
+
+    /**
+     * Loads a bulk import file, e.g. to seed a new cluster, without logging
+     * each key. The file is parsed on several threads and split by shard;
+     * each shard's master writes its pairs to an image file and sequences
+     * one load entry for them (see MasterNode::bulkLoad()), which its
+     * slaves apply by reading the image.
+     * @param path the CSV or binary file (see storage::BulkReader)
+     * @param imageDirectory where the image files are written; they must
+     *        stay there while the load entries may be replayed
+     * @return false if the file is malformed or a master refused its part
+     */
+    bool bulkLoad(const std::string& path, storage::BulkReader::Format format, const std::string& imageDirectory);
+
+    /**
+     * Gets the data store of a random slave that is up, merged across shards.
      * @return the data store, or empty map if all slaves are down
      */
     std::map<std::string, std::string> getDataStore() const;
@@ -75,10 +266,157 @@ public:
                               int checkIntervalSeconds);
 
     /**
-     * Gets all log entries from the master node.
+     * Starts the failure simulator with a sub-second check interval.
+     * @param failureProbability the probability of a node failing in each check
+     * @param recoveryProbability the probability of a failed node recovering in each check
+     * @param checkInterval the interval between checks
+     */
+    void startFailureSimulator(double failureProbability,
+                              double recoveryProbability,
+                              std::chrono::milliseconds checkInterval);
+
+    /**
+     * Waits until every up slave of a shard has applied the given log index.
+     * @param shard the shard index
+     * @param index the log index to wait for
+     * @param timeout how long to wait at most
+     * @return true if replication reached the index before the timeout
+     */
+    bool waitForReplication(int shard, long index,
+                            std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /**
+     * Waits until every up slave of every shard has applied all writes
+     * accepted so far. Use instead of sleeping after writes.
+     * @param timeout how long to wait at most, across all shards
+     * @return true if replication caught up before the timeout
+     */
+    bool quiesce(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+    /**
+     * Gets all log entries from the master node (of every shard, in shard order).
+     * Log IDs are only unique within a shard.
      * @return a list of all log entries from the master
      */
     std::vector<model::LogEntry> getLogs() const;
+
+    /**
+     * Gets all log entries from one shard's master.
+     * @param shard the shard index
+     */
+    std::vector<model::LogEntry> getLogs(int shard) const;
+
+    /**
+     * Subscribes to the entries one shard's master commits, instead of
+     * polling getLogs(). See MasterNode::subscribe(); after a failover,
+     * subscribe again from the last index the consumer received.
+     * @param shard the shard index
+     * @param afterIndex the last index the consumer already has (0 for everything)
+     * @param callback receives consecutive batches; returning false unsubscribes
+     * @return the subscription ID, or -1 if the master is down
+     */
+    long subscribe(int shard, long afterIndex, node::ChangeSubscription::Callback callback);
+
+    /**
+     * Ends a subscription on one shard's master.
+     * @return true if the subscription existed
+     */
+    bool unsubscribe(int shard, long subscriptionId);
+
+    /**
+     * Gets the number of shards.
+     */
+    int getShardCount() const;
+
+    /**
+     * Gets the shard owning a key.
+     */
+    int getShardForKey(const std::string& key) const;
+
+    /**
+     * Gets the master of a shard.
+     */
+    std::shared_ptr<node::MasterNode> getMaster(int shard = 0) const;
+
+    /**
+     * Gets the slaves of a shard.
+     */
+    std::vector<std::shared_ptr<node::SlaveNode>> getSlaves(int shard = 0) const;
+
+    /**
+     * Adds a read replica to a shard while it keeps serving. The new slave
+     * is bootstrapped from a snapshot of an up slave (or of the master when
+     * none is up), taken without pausing its applier, and then recovers
+     * only the entries logged after the snapshot. It serves reads from the
+     * snapshot mapping while the keys are loaded, and joins the configured
+     * topology once bootstrapped.
+     * @param shard the shard index
+     * @param snapshotDirectory where the bootstrap snapshot is written; the
+     *        system temporary directory when empty. The file is removed
+     *        once the slave has mapped it.
+     * @return the new slave, or nullptr if there is no such shard or no
+     *         snapshot could be taken
+     */
+    std::shared_ptr<node::SlaveNode> addSlave(int shard, const std::string& snapshotDirectory = "");
+
+    /**
+     * Removes a slave from a shard. Reads stop going to it at once and the
+     * remaining slaves are rewired into the topology. A slave fed by the
+     * master gets what is still queued for it before the master drops its
+     * state (see MasterNode::removeSlave()); one fed by a relay stops at
+     * the batch the relay is delivering. A shard keeps at least one slave,
+     * so it can still serve reads and fail over.
+     * @param shard the shard index
+     * @param slaveId the ID of the slave to remove
+     * @return false if there is no such shard or slave, or it is the last one
+     */
+    bool removeSlave(int shard, const std::string& slaveId);
+
+    /**
+     * Gets the current leader term of a shard.
+     */
+    long getTerm(int shard = 0) const;
+
+    /**
+     * Replaces the failover settings, restarting the failover monitor.
+     * @param config the new settings; enabled = false stops automatic failover
+     */
+    void configureFailover(const FailoverConfig& config);
+
+    /**
+     * Rewires every shard's slaves into the given topology. Relaying slaves
+     * forward each batch they apply on their own executor, and slaves
+     * recover from the nearest relay above them, so the master's fan-out
+     * stays constant however many slaves there are. Applied again after
+     * every failover and rejoin.
+     * @param config the topology; STAR is the default
+     */
+    void configureTopology(const TopologyConfig& config);
+
+    /**
+     * Bounds every shard's data store and log, evicting keys through each
+     * master's log once a write takes them past the limit. Every node of
+     * the shard compacts its log (see AbstractNode::setLogCompaction()).
+     * Applied again to the new master after every failover, and to slaves
+     * added or rejoined later.
+     * @param config the limit and eviction policy
+     */
+    void configureMemory(const MemoryConfig& config);
+
+    /**
+     * Switches the data store of every node to the given engine, moving
+     * the keys each one holds. Promoted slaves and rejoining masters are
+     * switched too.
+     * @param config the storage engine
+     */
+    void configureStorage(const StorageConfig& config);
+
+    /**
+     * Gets the duration of the most recent failover, from the old master
+     * going down to the first successful write on the new one.
+     * @return the duration in milliseconds, or -1 if no failover completed
+     */
+    long getLastFailoverMillis() const;
     
     /**
      * Gets the status of all nodes in the system.
@@ -93,10 +431,48 @@ public:
 
 private:
     /**
-     * Gets a random slave that is up (not failed).
+     * A partition of the keyspace with its own master, log and slaves.
+     */
+    struct Shard {
+        std::shared_ptr<node::MasterNode> master;
+        std::vector<std::shared_ptr<node::SlaveNode>> slaves;
+        // Fenced former masters waiting to come back up and rejoin as slaves
+        std::vector<std::shared_ptr<node::MasterNode>> deposed;
+        // When the replaced master went down, until the first write on the new one
+        long failoverStartedAt = -1;
+        // Number given to the next slave added, so slave IDs are never reused
+        int nextSlaveNumber = 0;
+    };
+
+    /**
+     * Creates the masters and slaves of every shard.
+     */
+    void createShards(int numSlaves);
+
+    /**
+     * Gets a random slave of a shard that is up (not failed).
+     * @param shard the shard index
      * @return a random up slave, or nullptr if all slaves are down
      */
-    std::shared_ptr<node::SlaveNode> getRandomUpSlave() const;
+    std::shared_ptr<node::SlaveNode> getRandomUpSlave(int shard) const;
+
+    /**
+     * Groups the positions of keys by the shard owning each key.
+     */
+    std::vector<std::vector<size_t>> groupByShard(const std::vector<std::string>& keys) const;
+
+    /**
+     * Gets a random up slave of a shard whose lag is within the bound.
+     * @param shard the shard index
+     * @param bound the maximum staleness allowed
+     * @return a random fresh slave, or nullptr if none qualifies
+     */
+    std::shared_ptr<node::SlaveNode> getFreshUpSlave(int shard, const StalenessBound& bound) const;
+
+    /**
+     * Picks a random node from a non-empty list.
+     */
+    std::shared_ptr<node::SlaveNode> pickRandom(const std::vector<std::shared_ptr<node::SlaveNode>>& slaves) const;
     
     /**
      * Simulates node failures and recoveries.
@@ -105,13 +481,83 @@ private:
      */
     void simulateFailureAndRecovery(double failureProbability, double recoveryProbability);
     
+    /**
+     * Stops the failure simulator thread, if running.
+     */
+    void stopFailureSimulator();
+
     /**
      * The failure simulator thread function
      */
     void failureSimulatorThread();
 
-    std::shared_ptr<node::MasterNode> master_;
-    std::vector<std::shared_ptr<node::SlaveNode>> slaves_;
+    void startFailoverMonitor();
+    void stopFailoverMonitor();
+
+    /**
+     * The failover monitor thread function
+     */
+    void failoverMonitorThread();
+
+    /**
+     * Elects a new master for a shard whose master is down: fences the old
+     * master, raises every slave to the new term and promotes the slave with
+     * the highest log index. The promoted slave's state is copied without
+     * the topology lock, which is only held exclusively to swap the nodes in.
+     * @param shard the shard index
+     * @return true if a new master was installed
+     */
+    bool electNewMaster(int shard);
+
+    /**
+     * Turns deposed masters that came back up into slaves of the current master.
+     * @param shard the shard index
+     */
+    void rejoinDeposedMasters(int shard);
+
+    /**
+     * Records the failover duration on the first successful write after an election.
+     */
+    void recordFailoverCompletion(int shard);
+
+    /**
+     * Links a shard's slaves into the configured topology, in slave order:
+     * slave i is fed by slave i / fanout - 1, or by the master for the
+     * first fanout slaves. Caller must hold topologyMutex_ exclusively.
+     */
+    void applyTopology(Shard& shard);
+
+    /**
+     * Sets a node's storage engine from the storage config. Caller must
+     * hold topologyMutex_ exclusively.
+     * @param term the term the node took its role at; 0 for the initial nodes
+     */
+    void applyStorage(node::AbstractNode& node, long term);
+
+    /**
+     * Sets a node's storage engine from a copy of the storage config, so
+     * no lock is needed.
+     */
+    static void applyStorage(node::AbstractNode& node, long term, const StorageConfig& storage);
+
+    /**
+     * Sets a slave's log compaction from the memory config. Caller must
+     * hold topologyMutex_.
+     */
+    void applyMemory(node::SlaveNode& slave);
+
+    /**
+     * Lets go of a node that left the system. On a shared event loop the
+     * node is kept until the tasks it queued have run.
+     */
+    void retireNode(std::shared_ptr<node::AbstractNode> node);
+
+    ShardRouter router_;
+    // Shared by every node when set; see node::EventLoop
+    std::shared_ptr<node::EventLoop> eventLoop_;
+    std::vector<Shard> shards_;
+    // Guards the shard topology (masters and slave lists), which failover changes
+    mutable std::shared_mutex topologyMutex_;
     mutable std::mt19937 random_;  // Mersenne Twister random number generator
     mutable std::mutex randomMutex_;
     
@@ -120,9 +566,26 @@ private:
     std::atomic<bool> stopFailureSimulator_;
     double failureProbability_;
     double recoveryProbability_;
-    int checkIntervalSeconds_;
+    std::chrono::milliseconds checkInterval_;
     std::mutex failureSimulatorMutex_;
     std::condition_variable failureSimulatorCV_;
+
+    // Failover monitor control
+    FailoverConfig failoverConfig_;
+    std::thread failoverMonitorThread_;
+    std::atomic<bool> stopFailoverMonitor_;
+    std::mutex failoverMonitorMutex_;
+    std::condition_variable failoverMonitorCV_;
+    std::atomic<int> pendingFailovers_;
+    std::atomic<long> lastFailoverMillis_;
+
+    // Serializes bulk loads, so image names made from a master's index stay unique
+    std::mutex bulkLoadMutex_;
+
+    // Guarded by topologyMutex_
+    TopologyConfig topology_;
+    MemoryConfig memory_;
+    StorageConfig storage_;
 };
 
 } // namespace system
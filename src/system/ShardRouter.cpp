@@ -0,0 +1,59 @@
+#include "system/ShardRouter.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace replication {
+namespace system {
+
+ShardRouter::ShardRouter(Scheme scheme, int numShards, std::vector<std::string> splitPoints)
+    : scheme_(scheme),
+      numShards_(numShards),
+      splitPoints_(std::move(splitPoints)) {
+}
+
+ShardRouter ShardRouter::hashPartitioned(int numShards) {
+    if (numShards < 1) {
+        throw std::invalid_argument("shard count must be at least 1");
+    }
+    return ShardRouter(Scheme::HASH, numShards, {});
+}
+
+ShardRouter ShardRouter::rangePartitioned(std::vector<std::string> splitPoints) {
+    if (!std::is_sorted(splitPoints.begin(), splitPoints.end()) ||
+        std::adjacent_find(splitPoints.begin(), splitPoints.end()) != splitPoints.end()) {
+        throw std::invalid_argument("split points must be strictly ascending");
+    }
+    int numShards = static_cast<int>(splitPoints.size()) + 1;
+    return ShardRouter(Scheme::RANGE, numShards, std::move(splitPoints));
+}
+
+int ShardRouter::shardFor(const std::string& key) const {
+    if (numShards_ == 1) {
+        return 0;
+    }
+    if (scheme_ == Scheme::RANGE) {
+        auto it = std::upper_bound(splitPoints_.begin(), splitPoints_.end(), key);
+        return static_cast<int>(std::distance(splitPoints_.begin(), it));
+    }
+    return static_cast<int>(hashKey(key) % static_cast<uint64_t>(numShards_));
+}
+
+int ShardRouter::getShardCount() const {
+    return numShards_;
+}
+
+ShardRouter::Scheme ShardRouter::getScheme() const {
+    return scheme_;
+}
+
+uint64_t ShardRouter::hashKey(const std::string& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace system
+} // namespace replication
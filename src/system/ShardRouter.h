@@ -0,0 +1,65 @@
+#ifndef SHARD_ROUTER_H
+#define SHARD_ROUTER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace replication {
+namespace system {
+
+/**
+ * Maps keys to shards of a partitioned replication system.
+ *
+ * Hash partitioning spreads keys uniformly using a stable 64-bit FNV-1a
+ * hash, so the mapping is identical across processes and runs. Range
+ * partitioning keeps lexicographically adjacent keys together: shard i owns
+ * keys in [splitPoints[i-1], splitPoints[i]).
+ */
+class ShardRouter {
+public:
+    /**
+     * Partitioning scheme used by the router.
+     */
+    enum class Scheme {
+        HASH,
+        RANGE
+    };
+
+    /**
+     * Creates a hash-partitioned router.
+     * @param numShards the number of shards (at least 1)
+     */
+    static ShardRouter hashPartitioned(int numShards);
+
+    /**
+     * Creates a range-partitioned router with splitPoints.size() + 1 shards.
+     * @param splitPoints strictly ascending boundaries between shards
+     */
+    static ShardRouter rangePartitioned(std::vector<std::string> splitPoints);
+
+    /**
+     * Gets the shard owning a key.
+     */
+    int shardFor(const std::string& key) const;
+
+    int getShardCount() const;
+    Scheme getScheme() const;
+
+    /**
+     * Stable 64-bit FNV-1a hash of a key.
+     */
+    static uint64_t hashKey(const std::string& key);
+
+private:
+    ShardRouter(Scheme scheme, int numShards, std::vector<std::string> splitPoints);
+
+    Scheme scheme_;
+    int numShards_;
+    std::vector<std::string> splitPoints_;
+};
+
+} // namespace system
+} // namespace replication
+
+#endif // SHARD_ROUTER_H
@@ -0,0 +1,139 @@
+// tests/AtomicOperationTest.cpp
+#include <gtest/gtest.h>
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <set>
+#include <thread>
+#include <climits>
+
+using namespace replication;
+
+class AtomicOperationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("atomic-master");
+        slave1 = std::make_shared<node::SlaveNode>("atomic-slave-1", master);
+        slave2 = std::make_shared<node::SlaveNode>("atomic-slave-2", master);
+        master->registerSlave(slave1);
+        master->registerSlave(slave2);
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    std::shared_ptr<node::SlaveNode> slave1;
+    std::shared_ptr<node::SlaveNode> slave2;
+};
+
+TEST_F(AtomicOperationTest, TestCompareAndSet) {
+    // Version 0 means "must not exist"
+    EXPECT_TRUE(master->compareAndSetVersion("config", 0, "v1"));
+    EXPECT_FALSE(master->compareAndSetVersion("config", 0, "v1-again"));
+    ASSERT_TRUE(master->quiesce());
+
+    std::string value;
+    long version = 0;
+    ASSERT_TRUE(slave1->readVersioned("config", value, version));
+    EXPECT_EQ("v1", value);
+    EXPECT_EQ(1, version);  // The ID of the write
+
+    // A writer holding the current version wins; one holding an old version loses
+    EXPECT_TRUE(master->compareAndSetVersion("config", version, "v2"));
+    EXPECT_FALSE(master->compareAndSetVersion("config", version, "lost-update"));
+    EXPECT_TRUE(master->compareAndSet("config", "v2", "v3"));
+    EXPECT_FALSE(master->compareAndSet("config", "v2", "v4"));
+    EXPECT_FALSE(master->compareAndSet("missing", "", "v"));
+    ASSERT_TRUE(master->quiesce());
+
+    // Failed operations are logged as no-ops, so logs stay dense and identical
+    auto log = slave2->getLogEntriesAfter(0);
+    ASSERT_EQ(7u, log.size());
+    EXPECT_EQ(model::LogEntry::OperationType::NOOP, log[1].getOperationType());
+    EXPECT_EQ(model::LogEntry::OperationType::WRITE, log[2].getOperationType());
+    EXPECT_EQ(model::LogEntry::OperationType::NOOP, log[3].getOperationType());
+    EXPECT_EQ("v3", slave2->read("config"));
+    ASSERT_TRUE(slave2->readVersioned("config", value, version));
+    EXPECT_EQ(5, version);
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+}
+
+TEST_F(AtomicOperationTest, TestConcurrentIncrements) {
+    const int threads = 8;
+    const int perThread = 250;
+    std::vector<std::vector<long long>> results(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < perThread; i++) {
+                long long result = 0;
+                ASSERT_TRUE(master->increment("hits", 1, result));
+                results[t].push_back(result);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ASSERT_TRUE(master->quiesce());
+
+    // Every increment saw a distinct value and none was lost
+    std::set<long long> seen;
+    for (const auto& perWorker : results) {
+        seen.insert(perWorker.begin(), perWorker.end());
+    }
+    EXPECT_EQ(static_cast<size_t>(threads * perThread), seen.size());
+    EXPECT_EQ(std::to_string(threads * perThread), slave1->read("hits"));
+    EXPECT_EQ(std::to_string(threads * perThread), slave2->read("hits"));
+
+    // Slaves only ever see resolved writes
+    for (const auto& entry : slave1->getLogEntriesAfter(0)) {
+        EXPECT_EQ(model::LogEntry::OperationType::WRITE, entry.getOperationType());
+    }
+}
+
+TEST_F(AtomicOperationTest, TestIncrementAndAppendEdgeCases) {
+    long long result = 0;
+    EXPECT_TRUE(master->increment("counter", -5, result));
+    EXPECT_EQ(-5, result);
+    EXPECT_TRUE(master->write("text", "abc"));
+    EXPECT_FALSE(master->increment("text", 1, result));
+    EXPECT_TRUE(master->write("big", std::to_string(LLONG_MAX)));
+    EXPECT_FALSE(master->increment("big", 1, result));
+
+    size_t length = 0;
+    EXPECT_TRUE(master->append("text", "def", length));
+    EXPECT_EQ(6u, length);
+    EXPECT_TRUE(master->append("fresh", "xy", length));
+    EXPECT_EQ(2u, length);
+    ASSERT_TRUE(master->quiesce());
+
+    EXPECT_EQ("-5", slave1->read("counter"));
+    EXPECT_EQ("abcdef", slave1->read("text"));
+    EXPECT_EQ("xy", slave1->read("fresh"));
+    EXPECT_EQ(std::to_string(LLONG_MAX), slave1->read("big"));
+
+    master->goDown();
+    EXPECT_FALSE(master->increment("counter", 1, result));
+    master->goUp();
+}
+
+TEST_F(AtomicOperationTest, TestVersionsSurviveFailover) {
+    ASSERT_TRUE(master->write("a", "1"));
+    ASSERT_TRUE(master->write("b", "2"));
+    ASSERT_TRUE(master->write("a", "3"));
+    ASSERT_TRUE(master->quiesce());
+    master->fence();
+
+    auto successor = std::make_shared<node::MasterNode>("atomic-successor");
+    successor->assumeLeadership(*slave1, 1);
+
+    std::string value;
+    long version = 0;
+    ASSERT_TRUE(successor->readVersioned("a", value, version));
+    EXPECT_EQ(3, version);
+    EXPECT_TRUE(successor->compareAndSetVersion("a", 3, "4"));
+    EXPECT_FALSE(master->compareAndSetVersion("a", 4, "5"));  // Fenced
+    successor->shutdown();
+}
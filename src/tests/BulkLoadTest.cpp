@@ -0,0 +1,244 @@
+// tests/BulkLoadTest.cpp
+#include <gtest/gtest.h>
+#include "storage/BulkReader.h"
+#include "storage/SnapshotFormat.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include "system/ReplicationSystem.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <unistd.h>
+
+using namespace replication;
+
+class BulkLoadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        directory = (std::filesystem::temp_directory_path() /
+                     ("bulk-load-test-" + std::to_string(::getpid()) + "-" + name)).string();
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    std::string writeFile(const std::string& name, const std::string& contents) const {
+        std::string path = (std::filesystem::path(directory) / name).string();
+        std::ofstream(path, std::ios::binary) << contents;
+        return path;
+    }
+
+    static std::string keyFor(int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key-%06d", i);
+        return key;
+    }
+
+    std::string directory;
+};
+
+TEST_F(BulkLoadTest, TestParsesCsv) {
+    std::string path = writeFile("input.csv",
+                                 "b,2\n"
+                                 "a,1\r\n"
+                                 "\n"
+                                 "\"c,d\",\"say \"\"hi\"\"\"\n"
+                                 "e,with,commas\n"
+                                 "a,replaced");
+    storage::BulkReader reader(storage::BulkReader::Format::CSV);
+    storage::BulkReader::Pairs pairs;
+    ASSERT_TRUE(reader.read(path, pairs)) << reader.getError();
+    EXPECT_EQ(5u, reader.getRecordCount());
+    storage::BulkReader::Pairs expected = {
+        {"a", "replaced"}, {"b", "2"}, {"c,d", "say \"hi\""}, {"e", "with,commas"}};
+    EXPECT_EQ(expected, pairs);
+
+    path = writeFile("malformed.csv", "a,1\nno comma here\n");
+    EXPECT_FALSE(reader.read(path, pairs));
+    EXPECT_NE(std::string::npos, reader.getError().find("byte 4"));
+    EXPECT_FALSE(reader.read(directory + "/missing.csv", pairs));
+}
+
+TEST_F(BulkLoadTest, TestParallelMatchesSequential) {
+    // Large enough to be split into several ranges, with keys repeated across them
+    std::string csv;
+    std::string binary;
+    std::map<std::string, std::string> expected;
+    for (int i = 0; i < 60000; i++) {
+        std::string key = keyFor((i * 7919) % 20000);
+        std::string value = "value-" + std::to_string(i);
+        csv += key + "," + value + "\n";
+        storage::BulkReader::appendBinaryRecord(binary, key, value);
+        expected[key] = value;
+    }
+    storage::BulkReader::Pairs expectedPairs(expected.begin(), expected.end());
+
+    for (auto format : {storage::BulkReader::Format::CSV, storage::BulkReader::Format::BINARY}) {
+        std::string path = format == storage::BulkReader::Format::CSV ? writeFile("input.csv", csv)
+                                                                       : writeFile("input.bin", binary);
+        for (size_t threads : {1u, 8u}) {
+            storage::BulkReader reader(format, threads);
+            storage::BulkReader::Pairs pairs;
+            ASSERT_TRUE(reader.read(path, pairs)) << reader.getError();
+            EXPECT_EQ(60000u, reader.getRecordCount());
+            EXPECT_EQ(expectedPairs, pairs);
+        }
+    }
+
+    // A record cut short is reported, not read past the end
+    std::string path = writeFile("truncated.bin", binary.substr(0, binary.size() - 3));
+    storage::BulkReader reader(storage::BulkReader::Format::BINARY, 4);
+    storage::BulkReader::Pairs pairs;
+    EXPECT_FALSE(reader.read(path, pairs));
+    EXPECT_NE(std::string::npos, reader.getError().find("truncated"));
+}
+
+TEST_F(BulkLoadTest, TestLoadReplicatesAsOneEntry) {
+    auto master = std::make_shared<node::MasterNode>("bulk-master");
+    auto slave = std::make_shared<node::SlaveNode>("bulk-slave", master);
+    auto parallelSlave = std::make_shared<node::SlaveNode>("bulk-parallel-slave", master);
+    auto downSlave = std::make_shared<node::SlaveNode>("bulk-down-slave", master);
+    parallelSlave->setApplyParallelism(4);
+    for (const auto& node : {slave, parallelSlave, downSlave}) {
+        master->registerSlave(node);
+    }
+
+    ASSERT_TRUE(master->write(keyFor(1), "before"));
+    ASSERT_TRUE(master->write("expiring", "x", std::chrono::hours(1)));
+    downSlave->goDown();
+
+    storage::BulkReader::Pairs pairs = {{"expiring", "loaded"}};
+    for (int i = 0; i < 5000; i++) {
+        pairs.emplace_back(keyFor(i), "loaded-" + std::to_string(i));
+    }
+    std::string image = directory + "/load.image";
+    ASSERT_TRUE(master->bulkLoad(pairs, image));
+    ASSERT_TRUE(master->write(keyFor(2), "after"));
+
+    // Writes, the expiry pair, the load and the last write
+    auto log = master->getLogEntriesAfter(0);
+    ASSERT_EQ(5u, log.size());
+    EXPECT_TRUE(log[3].isLoad());
+    EXPECT_EQ(image, log[3].getValue());
+    EXPECT_EQ("loaded-1", master->read(keyFor(1)));
+    EXPECT_EQ("after", master->read(keyFor(2)));
+    EXPECT_EQ(0, master->getExpiresAt("expiring"));
+    std::string value;
+    long version;
+    ASSERT_TRUE(master->readVersioned(keyFor(4999), value, version));
+    EXPECT_EQ(log[3].getId(), version);
+
+    downSlave->goUp();
+    ASSERT_TRUE(master->quiesce());
+    auto expected = master->getDataStore();
+    EXPECT_EQ(5001u, expected.size());
+    for (const auto& node : {slave, parallelSlave, downSlave}) {
+        EXPECT_EQ(expected, node->getDataStore()) << node->getId();
+        EXPECT_EQ(master->getLastLogIndex(), node->getLastLogIndex());
+        EXPECT_EQ(0, node->getExpiresAt("expiring"));
+    }
+
+    // Refused without writing anything once the master cannot take writes
+    master->goDown();
+    EXPECT_FALSE(master->bulkLoad(pairs, directory + "/refused.image"));
+    EXPECT_FALSE(std::filesystem::exists(directory + "/refused.image"));
+    master->shutdown();
+}
+
+TEST_F(BulkLoadTest, TestMissingImageFetchesMasterState) {
+    auto master = std::make_shared<node::MasterNode>("bulk-master");
+    auto slave = std::make_shared<node::SlaveNode>("bulk-slave", master);
+    master->registerSlave(slave);
+    ASSERT_TRUE(master->write("first", "1"));
+    ASSERT_TRUE(master->quiesce());
+
+    slave->goDown();
+    storage::BulkReader::Pairs pairs;
+    for (int i = 0; i < 100; i++) {
+        pairs.emplace_back(keyFor(i), std::to_string(i));
+    }
+    std::string image = directory + "/lost.image";
+    ASSERT_TRUE(master->bulkLoad(pairs, image));
+    ASSERT_TRUE(master->write("last", "2"));
+    std::filesystem::remove(image);
+
+    // The slave stops at the load instead of skipping it, goes down and copies the master
+    slave->goUp();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (slave->getLastLogIndex() != master->getLastLogIndex() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    EXPECT_EQ("99", slave->read(keyFor(99)));
+
+    ASSERT_TRUE(master->write("after", "3"));
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    EXPECT_EQ("3", slave->read("after"));
+    master->shutdown();
+}
+
+TEST_F(BulkLoadTest, TestCorruptImageFetchesMasterState) {
+    auto master = std::make_shared<node::MasterNode>("bulk-master");
+    auto slave = std::make_shared<node::SlaveNode>("bulk-slave", master);
+    master->registerSlave(slave);
+    ASSERT_TRUE(master->write("first", "1"));
+    ASSERT_TRUE(master->quiesce());
+
+    slave->goDown();
+    storage::BulkReader::Pairs pairs;
+    for (int i = 0; i < 100; i++) {
+        pairs.emplace_back(keyFor(i), std::to_string(i));
+    }
+    std::string image = directory + "/damaged.image";
+    ASSERT_TRUE(master->bulkLoad(pairs, image));
+    ASSERT_TRUE(master->write("last", "2"));
+
+    // Flip one byte inside the first data block
+    {
+        std::fstream file(image, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(storage::snapshot::kHeaderSize + 20));
+        file.put('#');
+    }
+
+    // The image opens but fails its checksum, which takes the same path as a missing one
+    slave->goUp();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (slave->getLastLogIndex() != master->getLastLogIndex() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    EXPECT_EQ("0", slave->read(keyFor(0)));
+    EXPECT_EQ("99", slave->read(keyFor(99)));
+    master->shutdown();
+}
+
+TEST_F(BulkLoadTest, TestSystemLoadsEveryShard) {
+    std::string binary;
+    for (int i = 0; i < 3000; i++) {
+        storage::BulkReader::appendBinaryRecord(binary, keyFor(i), std::to_string(i));
+    }
+    std::string path = writeFile("seed.bin", binary);
+
+    system::ReplicationSystem system(2, 3);
+    ASSERT_TRUE(system.bulkLoad(path, storage::BulkReader::Format::BINARY, directory + "/images"));
+    ASSERT_TRUE(system.quiesce());
+    for (int shard = 0; shard < system.getShardCount(); shard++) {
+        auto log = system.getLogs(shard);
+        ASSERT_EQ(1u, log.size());
+        EXPECT_TRUE(log[0].isLoad());
+    }
+    EXPECT_EQ(3000u, system.getDataStore().size());
+    EXPECT_EQ("1234", system.read(keyFor(1234)));
+
+    EXPECT_FALSE(system.bulkLoad(directory + "/missing.bin", storage::BulkReader::Format::BINARY,
+                                 directory + "/images"));
+    system.shutdown();
+}
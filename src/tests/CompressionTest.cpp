@@ -0,0 +1,221 @@
+// tests/CompressionTest.cpp
+#include <gtest/gtest.h>
+#include "storage/Compression.h"
+#include "storage/LogBatchCodec.h"
+#include "storage/WriteAheadLog.h"
+#include "storage/SnapshotReader.h"
+#include "storage/SnapshotWriter.h"
+#include "node/SlaveNode.h"
+#include "node/MasterNode.h"
+#include <filesystem>
+#include <random>
+#include <unistd.h>
+
+using namespace replication;
+
+class CompressionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory = (std::filesystem::temp_directory_path() /
+                     ("compression-test-" + std::to_string(::getpid()) + "-" +
+                      ::testing::UnitTest::GetInstance()->current_test_info()->name())).string();
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    static uint64_t directorySize(const std::string& path) {
+        uint64_t total = 0;
+        for (const auto& file : std::filesystem::directory_iterator(path)) {
+            if (file.path().extension() == ".log") {
+                total += file.file_size();
+            }
+        }
+        return total;
+    }
+
+    // A hot-key, update-heavy workload with repetitive values
+    static std::vector<model::LogEntry> sampleEntries(long count) {
+        std::vector<model::LogEntry> entries;
+        for (long i = 1; i <= count; i++) {
+            std::string key = "user:" + std::to_string(i % 7);
+            if (i % 11 == 0) {
+                entries.emplace_back(i, key, "", model::LogEntry::OperationType::DELETE, 1000 + i, 1 + i / 50);
+            } else {
+                entries.emplace_back(i, key, "{\"status\":\"active\",\"visits\":" + std::to_string(i % 3) + "}",
+                                     model::LogEntry::OperationType::WRITE, 1000 + i, 1 + i / 50);
+            }
+        }
+        return entries;
+    }
+
+    std::string directory;
+};
+
+TEST_F(CompressionTest, TestCompressorsRoundTrip) {
+    std::mt19937 random(7);
+    std::string noise(5000, '\0');
+    for (auto& c : noise) {
+        c = static_cast<char>(random());
+    }
+    std::string repetitive;
+    for (int i = 0; i < 500; i++) {
+        repetitive += "key-" + std::to_string(i % 10) + "=value;";
+    }
+    std::string dictionary = storage::Compressor::trainDictionary({"key-1=value;", "key-2=value;", "key-1=value;"});
+    EXPECT_FALSE(dictionary.empty());
+
+    for (auto type : {storage::CompressionType::NONE, storage::CompressionType::FAST,
+                      storage::CompressionType::DICTIONARY}) {
+        auto compressor = storage::Compressor::create(type, dictionary);
+        for (const std::string& input : {std::string(), std::string("abc"), noise, repetitive,
+                                         std::string(70000, 'x')}) {
+            std::string compressed;
+            compressor->compress(input.data(), input.size(), compressed);
+            std::string restored;
+            ASSERT_TRUE(compressor->decompress(compressed.data(), compressed.size(), input.size(), restored));
+            EXPECT_EQ(input, restored);
+        }
+    }
+
+    auto fast = storage::Compressor::create(storage::CompressionType::FAST);
+    std::string compressed;
+    fast->compress(repetitive.data(), repetitive.size(), compressed);
+    EXPECT_LT(compressed.size() * 10, repetitive.size());
+
+    // Truncated or mislabelled input is refused
+    std::string restored;
+    EXPECT_FALSE(fast->decompress(compressed.data(), compressed.size() / 2, repetitive.size(), restored));
+    EXPECT_FALSE(fast->decompress(compressed.data(), compressed.size(), repetitive.size() + 1, restored));
+
+    // A dictionary lets a single small value compress
+    auto primed = storage::Compressor::create(storage::CompressionType::DICTIONARY, dictionary);
+    std::string small = "key-1=value;";
+    std::string withDictionary, withoutDictionary;
+    primed->compress(small.data(), small.size(), withDictionary);
+    fast->compress(small.data(), small.size(), withoutDictionary);
+    EXPECT_LT(withDictionary.size(), withoutDictionary.size());
+}
+
+TEST_F(CompressionTest, TestLogBatchRoundTripAndDedup) {
+    auto entries = sampleEntries(500);
+    size_t plainSize = 0;
+    for (const auto& entry : entries) {
+        plainSize += storage::LogCodec::encodedSize(entry);
+    }
+
+    std::vector<size_t> frameSizes;
+    for (auto type : {storage::CompressionType::NONE, storage::CompressionType::FAST}) {
+        storage::LogBatchCodec codec(type);
+        std::string frame;
+        codec.encode(entries, frame);
+        ASSERT_TRUE(storage::LogBatchCodec::isFrame(frame.data()));
+        // Keys are sent once and IDs/timestamps as one-byte deltas
+        EXPECT_LT(frame.size() * 2, plainSize);
+        frameSizes.push_back(frame.size());
+
+        std::vector<model::LogEntry> decoded;
+        size_t consumed = 0;
+        ASSERT_EQ(storage::LogCodec::Status::COMPLETE,
+                  codec.decode(frame.data(), frame.size(), consumed, decoded));
+        EXPECT_EQ(frame.size(), consumed);
+        ASSERT_EQ(entries.size(), decoded.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+            EXPECT_EQ(entries[i].toString(), decoded[i].toString());
+        }
+
+        EXPECT_EQ(storage::LogCodec::Status::INCOMPLETE,
+                  codec.decode(frame.data(), frame.size() - 1, consumed, decoded));
+        frame[frame.size() - 1] ^= 0x01;
+        EXPECT_EQ(storage::LogCodec::Status::CORRUPT,
+                  codec.decode(frame.data(), frame.size(), consumed, decoded));
+    }
+    EXPECT_LT(frameSizes[1] * 2, frameSizes[0]);
+}
+
+TEST_F(CompressionTest, TestCompressedWalReopensWithAnySetting) {
+    auto entries = sampleEntries(2000);
+    std::string plainDirectory = directory + "/plain";
+    std::string compressedDirectory = directory + "/compressed";
+
+    for (const auto& [path, type] : {std::make_pair(plainDirectory, storage::CompressionType::NONE),
+                                     std::make_pair(compressedDirectory, storage::CompressionType::DICTIONARY)}) {
+        storage::WalConfig config;
+        config.directory = path;
+        config.backend = storage::IoBackendType::POSIX;
+        config.compression = type;
+        config.dictionary = "{\"status\":\"active\",\"visits\":";
+        storage::WriteAheadLog wal(config);
+        ASSERT_TRUE(wal.open());
+        for (const auto& entry : entries) {
+            ASSERT_TRUE(wal.append(entry));
+        }
+        ASSERT_TRUE(wal.flush());
+    }
+    EXPECT_LT(directorySize(compressedDirectory) * 3, directorySize(plainDirectory));
+
+    // The saved dictionary is used even when the caller no longer passes one
+    storage::WalConfig config;
+    config.directory = compressedDirectory;
+    config.backend = storage::IoBackendType::POSIX;
+    storage::WriteAheadLog reopened(config);
+    ASSERT_TRUE(reopened.open());
+    EXPECT_EQ(2000, reopened.getLastIndex());
+    ASSERT_TRUE(reopened.append(model::LogEntry(2001, "plain", "record")));
+    ASSERT_TRUE(reopened.flush());
+
+    auto restored = reopened.readEntriesAfter(1990);
+    ASSERT_EQ(11u, restored.size());
+    EXPECT_EQ(entries[1990].toString(), restored.front().toString());
+    EXPECT_EQ("record", restored.back().getValue());
+}
+
+TEST_F(CompressionTest, TestCompressedSnapshot) {
+    std::string plainPath = directory + "/plain.snap";
+    std::string compressedPath = directory + "/compressed.snap";
+    for (const auto& [path, type] : {std::make_pair(plainPath, storage::CompressionType::NONE),
+                                     std::make_pair(compressedPath, storage::CompressionType::FAST)}) {
+        storage::SnapshotWriter writer(path, 42, 4096, type);
+        ASSERT_TRUE(writer.open());
+        for (int i = 0; i < 3000; i++) {
+            char key[32];
+            std::snprintf(key, sizeof(key), "key-%06d", i);
+            ASSERT_TRUE(writer.add(key, "{\"status\":\"active\",\"visits\":" + std::to_string(i % 5) + "}"));
+        }
+        ASSERT_TRUE(writer.finish());
+    }
+    EXPECT_LT(std::filesystem::file_size(compressedPath) * 2, std::filesystem::file_size(plainPath));
+
+    auto reader = storage::SnapshotReader::open(compressedPath);
+    ASSERT_NE(nullptr, reader);
+    EXPECT_EQ(storage::CompressionType::FAST, reader->getCompression());
+    EXPECT_EQ(3000u, reader->getEntryCount());
+    std::string value;
+    ASSERT_TRUE(reader->get("key-002024", value));
+    EXPECT_EQ("{\"status\":\"active\",\"visits\":4}", value);
+    EXPECT_FALSE(reader->get("key-999999", value));
+}
+
+TEST_F(CompressionTest, TestCoalescedBatchKeepsFullLog) {
+    auto master = std::make_shared<node::MasterNode>("coalesce-master");
+    auto coalesced = std::make_shared<node::SlaveNode>("coalesced", master);
+    auto plain = std::make_shared<node::SlaveNode>("plain", master);
+
+    auto entries = sampleEntries(300);
+    EXPECT_EQ(300u, coalesced->applyBatchFromLeader(entries, 10, true));
+    EXPECT_EQ(300u, plain->applyBatchFromLeader(entries, 10, false));
+
+    // Same state and log, with most overwritten operations skipped
+    EXPECT_EQ(plain->getDataStore(), coalesced->getDataStore());
+    EXPECT_EQ(300, coalesced->getLastLogIndex());
+    EXPECT_EQ(300u, coalesced->getLogEntriesAfter(0).size());
+    EXPECT_EQ(300u - 7, coalesced->getCoalescedCount());
+    EXPECT_EQ(0u, plain->getCoalescedCount());
+
+    // Only the in-sequence prefix is applied
+    std::vector<model::LogEntry> gap = {model::LogEntry(302, "k", "v")};
+    EXPECT_EQ(0u, coalesced->applyBatchFromLeader(gap, 10, true));
+}
@@ -0,0 +1,94 @@
+// tests/EventLoopTest.cpp
+#include <gtest/gtest.h>
+#include "node/EventLoop.h"
+#include "system/ReplicationSystem.h"
+#include "bench/ProcessStats.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+
+using namespace replication;
+using bench::countProcessThreads;
+
+TEST(EventLoopTest, TestRetiredObjectOutlivesEarlierTasks) {
+    node::EventLoop loop(2);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<int> ran{0};
+    loop.execute([released, &ran]() {
+        released.wait();
+        ran++;
+    });
+
+    auto object = std::make_shared<int>(42);
+    std::weak_ptr<int> watcher = object;
+    loop.retire(std::move(object));
+    for (int i = 0; i < 100; i++) {
+        loop.execute([&ran]() { ran++; });
+    }
+    EXPECT_FALSE(loop.waitForIdle(std::chrono::milliseconds(50)));
+    // Still held while a task queued before it is running
+    EXPECT_FALSE(watcher.expired());
+
+    release.set_value();
+    ASSERT_TRUE(loop.waitForIdle());
+    EXPECT_EQ(101, ran.load());
+    EXPECT_EQ(101u, loop.getTasksRun());
+    EXPECT_TRUE(watcher.expired());
+
+    // Nothing pending: released at once
+    auto idle = std::make_shared<int>(7);
+    watcher = idle;
+    loop.retire(std::move(idle));
+    EXPECT_TRUE(watcher.expired());
+}
+
+TEST(EventLoopTest, TestThousandNodesOnFewThreads) {
+    int threadsBefore = countProcessThreads();
+    auto eventLoop = std::make_shared<node::EventLoop>(4);
+    system::FailoverConfig failover;
+    failover.enabled = false;
+
+    // Ten nodes cost a system exactly as many threads as a thousand do
+    int loopThreads = countProcessThreads();
+    int tenNodeThreads = 0;
+    {
+        system::ReplicationSystem smallSystem(9, 1, eventLoop);
+        smallSystem.configureFailover(failover);
+        tenNodeThreads = countProcessThreads() - loopThreads;
+        smallSystem.shutdown();
+    }
+    ASSERT_TRUE(eventLoop->waitForIdle());
+
+    system::ReplicationSystem replicationSystem(9, 100, eventLoop);
+    replicationSystem.configureFailover(failover);
+    system::TopologyConfig topology;
+    topology.type = system::TopologyConfig::Type::CHAIN;
+    replicationSystem.configureTopology(topology);
+    EXPECT_EQ(tenNodeThreads, countProcessThreads() - loopThreads);
+    // 1,000 nodes add the loop's workers and the system's own threads, not five per node
+    EXPECT_LE(countProcessThreads() - threadsBefore, 8);
+
+    for (int i = 0; i < 3000; i++) {
+        ASSERT_TRUE(replicationSystem.write("key" + std::to_string(i), std::to_string(i)));
+    }
+    ASSERT_TRUE(replicationSystem.quiesce(std::chrono::seconds(30)));
+    for (int shard = 0; shard < replicationSystem.getShardCount(); shard++) {
+        long index = replicationSystem.getMaster(shard)->getLastLogIndex();
+        for (const auto& slave : replicationSystem.getSlaves(shard)) {
+            EXPECT_EQ(index, slave->getLastLogIndex()) << slave->getId();
+        }
+    }
+    EXPECT_EQ(3000u, replicationSystem.getDataStore().size());
+
+    // Members come and go on the same loop
+    auto added = replicationSystem.addSlave(7);
+    ASSERT_NE(nullptr, added);
+    EXPECT_TRUE(replicationSystem.removeSlave(7, "slave-7-0"));
+    ASSERT_TRUE(replicationSystem.write("after", "membership"));
+    ASSERT_TRUE(replicationSystem.quiesce());
+    EXPECT_EQ(replicationSystem.getMaster(7)->getLastLogIndex(), added->getLastLogIndex());
+    EXPECT_EQ(4u, eventLoop->getThreadCount());
+    replicationSystem.shutdown();
+}
@@ -0,0 +1,225 @@
+// tests/EvictionTest.cpp
+#include <gtest/gtest.h>
+#include "storage/StripedStore.h"
+#include "storage/MemoryAccounting.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include "system/ReplicationSystem.h"
+#include <thread>
+#include <chrono>
+
+using namespace replication;
+
+class EvictionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("eviction-master");
+        slave1 = std::make_shared<node::SlaveNode>("eviction-slave-1", master);
+        slave2 = std::make_shared<node::SlaveNode>("eviction-slave-2", master);
+        master->registerSlave(slave1);
+        master->registerSlave(slave2);
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    static std::string keyFor(const std::string& prefix, int i) {
+        return prefix + "-" + std::to_string(i);
+    }
+
+    // Writes cold keys while reading the hot ones after every write
+    void runWorkload(int hotKeys, int coldKeys) {
+        std::string value(100, 'v');
+        for (int i = 0; i < hotKeys; i++) {
+            ASSERT_TRUE(master->write(keyFor("hot", i), value));
+        }
+        for (int i = 0; i < coldKeys; i++) {
+            ASSERT_TRUE(master->write(keyFor("cold", i), value));
+            for (int h = 0; h < hotKeys; h++) {
+                master->read(keyFor("hot", h));
+            }
+        }
+        ASSERT_TRUE(master->quiesce());
+    }
+
+    int countPresent(const std::string& prefix, int from, int to) {
+        int present = 0;
+        for (int i = from; i < to; i++) {
+            present += master->read(keyFor(prefix, i)).empty() ? 0 : 1;
+        }
+        return present;
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    std::shared_ptr<node::SlaveNode> slave1;
+    std::shared_ptr<node::SlaveNode> slave2;
+};
+
+TEST_F(EvictionTest, TestStoreAccounting) {
+    storage::StripedStore store(4);
+    EXPECT_EQ(0u, store.getFootprint());
+
+    store.put("short", "abc", 1);
+    store.put("a-key-longer-than-fifteen", std::string(100, 'x'), 2);
+    auto usage = store.getMemoryUsage();
+    EXPECT_EQ(5u + 25u, usage.keyBytes);
+    EXPECT_EQ(103u, usage.valueBytes);
+    EXPECT_EQ(2u, usage.entryCount);
+    EXPECT_EQ(usage.keyBytes + usage.valueBytes + usage.overheadBytes, store.getFootprint());
+    // The long key and value each hold a heap buffer on top of two tree nodes
+    EXPECT_GE(store.getFootprint(), 2 * storage::allocationSize(storage::kTreeNodeHeader + 2 * sizeof(std::string)) +
+                                    storage::allocationSize(26) + storage::allocationSize(101));
+
+    // Replaced values kept for a reader count as overhead until pruned
+    size_t before = store.getFootprint();
+    store.setOldestReader(1);
+    store.put("short", std::string(200, 'y'), 3);
+    EXPECT_GT(store.getFootprint(), before + 200);
+    store.clearHistory();
+    store.setOldestReader(storage::StripedStore::kNoReader);
+    EXPECT_EQ(300u, store.getMemoryUsage().valueBytes);
+
+    EXPECT_TRUE(store.erase("short"));
+    EXPECT_TRUE(store.erase("a-key-longer-than-fifteen"));
+    EXPECT_EQ(0u, store.getFootprint());
+    usage = store.getMemoryUsage();
+    EXPECT_EQ(0u, usage.keyBytes + usage.valueBytes + usage.overheadBytes);
+
+    store.put("k", "v");
+    store.clear();
+    EXPECT_EQ(0u, store.getFootprint());
+}
+
+TEST_F(EvictionTest, TestNodeMemoryUsage) {
+    auto empty = master->getMemoryUsage();
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(master->write(keyFor("key", i), std::string(50, 'v')));
+    }
+    ASSERT_TRUE(master->quiesce());
+
+    auto usage = master->getMemoryUsage();
+    EXPECT_EQ(100u, usage.keyCount);
+    EXPECT_EQ(100u * 50, usage.valueBytes);
+    EXPECT_EQ(100u, usage.logEntries);
+    EXPECT_GE(usage.logBytes, empty.logBytes + 100 * (sizeof(model::LogEntry) + 50));
+    // Both slave streams and their watermarks; nothing is queued once quiesced
+    EXPECT_GE(usage.replicationBytes, 2 * sizeof(node::ReplicationStream));
+    EXPECT_LT(usage.replicationBytes, 2 * sizeof(node::ReplicationStream) + 100 * sizeof(model::LogEntry));
+
+    // Slaves hold the same data, so they account the same data bytes
+    auto replica = slave1->getMemoryUsage();
+    EXPECT_EQ(usage.keyBytes, replica.keyBytes);
+    EXPECT_EQ(usage.valueBytes, replica.valueBytes);
+    EXPECT_EQ(usage.keyCount, replica.keyCount);
+}
+
+TEST_F(EvictionTest, TestLruEvictsThroughTheLog) {
+    // Room for roughly 100 keys of 100 bytes
+    const size_t limit = 25000;
+    master->setMemoryLimit(limit, storage::StripedStore::EvictionPolicy::LRU);
+    EXPECT_EQ(limit, master->getMemoryLimit());
+    runWorkload(10, 600);
+
+    auto usage = master->getMemoryUsage();
+    EXPECT_LE(usage.keyBytes + usage.valueBytes + usage.overheadBytes, limit);
+    EXPECT_GT(master->getEvictionCount(), 400u);
+
+    // Recently read keys survive; the oldest cold keys are gone
+    EXPECT_GE(countPresent("hot", 0, 10), 9);
+    EXPECT_LT(countPresent("cold", 0, 100), 10);
+
+    // Evictions are logged deletes, so every replica holds the same keys
+    EXPECT_EQ(master->getDataStore(), slave1->getDataStore());
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+    size_t deletes = 0;
+    for (const auto& entry : slave1->getLogEntriesAfter(0)) {
+        deletes += entry.isDelete() ? 1 : 0;
+        EXPECT_TRUE(entry.getValue().empty() || !entry.isDelete());
+    }
+    EXPECT_EQ(master->getEvictionCount(), deletes);
+}
+
+TEST_F(EvictionTest, TestLogIsCompactedBelowTheSlowestSlave) {
+    // Large enough that nothing is evicted; the limit only bounds the log
+    master->setMemoryLimit(10 * 1000 * 1000);
+    for (int i = 0; i < 500; i++) {
+        ASSERT_TRUE(master->write(keyFor("key", i), std::string(100, 'v')));
+    }
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ(0u, master->getEvictionCount());
+    EXPECT_GT(master->getLogStartIndex(), 0);
+    EXPECT_LT(master->getMemoryUsage().logEntries, 500u);
+    EXPECT_EQ(master->getLastLogIndex() - master->getLogStartIndex(),
+              static_cast<long>(master->getLogEntriesAfter(0).size()));
+
+    // A slave that was down while the log moved past it catches up through a state copy
+    slave2->goDown();
+    for (int i = 500; i < 1000; i++) {
+        ASSERT_TRUE(master->write(keyFor("key", i), std::string(100, 'v')));
+    }
+    ASSERT_TRUE(master->quiesce());
+    long lagged = slave2->getAppliedIndex();
+    ASSERT_GT(master->getLogStartIndex(), lagged);
+
+    slave2->goUp();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((!slave2->isUp() || slave2->getAppliedIndex() < master->getLastLogIndex()) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(master->getLastLogIndex(), slave2->getAppliedIndex());
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+    EXPECT_EQ(1000u, slave2->getMemoryUsage().keyCount);
+}
+
+TEST_F(EvictionTest, TestLfuKeepsFrequentlyReadKeys) {
+    const size_t limit = 25000;
+    master->setMemoryLimit(limit, storage::StripedStore::EvictionPolicy::LFU);
+    runWorkload(10, 600);
+
+    EXPECT_GE(countPresent("hot", 0, 10), 9);
+    EXPECT_LT(countPresent("cold", 0, 500), 100);
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+
+    // Removing the limit stops eviction
+    master->setMemoryLimit(0);
+    uint64_t evictions = master->getEvictionCount();
+    for (int i = 0; i < 200; i++) {
+        ASSERT_TRUE(master->write(keyFor("unbounded", i), std::string(100, 'v')));
+    }
+    EXPECT_EQ(evictions, master->getEvictionCount());
+    EXPECT_EQ(200, countPresent("unbounded", 0, 200));
+}
+
+TEST_F(EvictionTest, TestLimitSurvivesFailover) {
+    system::ReplicationSystem system(2, 1);
+    system::FailoverConfig failover;
+    failover.heartbeatInterval = std::chrono::milliseconds(10);
+    failover.electionTimeout = std::chrono::milliseconds(50);
+    system.configureFailover(failover);
+    system::MemoryConfig memory;
+    memory.limitBytes = 20000;
+    system.configureMemory(memory);
+
+    for (int i = 0; i < 300; i++) {
+        ASSERT_TRUE(system.write(keyFor("key", i), std::string(100, 'v')));
+    }
+    auto oldMaster = system.getMaster();
+    EXPECT_LE(oldMaster->getMemoryUsage().keyCount, 100u);
+
+    oldMaster->goDown();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (system.getTerm() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto newMaster = system.getMaster();
+    ASSERT_NE(oldMaster, newMaster);
+    EXPECT_EQ(memory.limitBytes, newMaster->getMemoryLimit());
+    for (int i = 300; i < 600; i++) {
+        ASSERT_TRUE(system.write(keyFor("key", i), std::string(100, 'v')));
+    }
+    auto usage = newMaster->getMemoryUsage();
+    EXPECT_LE(usage.keyBytes + usage.valueBytes + usage.overheadBytes, memory.limitBytes);
+    system.shutdown();
+}
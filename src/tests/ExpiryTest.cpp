@@ -0,0 +1,193 @@
+// tests/ExpiryTest.cpp
+#include <gtest/gtest.h>
+#include "node/TimingWheel.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <unistd.h>
+
+using namespace replication;
+
+class ExpiryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("expiry-master");
+        slave1 = std::make_shared<node::SlaveNode>("expiry-slave-1", master);
+        slave2 = std::make_shared<node::SlaveNode>("expiry-slave-2", master);
+        master->registerSlave(slave1);
+        master->registerSlave(slave2);
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    std::shared_ptr<node::SlaveNode> slave1;
+    std::shared_ptr<node::SlaveNode> slave2;
+};
+
+TEST_F(ExpiryTest, TestTimingWheelFiresInOrderAcrossLevels) {
+    node::TimingWheel wheel(10, 1000);
+    std::vector<std::pair<std::string, long>> expired;
+
+    wheel.schedule("past", 500);
+    wheel.schedule("soon", 1055);
+    wheel.schedule("level-1", 1000 + 10 * 100);
+    wheel.schedule("level-2", 1000 + 10 * 5000);
+    wheel.schedule("beyond-top", 1000 + 10 * (1L << 25));
+    EXPECT_EQ(5u, wheel.size());
+
+    wheel.advance(1000, expired);
+    ASSERT_EQ(1u, expired.size());
+    EXPECT_EQ("past", expired[0].first);
+
+    // Never early: 1055 is due at the 1060 tick, not the 1050 one
+    wheel.advance(1059, expired);
+    EXPECT_EQ(1u, expired.size());
+    wheel.advance(1060, expired);
+    ASSERT_EQ(2u, expired.size());
+    EXPECT_EQ("soon", expired[1].first);
+
+    wheel.advance(1000 + 10 * 5000, expired);
+    ASSERT_EQ(4u, expired.size());
+    EXPECT_EQ("level-1", expired[2].first);
+    EXPECT_EQ("level-2", expired[3].first);
+
+    wheel.advance(1000 + 10 * (1L << 25) - 10, expired);
+    EXPECT_EQ(4u, expired.size());
+    wheel.advance(1000 + 10 * (1L << 25), expired);
+    ASSERT_EQ(5u, expired.size());
+    EXPECT_EQ("beyond-top", expired[4].first);
+    EXPECT_EQ(0u, wheel.size());
+}
+
+TEST_F(ExpiryTest, TestExpiredKeyIsDeletedThroughTheLog) {
+    ASSERT_TRUE(master->write("session", "token", std::chrono::milliseconds(30)));
+    ASSERT_TRUE(master->write("profile", "kept"));
+    ASSERT_TRUE(master->quiesce());
+
+    // Every replica holds the same deadline
+    long deadline = master->getExpiresAt("session");
+    EXPECT_GT(deadline, 0);
+    EXPECT_EQ(deadline, slave1->getExpiresAt("session"));
+    EXPECT_EQ(deadline, slave2->getExpiresAt("session"));
+    EXPECT_EQ("token", slave1->read("session"));
+    EXPECT_EQ(0, master->getExpiresAt("profile"));
+
+    // Write, expire, plain write, then the logged delete
+    ASSERT_TRUE(master->waitForIndex(4, std::chrono::seconds(5)));
+    ASSERT_TRUE(master->quiesce());
+    auto log = slave1->getLogEntriesAfter(0);
+    ASSERT_EQ(4u, log.size());
+    EXPECT_TRUE(log[1].isExpire());
+    EXPECT_TRUE(log[3].isDelete());
+    EXPECT_GE(log[3].getTimestamp(), deadline);
+
+    for (const auto& node : {std::static_pointer_cast<node::AbstractNode>(master),
+                             std::static_pointer_cast<node::AbstractNode>(slave1),
+                             std::static_pointer_cast<node::AbstractNode>(slave2)}) {
+        EXPECT_EQ("", node->read("session"));
+        EXPECT_EQ("kept", node->read("profile"));
+        EXPECT_EQ(0u, node->getExpiringKeyCount());
+    }
+}
+
+TEST_F(ExpiryTest, TestMoreExpiriesThanTheRingHolds) {
+    // Timers wait on the wheel while the master is down, so they all fire in one tick
+    constexpr int kKeys = 3000;
+    for (int i = 0; i < kKeys; i++) {
+        ASSERT_TRUE(master->write("burst-" + std::to_string(i), "v", std::chrono::milliseconds(300)));
+    }
+    master->goDown();
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    master->goUp();
+
+    // Write and expire per key, then one delete each
+    ASSERT_TRUE(master->waitForIndex(3 * kKeys, std::chrono::seconds(10)));
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ(0u, master->getDataStore().size());
+    EXPECT_EQ(0u, master->getExpiringKeyCount());
+    EXPECT_EQ(master->getDataStore(), slave1->getDataStore());
+    EXPECT_EQ(3 * kKeys, slave2->getLastLogIndex());
+}
+
+TEST_F(ExpiryTest, TestRewriteCancelsExpiry) {
+    ASSERT_TRUE(master->write("cancelled", "v1", std::chrono::milliseconds(20)));
+    ASSERT_TRUE(master->write("cancelled", "v2"));
+    ASSERT_TRUE(master->write("extended", "v1", std::chrono::milliseconds(20)));
+    ASSERT_TRUE(master->write("extended", "v2", std::chrono::milliseconds(60)));
+    ASSERT_TRUE(master->write("marker", "gone", std::chrono::milliseconds(40)));
+
+    // The marker expires after the cancelled and first extended timers fired
+    ASSERT_TRUE(master->waitForIndex(10, std::chrono::seconds(5)));
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ("", master->read("marker"));
+    EXPECT_EQ("v2", slave1->read("cancelled"));
+    EXPECT_EQ("v2", slave1->read("extended"));
+    EXPECT_EQ(0, slave1->getExpiresAt("cancelled"));
+    EXPECT_GT(slave1->getExpiresAt("extended"), 0);
+
+    // Stale timers logged nothing; the extended key still expires on time
+    ASSERT_TRUE(master->waitForIndex(11, std::chrono::seconds(5)));
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ("", slave2->read("extended"));
+    EXPECT_EQ(11, slave2->getLastLogIndex());
+    EXPECT_EQ("v2", slave2->read("cancelled"));
+}
+
+TEST_F(ExpiryTest, TestNewLeaderTakesOverExpiry) {
+    EXPECT_FALSE(master->write("bad-ttl", "v", std::chrono::milliseconds(0)));
+    ASSERT_TRUE(master->write("lease", "holder", std::chrono::milliseconds(50)));
+    ASSERT_TRUE(master->quiesce());
+    master->fence();
+
+    // A slave promoted before the deadline inherits it and expires the key
+    auto successor = std::make_shared<node::MasterNode>("expiry-successor");
+    successor->assumeLeadership(*slave1, 1);
+    slave2->setMaster(successor);
+    successor->registerSlave(slave2);
+    EXPECT_EQ(master->getExpiresAt("lease"), successor->getExpiresAt("lease"));
+
+    ASSERT_TRUE(successor->waitForIndex(3, std::chrono::seconds(5)));
+    ASSERT_TRUE(successor->quiesce());
+    EXPECT_EQ("", successor->read("lease"));
+    EXPECT_EQ("", slave2->read("lease"));
+    EXPECT_EQ("holder", master->read("lease"));  // The fenced master no longer expires keys
+    successor->shutdown();
+}
+
+TEST_F(ExpiryTest, TestBootstrappedSlaveKeepsDeadlines) {
+    ASSERT_TRUE(master->write("lease", "holder", std::chrono::milliseconds(200)));
+    ASSERT_TRUE(master->write("plain", "value"));
+    ASSERT_TRUE(master->quiesce());
+    std::string path = (std::filesystem::temp_directory_path() /
+                        ("expiry-test-" + std::to_string(::getpid()) + ".snap")).string();
+    ASSERT_TRUE(master->writeSnapshot(path));
+
+    // The deadline comes from the snapshot; nothing after it is in the log tail
+    auto slave3 = std::make_shared<node::SlaveNode>("expiry-slave-3", master);
+    ASSERT_TRUE(slave3->bootstrapFromSnapshot(path));
+    master->registerSlave(slave3);
+    EXPECT_EQ(master->getExpiresAt("lease"), slave3->getExpiresAt("lease"));
+    EXPECT_EQ(0, slave3->getExpiresAt("plain"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (slave3->isLoadingSnapshot() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_FALSE(slave3->isLoadingSnapshot());
+    std::filesystem::remove(path);
+    master->fence();
+
+    // Promoted, the bootstrapped slave expires the key when its time comes
+    auto successor = std::make_shared<node::MasterNode>("expiry-successor");
+    successor->assumeLeadership(*slave3, 1);
+    EXPECT_EQ("holder", successor->read("lease"));
+    ASSERT_TRUE(successor->waitForIndex(4, std::chrono::seconds(5)));
+    ASSERT_TRUE(successor->quiesce());
+    EXPECT_EQ("", successor->read("lease"));
+    EXPECT_EQ("value", successor->read("plain"));
+    successor->shutdown();
+}
@@ -0,0 +1,139 @@
+// tests/FailoverTest.cpp
+#include <gtest/gtest.h>
+#include "system/ReplicationSystem.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+namespace {
+
+bool waitFor(const std::function<bool()>& condition, std::chrono::milliseconds timeout = 5000ms) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return condition();
+}
+
+system::FailoverConfig fastFailover() {
+    system::FailoverConfig config;
+    config.heartbeatInterval = 10ms;
+    config.electionTimeout = 100ms;
+    return config;
+}
+
+} // namespace
+
+TEST(FailoverTest, TestSlaveRefusesEntriesFromStaleTerm) {
+    auto master = std::make_shared<node::MasterNode>("master");
+    auto slave = std::make_shared<node::SlaveNode>("slave", master);
+
+    model::LogEntry first(1, "a", "1", model::LogEntry::OperationType::WRITE, 0, 1);
+    EXPECT_TRUE(slave->applyFromLeader(first, 1));
+    EXPECT_EQ(1, slave->getTerm());
+
+    slave->observeTerm(2);
+    model::LogEntry stale(2, "b", "2", model::LogEntry::OperationType::WRITE, 0, 1);
+    EXPECT_FALSE(slave->applyFromLeader(stale, 1));
+    EXPECT_EQ(1, slave->getLastLogIndex());
+    EXPECT_EQ("", slave->read("b"));
+}
+
+TEST(FailoverTest, TestMostUpToDateSlaveIsPromoted) {
+    system::ReplicationSystem system(3);
+    system.configureFailover(fastFailover());
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(system.write("key" + std::to_string(i), "value" + std::to_string(i)));
+    }
+    auto slaves = system.getSlaves();
+    ASSERT_TRUE(waitFor([&]() {
+        return std::all_of(slaves.begin(), slaves.end(), [](const auto& slave) {
+            return slave->getLastLogIndex() == 5;
+        });
+    }));
+
+    // slave-2 misses the last write, so it must not win the election
+    slaves[2]->goDown();
+    ASSERT_TRUE(system.write("latest", "value"));
+    ASSERT_TRUE(waitFor([&]() {
+        return slaves[0]->getLastLogIndex() == 6 && slaves[1]->getLastLogIndex() == 6;
+    }));
+    slaves[2]->goUp();
+
+    system.getMaster()->goDown();
+    EXPECT_FALSE(system.write("during-election", "value"));
+    ASSERT_TRUE(waitFor([&]() { return system.getTerm() == 1; }));
+
+    auto newMaster = system.getMaster();
+    EXPECT_NE("master", newMaster->getId());
+    EXPECT_EQ(6, newMaster->getLastLogIndex());
+    EXPECT_EQ(2u, system.getSlaves().size());
+
+    EXPECT_TRUE(system.write("after-failover", "value"));
+    EXPECT_EQ("value", newMaster->read("latest"));
+    EXPECT_EQ(7, newMaster->getLogEntriesAfter(6).front().getId());
+    EXPECT_EQ(1, newMaster->getLogEntriesAfter(6).front().getTerm());
+
+    // Failover time spans the election timeout, but not much more
+    EXPECT_GE(system.getLastFailoverMillis(), 100);
+    EXPECT_LT(system.getLastFailoverMillis(), 2000);
+}
+
+TEST(FailoverTest, TestDeposedMasterIsFencedAndRejoinsAsSlave) {
+    system::ReplicationSystem system(2);
+    auto oldMaster = system.getMaster();
+    auto slaves = system.getSlaves();
+
+    ASSERT_TRUE(system.write("a", "1"));
+    ASSERT_TRUE(waitFor([&]() {
+        return slaves[0]->getLastLogIndex() == 1 && slaves[1]->getLastLogIndex() == 1;
+    }));
+
+    // The old master accepts a write no slave ever receives, then fails
+    system.configureFailover(system::FailoverConfig{false});
+    for (const auto& slave : slaves) {
+        slave->goDown();
+    }
+    ASSERT_TRUE(oldMaster->write("unreplicated", "lost"));
+    // Let the drain find the slaves down before they come back
+    ASSERT_TRUE(oldMaster->quiesce());
+    oldMaster->goDown();
+    for (const auto& slave : slaves) {
+        slave->goUp();
+    }
+
+    system.configureFailover(fastFailover());
+    ASSERT_TRUE(waitFor([&]() { return system.getTerm() == 1; }));
+    ASSERT_TRUE(system.write("b", "2"));
+
+    // Coming back up does not let the old master accept writes again
+    oldMaster->goUp();
+    EXPECT_TRUE(oldMaster->isFenced());
+    EXPECT_FALSE(oldMaster->write("split-brain", "value"));
+
+    std::shared_ptr<node::SlaveNode> rejoined;
+    ASSERT_TRUE(waitFor([&]() {
+        for (const auto& slave : system.getSlaves()) {
+            if (slave->getId() == "master") {
+                rejoined = slave;
+            }
+        }
+        return rejoined && rejoined->getLastLogIndex() == 2;
+    }));
+
+    // The divergent entry at index 2 was discarded in favour of the new master's
+    EXPECT_EQ("", rejoined->read("unreplicated"));
+    EXPECT_EQ("1", rejoined->read("a"));
+    EXPECT_EQ("2", rejoined->read("b"));
+    EXPECT_EQ(1, rejoined->getTerm());
+}
@@ -23,6 +23,22 @@ protected:
         }
     }
 
+    // Waits for the failure simulator to bring every slave into the given state
+    bool waitForAllSlaves(bool up) {
+        auto deadline = std::chrono::steady_clock::now() + 5s;
+        while (std::chrono::steady_clock::now() < deadline) {
+            bool all = true;
+            for (const auto& slave : system->getSlaves()) {
+                all = all && slave->isUp() == up;
+            }
+            if (all) {
+                return true;
+            }
+            std::this_thread::sleep_for(5ms);
+        }
+        return false;
+    }
+
     std::unique_ptr<system::ReplicationSystem> system;
 };
 
@@ -34,16 +50,17 @@ TEST_F(FaultToleranceTest, TestSlaveRecovery) {
     }
 
     // Wait for replication
-    std::this_thread::sleep_for(2s);
+    ASSERT_TRUE(system->quiesce());
 
     // Simulate all slaves failing then recovering
     // First force high failure rate
-    system->startFailureSimulator(1.0, 0.0, 1);
-    std::this_thread::sleep_for(3s); // Time for all slaves to fail
+    system->startFailureSimulator(1.0, 0.0, 10ms);
+    ASSERT_TRUE(waitForAllSlaves(false));
 
     // Now force recovery
-    system->startFailureSimulator(0.0, 1.0, 1);
-    std::this_thread::sleep_for(5s); // Time for recovery
+    system->startFailureSimulator(0.0, 1.0, 10ms);
+    ASSERT_TRUE(waitForAllSlaves(true));
+    ASSERT_TRUE(system->quiesce()); // Wait for the slaves to catch up
 
     // After recovery, read should succeed for all initial data
     for (int i = 0; i < 5; i++) {
@@ -59,10 +76,10 @@ TEST_F(FaultToleranceTest, TestConsecutiveReadsWithFailures) {
         EXPECT_TRUE(system->write("read-key-" + std::to_string(i), 
                                 "read-value-" + std::to_string(i)));
     }
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(system->quiesce());
 
     // Start failure simulator with moderate failure/recovery
-    system->startFailureSimulator(0.4, 0.4, 1);
+    system->startFailureSimulator(0.4, 0.4, 10ms);
 
     // Perform multiple consecutive reads
     int successfulReads = 0;
@@ -72,7 +89,7 @@ TEST_F(FaultToleranceTest, TestConsecutiveReadsWithFailures) {
         if (!value.empty() && value == "read-value-" + std::to_string(i % 5)) {
             successfulReads++;
         }
-        std::this_thread::sleep_for(300ms);
+        std::this_thread::sleep_for(3ms);
     }
 
     // Even with failures, we should get some successful reads
@@ -81,7 +98,7 @@ TEST_F(FaultToleranceTest, TestConsecutiveReadsWithFailures) {
 
 TEST_F(FaultToleranceTest, TestContinuousWriteDuringFailures) {
     // Start failure simulator
-    system->startFailureSimulator(0.3, 0.3, 1);
+    system->startFailureSimulator(0.3, 0.3, 10ms);
 
     // Perform continuous writes
     int successfulWrites = 0;
@@ -91,15 +108,16 @@ TEST_F(FaultToleranceTest, TestContinuousWriteDuringFailures) {
         if (success) {
             successfulWrites++;
         }
-        std::this_thread::sleep_for(200ms);
+        std::this_thread::sleep_for(2ms);
     }
 
     // Master should never fail, so all writes should succeed
     EXPECT_EQ(30, successfulWrites);
 
     // Wait for recovery
-    system->startFailureSimulator(0.0, 1.0, 1);
-    std::this_thread::sleep_for(5s);
+    system->startFailureSimulator(0.0, 1.0, 10ms);
+    ASSERT_TRUE(waitForAllSlaves(true));
+    ASSERT_TRUE(system->quiesce());
 
     // Check data store
     auto dataStore = system->getDataStore();
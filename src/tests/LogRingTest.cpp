@@ -0,0 +1,97 @@
+// tests/LogRingTest.cpp
+#include <gtest/gtest.h>
+#include "node/LogRing.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+TEST(LogRingTest, TestEntriesAreConsumedInIdOrder) {
+    node::LogRing ring(4, 1);
+    EXPECT_EQ(4u, ring.getCapacity());
+
+    node::PendingOperation* pending = nullptr;
+    ring.publish(model::LogEntry(2, "b", "2"));
+    EXPECT_FALSE(ring.isReady(1));
+    EXPECT_FALSE(ring.tryConsume(1, pending).has_value());
+
+    node::PendingOperation outcome;
+    ring.publish(model::LogEntry(1, "a", "", model::LogEntry::OperationType::DELETE), &outcome);
+    auto first = ring.tryConsume(1, pending);
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ("a", first->getKey());
+    EXPECT_EQ(&outcome, pending);
+
+    auto second = ring.tryConsume(2, pending);
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ("b", second->getKey());
+    EXPECT_EQ(nullptr, pending);
+
+    // Slots are reused on the next lap
+    for (long id = 3; id <= 10; id++) {
+        ring.publish(model::LogEntry(id, "k", std::to_string(id)));
+        auto entry = ring.tryConsume(id, pending);
+        ASSERT_TRUE(entry.has_value());
+        EXPECT_EQ(id, entry->getId());
+    }
+}
+
+TEST(LogRingTest, TestConcurrentMasterWritesProduceDenseOrderedLog) {
+    auto master = std::make_shared<node::MasterNode>("master");
+    auto slave = std::make_shared<node::SlaveNode>("slave", master);
+    master->registerSlave(slave);
+
+    const int threads = 8;
+    const int writesPerThread = 250;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++) {
+        writers.emplace_back([&master, t, writesPerThread]() {
+            for (int i = 0; i < writesPerThread; i++) {
+                master->write("t" + std::to_string(t) + "-" + std::to_string(i % 20), std::to_string(i));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    const long total = threads * writesPerThread;
+    EXPECT_EQ(total, master->getLastLogIndex());
+
+    auto log = master->getLogEntriesAfter(0);
+    ASSERT_EQ(static_cast<size_t>(total), log.size());
+    for (long i = 0; i < total; i++) {
+        ASSERT_EQ(i + 1, log[i].getId());
+    }
+    EXPECT_EQ("249", master->read("t7-9"));
+
+    // Per-slave streams deliver in order, so the slave converges without gaps
+    ASSERT_TRUE(master->waitForReplication(total));
+    EXPECT_EQ(total, slave->getLastLogIndex());
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+}
+
+TEST(LogRingTest, TestConcurrentDeletesOfOneKeySucceedOnce) {
+    auto master = std::make_shared<node::MasterNode>("master");
+    master->write("shared", "value");
+
+    std::atomic<int> successes(0);
+    std::vector<std::thread> deleters;
+    for (int t = 0; t < 8; t++) {
+        deleters.emplace_back([&master, &successes]() {
+            if (master->deleteKey("shared")) {
+                successes++;
+            }
+        });
+    }
+    for (auto& deleter : deleters) {
+        deleter.join();
+    }
+
+    EXPECT_EQ(1, successes.load());
+    EXPECT_EQ("", master->read("shared"));
+}
@@ -0,0 +1,359 @@
+// tests/LsmTreeTest.cpp
+#include <gtest/gtest.h>
+#include "storage/LsmTree.h"
+#include "storage/StripedStore.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include "system/ReplicationSystem.h"
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+using namespace replication;
+
+class LsmTreeTest : public ::testing::Test {
+protected:
+    using Entries = std::vector<std::pair<std::string, std::string>>;
+
+    void SetUp() override {
+        std::string name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        directory = (std::filesystem::temp_directory_path() /
+                     ("lsm-test-" + std::to_string(::getpid()) + "-" + name)).string();
+        std::filesystem::remove_all(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    // Small memtables, blocks and levels, so a few thousand keys reach several levels
+    storage::LsmConfig makeConfig() const {
+        storage::LsmConfig config;
+        config.directory = directory;
+        config.memtableBytes = 8 * 1024;
+        config.blockBytes = 512;
+        config.blockCacheBytes = 64 * 1024;
+        config.level0Runs = 2;
+        config.levelBaseBytes = 16 * 1024;
+        config.levelRatio = 4;
+        config.runBytes = 8 * 1024;
+        return config;
+    }
+
+    static Entries scan(const storage::LsmTree& tree, const std::string& prefix = "") {
+        Entries entries;
+        EXPECT_TRUE(tree.snapshot(prefix)->forEachWithPrefix(prefix, [&entries](const std::string& key,
+                                                                                const std::string& value, long) {
+            entries.emplace_back(key, value);
+            return true;
+        }));
+        return entries;
+    }
+
+    size_t countRunFiles() const {
+        size_t runs = 0;
+        for (const auto& file : std::filesystem::directory_iterator(directory)) {
+            runs += file.path().extension() == ".run" ? 1 : 0;
+        }
+        return runs;
+    }
+
+    static std::string keyFor(int i) {
+        char key[16];
+        std::snprintf(key, sizeof(key), "key-%05d", i);
+        return key;
+    }
+
+    std::string directory;
+};
+
+TEST_F(LsmTreeTest, TestMatchesOrderedMap) {
+    storage::LsmTree tree(makeConfig());
+    ASSERT_TRUE(tree.open());
+    std::map<std::string, std::string> expected;
+    std::mt19937 random(11);
+    for (long version = 1; version <= 30000; version++) {
+        std::string key = keyFor(random() % 4000);
+        if (random() % 4 == 0) {
+            tree.erase(key, version);
+            expected.erase(key);
+        } else {
+            std::string value = "value-" + std::to_string(version) + std::string(random() % 40, 'x');
+            tree.put(key, value, version);
+            expected[key] = value;
+        }
+    }
+    ASSERT_TRUE(tree.quiesce());
+    EXPECT_EQ(30000, tree.getDurableVersion());
+
+    auto stats = tree.getStats();
+    EXPECT_GT(stats.flushes, 10u);
+    EXPECT_GT(stats.compactions, 0u);
+    EXPECT_LT(stats.runsPerLevel[0], 2u);
+    EXPECT_GT(stats.runsPerLevel[1] + stats.runsPerLevel[2], 0u);
+    EXPECT_EQ(Entries(expected.begin(), expected.end()), scan(tree));
+
+    for (int i = 0; i < 4000; i++) {
+        std::string value;
+        long version;
+        auto it = expected.find(keyFor(i));
+        ASSERT_EQ(it != expected.end(), tree.get(keyFor(i), value, version));
+        if (it != expected.end()) {
+            EXPECT_EQ(it->second, value);
+        }
+    }
+
+    // Hot keys come from the block cache after the first read
+    std::string value;
+    long version;
+    for (int i = 0; i < 100; i++) {
+        tree.get(expected.begin()->first, value, version);
+    }
+    EXPECT_GE(tree.getStats().cacheHits, 99u);
+
+    auto withPrefix = scan(tree, "key-012");
+    Entries expectedPrefix(expected.lower_bound("key-012"), expected.lower_bound("key-013"));
+    EXPECT_EQ(expectedPrefix, withPrefix);
+}
+
+TEST_F(LsmTreeTest, TestReopenKeepsRuns) {
+    {
+        storage::LsmTree tree(makeConfig());
+        ASSERT_TRUE(tree.open());
+        for (int i = 0; i < 2000; i++) {
+            tree.put(keyFor(i), std::string(20, 'a' + i % 26), i + 1);
+        }
+        tree.erase(keyFor(7), 2001);
+    }
+    // Left over from an interrupted flush
+    std::ofstream(std::filesystem::path(directory) / "999999.run") << "torn";
+    std::ofstream(std::filesystem::path(directory) / "999998.run.tmp") << "torn";
+
+    storage::LsmTree tree(makeConfig());
+    ASSERT_TRUE(tree.open());
+    EXPECT_EQ(2001, tree.getDurableVersion());
+    EXPECT_FALSE(std::filesystem::exists(std::filesystem::path(directory) / "999999.run"));
+    EXPECT_FALSE(std::filesystem::exists(std::filesystem::path(directory) / "999998.run.tmp"));
+
+    auto entries = scan(tree);
+    ASSERT_EQ(1999u, entries.size());
+    std::string value;
+    long version;
+    EXPECT_FALSE(tree.get(keyFor(7), value, version));
+    ASSERT_TRUE(tree.get(keyFor(1234), value, version));
+    EXPECT_EQ(std::string(20, 'a' + 1234 % 26), value);
+    EXPECT_EQ(1235, version);
+
+    // New runs never reuse the number of a file deleted on open
+    tree.put("after-reopen", "v", 2002);
+    ASSERT_TRUE(tree.quiesce());
+    EXPECT_FALSE(std::filesystem::exists(std::filesystem::path(directory) / "999999.run"));
+    EXPECT_TRUE(tree.get("after-reopen", value, version));
+}
+
+TEST_F(LsmTreeTest, TestSnapshotPinsReplacedRuns) {
+    storage::LsmTree tree(makeConfig());
+    ASSERT_TRUE(tree.open());
+    for (int i = 0; i < 1000; i++) {
+        tree.put(keyFor(i), "old", i + 1);
+    }
+    ASSERT_TRUE(tree.quiesce());
+    auto snapshot = tree.snapshot();
+
+    for (int i = 0; i < 1000; i++) {
+        tree.put(keyFor(i), "new", 1000 + i + 1);
+    }
+    ASSERT_TRUE(tree.quiesce());
+    std::string value;
+    long version;
+    ASSERT_TRUE(snapshot->get(keyFor(500), value, version));
+    EXPECT_EQ("old", value);
+    ASSERT_TRUE(tree.get(keyFor(500), value, version));
+    EXPECT_EQ("new", value);
+    size_t seen = 0;
+    snapshot->forEachWithPrefix("", [&seen](const std::string&, const std::string& value, long) {
+        seen += value == "old" ? 1 : 0;
+        return true;
+    });
+    EXPECT_EQ(1000u, seen);
+
+    // Runs replaced by compaction are deleted once no snapshot reads them
+    size_t live = 0;
+    for (size_t runs : tree.getStats().runsPerLevel) {
+        live += runs;
+    }
+    EXPECT_GT(countRunFiles(), live);
+    snapshot.reset();
+    EXPECT_EQ(live, countRunFiles());
+
+    tree.clear();
+    EXPECT_EQ(0u, countRunFiles());
+    EXPECT_FALSE(tree.get(keyFor(1), value, version));
+    EXPECT_TRUE(scan(tree).empty());
+}
+
+TEST_F(LsmTreeTest, TestStripedStoreOnLsm) {
+    storage::StripedStore store(4);
+    store.put("moved", "before", 1);
+    ASSERT_TRUE(store.setEngine(storage::StripedStore::Engine::LSM, makeConfig()));
+    EXPECT_EQ(storage::StripedStore::Engine::LSM, store.getEngine());
+
+    std::string value;
+    long version;
+    ASSERT_TRUE(store.get("moved", value, version));
+    EXPECT_EQ("before", value);
+    for (int i = 0; i < 3000; i++) {
+        store.put(keyFor(i), std::string(30, 'v'), i + 2);
+    }
+    EXPECT_FALSE(store.putIfAbsent(keyFor(5), "again", 5000));
+    EXPECT_TRUE(store.erase(keyFor(5), 5001));
+    EXPECT_FALSE(store.erase(keyFor(5), 5002));
+    EXPECT_TRUE(store.putIfAbsent(keyFor(5), "again", 5003));
+    EXPECT_EQ(3001u, store.size());
+    ASSERT_TRUE(store.flushEngine());
+
+    // Replaced values stay readable at older versions while a reader needs them
+    store.setOldestReader(5003);
+    store.put(keyFor(5), "newest", 5004);
+    ASSERT_EQ(storage::StripedStore::VersionLookup::FOUND, store.getAt(keyFor(5), 5003, value));
+    EXPECT_EQ("again", value);
+    ASSERT_EQ(storage::StripedStore::VersionLookup::FOUND, store.getAt(keyFor(5), 5004, value));
+    EXPECT_EQ("newest", value);
+    store.setOldestReader(storage::StripedStore::kNoReader);
+
+    auto scanned = store.scanPrefix("key-01", 20);
+    ASSERT_EQ(20u, scanned.size());
+    EXPECT_EQ(keyFor(1000), scanned.front().first);
+
+    // An image sees the store as it was opened
+    auto image = store.openImage();
+    ASSERT_NE(nullptr, image);
+    store.put("moved", "during image", 6000);
+    size_t imaged = 0;
+    image->forEach([&imaged](const std::string& key, const storage::StripedStore::VersionedValue& entry) {
+        imaged++;
+        EXPECT_TRUE(key != "moved" || entry.value == "before");
+        return true;
+    });
+    EXPECT_EQ(3001u, imaged);
+    image.reset();
+
+    auto usage = store.getMemoryUsage();
+    EXPECT_EQ(3001u, usage.entryCount);
+    std::string key;
+    EXPECT_FALSE(store.sampleEvictionCandidate(5, key, version));
+
+    // Leaving the engine brings every key back into memory and empties the directory
+    auto contents = store.copy();
+    ASSERT_TRUE(store.setEngine(storage::StripedStore::Engine::RADIX));
+    EXPECT_EQ(contents, store.copy());
+    EXPECT_EQ(0u, countRunFiles());
+}
+
+TEST_F(LsmTreeTest, TestReplicatesOnLsm) {
+    auto master = std::make_shared<node::MasterNode>("lsm-master");
+    auto slave = std::make_shared<node::SlaveNode>("lsm-slave", master);
+    master->registerSlave(slave);
+    storage::LsmConfig config = makeConfig();
+    config.directory = directory + "/slave";
+    ASSERT_TRUE(slave->setStorageEngine(storage::StripedStore::Engine::LSM, config));
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_TRUE(master->write(keyFor(i), std::to_string(i)));
+    }
+    ASSERT_TRUE(master->deleteKey(keyFor(3)));
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    EXPECT_EQ(master->scanPrefix("key-001"), slave->scanPrefix("key-001"));
+    EXPECT_EQ("42", slave->read(keyFor(42)));
+    master->shutdown();
+
+    system::ReplicationSystem system(2, 2);
+    system::StorageConfig storageConfig;
+    storageConfig.engine = storage::StripedStore::Engine::LSM;
+    storageConfig.lsm = makeConfig();
+    storageConfig.lsm.directory = directory + "/system";
+    system.configureStorage(storageConfig);
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(system.write(keyFor(i), std::to_string(i)));
+    }
+    ASSERT_TRUE(system.quiesce());
+    EXPECT_EQ(storage::StripedStore::Engine::LSM, system.getMaster(0)->getStorageEngine());
+    EXPECT_TRUE(std::filesystem::exists(std::filesystem::path(storageConfig.lsm.directory) /
+                                        system.getMaster(0)->getId() / "MANIFEST"));
+    EXPECT_EQ(1000u, system.scanPrefix("key-").size());
+    EXPECT_EQ("999", system.read(keyFor(999)));
+    system.shutdown();
+}
+
+TEST_F(LsmTreeTest, TestLsmNodesTrimTheirLogAndPromoteOnDisk) {
+    auto master = std::make_shared<node::MasterNode>("lsm-master");
+    auto slave = std::make_shared<node::SlaveNode>("lsm-slave", master);
+    master->registerSlave(slave);
+    storage::LsmConfig config = makeConfig();
+    config.directory = directory + "/master";
+    ASSERT_TRUE(master->setStorageEngine(storage::StripedStore::Engine::LSM, config));
+    config.directory = directory + "/slave";
+    ASSERT_TRUE(slave->setStorageEngine(storage::StripedStore::Engine::LSM, config));
+    for (int i = 0; i < 3000; i++) {
+        ASSERT_TRUE(master->write(keyFor(i), std::string(50, 'v')));
+    }
+    ASSERT_TRUE(master->quiesce());
+
+    // Flushed entries leave the log; the rest wait in memtables for a restart to replay
+    EXPECT_EQ(3000u, master->getDataStore().size());
+    EXPECT_GT(master->getLogStartIndex(), 0);
+    EXPECT_GT(slave->getLogStartIndex(), 0);
+    EXPECT_LT(master->getMemoryUsage().logEntries, 3000u);
+    EXPECT_LT(slave->getMemoryUsage().logEntries, 3000u);
+
+    // A slave that misses the trimmed entries catches up from the master's runs
+    slave->goDown();
+    for (int i = 3000; i < 6000; i++) {
+        ASSERT_TRUE(master->write(keyFor(i), std::string(50, 'v')));
+    }
+    ASSERT_TRUE(master->quiesce());
+    ASSERT_GT(master->getLogStartIndex(), slave->getAppliedIndex());
+    slave->goUp();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((!slave->isUp() || slave->getAppliedIndex() < master->getLastLogIndex()) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(master->getLastLogIndex(), slave->getAppliedIndex());
+    EXPECT_EQ(storage::StripedStore::Engine::LSM, slave->getStorageEngine());
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    master->shutdown();
+
+    // The promoted slave's state goes straight into its new directory
+    system::ReplicationSystem system(2, 1);
+    system::FailoverConfig failover;
+    failover.heartbeatInterval = std::chrono::milliseconds(10);
+    failover.electionTimeout = std::chrono::milliseconds(50);
+    system.configureFailover(failover);
+    system::StorageConfig storageConfig;
+    storageConfig.engine = storage::StripedStore::Engine::LSM;
+    storageConfig.lsm = makeConfig();
+    storageConfig.lsm.directory = directory + "/system";
+    system.configureStorage(storageConfig);
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_TRUE(system.write(keyFor(i), std::to_string(i)));
+    }
+    ASSERT_TRUE(system.quiesce());
+    auto oldMaster = system.getMaster();
+    oldMaster->goDown();
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (system.getTerm() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto newMaster = system.getMaster();
+    ASSERT_NE(oldMaster, newMaster);
+    EXPECT_EQ(storage::StripedStore::Engine::LSM, newMaster->getStorageEngine());
+    EXPECT_TRUE(std::filesystem::exists(std::filesystem::path(storageConfig.lsm.directory) /
+                                        (newMaster->getId() + "-term1") / "MANIFEST"));
+    EXPECT_EQ(2000u, newMaster->getDataStore().size());
+    EXPECT_EQ("1999", newMaster->read(keyFor(1999)));
+    system.shutdown();
+}
@@ -1,11 +1,8 @@
 // tests/MainTest.cpp
 #include <gtest/gtest.h>
 #include "system/ReplicationSystem.h"
-#include <thread>
-#include <chrono>
 
 using namespace replication;
-using namespace std::chrono_literals;
 
 class MainTest : public ::testing::Test {
 protected:
@@ -27,7 +24,7 @@ protected:
 TEST_F(MainTest, TestBasicWriteAndRead) {
     // Basic write/read functionality
     EXPECT_TRUE(system->write("key1", "value1"));
-    std::this_thread::sleep_for(1s); // Wait for replication
+    ASSERT_TRUE(system->quiesce()); // Wait for replication
     EXPECT_EQ("value1", system->read("key1"));
 }
 
@@ -38,7 +35,7 @@ TEST_F(MainTest, TestMultipleWritesAndReads) {
     EXPECT_TRUE(system->write("key3", "value3"));
 
     // Wait for replication
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(system->quiesce());
 
     // Read all entries
     EXPECT_EQ("value1", system->read("key1"));
@@ -52,12 +49,12 @@ TEST_F(MainTest, TestMultipleWritesAndReads) {
 TEST_F(MainTest, TestUpdateExistingKey) {
     // Write initial value
     EXPECT_TRUE(system->write("key1", "initial"));
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(system->quiesce());
     EXPECT_EQ("initial", system->read("key1"));
 
     // Update with new value
     EXPECT_TRUE(system->write("key1", "updated"));
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(system->quiesce());
     EXPECT_EQ("updated", system->read("key1"));
 }
 
@@ -65,7 +62,7 @@ TEST_F(MainTest, TestDataStoreConsistency) {
     // Write several entries
     EXPECT_TRUE(system->write("key1", "value1"));
     EXPECT_TRUE(system->write("key2", "value2"));
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(system->quiesce());
 
     // Get the data store and check contents
     auto dataStore = system->getDataStore();
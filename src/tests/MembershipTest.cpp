@@ -0,0 +1,115 @@
+// tests/MembershipTest.cpp
+#include <gtest/gtest.h>
+#include "system/ReplicationSystem.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <memory>
+#include <unistd.h>
+
+using namespace replication;
+
+namespace {
+
+std::unique_ptr<system::ReplicationSystem> makeSystem(int slaves, system::TopologyConfig::Type type) {
+    auto replicationSystem = std::make_unique<system::ReplicationSystem>(slaves);
+    system::FailoverConfig failover;
+    failover.enabled = false;
+    replicationSystem->configureFailover(failover);
+    system::TopologyConfig topology;
+    topology.type = type;
+    replicationSystem->configureTopology(topology);
+    return replicationSystem;
+}
+
+} // namespace
+
+TEST(MembershipTest, TestAddedSlaveBootstrapsFromSnapshot) {
+    auto replicationSystem = makeSystem(2, system::TopologyConfig::Type::STAR);
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i), std::to_string(i)));
+    }
+    ASSERT_TRUE(replicationSystem->quiesce());
+
+    // Writes keep flowing while the replica is added
+    std::atomic<bool> stop{false};
+    std::thread writer([&]() {
+        for (int i = 0; !stop; i++) {
+            replicationSystem->write("live" + std::to_string(i % 100), std::to_string(i));
+        }
+    });
+    std::string directory = (std::filesystem::temp_directory_path() /
+                             ("membership-test-" + std::to_string(::getpid()))).string();
+    auto slave = replicationSystem->addSlave(0, directory);
+    stop = true;
+    writer.join();
+
+    ASSERT_NE(nullptr, slave);
+    EXPECT_EQ("slave-2", slave->getId());
+    EXPECT_EQ("1999", slave->read("key1999"));
+    ASSERT_EQ(3u, replicationSystem->getSlaves().size());
+    // The snapshot file is gone once mapped
+    EXPECT_TRUE(std::filesystem::is_empty(directory));
+    std::filesystem::remove_all(directory);
+
+    ASSERT_TRUE(replicationSystem->write("after", "added"));
+    ASSERT_TRUE(replicationSystem->quiesce());
+    auto master = replicationSystem->getMaster();
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    EXPECT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    // Only the tail after the snapshot was replayed
+    EXPECT_LT(slave->getLogEntriesAfter(0).size(), master->getLogEntriesAfter(0).size() - 1000);
+    replicationSystem->shutdown();
+}
+
+TEST(MembershipTest, TestRemoveSlaveRewiresTopology) {
+    auto replicationSystem = makeSystem(4, system::TopologyConfig::Type::CHAIN);
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i % 10), std::to_string(i)));
+    }
+
+    // The head of the chain is fed by the master, which delivers its queue before removing it
+    auto removed = replicationSystem->getSlaves()[0];
+    ASSERT_TRUE(replicationSystem->removeSlave(0, "slave-0"));
+    EXPECT_FALSE(replicationSystem->removeSlave(0, "slave-0"));
+    EXPECT_EQ(100, removed->getLastLogIndex());
+    EXPECT_TRUE(removed->getDownstream().empty());
+    EXPECT_EQ(-1, replicationSystem->getMaster()->getReplicatedIndex("slave-0"));
+
+    // A relayed slave in the middle is bridged over
+    ASSERT_TRUE(replicationSystem->removeSlave(0, "slave-2"));
+    auto slaves = replicationSystem->getSlaves();
+    ASSERT_EQ(2u, slaves.size());
+    EXPECT_EQ("slave-1", slaves[0]->getId());
+    EXPECT_EQ(nullptr, slaves[0]->getUpstream());
+    EXPECT_EQ(slaves[0], slaves[1]->getUpstream());
+
+    for (int i = 100; i < 200; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i % 10), std::to_string(i)));
+    }
+    ASSERT_TRUE(replicationSystem->quiesce());
+    auto expected = replicationSystem->getMaster()->getDataStore();
+    for (const auto& slave : slaves) {
+        EXPECT_EQ(expected, slave->getDataStore()) << slave->getId();
+    }
+    EXPECT_EQ(100, removed->getLastLogIndex());
+
+    // Added slaves get fresh IDs, and a shard keeps its last slave
+    auto added = replicationSystem->addSlave(0);
+    ASSERT_NE(nullptr, added);
+    EXPECT_EQ("slave-4", added->getId());
+    for (const auto& id : {"slave-1", "slave-3"}) {
+        EXPECT_TRUE(replicationSystem->removeSlave(0, id));
+    }
+    EXPECT_FALSE(replicationSystem->removeSlave(0, "slave-4"));
+    EXPECT_FALSE(replicationSystem->removeSlave(1, "slave-4"));
+    EXPECT_FALSE(replicationSystem->removeSlave(-1, "slave-4"));
+    EXPECT_EQ(nullptr, replicationSystem->addSlave(1));
+    EXPECT_EQ(nullptr, added->getUpstream());
+    ASSERT_TRUE(replicationSystem->write("key0", "last"));
+    ASSERT_TRUE(replicationSystem->quiesce());
+    EXPECT_EQ("last", replicationSystem->read("key0"));
+    replicationSystem->shutdown();
+}
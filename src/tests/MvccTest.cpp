@@ -0,0 +1,171 @@
+// tests/MvccTest.cpp
+#include <gtest/gtest.h>
+#include "storage/StripedStore.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <atomic>
+#include <thread>
+
+using namespace replication;
+
+class MvccTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("mvcc-master");
+        slave = std::make_shared<node::SlaveNode>("mvcc-slave", master);
+        master->registerSlave(slave);
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    std::shared_ptr<node::SlaveNode> slave;
+};
+
+TEST_F(MvccTest, TestStoreKeepsReplacedValuesForReaders) {
+    storage::StripedStore store(4);
+    std::string value;
+
+    // Without readers nothing is kept
+    store.put("k", "v1", 1);
+    store.put("k", "v2", 2);
+    EXPECT_EQ(storage::StripedStore::VersionLookup::MISSING, store.getAt("k", 1, value));
+
+    store.setOldestReader(2);
+    store.put("k", "v3", 3);
+    store.put("other", "new", 4);
+    ASSERT_TRUE(store.erase("k", 5));
+    EXPECT_EQ(storage::StripedStore::VersionLookup::FOUND, store.getAt("k", 2, value));
+    EXPECT_EQ("v2", value);
+    EXPECT_EQ(storage::StripedStore::VersionLookup::FOUND, store.getAt("k", 4, value));
+    EXPECT_EQ("v3", value);
+    EXPECT_EQ(storage::StripedStore::VersionLookup::MISSING, store.getAt("k", 5, value));
+    EXPECT_EQ(storage::StripedStore::VersionLookup::MISSING, store.getAt("other", 3, value));
+
+    // Past the depth, lookups that needed a dropped value say so
+    store.setHistoryDepth(1);
+    store.put("k", "v6", 6);
+    store.put("k", "v7", 7);
+    EXPECT_EQ(storage::StripedStore::VersionLookup::DISCARDED, store.getAt("k", 2, value));
+    EXPECT_EQ(storage::StripedStore::VersionLookup::FOUND, store.getAt("k", 6, value));
+    EXPECT_EQ("v6", value);
+
+    store.setOldestReader(storage::StripedStore::kNoReader);
+    store.clearHistory();
+    EXPECT_EQ(storage::StripedStore::VersionLookup::MISSING, store.getAt("k", 6, value));
+    EXPECT_EQ(2u, store.size());
+}
+
+TEST_F(MvccTest, TestViewIgnoresLaterEntries) {
+    ASSERT_TRUE(master->write("balance", "100"));
+    ASSERT_TRUE(master->write("owner", "alice"));
+    ASSERT_TRUE(master->quiesce());
+
+    auto view = slave->openReadView();
+    ASSERT_NE(nullptr, view);
+    EXPECT_EQ(2, view->getIndex());
+
+    ASSERT_TRUE(master->write("balance", "50"));
+    ASSERT_TRUE(master->deleteKey("owner"));
+    ASSERT_TRUE(master->write("created", "later"));
+    ASSERT_TRUE(master->quiesce());
+
+    std::vector<std::string> values;
+    ASSERT_TRUE(slave->readAt(*view, {"balance", "owner", "created"}, values));
+    EXPECT_EQ((std::vector<std::string>{"100", "alice", ""}), values);
+    EXPECT_EQ((std::vector<std::string>{"50", "", "later"}),
+              slave->readMany({"balance", "owner", "created"}));
+
+    // A key rewritten more often than the retention can no longer be read
+    slave->setVersionRetention(2);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(master->write("balance", std::to_string(i)));
+    }
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_FALSE(slave->readAt(*view, {"balance"}, values));
+    ASSERT_TRUE(slave->readAt(*view, {"owner"}, values));
+    EXPECT_EQ("alice", values[0]);
+
+    long index = 0;
+    ASSERT_TRUE(slave->readConsistent({"balance", "owner"}, values, index));
+    EXPECT_EQ(slave->getLastLogIndex(), index);
+    EXPECT_EQ((std::vector<std::string>{"2", ""}), values);
+
+    slave->goDown();
+    EXPECT_EQ(nullptr, slave->openReadView());
+    slave->goUp();
+}
+
+TEST_F(MvccTest, TestViewsOpenAtOlderIndicesWithinTheHorizon) {
+    ASSERT_TRUE(master->write("balance", "100"));
+    ASSERT_TRUE(master->quiesce());
+
+    // Without a horizon only the last applied index can be opened
+    EXPECT_EQ(1, slave->getOldestReadableIndex());
+    EXPECT_EQ(nullptr, slave->openReadView(0));
+    EXPECT_EQ(nullptr, slave->openReadView(2));
+    ASSERT_NE(nullptr, slave->openReadView(1));
+
+    slave->setHistoryHorizon(3);
+    ASSERT_TRUE(master->write("balance", "90"));      // 2
+    ASSERT_TRUE(master->write("owner", "alice"));     // 3
+    ASSERT_TRUE(master->deleteKey("owner"));          // 4
+    ASSERT_TRUE(master->write("balance", "70"));      // 5
+    ASSERT_TRUE(master->quiesce());
+
+    // Indices from before the horizon was set stay unreadable
+    EXPECT_EQ(2, slave->getOldestReadableIndex());
+    EXPECT_EQ(nullptr, slave->openReadView(1));
+    std::vector<std::string> values;
+    auto view = slave->openReadView(3);
+    ASSERT_NE(nullptr, view);
+    ASSERT_TRUE(slave->readAt(*view, {"balance", "owner"}, values));
+    EXPECT_EQ((std::vector<std::string>{"90", "alice"}), values);
+    view = slave->openReadView(2);
+    ASSERT_NE(nullptr, view);
+    ASSERT_TRUE(slave->readAt(*view, {"balance", "owner"}, values));
+    EXPECT_EQ((std::vector<std::string>{"90", ""}), values);
+    view.reset();
+
+    // The horizon moves with the applied index
+    ASSERT_TRUE(master->write("balance", "60"));      // 6
+    ASSERT_TRUE(master->write("balance", "50"));      // 7
+    ASSERT_TRUE(master->quiesce());
+    EXPECT_EQ(4, slave->getOldestReadableIndex());
+    EXPECT_EQ(nullptr, slave->openReadView(3));
+    view = slave->openReadView(4);
+    ASSERT_NE(nullptr, view);
+    ASSERT_TRUE(slave->readAt(*view, {"balance", "owner"}, values));
+    EXPECT_EQ((std::vector<std::string>{"90", ""}), values);
+}
+
+TEST_F(MvccTest, TestConsistentReadsDuringReplication) {
+    // Entry 2i - 1 sets "first" to i and entry 2i sets "second" to i
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 1; i <= 500; i++) {
+            master->write("first", std::to_string(i));
+            master->write("second", std::to_string(i));
+        }
+        done = true;
+    });
+
+    int reads = 0;
+    while (!done || reads == 0) {
+        std::vector<std::string> values;
+        long index = 0;
+        if (!slave->readConsistent({"first", "second"}, values, index)) {
+            continue;
+        }
+        reads++;
+        long first = values[0].empty() ? 0 : std::stol(values[0]);
+        long second = values[1].empty() ? 0 : std::stol(values[1]);
+        // The index alone determines both values; a torn read would not match
+        EXPECT_EQ((index + 1) / 2, first);
+        EXPECT_EQ(index / 2, second);
+    }
+    writer.join();
+    EXPECT_GT(reads, 0);
+}
@@ -2,11 +2,8 @@
 #include <gtest/gtest.h>
 #include "node/MasterNode.h"
 #include "node/SlaveNode.h"
-#include <thread>
-#include <chrono>
 
 using namespace replication;
-using namespace std::chrono_literals;
 
 class NodeTest : public ::testing::Test {
 protected:
@@ -52,7 +49,7 @@ TEST_F(NodeTest, TestSlaveNodeBasicOperations) {
 
     // Write to master and check replication to slave
     EXPECT_TRUE(master->write("key-for-slave", "value-for-slave"));
-    std::this_thread::sleep_for(1s); // Wait for replication
+    ASSERT_TRUE(master->quiesce()); // Wait for replication
 
     // Slave should have received the data
     EXPECT_EQ("value-for-slave", slave1->read("key-for-slave"));
@@ -61,7 +58,7 @@ TEST_F(NodeTest, TestSlaveNodeBasicOperations) {
 TEST_F(NodeTest, TestSlaveNodeFailureAndRecovery) {
     // Initial write to master
     EXPECT_TRUE(master->write("key1", "value1"));
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(master->quiesce());
 
     // Verify slave has the data
     EXPECT_EQ("value1", slave1->read("key1"));
@@ -77,7 +74,7 @@ TEST_F(NodeTest, TestSlaveNodeFailureAndRecovery) {
 
     // Bring slave back up
     slave1->goUp(); // This should trigger recovery
-    std::this_thread::sleep_for(2s); // Wait for recovery
+    ASSERT_TRUE(master->quiesce()); // Wait for recovery
 
     // Verify slave has caught up with all data
     EXPECT_TRUE(slave1->isUp());
@@ -111,7 +108,7 @@ TEST_F(NodeTest, TestLogEntryReplication) {
         master->write("log-key-" + std::to_string(i), "log-value-" + std::to_string(i));
     }
 
-    std::this_thread::sleep_for(1s);
+    ASSERT_TRUE(master->quiesce());
 
     // Get log entries from master after index 0
     auto masterLogEntries = master->getLogEntriesAfter(0);
@@ -127,4 +124,36 @@ TEST_F(NodeTest, TestLogEntryReplication) {
         EXPECT_EQ(masterLogEntries[i].getKey(), slaveLogEntries[i].getKey());
         EXPECT_EQ(masterLogEntries[i].getValue(), slaveLogEntries[i].getValue());
     }
-}
\ No newline at end of file
+
+    // Each slave's acknowledgement watermark reached the end of the log
+    EXPECT_EQ(master->getLastLogIndex(), master->getReplicatedIndex("test-slave-1"));
+    EXPECT_EQ(master->getLastLogIndex(), master->getReplicatedIndex("test-slave-2"));
+    EXPECT_EQ(-1, master->getReplicatedIndex("unknown-slave"));
+}
+
+TEST_F(NodeTest, TestCoalescedCatchUp) {
+    slave2->setCoalescedCatchUp(false);
+    slave1->goDown();
+    slave2->goDown();
+
+    // An update-heavy backlog: 1000 operations on 10 keys, some deleted last
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_TRUE(master->write("hot-" + std::to_string(i % 10), "version-" + std::to_string(i)));
+    }
+    ASSERT_TRUE(master->deleteKey("hot-3"));
+    ASSERT_TRUE(master->deleteKey("hot-7"));
+    ASSERT_TRUE(master->quiesce());  // Nothing reaches the slaves except through recovery
+
+    slave1->goUp();
+    slave2->goUp();
+    ASSERT_TRUE(master->quiesce());
+
+    // Both end at the same state and log, but only the net effect was applied
+    EXPECT_EQ(master->getDataStore(), slave1->getDataStore());
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+    EXPECT_EQ(8u, slave1->getDataStore().size());
+    EXPECT_EQ(1002, slave1->getLastLogIndex());
+    EXPECT_EQ(1002u, slave1->getLogEntriesAfter(0).size());
+    EXPECT_EQ(1002u - 10, slave1->getCoalescedCount());
+    EXPECT_EQ(0u, slave2->getCoalescedCount());
+}
@@ -0,0 +1,116 @@
+// tests/ParallelApplyTest.cpp
+#include <gtest/gtest.h>
+#include "node/ParallelApplier.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <atomic>
+
+using namespace replication;
+
+class ParallelApplyTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("parallel-master");
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    // Writes, deletes and expiry deadlines over a small set of hot keys
+    static std::vector<model::LogEntry> sampleEntries(long first, long count) {
+        long deadline = model::LogEntry::currentTimeMillis() + 3600 * 1000;
+        std::vector<model::LogEntry> entries;
+        for (long i = first; i < first + count; i++) {
+            std::string key = "key-" + std::to_string(i % 97);
+            if (i % 13 == 0) {
+                entries.emplace_back(i, key, "", model::LogEntry::OperationType::DELETE, 1000 + i, 1);
+            } else if (i % 17 == 0) {
+                entries.emplace_back(i, key, std::to_string(deadline), model::LogEntry::OperationType::EXPIRE,
+                                     1000 + i, 1);
+            } else {
+                entries.emplace_back(i, key, "value-" + std::to_string(i), model::LogEntry::OperationType::WRITE,
+                                     1000 + i, 1);
+            }
+        }
+        return entries;
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+};
+
+TEST_F(ParallelApplyTest, TestApplierRunsEveryPartitionOnce) {
+    node::ParallelApplier applier(4);
+    EXPECT_EQ(4u, applier.getThreadCount());
+
+    for (size_t partitions : {1u, 3u, 4u, 50u}) {
+        std::vector<std::atomic<int>> runs(partitions);
+        for (int batch = 0; batch < 20; batch++) {
+            applier.run(partitions, [&](size_t partition) { runs[partition]++; });
+        }
+        for (size_t p = 0; p < partitions; p++) {
+            EXPECT_EQ(20, runs[p].load());
+        }
+    }
+}
+
+TEST_F(ParallelApplyTest, TestParallelMatchesSequential) {
+    auto sequential = std::make_shared<node::SlaveNode>("sequential", master);
+    auto parallel = std::make_shared<node::SlaveNode>("parallel", master);
+    auto coalesced = std::make_shared<node::SlaveNode>("parallel-coalesced", master);
+    parallel->setApplyParallelism(4);
+    coalesced->setApplyParallelism(3);
+
+    for (long first : {1L, 5001L}) {
+        auto entries = sampleEntries(first, 5000);
+        EXPECT_EQ(5000u, sequential->applyBatchFromLeader(entries, 1, false));
+        EXPECT_EQ(5000u, parallel->applyBatchFromLeader(entries, 1, false));
+        EXPECT_EQ(5000u, coalesced->applyBatchFromLeader(entries, 1, true));
+    }
+
+    // Same values, versions, deadlines and log, whatever the thread count
+    for (const auto& node : {parallel, coalesced}) {
+        EXPECT_EQ(sequential->getDataStore(), node->getDataStore());
+        EXPECT_EQ(10000, node->getLastLogIndex());
+        EXPECT_EQ(10000u, node->getLogEntriesAfter(0).size());
+        EXPECT_EQ(sequential->getExpiringKeyCount(), node->getExpiringKeyCount());
+        for (int k = 0; k < 97; k++) {
+            std::string key = "key-" + std::to_string(k);
+            std::string expectedValue, actualValue;
+            long expectedVersion = 0, actualVersion = 0;
+            EXPECT_EQ(sequential->readVersioned(key, expectedValue, expectedVersion),
+                      node->readVersioned(key, actualValue, actualVersion));
+            EXPECT_EQ(expectedVersion, actualVersion);
+            EXPECT_EQ(sequential->getExpiresAt(key), node->getExpiresAt(key));
+        }
+    }
+    EXPECT_GT(sequential->getExpiringKeyCount(), 0u);
+    EXPECT_EQ("value-9991", parallel->read("key-0"));  // The last write to the key wins
+
+    // Only the in-sequence prefix is applied
+    auto gap = sampleEntries(10002, 300);
+    EXPECT_EQ(0u, parallel->applyBatchFromLeader(gap, 1, false));
+    EXPECT_EQ(10000, parallel->getLastLogIndex());
+}
+
+TEST_F(ParallelApplyTest, TestReplicationWithParallelSlaves) {
+    auto slave1 = std::make_shared<node::SlaveNode>("parallel-slave-1", master);
+    auto slave2 = std::make_shared<node::SlaveNode>("parallel-slave-2", master);
+    slave1->setApplyParallelism(4);
+    master->registerSlave(slave1);
+    master->registerSlave(slave2);
+
+    // A slave that was down catches up in one large batch
+    slave2->goDown();
+    for (int i = 0; i < 2000; i++) {
+        ASSERT_TRUE(master->write("key-" + std::to_string(i % 150), std::to_string(i)));
+    }
+    slave2->setApplyParallelism(4);
+    slave2->goUp();
+    ASSERT_TRUE(master->quiesce());
+
+    EXPECT_EQ(master->getDataStore(), slave1->getDataStore());
+    EXPECT_EQ(master->getDataStore(), slave2->getDataStore());
+    EXPECT_EQ(2000, slave2->getLastLogIndex());
+    slave1->setApplyParallelism(1);
+}
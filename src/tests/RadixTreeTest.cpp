@@ -0,0 +1,206 @@
+// tests/RadixTreeTest.cpp
+#include <gtest/gtest.h>
+#include "storage/AdaptiveRadixTree.h"
+#include "storage/StripedStore.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include "system/ReplicationSystem.h"
+#include <map>
+#include <random>
+#include <algorithm>
+
+using namespace replication;
+
+class RadixTreeTest : public ::testing::Test {
+protected:
+    using Tree = storage::AdaptiveRadixTree<long>;
+    using Entries = std::vector<std::pair<std::string, long>>;
+
+    static Entries collectAfter(const Tree& tree, const std::string* after) {
+        Entries keys;
+        tree.forEachAfter(after, [&keys](const std::string& key, long& value) {
+            keys.emplace_back(key, value);
+            return true;
+        });
+        return keys;
+    }
+
+    static Entries collectPrefix(const Tree& tree, const std::string& prefix) {
+        Entries keys;
+        tree.forEachWithPrefix(prefix, [&keys](const std::string& key, long& value) {
+            keys.emplace_back(key, value);
+            return true;
+        });
+        return keys;
+    }
+
+    static std::string tenantKey(int tenant, int user) {
+        return "tenant/" + std::to_string(tenant) + "/user/" + std::to_string(user);
+    }
+};
+
+TEST_F(RadixTreeTest, TestMatchesOrderedMap) {
+    // Short random keys over a small alphabet give keys that are prefixes of
+    // others, long shared paths and nodes of every size, including bytes above 127
+    Tree tree;
+    std::map<std::string, long> expected;
+    std::mt19937 random(7);
+    const std::string alphabet = std::string("ab/\xff") + "0123456789";
+    for (int i = 0; i < 20000; i++) {
+        std::string key;
+        size_t length = random() % 6;
+        for (size_t c = 0; c < length; c++) {
+            key.push_back(random() % 3 == 0 ? static_cast<char>(random() % 256) : alphabet[random() % alphabet.size()]);
+        }
+        if (random() % 3 == 0) {
+            EXPECT_EQ(expected.erase(key) == 1, tree.erase(key));
+        } else {
+            auto [value, inserted] = tree.insert(key);
+            EXPECT_EQ(expected.count(key) == 0, inserted);
+            *value = i;
+            expected[key] = i;
+        }
+    }
+    ASSERT_EQ(expected.size(), tree.size());
+    EXPECT_EQ(Entries(expected.begin(), expected.end()), collectAfter(tree, nullptr));
+    for (const auto& [key, value] : expected) {
+        ASSERT_NE(nullptr, tree.find(key));
+        EXPECT_EQ(value, *tree.find(key));
+    }
+    EXPECT_EQ(nullptr, tree.find("not-a-key"));
+
+    // Bounds and prefixes that are, and are not, keys themselves
+    for (const std::string probe : {"", "a", "ab/", "b\xff", "9", "\xff\xff\xff\xff\xff\xff"}) {
+        Entries after(expected.upper_bound(probe), expected.end());
+        EXPECT_EQ(after, collectAfter(tree, &probe));
+        Entries withPrefix;
+        for (auto it = expected.lower_bound(probe); it != expected.end() && it->first.compare(0, probe.size(), probe) == 0;
+             ++it) {
+            withPrefix.push_back(*it);
+        }
+        EXPECT_EQ(withPrefix, collectPrefix(tree, probe));
+    }
+
+    // Removing every key frees every node
+    for (const auto& [key, value] : expected) {
+        ASSERT_TRUE(tree.erase(key));
+    }
+    EXPECT_EQ(0u, tree.size());
+    EXPECT_EQ(0u, tree.getFootprint());
+    EXPECT_EQ(0u, tree.getKeyBytes());
+}
+
+TEST_F(RadixTreeTest, TestNodesGrowAndShrink) {
+    Tree tree;
+    std::string key = "shared-prefix-longer-than-inline/";
+    for (int byte = 255; byte >= 0; byte--) {
+        *tree.insert(key + static_cast<char>(byte)).first = byte;
+    }
+    auto keys = collectAfter(tree, nullptr);
+    ASSERT_EQ(256u, keys.size());
+    for (int byte = 0; byte < 256; byte++) {
+        EXPECT_EQ(byte, keys[byte].second);
+    }
+    // The shared part is stored once: the prefix plus one byte per key
+    EXPECT_EQ(key.size() + 256, tree.getKeyBytes());
+
+    size_t full = tree.getFootprint();
+    for (int byte = 0; byte < 255; byte++) {
+        ASSERT_TRUE(tree.erase(key + static_cast<char>(byte)));
+    }
+    EXPECT_LT(tree.getFootprint(), full / 10);
+    EXPECT_EQ(key.size() + 1, tree.getKeyBytes());
+    ASSERT_NE(nullptr, tree.find(key + '\xff'));
+
+    // A stop from the visitor ends the walk
+    int visited = 0;
+    tree.insert(key);
+    EXPECT_FALSE(tree.forEachAfter(nullptr, [&visited](const std::string&, long&) {
+        visited++;
+        return false;
+    }));
+    EXPECT_EQ(1, visited);
+}
+
+TEST_F(RadixTreeTest, TestRadixEngineUsesLessMemory) {
+    storage::StripedStore tree(4, storage::StripedStore::Engine::TREE);
+    storage::StripedStore radix(4, storage::StripedStore::Engine::RADIX);
+    for (int tenant = 0; tenant < 20; tenant++) {
+        for (int user = 0; user < 500; user++) {
+            tree.put(tenantKey(tenant, user), "v", user + 1);
+            radix.put(tenantKey(tenant, user), "v", user + 1);
+        }
+    }
+    EXPECT_EQ(tree.copyVersioned().size(), radix.copyVersioned().size());
+    EXPECT_EQ(tree.copy(), radix.copy());
+
+    // Long shared prefixes: under three quarters of the tree engine's bytes
+    EXPECT_LT(radix.getFootprint() * 4, tree.getFootprint() * 3);
+    auto usage = radix.getMemoryUsage();
+    EXPECT_EQ(10000u, usage.entryCount);
+    EXPECT_LT(usage.keyBytes, tree.getMemoryUsage().keyBytes / 2);
+    EXPECT_EQ(usage.keyBytes + usage.valueBytes + usage.overheadBytes, radix.getFootprint());
+
+    auto scanned = radix.scanPrefix("tenant/7/user/4");
+    ASSERT_EQ(111u, scanned.size());  // 4, 40-49 and 400-499
+    EXPECT_EQ(tenantKey(7, 4), scanned.front().first);
+    EXPECT_EQ(tenantKey(7, 499), scanned.back().first);
+    EXPECT_EQ(500, scanned.back().second.version);
+    auto fromTree = tree.scanPrefix("tenant/1", 30);
+    auto fromRadix = radix.scanPrefix("tenant/1", 30);
+    ASSERT_EQ(30u, fromRadix.size());
+    for (size_t i = 0; i < fromTree.size(); i++) {
+        EXPECT_EQ(fromTree[i].first, fromRadix[i].first);
+        EXPECT_EQ(fromTree[i].second.version, fromRadix[i].second.version);
+    }
+
+    // Switching engines keeps every key and its accounting
+    radix.setEngine(storage::StripedStore::Engine::TREE);
+    EXPECT_EQ(tree.getFootprint(), radix.getFootprint());
+    EXPECT_EQ(tree.copy(), radix.copy());
+    radix.clear();
+    EXPECT_EQ(0u, radix.getFootprint());
+}
+
+TEST_F(RadixTreeTest, TestScanPrefixAcrossNodesAndShards) {
+    auto master = std::make_shared<node::MasterNode>("radix-master");
+    auto slave = std::make_shared<node::SlaveNode>("radix-slave", master);
+    master->registerSlave(slave);
+    slave->setStorageEngine(storage::StripedStore::Engine::RADIX);
+    for (int user = 0; user < 50; user++) {
+        ASSERT_TRUE(master->write(tenantKey(1, user), std::to_string(user)));
+        ASSERT_TRUE(master->write(tenantKey(2, user), std::to_string(user)));
+    }
+    ASSERT_TRUE(master->deleteKey(tenantKey(1, 3)));
+    ASSERT_TRUE(master->quiesce());
+
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+    EXPECT_EQ(master->scanPrefix("tenant/1/"), slave->scanPrefix("tenant/1/"));
+    EXPECT_EQ(49u, slave->scanPrefix("tenant/1/").size());
+    auto limited = slave->scanPrefix("tenant/2/user/1", 5);
+    ASSERT_EQ(5u, limited.size());
+    EXPECT_EQ(tenantKey(2, 1), limited[0].first);
+    EXPECT_EQ(tenantKey(2, 10), limited[1].first);
+    master->shutdown();
+
+    system::ReplicationSystem system(2, 3);
+    system::StorageConfig storageConfig;
+    storageConfig.engine = storage::StripedStore::Engine::RADIX;
+    system.configureStorage(storageConfig);
+    for (int user = 0; user < 100; user++) {
+        ASSERT_TRUE(system.write(tenantKey(5, user), std::to_string(user)));
+    }
+    ASSERT_TRUE(system.quiesce());
+    EXPECT_EQ(storage::StripedStore::Engine::RADIX, system.getMaster(1)->getStorageEngine());
+
+    // Keys with the prefix are spread over all shards and come back merged
+    auto all = system.scanPrefix("tenant/5/");
+    ASSERT_EQ(100u, all.size());
+    for (size_t i = 1; i < all.size(); i++) {
+        EXPECT_LT(all[i - 1].first, all[i].first);
+    }
+    auto firstTen = system.scanPrefix("tenant/5/", 10);
+    ASSERT_EQ(10u, firstTen.size());
+    EXPECT_TRUE(std::equal(firstTen.begin(), firstTen.end(), all.begin()));
+    system.shutdown();
+}
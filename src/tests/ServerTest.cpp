@@ -0,0 +1,206 @@
+// tests/ServerTest.cpp
+#include <gtest/gtest.h>
+#include "server/ReplicationServer.h"
+#include "server/RespProtocol.h"
+#include "system/ReplicationSystem.h"
+#include <thread>
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+namespace {
+
+int connectToServer(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends the request and reads until `replies` complete replies have arrived
+std::string roundTrip(int fd, const std::string& request, int replies) {
+    ::send(fd, request.data(), request.size(), 0);
+    std::string input;
+    char buffer[4096];
+    while (true) {
+        size_t offset = 0;
+        int complete = 0;
+        while (complete < replies) {
+            size_t consumed = 0;
+            bool isError = false;
+            if (server::RespParser::skipReply(input.data() + offset, input.size() - offset,
+                                              consumed, isError) != server::RespParser::Status::COMPLETE) {
+                break;
+            }
+            offset += consumed;
+            complete++;
+        }
+        if (complete == replies) {
+            return input;
+        }
+        ssize_t bytesRead = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0) {
+            return input;
+        }
+        input.append(buffer, static_cast<size_t>(bytesRead));
+    }
+}
+
+} // namespace
+
+TEST(RespProtocolTest, TestParseArrayCommand) {
+    std::string input = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n";
+    std::vector<std::string> args;
+    size_t consumed = 0;
+
+    EXPECT_EQ(server::RespParser::Status::COMPLETE,
+              server::RespParser::parseCommand(input.data(), input.size(), args, consumed));
+    EXPECT_EQ(input.size(), consumed);
+    ASSERT_EQ(3, args.size());
+    EXPECT_EQ("SET", args[0]);
+    EXPECT_EQ("key", args[1]);
+    EXPECT_EQ("value", args[2]);
+}
+
+TEST(RespProtocolTest, TestParseInlineAndIncomplete) {
+    std::vector<std::string> args;
+    size_t consumed = 0;
+
+    std::string inlineCommand = "GET  user1\r\n";
+    EXPECT_EQ(server::RespParser::Status::COMPLETE,
+              server::RespParser::parseCommand(inlineCommand.data(), inlineCommand.size(), args, consumed));
+    ASSERT_EQ(2, args.size());
+    EXPECT_EQ("user1", args[1]);
+
+    // Every strict prefix of a command must report INCOMPLETE
+    std::string command;
+    server::RespWriter::appendCommand(command, {"MGET", "a", "b"});
+    for (size_t length = 1; length < command.size(); length++) {
+        EXPECT_EQ(server::RespParser::Status::INCOMPLETE,
+                  server::RespParser::parseCommand(command.data(), length, args, consumed));
+    }
+
+    std::string invalid = "*1\r\n+OK\r\n";
+    EXPECT_EQ(server::RespParser::Status::ERROR,
+              server::RespParser::parseCommand(invalid.data(), invalid.size(), args, consumed));
+
+    // Header lines that never end, and bulk strings too large to buffer, are refused
+    std::string endlessArray = "*" + std::string(70 * 1024, '1');
+    EXPECT_EQ(server::RespParser::Status::ERROR,
+              server::RespParser::parseCommand(endlessArray.data(), endlessArray.size(), args, consumed));
+    std::string endlessBulk = "*1\r\n$" + std::string(70 * 1024, '1');
+    EXPECT_EQ(server::RespParser::Status::ERROR,
+              server::RespParser::parseCommand(endlessBulk.data(), endlessBulk.size(), args, consumed));
+    std::string hugeBulk = "*1\r\n$1073741824\r\n";
+    EXPECT_EQ(server::RespParser::Status::ERROR,
+              server::RespParser::parseCommand(hugeBulk.data(), hugeBulk.size(), args, consumed));
+}
+
+TEST(RespProtocolTest, TestSkipReply) {
+    std::string replies = "+OK\r\n$-1\r\n*2\r\n$1\r\na\r\n:5\r\n-ERR bad\r\n";
+    size_t offset = 0;
+    int count = 0;
+    bool sawError = false;
+    while (offset < replies.size()) {
+        size_t consumed = 0;
+        bool isError = false;
+        ASSERT_EQ(server::RespParser::Status::COMPLETE,
+                  server::RespParser::skipReply(replies.data() + offset, replies.size() - offset,
+                                                consumed, isError));
+        offset += consumed;
+        sawError = sawError || isError;
+        count++;
+    }
+    EXPECT_EQ(4, count);
+    EXPECT_TRUE(sawError);
+}
+
+TEST(ReplicationServerTest, TestPipelinedRequests) {
+    system::ReplicationSystem replicationSystem(2);
+    server::ServerConfig config;
+    config.port = 0;
+    server::ReplicationServer server(replicationSystem, config);
+    ASSERT_TRUE(server.start());
+
+    int fd = connectToServer(server.getPort());
+    ASSERT_GE(fd, 0);
+
+    // Several writes pipelined in a single send
+    std::string request;
+    server::RespWriter::appendCommand(request, {"SET", "k1", "v1"});
+    server::RespWriter::appendCommand(request, {"SET", "k2", "v2"});
+    server::RespWriter::appendCommand(request, {"SET", "k3", "v3"});
+    server::RespWriter::appendCommand(request, {"PING"});
+    EXPECT_EQ("+OK\r\n+OK\r\n+OK\r\n+PONG\r\n", roundTrip(fd, request, 4));
+
+    ASSERT_TRUE(replicationSystem.quiesce()); // Wait for replication
+
+    request.clear();
+    server::RespWriter::appendCommand(request, {"GET", "k1"});
+    server::RespWriter::appendCommand(request, {"MGET", "k2", "missing", "k3"});
+    server::RespWriter::appendCommand(request, {"DEL", "k1", "missing"});
+    EXPECT_EQ("$2\r\nv1\r\n*3\r\n$2\r\nv2\r\n$-1\r\n$2\r\nv3\r\n:1\r\n", roundTrip(fd, request, 3));
+
+    EXPECT_EQ("-ERR unknown command 'FLUSHALL'\r\n", roundTrip(fd, "FLUSHALL\r\n", 1));
+
+    // An empty value is a value, not a missing key
+    request.clear();
+    server::RespWriter::appendCommand(request, {"SET", "empty", ""});
+    EXPECT_EQ("+OK\r\n", roundTrip(fd, request, 1));
+    ASSERT_TRUE(replicationSystem.quiesce());
+    request.clear();
+    server::RespWriter::appendCommand(request, {"GET", "empty"});
+    server::RespWriter::appendCommand(request, {"MGET", "empty", "missing"});
+    EXPECT_EQ("$0\r\n\r\n*2\r\n$0\r\n\r\n$-1\r\n", roundTrip(fd, request, 2));
+
+    request.clear();
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "PX", "60000"});
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "EX", "0"});
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "KEEP", "1"});
+    EXPECT_EQ("+OK\r\n-ERR invalid expire time in 'set' command\r\n-ERR syntax error\r\n",
+              roundTrip(fd, request, 3));
+    EXPECT_GT(replicationSystem.getMaster(replicationSystem.getShardForKey("temp"))->getExpiresAt("temp"), 0);
+
+    // TTLs whose milliseconds or deadline would overflow are refused
+    request.clear();
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "EX", "9223372036854775"});
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "EX", "9223372036854776"});
+    server::RespWriter::appendCommand(request, {"SET", "temp", "v", "PX", "9223372036854775807"});
+    EXPECT_EQ("-ERR invalid expire time in 'set' command\r\n"
+              "-ERR value is not an integer or out of range\r\n"
+              "-ERR invalid expire time in 'set' command\r\n",
+              roundTrip(fd, request, 3));
+
+    request.clear();
+    server::RespWriter::appendCommand(request, {"INCR", "visits"});
+    server::RespWriter::appendCommand(request, {"INCRBY", "visits", "10"});
+    server::RespWriter::appendCommand(request, {"DECR", "visits"});
+    server::RespWriter::appendCommand(request, {"APPEND", "visits", "x"});
+    server::RespWriter::appendCommand(request, {"INCR", "visits"});
+    EXPECT_EQ(":1\r\n:11\r\n:10\r\n:3\r\n-ERR value is not an integer or out of range\r\n",
+              roundTrip(fd, request, 5));
+
+    // The smallest integer has no negation to decrement by
+    request.clear();
+    server::RespWriter::appendCommand(request, {"DECRBY", "counter", "-9223372036854775808"});
+    server::RespWriter::appendCommand(request, {"INCRBY", "counter", "-9223372036854775808"});
+    EXPECT_EQ("-ERR value is not an integer or out of range\r\n:-9223372036854775808\r\n",
+              roundTrip(fd, request, 2));
+
+    ::close(fd);
+    server.stop();
+    EXPECT_FALSE(server.isRunning());
+    replicationSystem.shutdown();
+}
@@ -0,0 +1,110 @@
+// tests/ShardingTest.cpp
+#include <gtest/gtest.h>
+#include "system/ReplicationSystem.h"
+#include "system/ShardRouter.h"
+#include <thread>
+#include <chrono>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+TEST(ShardRouterTest, TestHashPartitioningIsStableAndBalanced) {
+    auto router = system::ShardRouter::hashPartitioned(4);
+    EXPECT_EQ(4, router.getShardCount());
+
+    std::vector<int> counts(4, 0);
+    for (int i = 0; i < 4000; i++) {
+        std::string key = "user-" + std::to_string(i);
+        int shard = router.shardFor(key);
+        ASSERT_GE(shard, 0);
+        ASSERT_LT(shard, 4);
+        EXPECT_EQ(shard, router.shardFor(key));
+        counts[shard]++;
+    }
+    for (int count : counts) {
+        EXPECT_GT(count, 800);
+        EXPECT_LT(count, 1200);
+    }
+
+    // FNV-1a reference values keep the mapping stable across builds
+    EXPECT_EQ(14695981039346656037ULL, system::ShardRouter::hashKey(""));
+    EXPECT_EQ(0xaf63dc4c8601ec8cULL, system::ShardRouter::hashKey("a"));
+}
+
+TEST(ShardRouterTest, TestRangePartitioning) {
+    auto router = system::ShardRouter::rangePartitioned({"g", "p"});
+    EXPECT_EQ(3, router.getShardCount());
+    EXPECT_EQ(0, router.shardFor("apple"));
+    EXPECT_EQ(1, router.shardFor("g"));
+    EXPECT_EQ(1, router.shardFor("orange"));
+    EXPECT_EQ(2, router.shardFor("pear"));
+    EXPECT_THROW(system::ShardRouter::rangePartitioned({"p", "g"}), std::invalid_argument);
+}
+
+class ShardingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 3 shards with 2 slaves each
+        system = std::make_unique<system::ReplicationSystem>(2, 3);
+    }
+
+    void TearDown() override {
+        if (system) {
+            system->shutdown();
+        }
+    }
+
+    std::unique_ptr<system::ReplicationSystem> system;
+};
+
+TEST_F(ShardingTest, TestWritesGoOnlyToOwningShard) {
+    EXPECT_EQ(3, system->getShardCount());
+    EXPECT_EQ(9u, system->getNodesStatus().size());
+    EXPECT_EQ("master-1", system->getMaster(1)->getId());
+    EXPECT_EQ("slave-2-1", system->getSlaves(2)[1]->getId());
+
+    for (int i = 0; i < 30; i++) {
+        EXPECT_TRUE(system->write("key" + std::to_string(i), "value" + std::to_string(i)));
+    }
+
+    // Every shard keeps its own log with its own index sequence
+    long totalEntries = 0;
+    for (int s = 0; s < system->getShardCount(); s++) {
+        auto logs = system->getLogs(s);
+        totalEntries += static_cast<long>(logs.size());
+        for (size_t i = 0; i < logs.size(); i++) {
+            EXPECT_EQ(static_cast<long>(i) + 1, logs[i].getId());
+            EXPECT_EQ(s, system->getShardForKey(logs[i].getKey()));
+        }
+    }
+    EXPECT_EQ(30, totalEntries);
+    EXPECT_EQ(30u, system->getLogs().size());
+
+    ASSERT_TRUE(system->quiesce()); // Wait for replication
+    EXPECT_EQ("value7", system->read("key7"));
+    EXPECT_EQ(30u, system->getDataStore().size());
+}
+
+TEST_F(ShardingTest, TestCrossShardMultiGet) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 12; i++) {
+        keys.push_back("mkey" + std::to_string(i));
+        EXPECT_TRUE(system->write(keys.back(), "mvalue" + std::to_string(i)));
+    }
+    keys.push_back("missing");
+    ASSERT_TRUE(system->quiesce()); // Wait for replication
+
+    auto values = system->multiGet(keys);
+    ASSERT_EQ(keys.size(), values.size());
+    for (int i = 0; i < 12; i++) {
+        EXPECT_EQ("mvalue" + std::to_string(i), values[i]);
+    }
+    EXPECT_EQ("", values.back());
+
+    std::vector<std::string> consistent;
+    ASSERT_TRUE(system->multiGetConsistent(keys, consistent));
+    EXPECT_EQ(values, consistent);
+
+    EXPECT_TRUE(system->deleteKey("mkey3"));
+    EXPECT_FALSE(system->deleteKey("mkey3"));
+}
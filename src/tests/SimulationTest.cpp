@@ -0,0 +1,95 @@
+// tests/SimulationTest.cpp
+#include <gtest/gtest.h>
+#include "sim/Simulation.h"
+#include "sim/ConsistencyChecker.h"
+
+using namespace replication;
+
+TEST(SimulationTest, TestExecutorOrdersTasksByVirtualTime) {
+    sim::VirtualClock clock;
+    sim::SimulatedExecutor executor(clock, 42, 1000);
+
+    std::vector<int> order;
+    for (int i = 0; i < 20; i++) {
+        executor.execute([&order, i]() { order.push_back(i); });
+    }
+    EXPECT_EQ(20u, executor.getPendingCount());
+    EXPECT_EQ(20u, executor.runUntilQuiescent(100));
+    EXPECT_EQ(20u, order.size());
+    EXPECT_LE(clock.now(), 1000);
+
+    // The same seed replays the same interleaving
+    sim::VirtualClock otherClock;
+    sim::SimulatedExecutor replay(otherClock, 42, 1000);
+    std::vector<int> replayOrder;
+    for (int i = 0; i < 20; i++) {
+        replay.execute([&replayOrder, i]() { replayOrder.push_back(i); });
+    }
+    replay.runUntilQuiescent(100);
+    EXPECT_EQ(order, replayOrder);
+    EXPECT_EQ(clock.now(), otherClock.now());
+}
+
+TEST(SimulationTest, TestSameSeedReplaysIdentically) {
+    sim::SimulationConfig config;
+    config.seed = 7;
+    config.faults = sim::Simulation::randomFaults(config.seed, config.numSlaves, 150, 4, true);
+
+    sim::SimulationResult first = sim::Simulation(config).run();
+    sim::SimulationResult second = sim::Simulation(config).run();
+    EXPECT_TRUE(first.consistent);
+    EXPECT_EQ(first.fingerprint, second.fingerprint);
+    EXPECT_EQ(first.tasksRun, second.tasksRun);
+    EXPECT_EQ(first.virtualTimeMicros, second.virtualTimeMicros);
+    EXPECT_EQ(first.operationsAccepted, second.operationsAccepted);
+
+    config.seed = 8;
+    EXPECT_NE(first.fingerprint, sim::Simulation(config).run().fingerprint);
+}
+
+TEST(SimulationTest, TestFaultsFireAtLogIndices) {
+    sim::SimulationConfig config;
+    config.numOperations = 60;
+    config.deleteRatio = 0.0;
+    config.faults = {
+        {10, 0, sim::FaultEvent::Action::NODE_DOWN},
+        {30, 0, sim::FaultEvent::Action::NODE_UP},
+        {40, -1, sim::FaultEvent::Action::NODE_DOWN},
+    };
+
+    sim::SimulationResult result = sim::Simulation(config).run();
+    EXPECT_TRUE(result.consistent);
+    // The master outage ends after maxMasterOutageOps rejected writes
+    EXPECT_EQ(4u, result.faultsInjected);
+    EXPECT_EQ(config.maxMasterOutageOps, result.operationsRejected);
+    EXPECT_EQ(result.operationsAccepted, result.finalLogIndex);
+}
+
+TEST(SimulationTest, TestRandomFaultScenariosStayConsistent) {
+    for (uint64_t seed = 1; seed <= 200; seed++) {
+        sim::SimulationConfig config;
+        config.seed = seed;
+        config.numOperations = 100;
+        config.faults = sim::Simulation::randomFaults(seed, config.numSlaves, 100, 3, true);
+
+        sim::SimulationResult result = sim::Simulation(config).run();
+        ASSERT_TRUE(result.consistent) << "seed " << seed << ": " << result.violations.front();
+    }
+}
+
+TEST(SimulationTest, TestCheckerDetectsDivergence) {
+    sim::SimulationConfig config;
+    config.numOperations = 20;
+    config.deleteRatio = 0.0;
+    sim::Simulation simulation(config);
+    ASSERT_TRUE(simulation.run().consistent);
+
+    // A slave that applies an entry the master never logged must be reported
+    auto slave = simulation.getSlaves()[1];
+    model::LogEntry rogue(simulation.getMaster()->getLastLogIndex() + 1, "rogue", "value");
+    ASSERT_TRUE(slave->applyLogEntry(rogue));
+
+    auto violations = sim::ConsistencyChecker::check(*simulation.getMaster(), simulation.getSlaves());
+    ASSERT_FALSE(violations.empty());
+    EXPECT_NE(std::string::npos, violations.front().find("slave-1"));
+}
@@ -0,0 +1,216 @@
+// tests/SnapshotTest.cpp
+#include <gtest/gtest.h>
+#include "storage/SnapshotReader.h"
+#include "storage/SnapshotWriter.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+class SnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("snapshot-test-" + std::to_string(::getpid()) + "-" +
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".snap")).string();
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    static std::string keyFor(int i) {
+        char key[32];
+        std::snprintf(key, sizeof(key), "key-%06d", i);
+        return key;
+    }
+
+    bool writeSample(int count, long lastIndex, size_t blockSize) {
+        storage::SnapshotWriter writer(path, lastIndex, blockSize);
+        if (!writer.open()) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (!writer.add(keyFor(i), "value-" + std::to_string(i))) {
+                return false;
+            }
+        }
+        return writer.finish();
+    }
+
+    std::string path;
+};
+
+TEST_F(SnapshotTest, TestWriteAndLookup) {
+    ASSERT_TRUE(writeSample(5000, 42, 1024));
+
+    auto reader = storage::SnapshotReader::open(path);
+    ASSERT_NE(nullptr, reader);
+    EXPECT_EQ(42, reader->getLastIndex());
+    EXPECT_EQ(5000u, reader->getEntryCount());
+    EXPECT_GT(reader->getBlockCount(), 10u);
+
+    std::string value;
+    EXPECT_TRUE(reader->get(keyFor(0), value));
+    EXPECT_EQ("value-0", value);
+    EXPECT_TRUE(reader->get(keyFor(2718), value));
+    EXPECT_EQ("value-2718", value);
+    EXPECT_TRUE(reader->get(keyFor(4999), value));
+    EXPECT_FALSE(reader->get("aaa", value));
+    EXPECT_FALSE(reader->get("key-002718x", value));
+    EXPECT_FALSE(reader->get("zzz", value));
+}
+
+TEST_F(SnapshotTest, TestRejectsOutOfOrderKeys) {
+    storage::SnapshotWriter writer(path, 1);
+    ASSERT_TRUE(writer.open());
+    EXPECT_TRUE(writer.add("b", "1"));
+    EXPECT_FALSE(writer.add("a", "2"));
+    EXPECT_FALSE(writer.finish());
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST_F(SnapshotTest, TestChecksumsDetectCorruption) {
+    ASSERT_TRUE(writeSample(1000, 7, 1024));
+
+    // Flip one byte inside the first data block
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(storage::snapshot::kHeaderSize + 20));
+        file.put('#');
+    }
+
+    auto reader = storage::SnapshotReader::open(path);
+    ASSERT_NE(nullptr, reader);
+    std::string value;
+    EXPECT_FALSE(reader->get(keyFor(0), value));
+    EXPECT_TRUE(reader->get(keyFor(999), value));
+
+    // A damaged header makes the whole file unusable
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(storage::snapshot::kLastIndexOffset);
+        file.put('\x7f');
+    }
+    EXPECT_EQ(nullptr, storage::SnapshotReader::open(path));
+}
+
+TEST_F(SnapshotTest, TestSlaveBootstrapsFromSnapshot) {
+    auto master = std::make_shared<node::MasterNode>("snap-master");
+    for (int i = 0; i < 200; i++) {
+        master->write(keyFor(i), "value-" + std::to_string(i));
+    }
+    ASSERT_TRUE(master->writeSnapshot(path));
+
+    // Changes after the snapshot must come from the log tail
+    master->write(keyFor(0), "updated");
+    master->deleteKey(keyFor(1));
+    master->write("late-key", "late-value");
+
+    auto slave = std::make_shared<node::SlaveNode>("snap-slave", master);
+    ASSERT_TRUE(slave->bootstrapFromSnapshot(path));
+    master->registerSlave(slave);
+
+    // Snapshot contents are readable straight away
+    EXPECT_EQ("value-150", slave->read(keyFor(150)));
+
+    ASSERT_TRUE(master->quiesce()); // Wait for background load and recovery
+    EXPECT_FALSE(slave->isLoadingSnapshot());
+    EXPECT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    EXPECT_EQ("updated", slave->read(keyFor(0)));
+    EXPECT_EQ("", slave->read(keyFor(1)));
+    EXPECT_EQ("late-value", slave->read("late-key"));
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+}
+
+TEST_F(SnapshotTest, TestCorruptSnapshotFallsBackToMasterState) {
+    auto master = std::make_shared<node::MasterNode>("snap-corrupt-master");
+    const int keys = 5000;  // Several default-sized blocks
+    for (int i = 0; i < keys; i++) {
+        ASSERT_TRUE(master->write(keyFor(i), "value-" + std::to_string(i)));
+    }
+    ASSERT_TRUE(master->writeSnapshot(path));
+    ASSERT_GT(storage::SnapshotReader::open(path)->getBlockCount(), 1u);
+    master->write("late-key", "late-value");
+
+    // Flip one byte inside the first data block
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(storage::snapshot::kHeaderSize + 20));
+        file.put('#');
+    }
+
+    auto slave = std::make_shared<node::SlaveNode>("snap-corrupt-slave", master);
+    ASSERT_TRUE(slave->bootstrapFromSnapshot(path));
+    master->registerSlave(slave);
+
+    // The slave drops the snapshot and copies the master's state instead
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!(slave->isUp() && !slave->isLoadingSnapshot() &&
+             slave->getLastLogIndex() == master->getLastLogIndex() &&
+             slave->getDataStore() == master->getDataStore()) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_TRUE(slave->isUp());
+    EXPECT_FALSE(slave->isLoadingSnapshot());
+    EXPECT_EQ(master->getLastLogIndex(), slave->getLastLogIndex());
+    EXPECT_EQ("value-0", slave->read(keyFor(0)));
+    EXPECT_EQ("late-value", slave->read("late-key"));
+    EXPECT_EQ(master->getDataStore(), slave->getDataStore());
+}
+
+TEST_F(SnapshotTest, TestSnapshotWhileWritesContinue) {
+    auto master = std::make_shared<node::MasterNode>("snap-cow-master");
+    const int keys = 500;
+    for (int i = 0; i < keys; i++) {
+        ASSERT_TRUE(master->write(keyFor(i), "round-0"));
+    }
+
+    // Log ID r * keys + k + 1 writes round r of key k
+    std::thread writer([&] {
+        for (int round = 1; round < 20; round++) {
+            for (int i = 0; i < keys; i++) {
+                master->write(keyFor(i), "round-" + std::to_string(round));
+            }
+        }
+    });
+    while (master->getLastLogIndex() < 2 * keys) {
+        std::this_thread::yield();
+    }
+    ASSERT_TRUE(master->writeSnapshot(path));
+    writer.join();
+
+    auto reader = storage::SnapshotReader::open(path);
+    ASSERT_NE(nullptr, reader);
+    long index = reader->getLastIndex();
+    EXPECT_GE(index, 2L * keys);
+    ASSERT_EQ(static_cast<uint64_t>(keys), reader->getEntryCount());
+    for (int i = 0; i < keys; i++) {
+        long round = (index - i - 1) / keys;
+        std::string value;
+        ASSERT_TRUE(reader->get(keyFor(i), value));
+        EXPECT_EQ("round-" + std::to_string(round), value) << "at log index " << index;
+    }
+
+    // An image opened before later writes streams the state as of its index
+    auto image = master->openSnapshotImage();
+    ASSERT_NE(nullptr, image);
+    EXPECT_EQ(20L * keys, image->getIndex());
+    ASSERT_TRUE(master->write(keyFor(0), "after"));
+    ASSERT_TRUE(master->deleteKey(keyFor(1)));
+    size_t count = 0;
+    image->forEach([&](const std::string&, const std::string& value) {
+        EXPECT_EQ("round-19", value);
+        count++;
+        return true;
+    });
+    EXPECT_EQ(static_cast<size_t>(keys), count);
+    master->shutdown();
+}
@@ -0,0 +1,92 @@
+// tests/StalenessTest.cpp
+#include <gtest/gtest.h>
+#include "system/ReplicationSystem.h"
+#include <thread>
+#include <chrono>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+class StalenessTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        system = std::make_unique<system::ReplicationSystem>(2);
+        system->configureFailover(system::FailoverConfig{false});
+        slaves = system->getSlaves();
+
+        ASSERT_TRUE(system->write("old", "value"));
+        ASSERT_TRUE(system->quiesce());
+
+        // slave-0 misses the next writes but stays up without recovering,
+        // leaving it a known number of entries behind
+        slaves[0]->goDown();
+        ASSERT_TRUE(system->write("fresh-1", "value"));
+        ASSERT_TRUE(system->write("fresh-2", "value"));
+        ASSERT_TRUE(system->quiesce());
+        slaves[0]->node::AbstractNode::goUp();
+    }
+
+    std::unique_ptr<system::ReplicationSystem> system;
+    std::vector<std::shared_ptr<node::SlaveNode>> slaves;
+};
+
+TEST_F(StalenessTest, TestWatermarksArePublished) {
+    auto master = system->getMaster();
+    EXPECT_EQ(3, master->getLastLogIndex());
+    EXPECT_EQ(1, slaves[0]->getLastLogIndex());
+    EXPECT_EQ(3, slaves[1]->getLastLogIndex());
+    EXPECT_EQ(master->getLastAppliedTimestamp(), slaves[1]->getLastAppliedTimestamp());
+    EXPECT_LE(slaves[0]->getLastAppliedTimestamp(), slaves[1]->getLastAppliedTimestamp());
+    EXPECT_GT(slaves[0]->getLastAppliedTimestamp(), 0);
+}
+
+TEST_F(StalenessTest, TestEntryBoundExcludesLaggingSlave) {
+    system::StalenessBound bound;
+    bound.maxLagEntries = 0;
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ("value", system->read("fresh-2", bound));
+    }
+
+    // A loose bound admits the lagging slave again
+    bound.maxLagEntries = 2;
+    bool sawStale = false;
+    for (int i = 0; i < 50 && !sawStale; i++) {
+        sawStale = system->read("fresh-2", bound).empty();
+    }
+    EXPECT_TRUE(sawStale);
+}
+
+TEST_F(StalenessTest, TestTimeBoundExcludesLaggingSlave) {
+    std::this_thread::sleep_for(100ms);
+
+    system::StalenessBound bound;
+    bound.maxLagMillis = 50;
+    for (int i = 0; i < 20; i++) {
+        EXPECT_EQ("value", system->read("fresh-1", bound));
+    }
+}
+
+TEST_F(StalenessTest, TestFallsBackToMasterWhenNoSlaveIsFresh) {
+    slaves[1]->goDown();
+
+    system::StalenessBound bound;
+    bound.maxLagEntries = 0;
+    EXPECT_EQ("value", system->read("fresh-2", bound));
+
+    // Without a bound the lagging slave answers, and does not have the key
+    EXPECT_EQ("", system->read("fresh-2"));
+}
+
+TEST_F(StalenessTest, TestBoundHoldsWhileMasterIsDown) {
+    slaves[1]->goDown();
+    system->getMaster()->goDown();
+
+    // The lagging slave is still measured against what the master wrote, so nothing can answer
+    system::StalenessBound bound;
+    bound.maxLagEntries = 0;
+    EXPECT_EQ("", system->read("old", bound));
+
+    // A bound it meets admits it
+    bound.maxLagEntries = 2;
+    EXPECT_EQ("value", system->read("old", bound));
+}
@@ -0,0 +1,148 @@
+// tests/StripedStoreTest.cpp
+#include <gtest/gtest.h>
+#include "storage/StripedStore.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+using namespace replication;
+
+TEST(StripedStoreTest, TestBasicOperations) {
+    storage::StripedStore store(8);
+    EXPECT_EQ(8u, store.getStripeCount());
+
+    std::string value;
+    EXPECT_FALSE(store.get("a", value));
+    store.put("a", "1");
+    store.put("b", "2");
+    EXPECT_TRUE(store.get("a", value));
+    EXPECT_EQ("1", value);
+    EXPECT_FALSE(store.putIfAbsent("a", "x"));
+    EXPECT_TRUE(store.putIfAbsent("c", "3"));
+    EXPECT_EQ(3u, store.size());
+
+    EXPECT_TRUE(store.erase("b"));
+    EXPECT_FALSE(store.erase("b"));
+    EXPECT_FALSE(store.contains("b"));
+
+    std::map<std::string, std::string> expected = {{"a", "1"}, {"c", "3"}};
+    EXPECT_EQ(expected, store.copy());
+
+    store.clear();
+    EXPECT_EQ(0u, store.size());
+}
+
+TEST(StripedStoreTest, TestImageIgnoresLaterWrites) {
+    storage::StripedStore store(4);
+    for (int i = 0; i < 1000; i++) {
+        store.put("key-" + std::to_string(1000 + i), "old", i + 1);
+    }
+    auto image = store.openImage();
+    ASSERT_NE(nullptr, image);
+    EXPECT_EQ(nullptr, store.openImage());  // One image at a time
+
+    // Overwrites, erases and inserts after the image opened
+    for (int i = 0; i < 1000; i += 2) {
+        store.put("key-" + std::to_string(1000 + i), "new", 2000 + i);
+        store.put("key-" + std::to_string(1000 + i), "newer", 3000 + i);
+    }
+    store.erase("key-1001", 5000);
+    store.put("added", "x", 5001);
+    EXPECT_TRUE(store.putIfAbsent("added-too", "y", 5002));
+    EXPECT_EQ(503u, image->getPreservedCount());  // Each changed key was copied once
+
+    std::vector<std::string> keys;
+    EXPECT_TRUE(image->forEach([&](const std::string& key, const storage::StripedStore::VersionedValue& entry) {
+        EXPECT_EQ("old", entry.value);
+        keys.push_back(key);
+        return true;
+    }));
+    ASSERT_EQ(1000u, keys.size());
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+    // Clearing the store hands the remaining keys to the image
+    store.clear();
+    size_t count = 0;
+    image->forEach([&](const std::string&, const storage::StripedStore::VersionedValue&) { return ++count < 10; });
+    EXPECT_EQ(10u, count);
+    keys.clear();
+    image->forEach([&](const std::string& key, const storage::StripedStore::VersionedValue&) {
+        keys.push_back(key);
+        return true;
+    });
+    EXPECT_EQ(1000u, keys.size());
+
+    image.reset();
+    store.put("after", "z");
+    auto next = store.openImage();
+    ASSERT_NE(nullptr, next);
+    EXPECT_EQ(0u, next->getPreservedCount());
+}
+
+TEST(StripedStoreTest, TestConcurrentReadsAndWrites) {
+    storage::StripedStore store;
+    const int writers = 4;
+    const int keysPerWriter = 2000;
+    std::atomic<bool> done(false);
+    std::atomic<long> hits(0);
+
+    std::thread reader([&]() {
+        std::string value;
+        while (!done) {
+            for (int i = 0; i < 100; i++) {
+                if (store.get("w0-" + std::to_string(i), value)) {
+                    hits++;
+                }
+            }
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; w++) {
+        threads.emplace_back([&store, w, keysPerWriter]() {
+            for (int i = 0; i < keysPerWriter; i++) {
+                store.put("w" + std::to_string(w) + "-" + std::to_string(i), std::to_string(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(static_cast<size_t>(writers * keysPerWriter), store.size());
+    std::string value;
+    EXPECT_TRUE(store.get("w3-1999", value));
+    EXPECT_EQ("1999", value);
+}
+
+TEST(StripedStoreTest, TestSlaveAppliesStayOrderedUnderConcurrentReads) {
+    auto master = std::make_shared<node::MasterNode>("master");
+    auto slave = std::make_shared<node::SlaveNode>("slave", master);
+
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        while (!done) {
+            slave->read("key-" + std::to_string(slave->getLastLogIndex() % 50));
+        }
+    });
+
+    // Apply directly, in order, while reads hit other stripes
+    for (long i = 1; i <= 500; i++) {
+        model::LogEntry entry(i, "key-" + std::to_string(i % 50), std::to_string(i),
+                              model::LogEntry::OperationType::WRITE);
+        ASSERT_TRUE(slave->applyLogEntry(entry));
+    }
+    done = true;
+    reader.join();
+
+    // A gap is rejected rather than applied out of order
+    model::LogEntry gap(502, "key-x", "v", model::LogEntry::OperationType::WRITE);
+    EXPECT_FALSE(slave->applyLogEntry(gap));
+    EXPECT_EQ(500, slave->getLastLogIndex());
+    EXPECT_EQ("500", slave->read("key-0"));
+    EXPECT_EQ(500u, slave->getLogEntriesAfter(0).size());
+}
@@ -0,0 +1,143 @@
+// tests/SubscriptionTest.cpp
+#include <gtest/gtest.h>
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include "system/ReplicationSystem.h"
+#include <mutex>
+#include <thread>
+
+using namespace replication;
+
+class SubscriptionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        master = std::make_shared<node::MasterNode>("cdc-master");
+        slave = std::make_shared<node::SlaveNode>("cdc-slave", master);
+        master->registerSlave(slave);
+    }
+
+    void TearDown() override {
+        master->shutdown();
+    }
+
+    // Collects delivered entry IDs; returning false after `limit` of them disconnects
+    node::ChangeSubscription::Callback collect(std::vector<long>& ids, size_t limit = SIZE_MAX) {
+        return [this, &ids, limit](const std::vector<model::LogEntry>& entries) {
+            std::lock_guard<std::mutex> guard(mutex);
+            for (const auto& entry : entries) {
+                ids.push_back(entry.getId());
+            }
+            return ids.size() < limit;
+        };
+    }
+
+    static void expectSequence(const std::vector<long>& ids, long first, long last) {
+        ASSERT_EQ(static_cast<size_t>(last - first + 1), ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+            EXPECT_EQ(first + static_cast<long>(i), ids[i]);
+        }
+    }
+
+    std::shared_ptr<node::MasterNode> master;
+    std::shared_ptr<node::SlaveNode> slave;
+    std::mutex mutex;
+};
+
+TEST_F(SubscriptionTest, TestBackfillThenLiveEntries) {
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(master->write("key" + std::to_string(i), "v"));
+    }
+
+    // One subscriber starts from the beginning, one from the present
+    std::vector<long> all, live;
+    long fromStart = master->subscribe(0, collect(all));
+    long fromNow = master->subscribe(master->getLastLogIndex(), collect(live));
+    ASSERT_GT(fromStart, 0);
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&, t] {
+            for (int i = 0; i < 50; i++) {
+                master->write("w" + std::to_string(t), std::to_string(i));
+            }
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    ASSERT_TRUE(master->deleteKey("key0"));
+    ASSERT_TRUE(master->quiesce());
+
+    expectSequence(all, 1, 206);
+    expectSequence(live, 6, 206);
+    EXPECT_EQ(206, master->getSubscriptionCursor(fromStart));
+    EXPECT_TRUE(master->unsubscribe(fromNow));
+    EXPECT_FALSE(master->unsubscribe(fromNow));
+    EXPECT_EQ(-1, master->getSubscriptionCursor(fromNow));
+}
+
+TEST_F(SubscriptionTest, TestSlowSubscriberFallsBackToTheLog) {
+    std::vector<long> ids;
+    auto record = collect(ids);
+    long id = master->subscribe(0, [&](const std::vector<model::LogEntry>& entries) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return record(entries);
+    }, 8);
+
+    for (int i = 0; i < 300; i++) {
+        ASSERT_TRUE(master->write("hot", std::to_string(i)));
+    }
+    ASSERT_TRUE(master->quiesce());
+
+    // However often the stream overflowed, nothing was skipped or repeated
+    expectSequence(ids, 1, 300);
+    EXPECT_EQ(300, master->getSubscriptionCursor(id));
+}
+
+TEST_F(SubscriptionTest, TestResumeAfterDisconnect) {
+    std::vector<long> first;
+    long id = master->subscribe(0, collect(first, 10));
+    for (int i = 0; i < 25; i++) {
+        ASSERT_TRUE(master->write("k", std::to_string(i)));
+    }
+    ASSERT_TRUE(master->quiesce());
+
+    // The consumer hung up after 10 entries, so its subscription is gone
+    ASSERT_GE(first.size(), 10u);
+    EXPECT_EQ(-1, master->getSubscriptionCursor(id));
+    long resumeFrom = first.back();
+
+    for (int i = 25; i < 30; i++) {
+        ASSERT_TRUE(master->write("k", std::to_string(i)));
+    }
+    std::vector<long> resumed;
+    master->subscribe(resumeFrom, collect(resumed));
+    ASSERT_TRUE(master->quiesce());
+    expectSequence(resumed, resumeFrom + 1, 30);
+
+    master->goDown();
+    EXPECT_EQ(-1, master->subscribe(0, collect(resumed)));
+    master->goUp();
+}
+
+TEST_F(SubscriptionTest, TestSystemSubscribesPerShard) {
+    system::ReplicationSystem system(2, 2);
+    std::vector<std::vector<long>> ids(system.getShardCount());
+    for (int shard = 0; shard < system.getShardCount(); shard++) {
+        EXPECT_GT(system.subscribe(shard, 0, collect(ids[shard])), 0);
+    }
+
+    for (int i = 0; i < 20; i++) {
+        ASSERT_TRUE(system.write("key" + std::to_string(i), "v"));
+    }
+    ASSERT_TRUE(system.quiesce());
+
+    size_t total = 0;
+    for (int shard = 0; shard < system.getShardCount(); shard++) {
+        expectSequence(ids[shard], 1, static_cast<long>(system.getLogs(shard).size()));
+        total += ids[shard].size();
+    }
+    EXPECT_EQ(20u, total);
+    EXPECT_TRUE(system.unsubscribe(0, 1));
+    system.shutdown();
+}
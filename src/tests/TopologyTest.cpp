@@ -0,0 +1,138 @@
+// tests/TopologyTest.cpp
+#include <gtest/gtest.h>
+#include "system/ReplicationSystem.h"
+#include "node/MasterNode.h"
+#include "node/SlaveNode.h"
+#include <thread>
+#include <chrono>
+#include <memory>
+
+using namespace replication;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::unique_ptr<system::ReplicationSystem> makeSystem(int slaves, system::TopologyConfig::Type type,
+                                                     int fanout = 2) {
+    auto replicationSystem = std::make_unique<system::ReplicationSystem>(slaves);
+    system::FailoverConfig failover;
+    failover.enabled = false;
+    replicationSystem->configureFailover(failover);
+    system::TopologyConfig topology;
+    topology.type = type;
+    topology.fanout = fanout;
+    replicationSystem->configureTopology(topology);
+    return replicationSystem;
+}
+
+} // namespace
+
+TEST(TopologyTest, TestChainRelaysEveryEntry) {
+    auto replicationSystem = makeSystem(4, system::TopologyConfig::Type::CHAIN);
+    auto slaves = replicationSystem->getSlaves();
+    EXPECT_EQ(nullptr, slaves[0]->getUpstream());
+    for (size_t i = 1; i < slaves.size(); i++) {
+        EXPECT_EQ(slaves[i - 1], slaves[i]->getUpstream());
+        ASSERT_EQ(1u, slaves[i - 1]->getDownstream().size());
+    }
+
+    for (int i = 0; i < 100; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i % 10), std::to_string(i)));
+    }
+    ASSERT_TRUE(replicationSystem->deleteKey("key0"));
+    ASSERT_TRUE(replicationSystem->quiesce());
+
+    auto expected = replicationSystem->getMaster()->getDataStore();
+    for (const auto& slave : slaves) {
+        EXPECT_EQ(101, slave->getLastLogIndex());
+        EXPECT_EQ(expected, slave->getDataStore());
+    }
+    replicationSystem->shutdown();
+}
+
+TEST(TopologyTest, TestWideTreeKeepsMasterFanOutConstant) {
+    auto replicationSystem = makeSystem(52, system::TopologyConfig::Type::TREE, 3);
+    auto slaves = replicationSystem->getSlaves();
+
+    // Slave i is fed by slave i / 3 - 1; the master feeds only the first three
+    for (size_t i = 0; i < slaves.size(); i++) {
+        EXPECT_EQ(i < 3 ? nullptr : slaves[i / 3 - 1], slaves[i]->getUpstream());
+        EXPECT_LE(slaves[i]->getDownstream().size(), 3u);
+    }
+
+    for (int i = 0; i < 200; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i), "value"));
+    }
+    ASSERT_TRUE(replicationSystem->quiesce());
+    for (const auto& slave : slaves) {
+        EXPECT_EQ(200, slave->getLastLogIndex());
+        EXPECT_EQ(200u, slave->getDataStore().size());
+    }
+    replicationSystem->shutdown();
+}
+
+TEST(TopologyTest, TestFailedRelayIsBypassedAndRecoversFromUpstream) {
+    auto replicationSystem = makeSystem(3, system::TopologyConfig::Type::CHAIN);
+    auto master = replicationSystem->getMaster();
+    auto slaves = replicationSystem->getSlaves();
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i), "v"));
+    }
+    ASSERT_TRUE(replicationSystem->quiesce());
+
+    // With the middle relay down, the tail is fed directly by the head
+    slaves[1]->goDown();
+    for (int i = 10; i < 20; i++) {
+        ASSERT_TRUE(replicationSystem->write("key" + std::to_string(i), "v"));
+    }
+    ASSERT_TRUE(replicationSystem->quiesce());
+    EXPECT_EQ(20, slaves[2]->getLastLogIndex());
+
+    // Recovery comes from the nearest relay above, so it works without the master
+    master->goDown();
+    slaves[1]->goUp();
+    ASSERT_TRUE(slaves[1]->waitForIndex(20, 5s));
+    EXPECT_EQ(slaves[0]->getDataStore(), slaves[1]->getDataStore());
+
+    master->goUp();
+    ASSERT_TRUE(replicationSystem->write("after", "recovery"));
+    ASSERT_TRUE(replicationSystem->quiesce());
+    for (const auto& slave : slaves) {
+        EXPECT_EQ("recovery", slave->read("after"));
+    }
+    replicationSystem->shutdown();
+}
+
+TEST(TopologyTest, TestFailoverRebuildsChain) {
+    system::ReplicationSystem replicationSystem(3);
+    system::FailoverConfig failover;
+    failover.heartbeatInterval = 10ms;
+    failover.electionTimeout = 100ms;
+    replicationSystem.configureFailover(failover);
+    system::TopologyConfig topology;
+    topology.type = system::TopologyConfig::Type::CHAIN;
+    replicationSystem.configureTopology(topology);
+
+    ASSERT_TRUE(replicationSystem.write("before", "failover"));
+    ASSERT_TRUE(replicationSystem.quiesce());
+    auto oldMaster = replicationSystem.getMaster();
+    oldMaster->goDown();
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (replicationSystem.getMaster() == oldMaster && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(10ms);
+    }
+    ASSERT_NE(oldMaster, replicationSystem.getMaster());
+
+    // The two remaining slaves form a new chain under the new master
+    auto slaves = replicationSystem.getSlaves();
+    ASSERT_EQ(2u, slaves.size());
+    EXPECT_EQ(nullptr, slaves[0]->getUpstream());
+    EXPECT_EQ(slaves[0], slaves[1]->getUpstream());
+
+    ASSERT_TRUE(replicationSystem.write("after", "failover"));
+    ASSERT_TRUE(replicationSystem.quiesce());
+    EXPECT_EQ("failover", slaves[1]->read("before"));
+    EXPECT_EQ("failover", slaves[1]->read("after"));
+    replicationSystem.shutdown();
+}